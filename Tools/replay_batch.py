@@ -0,0 +1,365 @@
+#!/usr/bin/env python
+
+"""
+Replay a directory of ULog files through ekf2 and summarize the estimator output,
+e.g. to check a parameter change or an estimator change against a set of flight logs.
+
+Each log is replayed in lockstep mode (replay_mode=ekf2, see the replay module)
+with posix-configs/SITL/init/replay/ekf2_lockstep, in a separate px4 process and
+working directory (<output dir>/<log name>/), so that they can run in parallel.
+The optional parameter file is used as replay_params.txt (one '<name> <value>'
+per line) and applied on top of the parameters stored in the log.
+
+The replayed log is written to <output dir>/<log name>/rootfs/fs/microsd/log/
+(the logger's LOG_ROOT on posix SITL), the console output to
+<output dir>/<log name>/px4.log. The estimator_status metrics of all logs
+(innovation test ratios and flags) are written to <output dir>/summary.csv.
+
+With --check-determinism, each log is replayed a second time (in
+<output dir>/<log name>/check/) and the logged estimator output of both runs
+must be identical. Lockstep replay guarantees this, but not that the output
+is identical to a real-time replay: there, ekf2 does not run in replay mode
+and its output depends on the scheduling.
+
+It assumes px4 is already built, with 'make posix_sitl_default'.
+"""
+
+from __future__ import print_function
+import argparse
+import csv
+import multiprocessing
+import os
+import pty
+import select
+import shutil
+import struct
+import subprocess
+import sys
+import time
+
+from ulog_decompress import decompress, expand_deltas, field_sizes
+
+ULOG_FILE_HEADER_LEN = 16
+ULOG_MSG_HEADER_LEN = 3
+MSG_TYPE_FORMAT = ord('F')
+MSG_TYPE_ADD_LOGGED_MSG = ord('A')
+MSG_TYPE_DATA = ord('D')
+STRUCT_TYPES = {
+    'int8_t': 'b', 'uint8_t': 'B', 'char': 'c', 'bool': '?',
+    'int16_t': 'h', 'uint16_t': 'H',
+    'int32_t': 'i', 'uint32_t': 'I', 'float': 'f',
+    'int64_t': 'q', 'uint64_t': 'Q', 'double': 'd',
+}
+
+RC_SCRIPT = 'posix-configs/SITL/init/replay/ekf2_lockstep'
+# the output must be a single file
+LOGGER_PARAMS = ['SDLOG_ROTATE_MB 0', 'SDLOG_ROTATE_S 0']
+
+TEST_RATIOS = ['mag_test_ratio', 'vel_test_ratio', 'pos_test_ratio',
+               'hgt_test_ratio', 'tas_test_ratio', 'hagl_test_ratio']
+FLAGS = ['filter_fault_flags', 'innovation_check_flags', 'gps_check_fail_flags',
+         'nan_flags', 'timeout_flags']
+# estimator output that must be identical in repeated replays of a log
+DETERMINISM_TOPICS = ['estimator_status', 'ekf2_innovations', 'vehicle_attitude',
+                      'vehicle_local_position', 'vehicle_global_position']
+SUMMARY_FIELDS = ['log', 'result', 'replay_time_s', 'samples', 'duration_s'] + \
+    [ratio + suffix for ratio in TEST_RATIOS for suffix in ('_max', '_mean', '_fail')] + \
+    [flags + suffix for flags in FLAGS for suffix in ('_or', '_set')]
+
+
+def topic_fields(formats, name):
+    """ Returns {field name: (offset, struct format)} of the fields with a basic type """
+    fields = {}
+    offset = 0
+    definitions = [field for field in formats[name].split(';') if field]
+    for field, size in zip(definitions, field_sizes(formats, name)):
+        type_name, field_name = field.split(' ', 1)
+        array_size = 1
+        if '[' in type_name:
+            array_size = int(type_name[type_name.index('[') + 1:type_name.index(']')])
+            type_name = type_name[:type_name.index('[')]
+        if type_name in STRUCT_TYPES:
+            fields[field_name] = (offset, '<' + str(array_size) + STRUCT_TYPES[type_name])
+        offset += size
+    return fields
+
+
+def read_topic(data, topic_name):
+    """ Returns the list of samples (dicts) of the first instance of a topic """
+    formats = {}
+    msg_id = None
+    fields = None
+    samples = []
+    pos = ULOG_FILE_HEADER_LEN
+
+    while pos + ULOG_MSG_HEADER_LEN <= len(data):
+        msg_size, msg_type = struct.unpack('<HB', data[pos:pos + ULOG_MSG_HEADER_LEN])
+        end = pos + ULOG_MSG_HEADER_LEN + msg_size
+        if end > len(data):
+            break # truncated
+        payload = data[pos + ULOG_MSG_HEADER_LEN:end]
+        pos = end
+
+        if msg_type == MSG_TYPE_FORMAT:
+            name, definition = bytes(payload).decode('utf-8').split(':', 1)
+            formats[name] = definition
+
+        elif msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+            multi_id = bytearray(payload[0:1])[0]
+            if bytes(payload[3:]).decode('utf-8') == topic_name and multi_id == 0:
+                msg_id, = struct.unpack('<H', payload[1:3])
+                fields = topic_fields(formats, topic_name)
+
+        elif msg_type == MSG_TYPE_DATA and msg_id is not None:
+            if struct.unpack('<H', payload[:2])[0] != msg_id:
+                continue
+            sample = {}
+            for field_name, (offset, fmt) in fields.items():
+                if 2 + offset + struct.calcsize(fmt) <= len(payload):
+                    value = struct.unpack_from(fmt, payload, 2 + offset)
+                    sample[field_name] = value[0] if len(value) == 1 else value
+            samples.append(sample)
+
+    return samples
+
+
+def read_log(log_file):
+    """ Read a log file, decompressed and with expanded delta messages """
+    with open(log_file, 'rb') as f:
+        data = f.read()
+
+    decompressed = decompress(data)
+    if decompressed is not None:
+        data = decompressed
+    data, _ = expand_deltas(data)
+    return data
+
+
+def topic_data(data, topic_names):
+    """ Returns {(topic name, multi id): [data of each sample]} of the given topics """
+    topics = {} # msg_id -> (topic name, multi id)
+    samples = {}
+    pos = ULOG_FILE_HEADER_LEN
+
+    while pos + ULOG_MSG_HEADER_LEN <= len(data):
+        msg_size, msg_type = struct.unpack('<HB', data[pos:pos + ULOG_MSG_HEADER_LEN])
+        end = pos + ULOG_MSG_HEADER_LEN + msg_size
+        if end > len(data):
+            break # truncated
+        payload = data[pos + ULOG_MSG_HEADER_LEN:end]
+        pos = end
+
+        if msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+            name = bytes(payload[3:]).decode('utf-8')
+            if name in topic_names:
+                msg_id, = struct.unpack('<H', payload[1:3])
+                topics[msg_id] = (name, bytearray(payload[0:1])[0])
+
+        elif msg_type == MSG_TYPE_DATA:
+            msg_id, = struct.unpack('<H', payload[:2])
+            if msg_id in topics:
+                samples.setdefault(topics[msg_id], []).append(bytes(payload[2:]))
+
+    return samples
+
+
+def estimator_metrics(log_file):
+    """ Summarize the estimator_status samples of a (replayed) log file """
+    samples = read_topic(read_log(log_file), 'estimator_status')
+    metrics = {'samples': len(samples)}
+    if not samples:
+        return metrics
+
+    metrics['duration_s'] = '{:.3f}'.format((samples[-1]['timestamp'] - samples[0]['timestamp']) / 1e6)
+
+    for ratio in TEST_RATIOS:
+        values = [sample[ratio] for sample in samples if ratio in sample]
+        if values:
+            metrics[ratio + '_max'] = '{:.4f}'.format(max(values))
+            metrics[ratio + '_mean'] = '{:.4f}'.format(sum(values) / len(values))
+            # fraction of the samples that failed the innovation consistency check
+            metrics[ratio + '_fail'] = '{:.4f}'.format(sum(1 for v in values if v > 1) / float(len(values)))
+
+    for flags in FLAGS:
+        values = [sample[flags] for sample in samples if flags in sample]
+        if values:
+            combined = 0
+            for value in values:
+                combined |= value
+            metrics[flags + '_or'] = '0x{:x}'.format(combined)
+            # fraction of the samples with any flag set
+            metrics[flags + '_set'] = '{:.4f}'.format(sum(1 for v in values if v) / float(len(values)))
+
+    return metrics
+
+
+def find_log(work_dir):
+    """ Returns the newest ULog file written by the logger, or None """
+    log_files = []
+    for root, _, files in os.walk(os.path.join(work_dir, 'rootfs', 'fs', 'microsd', 'log')):
+        log_files += [os.path.join(root, name) for name in files if name.endswith('.ulg')]
+    if not log_files:
+        return None
+    return max(log_files, key=os.path.getmtime)
+
+
+def run_px4(args, log_file, work_dir):
+    """ Replay log_file in a px4 process. Returns the result ('ok', 'timeout', ...) """
+    src_path = os.path.abspath(args.src)
+    env = dict(os.environ)
+    env['replay'] = os.path.abspath(log_file)
+    env['replay_mode'] = 'ekf2'
+
+    # use a pseudo-terminal, so that the output is line-buffered
+    master, slave = pty.openpty()
+    proc = subprocess.Popen([os.path.abspath(args.px4), src_path, os.path.join(src_path, RC_SCRIPT)],
+                            cwd=work_dir, env=env, stdin=subprocess.PIPE,
+                            stdout=slave, stderr=slave, close_fds=True)
+    os.close(slave)
+
+    result = 'error'
+    output = ''
+    stopping = False
+    deadline = time.time() + args.timeout
+
+    with open(os.path.join(work_dir, 'px4.log'), 'w') as console:
+        while True:
+            ready, _, _ = select.select([master], [], [], 1)
+            if ready:
+                try:
+                    data = os.read(master, 4096)
+                except OSError: # EIO: the process exited
+                    data = b''
+                if not data:
+                    break
+                text = data.decode('utf-8', 'replace')
+                console.write(text)
+                output = output[-1000:] + text
+
+            if not stopping and ('Replay done' in output or 'Replay aborted' in output):
+                # close the log file before exiting
+                proc.stdin.write(b'logger stop\nshutdown\n')
+                proc.stdin.flush()
+                stopping = True
+                # aborted: a module did not keep up with the lockstep replay, so the output is not reproducible
+                result = 'ok' if 'Replay done' in output else 'aborted'
+
+            if time.time() > deadline:
+                proc.kill()
+                result = 'timeout'
+                break
+
+            if proc.poll() is not None and not ready:
+                break
+
+    os.close(master)
+    proc.wait()
+    return result
+
+
+def replay(args, log_file, work_dir):
+    """ Replay a log in a new working directory. Returns (result, output log file or None) """
+    if os.path.exists(work_dir):
+        shutil.rmtree(work_dir)
+    os.makedirs(os.path.join(work_dir, 'rootfs'))
+
+    with open(os.path.join(work_dir, 'rootfs', 'replay_params.txt'), 'w') as params:
+        if args.params:
+            with open(args.params) as user_params:
+                params.write(user_params.read().rstrip('\n') + '\n')
+        params.write('\n'.join(LOGGER_PARAMS) + '\n')
+
+    result = run_px4(args, log_file, work_dir)
+    replayed_file = find_log(work_dir)
+    if replayed_file is None and result == 'ok':
+        result = 'no output log'
+    return result, replayed_file
+
+
+def replay_log(job):
+    """ Replay a single log and return its summary row """
+    args, log_file = job
+    name = os.path.splitext(os.path.basename(log_file))[0]
+    work_dir = os.path.join(args.output, name)
+
+    start_time = time.time()
+    result, replayed_file = replay(args, log_file, work_dir)
+    row = {'log': name, 'result': result, 'replay_time_s': '{:.1f}'.format(time.time() - start_time)}
+
+    if replayed_file is None:
+        return row
+
+    try:
+        row.update(estimator_metrics(replayed_file))
+
+        if args.check_determinism and result == 'ok':
+            check_result, check_file = replay(args, log_file, os.path.join(work_dir, 'check'))
+            if check_result != 'ok':
+                row['result'] = 'check run: ' + check_result
+            elif topic_data(read_log(replayed_file), DETERMINISM_TOPICS) != \
+                    topic_data(read_log(check_file), DETERMINISM_TOPICS):
+                row['result'] = 'not deterministic'
+
+    except (ValueError, KeyError, struct.error) as e:
+        row['result'] = 'invalid output log ({:})'.format(e)
+
+    return row
+
+
+def main():
+    default_src = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+    parser = argparse.ArgumentParser(
+        description='Replay all ULog files of a directory through ekf2 in parallel and summarize the results')
+    parser.add_argument('logs', help='directory with the ULog files to replay')
+    parser.add_argument('-o', '--output', default='replay_batch', help='output directory (default: %(default)s)')
+    parser.add_argument('-p', '--params', help='parameter override file (replay_params.txt format)')
+    parser.add_argument('-j', '--jobs', type=int, default=multiprocessing.cpu_count(),
+                        help='number of parallel replays (default: number of CPUs)')
+    parser.add_argument('-t', '--timeout', type=float, default=3600,
+                        help='timeout per log [s] (default: %(default)s)')
+    parser.add_argument('--check-determinism', action='store_true',
+                        help='replay each log twice and check that the estimator output is identical')
+    parser.add_argument('--src', default=default_src, help='Firmware source directory')
+    parser.add_argument('--px4', help='px4 binary (default: build_posix_sitl_default in the source directory)')
+    args = parser.parse_args()
+
+    if args.px4 is None:
+        args.px4 = os.path.join(args.src, 'build_posix_sitl_default', 'src', 'firmware', 'posix', 'px4')
+    if not os.path.isfile(args.px4):
+        print('px4 binary {:} not found. Build it with \'make posix_sitl_default\''.format(args.px4))
+        sys.exit(1)
+
+    log_files = sorted(os.path.join(args.logs, name) for name in os.listdir(args.logs)
+                       if name.endswith('.ulg'))
+    if not log_files:
+        print('No ULog files in {:}'.format(args.logs))
+        sys.exit(1)
+
+    args.output = os.path.abspath(args.output)
+    if not os.path.isdir(args.output):
+        os.makedirs(args.output)
+
+    print('Replaying {:} logs with {:} jobs'.format(len(log_files), args.jobs))
+    pool = multiprocessing.Pool(args.jobs)
+    rows = []
+    for row in pool.imap_unordered(replay_log, [(args, log_file) for log_file in log_files]):
+        print('{:<40} {:<16} {:>8} s'.format(row['log'], row['result'], row['replay_time_s']))
+        rows.append(row)
+    pool.close()
+    pool.join()
+
+    summary_file = os.path.join(args.output, 'summary.csv')
+    with open(summary_file, 'w') as f:
+        writer = csv.DictWriter(f, fieldnames=SUMMARY_FIELDS, restval='')
+        writer.writeheader()
+        for row in sorted(rows, key=lambda r: r['log']):
+            writer.writerow(row)
+
+    num_failed = sum(1 for row in rows if row['result'] != 'ok')
+    print('Wrote {:} ({:} failed)'.format(summary_file, num_failed))
+    if num_failed > 0:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,265 @@
+#!/usr/bin/env python
+
+"""
+Convert a compressed and/or delta encoded ULog file (logged with SDLOG_COMPRESS=1
+or SDLOG_DELTA=1) into a regular ULog file that can be read by any ULog parser.
+
+Compression: the file header is stored as-is, followed by COMPRESSED ('Z')
+messages. Each of them contains an LZ4 block of the message stream, and matches
+can refer to the data of the previous blocks, so they are decompressed in order.
+
+Delta encoding: DATA_DELTA ('E') messages contain a bitmask of the changed fields
+of a topic, followed by the data of these fields. The other fields are the same as
+in the previous data message with the same msg_id. They are converted into
+regular DATA ('D') messages. This changes the file offsets, so a seek index
+(INDEX/INDEX_END messages) is dropped.
+"""
+
+from __future__ import print_function
+import argparse
+import struct
+import sys
+
+ULOG_FILE_HEADER_LEN = 16
+ULOG_MSG_HEADER_LEN = 3
+MSG_TYPE_COMPRESSED = ord('Z')
+MSG_TYPE_FORMAT = ord('F')
+MSG_TYPE_ADD_LOGGED_MSG = ord('A')
+MSG_TYPE_DATA = ord('D')
+MSG_TYPE_DATA_DELTA = ord('E')
+MSG_TYPE_INDEX = ord('X')
+MSG_TYPE_INDEX_END = ord('Y')
+TYPE_SIZES = {
+    'int8_t': 1, 'uint8_t': 1, 'char': 1, 'bool': 1,
+    'int16_t': 2, 'uint16_t': 2,
+    'int32_t': 4, 'uint32_t': 4, 'float': 4,
+    'int64_t': 8, 'uint64_t': 8, 'double': 8,
+}
+HISTORY_LEN = 4096 # matches can go back this far into the previous block
+
+
+def decompress_block(src, out, history_start):
+    """ Decompress an LZ4 block and append it to out (a bytearray). Matches may
+    refer to data in out after history_start. Returns False on invalid data. """
+    ip = 0
+    src_len = len(src)
+
+    while ip < src_len:
+        token = src[ip]
+        ip += 1
+        length = token >> 4
+
+        if length == 15:
+            while True:
+                if ip >= src_len:
+                    return False
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+
+        if ip + length > src_len:
+            return False
+        out += src[ip:ip + length]
+        ip += length
+
+        if ip == src_len:
+            break # the last sequence has no match
+
+        if ip + 2 > src_len:
+            return False
+        offset = src[ip] | (src[ip + 1] << 8)
+        ip += 2
+
+        length = token & 0xf
+        if length == 15:
+            while True:
+                if ip >= src_len:
+                    return False
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+        length += 4
+
+        start = len(out) - offset
+        if offset == 0 or start < history_start:
+            return False
+
+        if offset >= length:
+            out += out[start:start + length]
+        else: # overlapping match: repeat the pattern
+            for i in range(length):
+                out.append(out[start + i])
+
+    return True
+
+
+def decompress(data):
+    """ Returns the decompressed file, or None if the file is not compressed """
+    if len(data) < ULOG_FILE_HEADER_LEN + ULOG_MSG_HEADER_LEN or data[:4] != b'ULog':
+        raise ValueError('not a ULog file')
+
+    out = bytearray(data[:ULOG_FILE_HEADER_LEN])
+    pos = ULOG_FILE_HEADER_LEN
+    stream_start = len(out)
+
+    if bytearray(data[pos + 2:pos + 3])[0] != MSG_TYPE_COMPRESSED:
+        return None
+
+    while pos + ULOG_MSG_HEADER_LEN + 2 <= len(data):
+        msg_size, msg_type, uncompressed_size = struct.unpack('<HBH', data[pos:pos + 5])
+        end = pos + ULOG_MSG_HEADER_LEN + msg_size
+
+        if msg_type != MSG_TYPE_COMPRESSED or end > len(data):
+            print('Warning: file is truncated or broken at offset {:}'.format(pos), file=sys.stderr)
+            break
+
+        block_start = len(out)
+        history_start = max(stream_start, block_start - HISTORY_LEN)
+
+        if not decompress_block(bytearray(data[pos + 5:end]), out, history_start) or \
+                len(out) - block_start != uncompressed_size:
+            print('Warning: invalid compressed block at offset {:}'.format(pos), file=sys.stderr)
+            del out[block_start:]
+            break
+
+        pos = end
+
+    return out
+
+
+def field_sizes(formats, name):
+    """ Returns the list of field sizes of a type (nested types are a single field) """
+    sizes = []
+    for field in formats[name].split(';'):
+        if not field:
+            continue
+        type_name = field.split(' ')[0]
+        array_size = 1
+        if '[' in type_name:
+            array_size = int(type_name[type_name.index('[') + 1:type_name.index(']')])
+            type_name = type_name[:type_name.index('[')]
+        if type_name in TYPE_SIZES:
+            sizes.append(TYPE_SIZES[type_name] * array_size)
+        else:
+            sizes.append(sum(field_sizes(formats, type_name)) * array_size)
+    return sizes
+
+
+def field_offsets(formats, name, size):
+    """ Returns the field offsets (plus the end) of a topic with size bytes of
+    logged data (the padding at the end is not logged), None on mismatch """
+    offsets = [0]
+    for field_size in field_sizes(formats, name):
+        if offsets[-1] >= size:
+            break
+        offsets.append(offsets[-1] + field_size)
+    if offsets[-1] != size:
+        return None
+    return offsets
+
+
+def expand_deltas(data):
+    """ Replaces the DATA_DELTA messages of an uncompressed ULog file with DATA
+    messages. Returns the new file and the number of expanded messages """
+    out = bytearray(data[:ULOG_FILE_HEADER_LEN])
+    pos = ULOG_FILE_HEADER_LEN
+    formats = {}
+    topics = {} # msg_id -> topic name
+    last_data = {} # msg_id -> last data (w/o msg_id)
+    layouts = {} # msg_id -> field offsets
+    num_expanded = 0
+
+    while pos + ULOG_MSG_HEADER_LEN <= len(data):
+        msg_size, msg_type = struct.unpack('<HB', data[pos:pos + ULOG_MSG_HEADER_LEN])
+        end = pos + ULOG_MSG_HEADER_LEN + msg_size
+        if end > len(data):
+            break # truncated
+        payload = data[pos + ULOG_MSG_HEADER_LEN:end]
+
+        if msg_type == MSG_TYPE_FORMAT:
+            name, fields = bytes(payload).decode('utf-8').split(':', 1)
+            formats[name] = fields
+
+        elif msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+            msg_id, = struct.unpack('<H', payload[1:3])
+            topics[msg_id] = bytes(payload[3:]).decode('utf-8')
+            last_data.pop(msg_id, None)
+
+        elif msg_type == MSG_TYPE_DATA:
+            msg_id, = struct.unpack('<H', payload[:2])
+            last_data[msg_id] = bytearray(payload[2:])
+
+        elif msg_type == MSG_TYPE_DATA_DELTA:
+            msg_id, = struct.unpack('<H', payload[:2])
+            prev = last_data.get(msg_id)
+            if msg_id not in layouts and prev is not None:
+                layouts[msg_id] = field_offsets(formats, topics[msg_id], len(prev))
+            offsets = layouts.get(msg_id)
+            delta = bytearray(payload[2:])
+            num_fields = 0 if offsets is None else len(offsets) - 1
+            mask_len = (num_fields + 7) // 8
+            src = mask_len
+
+            if prev is None or offsets is None or len(delta) < mask_len:
+                print('Warning: cannot expand delta message at offset {:}'.format(pos), file=sys.stderr)
+                pos = end
+                continue
+
+            for i in range(num_fields):
+                if delta[i // 8] & (1 << (i % 8)):
+                    field_size = offsets[i + 1] - offsets[i]
+                    prev[offsets[i]:offsets[i + 1]] = delta[src:src + field_size]
+                    src += field_size
+
+            out += struct.pack('<HBH', len(prev) + 2, MSG_TYPE_DATA, msg_id)
+            out += prev
+            num_expanded += 1
+            pos = end
+            continue
+
+        elif msg_type in (MSG_TYPE_INDEX, MSG_TYPE_INDEX_END):
+            pos = end # the offsets are not valid anymore
+            continue
+
+        out += data[pos:end]
+        pos = end
+
+    return out, num_expanded
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert a compressed and/or delta encoded ULog file into a regular ULog file')
+    parser.add_argument('input', help='compressed or delta encoded ULog file')
+    parser.add_argument('output', help='output ULog file')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    out = decompress(data)
+    compressed = out is not None
+
+    if not compressed:
+        out = data
+
+    out, num_expanded = expand_deltas(out)
+
+    if not compressed and num_expanded == 0:
+        print('{:} is neither compressed nor delta encoded'.format(args.input))
+        sys.exit(1)
+
+    with open(args.output, 'wb') as f:
+        f.write(out)
+
+    if compressed:
+        print('Decompressed {:} bytes'.format(len(data)))
+    print('Expanded {:} delta messages, wrote {:} bytes'.format(num_expanded, len(out)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,280 @@
+#!/usr/bin/env python
+
+"""
+Read the seek index of a ULog file (logged with SDLOG_INDEX_MS set) and use it to
+extract a time window and/or a subset of the topics without reading the whole file.
+
+The index is at the end of the file: INDEX ('X') messages with the timestamps and
+file offsets of the first data message of each msg_id in every index interval,
+followed by a fixed-size INDEX_END ('Y') message with the offset of the first
+INDEX message. Indexed data messages are always full DATA messages.
+
+Without -o, a summary of the index is printed.
+"""
+
+from __future__ import print_function
+import argparse
+import bisect
+import struct
+import sys
+
+ULOG_FILE_HEADER_LEN = 16
+ULOG_MSG_HEADER_LEN = 3
+MSG_TYPE_FORMAT = ord('F')
+MSG_TYPE_ADD_LOGGED_MSG = ord('A')
+MSG_TYPE_DATA = ord('D')
+MSG_TYPE_DATA_DELTA = ord('E')
+MSG_TYPE_LOGGING = ord('L')
+MSG_TYPE_INDEX = ord('X')
+MSG_TYPE_INDEX_END = ord('Y')
+INDEX_HEADER_LEN = ULOG_MSG_HEADER_LEN + 18
+INDEX_ENTRY_LEN = 16
+INDEX_END_LEN = ULOG_MSG_HEADER_LEN + 20
+INDEX_MAGIC = b'ULogIdx\0'
+TYPE_SIZES = {
+    'int8_t': 1, 'uint8_t': 1, 'char': 1, 'bool': 1,
+    'int16_t': 2, 'uint16_t': 2,
+    'int32_t': 4, 'uint32_t': 4, 'float': 4,
+    'int64_t': 8, 'uint64_t': 8, 'double': 8,
+}
+
+
+class Index(object):
+    """ seek index of one msg_id """
+    def __init__(self, first_timestamp, last_timestamp):
+        self.first_timestamp = first_timestamp
+        self.last_timestamp = last_timestamp
+        self.timestamps = []
+        self.offsets = []
+
+    def offset_before(self, timestamp):
+        """ offset of the last indexed message at or before timestamp (or the first one) """
+        if not self.offsets:
+            return None
+        i = bisect.bisect_right(self.timestamps, timestamp)
+        return self.offsets[max(i - 1, 0)]
+
+
+def read_index(f):
+    """ Returns (interval [ms], index offset, {msg_id: Index}), or None if the
+    file has no index """
+    f.seek(0, 2)
+    file_size = f.tell()
+    if file_size < ULOG_FILE_HEADER_LEN + INDEX_END_LEN:
+        return None
+
+    f.seek(file_size - INDEX_END_LEN)
+    msg_size, msg_type, interval, index_offset, magic = struct.unpack('<HBIQ8s', f.read(INDEX_END_LEN))
+    if msg_type != MSG_TYPE_INDEX_END or msg_size != INDEX_END_LEN - ULOG_MSG_HEADER_LEN or \
+            magic != INDEX_MAGIC or index_offset >= file_size - INDEX_END_LEN:
+        return None
+
+    f.seek(index_offset)
+    data = f.read(file_size - INDEX_END_LEN - index_offset)
+    indexes = {}
+    pos = 0
+
+    while pos < len(data):
+        msg_size, msg_type, msg_id, first_timestamp, last_timestamp = \
+            struct.unpack('<HBHQQ', data[pos:pos + INDEX_HEADER_LEN])
+        end = pos + ULOG_MSG_HEADER_LEN + msg_size
+        if msg_type != MSG_TYPE_INDEX or end > len(data):
+            raise ValueError('invalid index message at offset {:}'.format(index_offset + pos))
+
+        index = indexes.setdefault(msg_id, Index(first_timestamp, last_timestamp))
+        for entry in range(pos + INDEX_HEADER_LEN, end, INDEX_ENTRY_LEN):
+            timestamp, offset = struct.unpack('<QQ', data[entry:entry + INDEX_ENTRY_LEN])
+            index.timestamps.append(timestamp)
+            index.offsets.append(offset)
+        pos = end
+
+    return interval, index_offset, indexes
+
+
+def read_message(f):
+    """ Read the next message: returns (msg_type, message including the header),
+    or (None, None) at the end of the file """
+    header = f.read(ULOG_MSG_HEADER_LEN)
+    if len(header) < ULOG_MSG_HEADER_LEN:
+        return None, None
+    msg_size, msg_type = struct.unpack('<HB', header)
+    payload = f.read(msg_size)
+    if len(payload) < msg_size:
+        return None, None
+    return msg_type, header + payload
+
+
+def read_definitions(f):
+    """ Read the definitions and the ADD_LOGGED_MSG messages up to the first data
+    message. Returns (definitions, formats, {msg_id: (topic name, ADD_LOGGED_MSG message)}) """
+    f.seek(0)
+    definitions = bytearray(f.read(ULOG_FILE_HEADER_LEN))
+    formats = {}
+    topics = {}
+
+    while True:
+        pos = f.tell()
+        msg_type, msg = read_message(f)
+        if msg_type is None or msg_type in (MSG_TYPE_DATA, MSG_TYPE_DATA_DELTA):
+            f.seek(pos)
+            break
+
+        if msg_type == MSG_TYPE_FORMAT:
+            name, fields = bytes(msg[ULOG_MSG_HEADER_LEN:]).decode('utf-8').split(':', 1)
+            formats[name] = fields
+        elif msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+            msg_id, = struct.unpack('<H', msg[4:6])
+            topics[msg_id] = (bytes(msg[6:]).decode('utf-8'), msg)
+            continue
+
+        if not topics:
+            definitions += msg
+
+    return definitions, formats, topics
+
+
+def type_size(formats, type_name_full):
+    type_name = type_name_full
+    array_size = 1
+    if '[' in type_name:
+        array_size = int(type_name[type_name.index('[') + 1:type_name.index(']')])
+        type_name = type_name[:type_name.index('[')]
+    if type_name in TYPE_SIZES:
+        return TYPE_SIZES[type_name] * array_size
+    return sum(type_size(formats, field.split(' ')[0])
+               for field in formats[type_name].split(';') if field) * array_size
+
+
+def timestamp_offset(formats, name):
+    """ offset of the timestamp in the data of a topic, None if it has none """
+    offset = 0
+    for field in formats[name].split(';'):
+        if not field:
+            continue
+        type_name, field_name = field.split(' ', 1)
+        if field_name == 'timestamp' and type_name == 'uint64_t':
+            return offset
+        offset += type_size(formats, type_name)
+    return None
+
+
+def extract(f, out, index_info, topic_names, start, end):
+    """ Write the messages of the selected topics (all if topic_names is None)
+    between start and end [us] to out. Returns the number of written data messages """
+    interval, index_offset, indexes = index_info
+    definitions, formats, topics = read_definitions(f)
+
+    selected = set(msg_id for msg_id, (name, _) in topics.items()
+                   if topic_names is None or name in topic_names)
+    ts_offsets = dict((msg_id, timestamp_offset(formats, topics[msg_id][0])) for msg_id in selected)
+
+    out.write(definitions)
+    for msg_id in sorted(topics):
+        if msg_id in selected:
+            out.write(topics[msg_id][1])
+
+    # start at the earliest indexed message before the window of the selected topics
+    offsets = [indexes[msg_id].offset_before(start) for msg_id in selected if msg_id in indexes]
+    offsets = [offset for offset in offsets if offset is not None]
+    if not offsets:
+        return 0
+    f.seek(min(offsets))
+
+    full_seen = set() # a DATA_DELTA message needs the previous data message
+    done = set() # msg_ids that reached the end of the window
+    num_written = 0
+
+    while f.tell() < index_offset and len(done) < len(selected):
+        msg_type, msg = read_message(f)
+        if msg_type is None:
+            break
+
+        if msg_type in (MSG_TYPE_DATA, MSG_TYPE_DATA_DELTA):
+            msg_id, = struct.unpack('<H', msg[3:5])
+            if msg_id not in selected or msg_id in done:
+                continue
+
+            if msg_type == MSG_TYPE_DATA:
+                ts_offset = ts_offsets[msg_id]
+                if ts_offset is not None:
+                    timestamp, = struct.unpack('<Q', msg[5 + ts_offset:13 + ts_offset])
+                    if timestamp > end:
+                        done.add(msg_id)
+                        continue
+                    if timestamp < start:
+                        full_seen.discard(msg_id)
+                        continue
+                full_seen.add(msg_id)
+
+            elif msg_id not in full_seen:
+                continue
+
+            out.write(msg)
+            num_written += 1
+
+        elif msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+            # new instances of a topic, logged later
+            msg_id, = struct.unpack('<H', msg[4:6])
+            name = bytes(msg[6:]).decode('utf-8')
+            if (topic_names is None or name in topic_names) and msg_id not in selected:
+                selected.add(msg_id)
+                ts_offsets[msg_id] = timestamp_offset(formats, name)
+                out.write(msg)
+
+        elif msg_type == MSG_TYPE_LOGGING:
+            timestamp, = struct.unpack('<Q', msg[4:12])
+            if start <= timestamp <= end:
+                out.write(msg)
+
+        elif msg_type not in (MSG_TYPE_INDEX, MSG_TYPE_INDEX_END):
+            out.write(msg) # parameter changes, dropouts, ...
+
+    return num_written
+
+
+def print_summary(f, index_info):
+    interval, index_offset, indexes = index_info
+    _, _, topics = read_definitions(f)
+    print('Index interval: {:} ms, data size: {:} bytes'.format(interval, index_offset))
+    print('{:>6} {:<40} {:>12} {:>12} {:>8}'.format('msg_id', 'topic', 'first [s]', 'last [s]', 'entries'))
+    for msg_id in sorted(indexes):
+        index = indexes[msg_id]
+        name = topics[msg_id][0] if msg_id in topics else '?'
+        print('{:>6} {:<40} {:>12.3f} {:>12.3f} {:>8}'.format(msg_id, name, index.first_timestamp / 1e6,
+                                                            index.last_timestamp / 1e6, len(index.offsets)))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Print the seek index of a ULog file or extract a time window and/or topics')
+    parser.add_argument('input', help='indexed ULog file')
+    parser.add_argument('-o', '--output', help='output ULog file')
+    parser.add_argument('-s', '--start', type=float, default=0,
+                        help='start of the time window [s] (same time base as the logged timestamps)')
+    parser.add_argument('-e', '--end', type=float, default=float('inf'),
+                        help='end of the time window [s]')
+    parser.add_argument('-t', '--topics', help='comma-separated list of topics (default: all)')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        index_info = read_index(f)
+
+        if index_info is None:
+            print('{:} has no seek index'.format(args.input))
+            sys.exit(1)
+
+        if not args.output:
+            print_summary(f, index_info)
+            return
+
+        topic_names = set(args.topics.split(',')) if args.topics else None
+        end = args.end * 1e6 if args.end != float('inf') else 2**64
+
+        with open(args.output, 'wb') as out:
+            num_written = extract(f, out, index_info, topic_names, args.start * 1e6, end)
+
+    print('Wrote {:} data messages to {:}'.format(num_written, args.output))
+
+
+if __name__ == '__main__':
+    main()
@@ -118,6 +118,7 @@ set(config_module_list
 	#
 	modules/sdlog2
 	modules/logger
+	modules/flight_recorder
 
 	#
 	# Library modules
@@ -28,6 +28,7 @@ set(config_module_list
 	systemcmds/perf
 	systemcmds/reboot
 	systemcmds/sd_bench
+	systemcmds/uorb_bench
 	systemcmds/topic_listener
 	systemcmds/ver
 	systemcmds/top
@@ -37,6 +38,7 @@ set(config_module_list
 	modules/commander
 	modules/dataman
 	modules/ekf2
+	modules/flight_recorder
 	modules/fw_att_control
 	modules/fw_pos_control_l1
 	modules/land_detector
@@ -94,6 +96,13 @@ set(config_module_list
 
 	)
 
+# uORB over shared memory between processes (uses Linux futexes)
+if(NOT APPLE)
+	list(APPEND config_module_list
+		modules/muorb/shm
+		)
+endif()
+
 set(config_extra_builtin_cmds
 	serdis
 	sercon
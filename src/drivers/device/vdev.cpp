@@ -427,6 +427,19 @@ VDev::poll(file_t *filep, px4_pollfd_struct_t *fds, bool setup)
 	return ret;
 }
 
+pollevent_t
+VDev::poll_recheck(file_t *filep, px4_pollfd_struct_t *fds)
+{
+	lock();
+
+	fds->revents = fds->events & poll_state(filep);
+	pollevent_t revents = fds->revents;
+
+	unlock();
+
+	return revents;
+}
+
 void
 VDev::poll_notify(pollevent_t events)
 {
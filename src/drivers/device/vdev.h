@@ -240,6 +240,19 @@ public:
 	 */
 	virtual int	poll(file_t *filep, px4_pollfd_struct_t *fds, bool setup);
 
+	/**
+	 * Re-evaluate a poll waiter that stays registered across several waits
+	 * (see px4_pollset_wait()).
+	 *
+	 * Events that are no longer pending (e.g. because the data has been read
+	 * in the meantime) are cleared from fds->revents.
+	 *
+	 * @param filep		Pointer to the internal file structure.
+	 * @param fds		Registered poll descriptor.
+	 * @return		The events that are still pending.
+	 */
+	pollevent_t	poll_recheck(file_t *filep, px4_pollfd_struct_t *fds);
+
 	/**
 	 * Test whether the device is currently open.
 	 *
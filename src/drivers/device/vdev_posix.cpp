@@ -89,6 +89,46 @@ extern "C" {
 		return dev;
 	}
 
+	/*
+	 * Timed semaphore wait of px4_poll() and px4_pollset_wait(). Where sem_clockwait() exists, the
+	 * deadline is on the monotonic clock, so that setting the system time does not change the timeout.
+	 */
+#if defined(__PX4_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+#define POLL_WAIT_MONOTONIC
+#endif
+
+	static void poll_wait_deadline(int timeout_ms, struct timespec *deadline)
+	{
+#ifdef POLL_WAIT_MONOTONIC
+		px4_clock_gettime(CLOCK_MONOTONIC, deadline);
+#else
+		px4_clock_gettime(CLOCK_REALTIME, deadline);
+#endif
+
+		const unsigned billion = (1000 * 1000 * 1000);
+		uint64_t nsecs = deadline->tv_nsec + ((uint64_t)timeout_ms * 1000 * 1000);
+		deadline->tv_sec += nsecs / billion;
+		deadline->tv_nsec = nsecs % billion;
+	}
+
+	/**
+	 * @return 0 if the semaphore was taken, otherwise a (positive) errno value, ETIMEDOUT once the deadline passed
+	 */
+	static int poll_wait_until(px4_sem_t *sem, const struct timespec *deadline)
+	{
+		errno = 0;
+#ifdef POLL_WAIT_MONOTONIC
+		int ret = sem_clockwait(sem, CLOCK_MONOTONIC, deadline);
+#else
+		int ret = px4_sem_timedwait(sem, deadline);
+#endif
+#ifndef __PX4_DARWIN
+		ret = errno;
+#endif
+
+		return ret < 0 ? -ret : ret;
+	}
+
 	int px4_open(const char *path, int flags, ...)
 	{
 		PX4_DEBUG("px4_open");
@@ -312,30 +352,12 @@ extern "C" {
 		if (fd_pollable) {
 			if (timeout > 0) {
 
-				// Get the current time
-				struct timespec ts;
-				// FIXME: check if QURT should probably be using CLOCK_MONOTONIC
-				px4_clock_gettime(CLOCK_REALTIME, &ts);
-
-				// Calculate an absolute time in the future
-				const unsigned billion = (1000 * 1000 * 1000);
-				unsigned tdiff = timeout;
-				uint64_t nsecs = ts.tv_nsec + (tdiff * 1000 * 1000);
-				ts.tv_sec += nsecs / billion;
-				nsecs -= (nsecs / billion) * billion;
-				ts.tv_nsec = nsecs;
-
 				// Execute a blocking wait for that time in the future
-				errno = 0;
-				ret = px4_sem_timedwait(&sem, &ts);
-#ifndef __PX4_DARWIN
-				ret = errno;
-#endif
+				struct timespec ts;
+				poll_wait_deadline(timeout, &ts);
 
 				// Ensure ret is negative on failure
-				if (ret > 0) {
-					ret = -ret;
-				}
+				ret = -poll_wait_until(&sem, &ts);
 
 				if (ret && ret != -ETIMEDOUT) {
 					PX4_WARN("%s: px4_poll() sem error", thread_name);
@@ -375,6 +397,202 @@ extern "C" {
 		return (count) ? count : ret;
 	}
 
+	struct px4_pollset_entry {
+		px4_pollfd_struct_t pfd; // registered with the device, the address must stay the same
+		VDev *dev;
+		device::file_t *filep;
+	};
+
+	struct px4_pollset {
+		px4_sem_t sem;
+		px4_pollset_entry **entries;
+		unsigned count;
+		unsigned capacity;
+	};
+
+	px4_pollset_t *px4_pollset_create(void)
+	{
+		px4_pollset_t *set = new px4_pollset_t;
+
+		if (!set) {
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		px4_sem_init(&set->sem, 0, 0);
+		set->entries = nullptr;
+		set->count = 0;
+		set->capacity = 0;
+
+		return set;
+	}
+
+	void px4_pollset_destroy(px4_pollset_t *set)
+	{
+		if (!set) {
+			return;
+		}
+
+		for (unsigned i = 0; i < set->count; ++i) {
+			set->entries[i]->dev->poll(set->entries[i]->filep, &set->entries[i]->pfd, false);
+			delete set->entries[i];
+		}
+
+		delete[](set->entries);
+		px4_sem_destroy(&set->sem);
+		delete set;
+	}
+
+	int px4_pollset_add(px4_pollset_t *set, int fd, pollevent_t events)
+	{
+		VDev *dev = get_vdev(fd);
+
+		if (!set || !dev) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		for (unsigned i = 0; i < set->count; ++i) {
+			if (set->entries[i]->pfd.fd == fd) {
+				errno = EEXIST;
+				return -1;
+			}
+		}
+
+		if (set->count == set->capacity) {
+			const unsigned new_capacity = set->capacity > 0 ? set->capacity * 2 : 4;
+			px4_pollset_entry **new_entries = new px4_pollset_entry *[new_capacity];
+
+			if (!new_entries) {
+				errno = ENOMEM;
+				return -1;
+			}
+
+			if (set->count > 0) {
+				memcpy(new_entries, set->entries, sizeof(px4_pollset_entry *) * set->count);
+			}
+
+			delete[](set->entries);
+			set->entries = new_entries;
+			set->capacity = new_capacity;
+		}
+
+		px4_pollset_entry *entry = new px4_pollset_entry;
+
+		if (!entry) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		entry->pfd.fd = fd;
+		entry->pfd.events = events;
+		entry->pfd.revents = 0;
+		entry->pfd.sem = &set->sem;
+		entry->pfd.priv = NULL;
+		entry->dev = dev;
+		entry->filep = filemap[fd];
+
+		// registers the waiter and posts the semaphore if the fd is ready already
+		int ret = dev->poll(entry->filep, &entry->pfd, true);
+
+		if (ret < 0) {
+			delete entry;
+			errno = -ret;
+			return -1;
+		}
+
+		set->entries[set->count++] = entry;
+		return 0;
+	}
+
+	int px4_pollset_remove(px4_pollset_t *set, int fd)
+	{
+		if (!set) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		for (unsigned i = 0; i < set->count; ++i) {
+			px4_pollset_entry *entry = set->entries[i];
+
+			if (entry->pfd.fd == fd) {
+				entry->dev->poll(entry->filep, &entry->pfd, false);
+				delete entry;
+				set->entries[i] = set->entries[--set->count];
+				return 0;
+			}
+		}
+
+		errno = ENOENT;
+		return -1;
+	}
+
+	int px4_pollset_wait(px4_pollset_t *set, px4_pollfd_struct_t *ready, unsigned max_ready, int timeout)
+	{
+		if (!set || !ready || max_ready == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		while (sim_delay) {
+			usleep(100);
+		}
+
+		struct timespec ts;
+
+		if (timeout > 0) {
+			poll_wait_deadline(timeout, &ts);
+		}
+
+		while (true) {
+			// Consume pending wakeups before looking at the entries: a notification
+			// that arrives after this point posts the semaphore again, so none is lost.
+			int sval;
+
+			while (px4_sem_getvalue(&set->sem, &sval) == 0 && sval > 0) {
+				px4_sem_wait(&set->sem);
+			}
+
+			// The devices only set revents when notifying, so entries with revents == 0
+			// cannot be ready. The others are re-evaluated, as the data might have been
+			// read since the notification.
+			unsigned count = 0;
+
+			for (unsigned i = 0; i < set->count && count < max_ready; ++i) {
+				px4_pollset_entry *entry = set->entries[i];
+
+				if (entry->pfd.revents != 0 && entry->dev->poll_recheck(entry->filep, &entry->pfd) != 0) {
+					ready[count].fd = entry->pfd.fd;
+					ready[count].events = entry->pfd.events;
+					ready[count].revents = entry->pfd.revents;
+					ready[count].sem = nullptr;
+					ready[count].priv = nullptr;
+					++count;
+				}
+			}
+
+			if (count > 0 || timeout == 0) {
+				return count;
+			}
+
+			if (timeout > 0) {
+				int ret = poll_wait_until(&set->sem, &ts);
+
+				if (ret == ETIMEDOUT) {
+					// check one last time, then return
+					timeout = 0;
+
+				} else if (ret != 0 && ret != EINTR) {
+					errno = ret;
+					return -1;
+				}
+
+			} else {
+				px4_sem_wait(&set->sem);
+			}
+		}
+	}
+
 	int px4_fsync(int fd)
 	{
 		return 0;
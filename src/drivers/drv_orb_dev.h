@@ -93,4 +93,16 @@
 /** Get the minimum interval at which the topic can be seen to be updated for this subscription */
 #define ORBIOCGETINTERVAL	_ORBIOC(16)
 
+/** Borrow the next element of the topic for this subscription, sets *(const void **)arg to the data in the queue */
+#define ORBIOCBORROW		_ORBIOC(17)
+
+/** Return the element borrowed with ORBIOCBORROW, fails with EAGAIN if it was overwritten in the meantime */
+#define ORBIOCRETURN		_ORBIOC(18)
+
+/** Copy all unread elements of the topic for this subscription, arg is a (uORB::orb_copy_all_data *) */
+#define ORBIOCCOPYALL		_ORBIOC(19)
+
+/** Set (or clear) bits on every publication visible to this subscription, arg is a (uORB::orb_update_flag_data *) */
+#define ORBIOCSETUPDATEFLAG	_ORBIOC(20)
+
 #endif /* _DRV_UORB_H */
@@ -77,6 +77,7 @@
 #include <uORB/topics/ekf2_innovations.h>
 #include <uORB/topics/actuator_armed.h>
 #include <uORB/topics/ekf2_replay.h>
+#include <uORB/topics/replay_ack.h>
 #include <uORB/topics/optical_flow.h>
 #include <uORB/topics/distance_sensor.h>
 #include <uORB/topics/vehicle_land_detected.h>
@@ -164,7 +165,9 @@ private:
 	orb_advert_t _estimator_status_pub;
 	orb_advert_t _estimator_innovations_pub;
 	orb_advert_t _replay_pub;
+	orb_advert_t _replay_ack_pub;
 
+	uint32_t _replay_processed = 0;	// number of sensor samples processed in replay mode
 	/* Low pass filter for attitude rates */
 	math::LowPassFilter2p _lp_roll_rate;
 	math::LowPassFilter2p _lp_pitch_rate;
@@ -286,6 +289,12 @@ private:
 
 	int update_subscriptions();
 
+	/**
+	 * Current time to stamp the estimator output with. In replay mode this is the
+	 * time of the replayed sensor data, so that the output does not depend on the replay speed.
+	 */
+	hrt_abstime current_time(hrt_abstime now) const { return _replay_mode ? now : hrt_absolute_time(); }
+
 };
 
 Ekf2::Ekf2():
@@ -300,6 +309,7 @@ Ekf2::Ekf2():
 	_estimator_status_pub(nullptr),
 	_estimator_innovations_pub(nullptr),
 	_replay_pub(nullptr),
+	_replay_ack_pub(nullptr),
 	_lp_roll_rate(250.0f, 30.0f),
 	_lp_pitch_rate(250.0f, 30.0f),
 	_lp_yaw_rate(250.0f, 20.0f),
@@ -705,7 +715,7 @@ void Ekf2::task_main()
 				control_state_s ctrl_state = {};
 				float gyro_bias[3] = {};
 				_ekf.get_gyro_bias(gyro_bias);
-				ctrl_state.timestamp = hrt_absolute_time();
+				ctrl_state.timestamp = current_time(now);
 				gyro_rad[0] = sensors.gyro_rad[0] - gyro_bias[0];
 				gyro_rad[1] = sensors.gyro_rad[1] - gyro_bias[1];
 				gyro_rad[2] = sensors.gyro_rad[2] - gyro_bias[2];
@@ -757,7 +767,7 @@ void Ekf2::task_main()
 				// use estimated velocity for airspeed estimate
 				if (_airspeed_mode.get() == control_state_s::AIRSPD_MODE_MEAS) {
 					// use measured airspeed
-					if (PX4_ISFINITE(airspeed.indicated_airspeed_m_s) && hrt_absolute_time() - airspeed.timestamp < 1e6
+					if (PX4_ISFINITE(airspeed.indicated_airspeed_m_s) && current_time(now) - airspeed.timestamp < 1e6
 					    && airspeed.timestamp > 0) {
 						ctrl_state.airspeed = airspeed.indicated_airspeed_m_s;
 						ctrl_state.airspeed_valid = true;
@@ -787,7 +797,7 @@ void Ekf2::task_main()
 			{
 				// generate vehicle attitude quaternion data
 				struct vehicle_attitude_s att = {};
-				att.timestamp = hrt_absolute_time();
+				att.timestamp = current_time(now);
 
 				att.q[0] = q(0);
 				att.q[1] = q(1);
@@ -811,7 +821,7 @@ void Ekf2::task_main()
 			struct vehicle_local_position_s lpos = {};
 			float pos[3] = {};
 
-			lpos.timestamp = hrt_absolute_time();
+			lpos.timestamp = current_time(now);
 
 			// Position of body origin in local NED frame
 			_ekf.get_position(pos);
@@ -847,7 +857,7 @@ void Ekf2::task_main()
 			lpos.dist_bottom_valid = _ekf.get_terrain_vert_pos(&terrain_vpos);
 			lpos.dist_bottom = terrain_vpos - pos[2]; // Distance to bottom surface (ground) in meters
 			lpos.dist_bottom_rate = -velocity[2]; // Distance to bottom surface (ground) change rate
-			lpos.surface_bottom_timestamp	= hrt_absolute_time(); // Time when new bottom surface found
+			lpos.surface_bottom_timestamp	= current_time(now); // Time when new bottom surface found
 
 			// TODO: uORB definition does not define what these variables are. We have assumed them to be horizontal and vertical 1-std dev accuracy in metres
 			Vector3f pos_var, vel_var;
@@ -874,7 +884,7 @@ void Ekf2::task_main()
 				// generate and publish global position data
 				struct vehicle_global_position_s global_pos = {};
 
-				global_pos.timestamp = hrt_absolute_time(); // Time of this estimate, in microseconds since system start
+				global_pos.timestamp = current_time(now); // Time of this estimate, in microseconds since system start
 				global_pos.time_utc_usec = gps.time_utc_usec; // GPS UTC timestamp in microseconds
 
 				double est_lat, est_lon, lat_pre_reset, lon_pre_reset;
@@ -939,7 +949,7 @@ void Ekf2::task_main()
 
 		// publish estimator status
 		struct estimator_status_s status = {};
-		status.timestamp = hrt_absolute_time();
+		status.timestamp = current_time(now);
 		_ekf.get_state_delayed(status.states);
 		_ekf.get_covariances(status.covariances);
 		_ekf.get_gps_check_status(&status.gps_check_fail_flags);
@@ -963,7 +973,7 @@ void Ekf2::task_main()
 
 		// Publish wind estimate
 		struct wind_estimate_s wind_estimate = {};
-		wind_estimate.timestamp = hrt_absolute_time();
+		wind_estimate.timestamp = current_time(now);
 		wind_estimate.windspeed_north = status.states[22];
 		wind_estimate.windspeed_east = status.states[23];
 		wind_estimate.covariance_north = status.covariances[22];
@@ -978,31 +988,46 @@ void Ekf2::task_main()
 
 		// publish estimator innovation data
 		{
-			struct ekf2_innovations_s innovations = {};
-			innovations.timestamp = hrt_absolute_time();
-			_ekf.get_vel_pos_innov(&innovations.vel_pos_innov[0]);
-			_ekf.get_mag_innov(&innovations.mag_innov[0]);
-			_ekf.get_heading_innov(&innovations.heading_innov);
-			_ekf.get_airspeed_innov(&innovations.airspeed_innov);
-			_ekf.get_beta_innov(&innovations.beta_innov);
-			_ekf.get_flow_innov(&innovations.flow_innov[0]);
-			_ekf.get_hagl_innov(&innovations.hagl_innov);
-
-			_ekf.get_vel_pos_innov_var(&innovations.vel_pos_innov_var[0]);
-			_ekf.get_mag_innov_var(&innovations.mag_innov_var[0]);
-			_ekf.get_heading_innov_var(&innovations.heading_innov_var);
-			_ekf.get_airspeed_innov_var(&innovations.airspeed_innov_var);
-			_ekf.get_beta_innov_var(&innovations.beta_innov_var);
-			_ekf.get_flow_innov_var(&innovations.flow_innov_var[0]);
-			_ekf.get_hagl_innov_var(&innovations.hagl_innov_var);
-
-			_ekf.get_output_tracking_error(&innovations.output_tracking_error[0]);
+			struct ekf2_innovations_s innovations_local;
+			struct ekf2_innovations_s *innovations = &innovations_local;
+
+			if (_estimator_innovations_pub != nullptr) {
+				// fill in the topic buffer directly to avoid copying the message on publication
+				innovations = (struct ekf2_innovations_s *)orb_loan(ORB_ID(ekf2_innovations), _estimator_innovations_pub);
+
+				if (innovations == nullptr) {
+					innovations = &innovations_local;
+				}
+			}
+
+			*innovations = {};
+			innovations->timestamp = current_time(now);
+			_ekf.get_vel_pos_innov(&innovations->vel_pos_innov[0]);
+			_ekf.get_mag_innov(&innovations->mag_innov[0]);
+			_ekf.get_heading_innov(&innovations->heading_innov);
+			_ekf.get_airspeed_innov(&innovations->airspeed_innov);
+			_ekf.get_beta_innov(&innovations->beta_innov);
+			_ekf.get_flow_innov(&innovations->flow_innov[0]);
+			_ekf.get_hagl_innov(&innovations->hagl_innov);
+
+			_ekf.get_vel_pos_innov_var(&innovations->vel_pos_innov_var[0]);
+			_ekf.get_mag_innov_var(&innovations->mag_innov_var[0]);
+			_ekf.get_heading_innov_var(&innovations->heading_innov_var);
+			_ekf.get_airspeed_innov_var(&innovations->airspeed_innov_var);
+			_ekf.get_beta_innov_var(&innovations->beta_innov_var);
+			_ekf.get_flow_innov_var(&innovations->flow_innov_var[0]);
+			_ekf.get_hagl_innov_var(&innovations->hagl_innov_var);
+
+			_ekf.get_output_tracking_error(&innovations->output_tracking_error[0]);
 
 			if (_estimator_innovations_pub == nullptr) {
-				_estimator_innovations_pub = orb_advertise(ORB_ID(ekf2_innovations), &innovations);
+				_estimator_innovations_pub = orb_advertise(ORB_ID(ekf2_innovations), innovations);
+
+			} else if (innovations != &innovations_local) {
+				orb_publish_loaned(ORB_ID(ekf2_innovations), _estimator_innovations_pub);
 
 			} else {
-				orb_publish(ORB_ID(ekf2_innovations), _estimator_innovations_pub, &innovations);
+				orb_publish(ORB_ID(ekf2_innovations), _estimator_innovations_pub, innovations);
 			}
 
 		}
@@ -1107,6 +1132,20 @@ void Ekf2::task_main()
 				orb_publish(ORB_ID(ekf2_replay), _replay_pub, &replay);
 			}
 		}
+
+		if (_replay_mode) {
+			// tell the replay module that the sample is processed, so that it can publish the next one
+			struct replay_ack_s ack = {};
+			ack.timestamp = now;
+			ack.processed = ++_replay_processed;
+
+			if (_replay_ack_pub == nullptr) {
+				_replay_ack_pub = orb_advertise(ORB_ID(replay_ack_ekf2), &ack);
+
+			} else {
+				orb_publish(ORB_ID(replay_ack_ekf2), _replay_ack_pub, &ack);
+			}
+		}
 	}
 
 	orb_unsubscribe(sensors_sub);
@@ -0,0 +1,1156 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file flight_recorder.cpp
+ * In-memory flight recorder (black box), see FlightRecorder.
+ */
+
+#include "flight_recorder.h"
+
+#include <logger/messages.h>
+#include <logger/ulog_definitions.h>
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <uORB/uORB.h>
+#include <uORB/uORBTopics.h>
+#include <uORB/topics/log_message.h>
+#include <uORB/topics/vehicle_status.h>
+#include <uORB/topics/vehicle_command.h>
+#include <uORB/topics/vehicle_command_ack.h>
+
+#include <px4_includes.h>
+#include <px4_getopt.h>
+#include <px4_log.h>
+#include <px4_sem.h>
+#include <systemlib/git_version.h>
+#include <version/version.h>
+
+#define TRY_SUBSCRIBE_INTERVAL 1000*1000	// interval in microseconds at which we try to subscribe to a topic
+// if we haven't succeeded before
+
+using namespace px4::flight_recorder;
+
+static FlightRecorder *recorder_ptr = nullptr;
+static int recorder_task = -1;
+
+/* This is used to schedule work for the recorder (periodic scan for updated topics) */
+static void timer_callback(void *arg)
+{
+	px4_sem_t *semaphore = (px4_sem_t *)arg;
+	px4_sem_post(semaphore);
+}
+
+namespace
+{
+
+using namespace px4::logger;
+
+#ifdef __PX4_POSIX
+const int fault_signals[] = { SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL };
+#endif
+
+/**
+ * Write the whole buffer, retrying on EINTR. Only uses write(), so it is async-signal-safe.
+ * @return true on success
+ */
+bool write_all(int fd, const uint8_t *data, size_t size)
+{
+	while (size > 0) {
+		ssize_t ret = ::write(fd, data, size);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (ret <= 0) {
+			return false;
+		}
+
+		data += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/**
+ * Small buffered writer for the dump file, without dynamic memory.
+ */
+class DumpFile
+{
+public:
+	explicit DumpFile(int fd) : _fd(fd) {}
+
+	void write(const void *data, size_t size)
+	{
+		_size += size;
+
+		if (_buffer_len + size > sizeof(_buffer)) {
+			flush();
+		}
+
+		if (size > sizeof(_buffer)) {
+			_failed = _failed || !write_all(_fd, (const uint8_t *)data, size);
+
+		} else {
+			memcpy(_buffer + _buffer_len, data, size);
+			_buffer_len += size;
+		}
+	}
+
+	void flush()
+	{
+		_failed = _failed || !write_all(_fd, _buffer, _buffer_len);
+		_buffer_len = 0;
+	}
+
+	bool failed() const { return _failed; }
+
+	/** number of bytes written so far */
+	size_t size() const { return _size; }
+
+private:
+	int _fd;
+	uint8_t _buffer[512];
+	size_t _buffer_len = 0;
+	size_t _size = 0;
+	bool _failed = false;
+};
+
+void write_info(DumpFile &file, const char *name, const char *value)
+{
+	ulog_message_info_header_s msg;
+	size_t msg_size = ulog_encode_info(msg, name, value);
+
+	if (msg_size > 0) {
+		file.write(&msg, msg_size);
+	}
+}
+
+} // anonymous namespace
+
+int flight_recorder_main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		FlightRecorder::usage(nullptr);
+		return 1;
+	}
+
+	//Check if thread exited, but the object has not been destroyed yet (happens in case of an error)
+	if (recorder_task == -1 && recorder_ptr) {
+		delete recorder_ptr;
+		recorder_ptr = nullptr;
+	}
+
+	if (!strcmp(argv[1], "start")) {
+
+		if (recorder_ptr != nullptr) {
+			PX4_INFO("already running");
+			return 1;
+		}
+
+		if (OK != FlightRecorder::start((char *const *)argv)) {
+			PX4_WARN("start failed");
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		if (recorder_ptr == nullptr) {
+			PX4_INFO("not running");
+			return 1;
+		}
+
+		delete recorder_ptr;
+		recorder_ptr = nullptr;
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		if (recorder_ptr) {
+			recorder_ptr->status();
+			return 0;
+
+		} else {
+			PX4_INFO("not running");
+			return 1;
+		}
+	}
+
+	if (!strcmp(argv[1], "dump")) {
+		if (recorder_ptr) {
+			recorder_ptr->trigger("command line", 0);
+			return 0;
+
+		} else {
+			PX4_INFO("not running");
+			return 1;
+		}
+	}
+
+	FlightRecorder::usage("unrecognized command");
+	return 1;
+}
+
+namespace px4
+{
+namespace flight_recorder
+{
+
+void FlightRecorder::usage(const char *reason)
+{
+	if (reason) {
+		PX4_WARN("%s\n", reason);
+	}
+
+	PX4_INFO("usage: flight_recorder {start|stop|status|dump} [-r <rate>] [-b <buffer size>]\n"
+		 "\t-r\tRecording rate in Hz (polling of the topics), default is 500\n"
+		 "\t-b\tMaximum ring buffer size in KiB, default is %u. The ring is sized\n"
+		 "\t\tfor FREC_WINDOW + FREC_POST_TRIG seconds at the topic rates\n"
+		 "\tdump\tWrite the recorded data to a file", (unsigned)(DEFAULT_MAX_RING_SIZE / 1024));
+}
+
+int FlightRecorder::start(char *const *argv)
+{
+	ASSERT(recorder_task == -1);
+
+	/* start the task */
+	recorder_task = px4_task_spawn_cmd("flight_recorder",
+					   SCHED_DEFAULT,
+					   SCHED_PRIORITY_MAX - 5,
+					   3400,
+					   (px4_main_t)&FlightRecorder::run_trampoline,
+					   (char *const *)argv);
+
+	if (recorder_task < 0) {
+		recorder_task = -1;
+		PX4_WARN("task start failed");
+		return -errno;
+	}
+
+	return OK;
+}
+
+void FlightRecorder::run_trampoline(int argc, char *argv[])
+{
+	uint32_t interval = 2000;
+	size_t buffer_size = DEFAULT_MAX_RING_SIZE;
+	bool error_flag = false;
+
+	int myoptind = 1;
+	int ch;
+	const char *myoptarg = NULL;
+
+	while ((ch = px4_getopt(argc, argv, "r:b:", &myoptind, &myoptarg)) != EOF) {
+		switch (ch) {
+		case 'r': {
+				unsigned long r = strtoul(myoptarg, NULL, 10);
+
+				if (r <= 0) {
+					r = 1e6;
+				}
+
+				interval = 1e6 / r;
+			}
+			break;
+
+		case 'b': {
+				unsigned long s = strtoul(myoptarg, NULL, 10);
+
+				if (s < 1) {
+					s = 1;
+				}
+
+				buffer_size = 1024 * s;
+			}
+			break;
+
+		case '?':
+			error_flag = true;
+			break;
+
+		default:
+			PX4_WARN("unrecognized flag");
+			error_flag = true;
+			break;
+		}
+	}
+
+	if (error_flag) {
+		recorder_task = -1;
+		return;
+	}
+
+	recorder_ptr = new FlightRecorder(buffer_size, interval);
+
+	if (recorder_ptr == nullptr) {
+		PX4_ERR("alloc failed");
+
+	} else {
+		recorder_ptr->run();
+	}
+
+	recorder_task = -1;
+}
+
+FlightRecorder::FlightRecorder(size_t max_buffer_size, uint32_t interval) :
+	_max_ring_size(max_buffer_size),
+	_interval(interval)
+{
+	_param_window = param_find("FREC_WINDOW");
+	_param_post_trigger = param_find("FREC_POST_TRIG");
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	if (recorder_task != -1) {
+		/* task wakes up every few ms */
+		_task_should_exit = true;
+
+		/* wait for a second for the task to quit at our request */
+		unsigned int i = 0;
+
+		do {
+			/* wait 20ms */
+			usleep(20000);
+
+			/* if we have given up, kill it */
+			if (++i > 50) {
+				px4_task_delete(recorder_task);
+				recorder_task = -1;
+				break;
+			}
+		} while (recorder_task != -1);
+	}
+
+	if (_ring) {
+		delete[](_ring);
+	}
+
+	if (_msg_buffer) {
+		delete[](_msg_buffer);
+	}
+}
+
+void FlightRecorder::status()
+{
+	uint64_t used = _ring_write_count - _ring_read_count;
+	PX4_INFO("recording %zu topics, ring: %llu / %zu B used (%llu B recorded), %.1f s at the nominal topic rates",
+		 _num_subscriptions, (unsigned long long)used, _ring_size, (unsigned long long)_ring_write_count,
+		 (double)_ring_seconds);
+
+	if (_fault_fd >= 0) {
+		PX4_INFO("fault dump file: %s", _fault_dump_file);
+	}
+
+	PX4_INFO("dumps: %u%s%s", _num_dumps, _num_dumps > 0 ? ", last: " : "", _last_dump_file);
+
+	if (_dump.stage != DumpState::Stage::Idle) {
+		PX4_INFO("dumping (%s) to %s", _dump.reason, _dump.file_name);
+
+	} else if (_dump_requested) {
+		PX4_INFO("dump pending (%s)", _dump_reason);
+	}
+
+	if (_dump_dropped > 0) {
+		PX4_INFO("messages dropped while dumping: %u", (unsigned)_dump_dropped);
+	}
+}
+
+int FlightRecorder::add_topic(const char *name, unsigned rate)
+{
+	const orb_metadata **topics = orb_get_topics();
+
+	for (size_t i = 0; i < orb_topics_count(); i++) {
+		if (strcmp(name, topics[i]->o_name) == 0) {
+			size_t fields_len = strlen(topics[i]->o_fields) + strlen(topics[i]->o_name) + 1; //1 for ':'
+
+			if (fields_len > sizeof(ulog_message_format_s::format)) {
+				PX4_WARN("skip topic %s, format string is too large", name);
+				return -1;
+			}
+
+			if (_num_subscriptions >= MAX_TOPICS_NUM) {
+				PX4_WARN("failed to add topic %s. Too many subscriptions", name);
+				return -1;
+			}
+
+			RecorderSubscription &sub = _subscriptions[_num_subscriptions++];
+			sub.metadata = topics[i];
+			sub.rate = rate;
+
+			/* all instances get a fixed msg id, so that the ADD_LOGGED_MSG messages can be written on every dump */
+			for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; ++instance) {
+				sub.fd[instance] = -1;
+				sub.msg_ids[instance] = _next_topic_id++;
+			}
+
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int FlightRecorder::add_topics_from_file(const char *fname)
+{
+	FILE		*fp;
+	char		line[80];
+	char		topic_name[80];
+	unsigned	rate;
+	int			ntopics = 0;
+
+	/* open the topic list file */
+	fp = fopen(fname, "r");
+
+	if (fp == NULL) {
+		return -1;
+	}
+
+	/* format is TOPIC_NAME, [rate]: topics are recorded at full rate, the nominal publication rate in Hz
+	 * is only used to size the ring */
+	for (;;) {
+
+		/* get a line, bail on error/EOF */
+		line[0] = '\0';
+
+		if (fgets(line, sizeof(line), fp) == NULL) {
+			break;
+		}
+
+		/* skip comment lines */
+		if ((strlen(line) < 2) || (line[0] == '#')) {
+			continue;
+		}
+
+		/* the fields are separated by commas and/or spaces */
+		for (char *c = line; *c; ++c) {
+			if (*c == ',') {
+				*c = ' ';
+			}
+		}
+
+		rate = DEFAULT_TOPIC_RATE;
+
+		if (sscanf(line, "%79s %u", topic_name, &rate) > 0 && add_topic(topic_name, rate) == 0) {
+			ntopics++;
+		}
+	}
+
+	fclose(fp);
+	return ntopics;
+}
+
+void FlightRecorder::add_default_topics()
+{
+	// nominal publication rates in Hz, used to size the ring
+	add_topic("sensor_combined", 250);
+	add_topic("vehicle_attitude", 250);
+	add_topic("vehicle_attitude_setpoint", 50);
+	add_topic("vehicle_rates_setpoint", 250);
+	add_topic("actuator_controls_0", 250);
+	add_topic("actuator_outputs", 250);
+	add_topic("vehicle_local_position", 100);
+	add_topic("vehicle_local_position_setpoint", 50);
+	add_topic("vehicle_global_position", 100);
+	add_topic("vehicle_gps_position", 10);
+	add_topic("manual_control_setpoint", 50);
+	add_topic("battery_status", 100);
+	add_topic("estimator_status", 100);
+	add_topic("vehicle_status", 5);
+	add_topic("vehicle_command", 1);
+	add_topic("commander_state", 5);
+	add_topic("vehicle_land_detected", 1);
+}
+
+void FlightRecorder::run()
+{
+	int ntopics = add_topics_from_file(PX4_ROOTFSDIR "/fs/microsd/etc/logging/flight_recorder_topics.txt");
+
+	if (ntopics > 0) {
+		PX4_INFO("recording %d topics from flight_recorder_topics.txt", ntopics);
+
+	} else {
+		add_default_topics();
+	}
+
+	//all topics added. Get required message buffer size
+	size_t max_msg_size = 0;
+
+	for (size_t i = 0; i < _num_subscriptions; ++i) {
+		//use o_size, because that's what orb_copy will use
+		if (_subscriptions[i].metadata->o_size > max_msg_size) {
+			max_msg_size = _subscriptions[i].metadata->o_size;
+		}
+	}
+
+	max_msg_size += sizeof(ulog_message_data_header_s);
+
+	if (sizeof(ulog_message_logging_s) > max_msg_size) {
+		max_msg_size = sizeof(ulog_message_logging_s);
+	}
+
+	_msg_buffer_len = max_msg_size;
+	_msg_buffer = new uint8_t[_msg_buffer_len];
+
+	if (!_msg_buffer) {
+		PX4_ERR("failed to alloc message buffer");
+		return;
+	}
+
+	/* size the ring for the time span that gets dumped */
+	float window = 0.f;
+	float post_trigger_time = 0.f;
+	param_get(_param_window, &window);
+	param_get(_param_post_trigger, &post_trigger_time);
+	_window = window > 0.f ? window * 1e6f : 0;
+
+	const size_t rate_bytes = data_rate();
+	_ring_size = _max_ring_size;
+
+	if (window > 0.f && rate_bytes > 0) {
+		const float required = (window + post_trigger_time) * rate_bytes;
+
+		if (required < _max_ring_size) {
+			_ring_size = required > max_msg_size ? (size_t)required : max_msg_size;
+
+		} else {
+			PX4_WARN("ring limited to %zu KiB (%.0f KiB required)", _max_ring_size / 1024, (double)(required / 1024.f));
+		}
+	}
+
+	_ring_seconds = rate_bytes > 0 ? (float)_ring_size / rate_bytes : 0.f;
+
+	_ring = new uint8_t[_ring_size];
+
+	if (!_ring) {
+		PX4_ERR("failed to alloc ring buffer");
+		return;
+	}
+
+	PX4_INFO("flight recorder started (%zu KiB, %.1f s)", _ring_size / 1024, (double)_ring_seconds);
+
+	int vehicle_status_sub = orb_subscribe(ORB_ID(vehicle_status));
+	int vehicle_command_sub = orb_subscribe(ORB_ID(vehicle_command));
+	int log_message_sub = orb_subscribe(ORB_ID(log_message));
+	orb_advert_t vehicle_command_ack_pub = nullptr;
+	bool was_failsafe = false;
+
+	install_fault_handler();
+
+	_task_should_exit = false;
+
+	/* init the update timer */
+	struct hrt_call timer_call;
+	memset(&timer_call, 0, sizeof(hrt_call));
+	px4_sem_t timer_semaphore;
+	px4_sem_init(&timer_semaphore, 0, 0);
+	hrt_call_every(&timer_call, _interval, _interval, timer_callback, &timer_semaphore);
+
+	hrt_abstime next_subscribe_check = 0;
+
+	while (!_task_should_exit) {
+
+		/* trigger on failsafe */
+		bool updated;
+
+		if (orb_check(vehicle_status_sub, &updated) == 0 && updated) {
+			vehicle_status_s vehicle_status;
+			orb_copy(ORB_ID(vehicle_status), vehicle_status_sub, &vehicle_status);
+
+			if (vehicle_status.failsafe && !was_failsafe) {
+				float post_trigger = 0.f;
+				param_get(_param_post_trigger, &post_trigger);
+				trigger("failsafe", post_trigger * 1e6f);
+			}
+
+			was_failsafe = vehicle_status.failsafe;
+		}
+
+		/* trigger on command (handle all queued commands) */
+		while (orb_check(vehicle_command_sub, &updated) == 0 && updated) {
+			vehicle_command_s command;
+			orb_copy(ORB_ID(vehicle_command), vehicle_command_sub, &command);
+
+			if (command.command == vehicle_command_s::VEHICLE_CMD_FLIGHT_RECORDER_DUMP) {
+				float post_trigger = 0.f;
+				param_get(_param_post_trigger, &post_trigger);
+				trigger("vehicle_command", post_trigger * 1e6f);
+				ack_vehicle_command(vehicle_command_ack_pub, command.command, vehicle_command_s::VEHICLE_CMD_RESULT_ACCEPTED);
+			}
+		}
+
+		const hrt_abstime now = hrt_absolute_time();
+		const bool try_to_subscribe = now > next_subscribe_check;
+
+		if (try_to_subscribe) {
+			next_subscribe_check = now + TRY_SUBSCRIBE_INTERVAL;
+		}
+
+		record_updates(try_to_subscribe);
+		record_log_messages(log_message_sub);
+
+		if (_dump.stage == DumpState::Stage::Idle && _dump_requested && now >= _dump_time) {
+			int ret = start_dump(_dump_reason);
+
+			if (ret != 0) {
+				PX4_ERR("flight recorder dump failed (%i)", ret);
+				_dump_requested = false;
+			}
+		}
+
+		/* write the dump in chunks, so that recording continues */
+		if (_dump.stage != DumpState::Stage::Idle) {
+			int ret = dump_step();
+
+			if (ret != 0) {
+				PX4_ERR("flight recorder dump failed (%i)", ret);
+				_dump_requested = false;
+
+			} else if (_dump.stage == DumpState::Stage::Idle) {
+				PX4_INFO("flight recorder dump (%s): %s", _dump.reason, _last_dump_file);
+				_dump_requested = false;
+			}
+		}
+
+		while (px4_sem_wait(&timer_semaphore) != 0);
+	}
+
+	hrt_cancel(&timer_call);
+	px4_sem_destroy(&timer_semaphore);
+
+	if (_dump.stage != DumpState::Stage::Idle) {
+		PX4_WARN("stopped while dumping, %s is incomplete", _dump.file_name);
+		close_dump();
+	}
+
+	uninstall_fault_handler();
+
+	for (size_t i = 0; i < _num_subscriptions; ++i) {
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (_subscriptions[i].fd[instance] != -1) {
+				orb_unsubscribe(_subscriptions[i].fd[instance]);
+				_subscriptions[i].fd[instance] = -1;
+			}
+		}
+	}
+
+	orb_unsubscribe(vehicle_status_sub);
+	orb_unsubscribe(vehicle_command_sub);
+	orb_unsubscribe(log_message_sub);
+
+	if (vehicle_command_ack_pub) {
+		orb_unadvertise(vehicle_command_ack_pub);
+	}
+}
+
+void FlightRecorder::record_updates(bool try_to_subscribe)
+{
+	for (size_t i = 0; i < _num_subscriptions; ++i) {
+		RecorderSubscription &sub = _subscriptions[i];
+		size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			int &handle = sub.fd[instance];
+			bool updated = false;
+
+			if (handle < 0) {
+				if (try_to_subscribe && orb_exists(sub.metadata, instance) == OK) {
+					handle = orb_subscribe_multi(sub.metadata, instance);
+					/* orb_copy fails if there is no publisher yet */
+					updated = handle >= 0 && orb_copy(sub.metadata, handle, _msg_buffer + sizeof(ulog_message_data_header_s)) == OK;
+				}
+
+			} else if (orb_check(handle, &updated) == 0 && updated) {
+				orb_copy(sub.metadata, handle, _msg_buffer + sizeof(ulog_message_data_header_s));
+			}
+
+			if (updated) {
+				uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+				//write one byte after another (necessary because of alignment)
+				_msg_buffer[0] = (uint8_t)write_msg_size;
+				_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
+				_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
+				_msg_buffer[3] = (uint8_t)sub.msg_ids[instance];
+				_msg_buffer[4] = (uint8_t)(sub.msg_ids[instance] >> 8);
+
+				ring_write(_msg_buffer, msg_size);
+			}
+		}
+	}
+}
+
+void FlightRecorder::record_log_messages(int log_message_sub)
+{
+	log_message_s log_messages[2]; // queue size of the publisher
+	int num_log_messages = orb_copy_all(ORB_ID(log_message), log_message_sub, log_messages,
+					    sizeof(log_messages) / sizeof(log_messages[0]), nullptr);
+
+	for (int i = 0; i < num_log_messages; ++i) {
+		const log_message_s &log_message = log_messages[i];
+		const char *message = (const char *)log_message.text;
+		int message_len = strlen(message);
+
+		if (message_len > 0) {
+			uint16_t write_msg_size = sizeof(ulog_message_logging_s) - sizeof(ulog_message_logging_s::message)
+						  - ULOG_MSG_HEADER_LEN + message_len;
+			_msg_buffer[0] = (uint8_t)write_msg_size;
+			_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
+			_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::LOGGING);
+			_msg_buffer[3] = log_message.severity + '0';
+			memcpy(_msg_buffer + 4, &log_message.timestamp, sizeof(ulog_message_logging_s::timestamp));
+			strncpy((char *)(_msg_buffer + 12), message, sizeof(ulog_message_logging_s::message));
+
+			ring_write(_msg_buffer, write_msg_size + ULOG_MSG_HEADER_LEN);
+		}
+	}
+}
+
+void FlightRecorder::ring_write(const uint8_t *data, size_t size)
+{
+	if (size > _ring_size) {
+		return;
+	}
+
+	const uint64_t write_count = _ring_write_count;
+	uint64_t read_count = _ring_read_count;
+
+	/* drop the oldest messages until there is enough space */
+	while (write_count + size - read_count > _ring_size) {
+		uint8_t header[ULOG_MSG_HEADER_LEN];
+		ring_read(read_count, header, sizeof(header));
+		const uint64_t next_count = read_count + ULOG_MSG_HEADER_LEN + (header[0] | (header[1] << 8));
+
+		if (_dump.stage != DumpState::Stage::Idle && next_count > _dump.pos && read_count < _dump.end) {
+			/* the oldest message is part of the dump in progress and not written yet: drop the new one */
+			_ring_read_count = read_count;
+			++_dump_dropped;
+			return;
+		}
+
+		read_count = next_count;
+	}
+
+	/* publish the new read position before overwriting the data, in case a fault handler dumps the ring */
+	_ring_read_count = read_count;
+
+	size_t pos = write_count % _ring_size;
+	size_t first = size < _ring_size - pos ? size : _ring_size - pos;
+	memcpy(_ring + pos, data, first);
+	memcpy(_ring, data + first, size - first);
+
+	_ring_write_count = write_count + size;
+}
+
+void FlightRecorder::ring_read(uint64_t pos, uint8_t *data, size_t size) const
+{
+	size_t offset = pos % _ring_size;
+	size_t first = size < _ring_size - offset ? size : _ring_size - offset;
+	memcpy(data, _ring + offset, first);
+	memcpy(data + first, _ring, size - first);
+}
+
+uint64_t FlightRecorder::find_window_start(uint64_t read_count, uint64_t write_count) const
+{
+	if (_window == 0) {
+		return read_count;
+	}
+
+	const hrt_abstime now = hrt_absolute_time();
+	const hrt_abstime start_time = now > _window ? now - _window : 0;
+
+	/* messages are roughly in time order: skip everything before the first message inside the window */
+	while (read_count < write_count) {
+		uint8_t header[sizeof(ulog_message_data_header_s) + sizeof(uint64_t)];
+		ring_read(read_count, header, sizeof(header));
+		const uint16_t msg_size = header[0] | (header[1] << 8);
+		uint64_t timestamp;
+
+		if (header[2] == static_cast<uint8_t>(ULogMessageType::DATA)) {
+			memcpy(&timestamp, header + sizeof(ulog_message_data_header_s), sizeof(timestamp));
+
+			if (timestamp >= start_time) {
+				break;
+			}
+
+		} else if (header[2] == static_cast<uint8_t>(ULogMessageType::LOGGING)) {
+			memcpy(&timestamp, header + 4, sizeof(timestamp));
+
+			if (timestamp >= start_time) {
+				break;
+			}
+		}
+
+		read_count += ULOG_MSG_HEADER_LEN + msg_size;
+	}
+
+	return read_count;
+}
+
+void FlightRecorder::trigger(const char *reason, hrt_abstime delay_us)
+{
+	if (_dump_requested) {
+		return; // already pending: the data of this trigger will be in the dump as well
+	}
+
+	_dump_reason = reason;
+	_dump_time = hrt_absolute_time() + delay_us;
+	_dump_requested = true;
+}
+
+int FlightRecorder::open_dump_file(char *file_name, size_t file_name_size)
+{
+	/* create the parent (log root) dir as well */
+	char dir[128];
+	snprintf(dir, sizeof(dir), "%s", DUMP_DIR);
+	char *separator = strrchr(dir, '/');
+
+	if (separator) {
+		*separator = '\0';
+
+		if (mkdir(dir, S_IRWXU | S_IRWXG | S_IRWXO) != 0 && errno != EEXIST) {
+			return -errno;
+		}
+	}
+
+	if (mkdir(DUMP_DIR, S_IRWXU | S_IRWXG | S_IRWXO) != 0 && errno != EEXIST) {
+		return -errno;
+	}
+
+	/* look for the next file that does not exist */
+	for (unsigned file_number = 1; file_number <= MAX_NO_DUMPFILE; ++file_number) {
+		snprintf(file_name, file_name_size, "%s/rec%03u.ulg", DUMP_DIR, file_number);
+		int fd = ::open(file_name, O_CREAT | O_EXCL | O_WRONLY, PX4_O_MODE_666);
+
+		if (fd >= 0 || errno != EEXIST) {
+			return fd >= 0 ? fd : -errno;
+		}
+	}
+
+	return -ENOSPC;
+}
+
+int FlightRecorder::write_definitions(DumpState &state, size_t max_size)
+{
+	DumpFile file(state.fd);
+
+	while (state.stage != DumpState::Stage::Idle && state.stage != DumpState::Stage::Data && file.size() < max_size) {
+		switch (state.stage) {
+		case DumpState::Stage::Header: {
+				ulog_file_header_s header;
+				file.write(&header, ulog_encode_header(header, hrt_absolute_time()));
+
+				write_info(file, "ver_sw", PX4_GIT_VERSION_STR);
+				write_info(file, "ver_hw", HW_ARCH);
+				write_info(file, "sys_name", "PX4");
+				write_info(file, "flight_recorder_trigger", state.reason);
+
+				state.stage = DumpState::Stage::Formats;
+				state.index = 0;
+			}
+			break;
+
+		case DumpState::Stage::Formats:
+
+			//write all known formats (the recorded topics can contain nested types)
+			if (state.index < orb_topics_count()) {
+				ulog_message_format_s format_msg;
+				file.write(&format_msg, ulog_encode_format(format_msg, orb_get_topics()[state.index++]));
+
+			} else {
+				state.stage = DumpState::Stage::Parameters;
+				state.index = 0;
+			}
+
+			break;
+
+		case DumpState::Stage::Parameters:
+			if (state.index < param_count()) {
+				param_t param = param_for_index(state.index++);
+
+				if (param != PARAM_INVALID && param_used(param)) {
+					ulog_message_parameter_header_s param_msg;
+					size_t msg_size = ulog_encode_parameter(param_msg, param);
+
+					if (msg_size > 0) {
+						file.write(&param_msg, msg_size);
+					}
+				}
+
+			} else {
+				state.stage = DumpState::Stage::AddLoggedMsgs;
+				state.index = 0;
+			}
+
+			break;
+
+		case DumpState::Stage::AddLoggedMsgs:
+			if (state.index < _num_subscriptions * ORB_MULTI_MAX_INSTANCES) {
+				const RecorderSubscription &sub = _subscriptions[state.index / ORB_MULTI_MAX_INSTANCES];
+				const int instance = state.index % ORB_MULTI_MAX_INSTANCES;
+				ulog_message_add_logged_s add_logged_msg;
+				file.write(&add_logged_msg, ulog_encode_add_logged_msg(add_logged_msg, sub.metadata,
+						sub.msg_ids[instance], instance));
+				++state.index;
+
+			} else {
+				state.stage = DumpState::Stage::Data;
+			}
+
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	file.flush();
+	return file.failed() ? -EIO : 0;
+}
+
+bool FlightRecorder::write_ring(int fd, uint64_t start, uint64_t end) const
+{
+	for (uint64_t pos = start; pos < end;) {
+		size_t offset = pos % _ring_size;
+		size_t len = _ring_size - offset;
+
+		if (len > end - pos) {
+			len = end - pos;
+		}
+
+		if (!write_all(fd, _ring + offset, len)) {
+			return false;
+		}
+
+		pos += len;
+	}
+
+	return true;
+}
+
+int FlightRecorder::start_dump(const char *reason)
+{
+	/* take a snapshot of the ring positions. The recorder continues to write while the file is written,
+	 * but does not overwrite the data between _dump.pos and _dump.end. */
+	const uint64_t write_count = _ring_write_count;
+	const uint64_t read_count = _ring_read_count;
+
+	if (_ring == nullptr || write_count == read_count) {
+		return -ENODATA;
+	}
+
+	float window = 0.f;
+	param_get(_param_window, &window);
+	_window = window > 0.f ? window * 1e6f : 0;
+
+	int fd = open_dump_file(_dump.file_name, sizeof(_dump.file_name));
+
+	if (fd < 0) {
+		return fd;
+	}
+
+	_dump.fd = fd;
+	_dump.reason = reason;
+	_dump.index = 0;
+	_dump.pos = find_window_start(read_count, write_count);
+	_dump.end = write_count;
+	_dump.stage = DumpState::Stage::Header;
+	return 0;
+}
+
+int FlightRecorder::dump_step()
+{
+	int ret = 0;
+
+	if (_dump.stage != DumpState::Stage::Data) {
+		ret = write_definitions(_dump, DUMP_CHUNK_SIZE);
+
+	} else {
+		/* the data messages, directly from the ring */
+		const uint64_t end = _dump.end - _dump.pos > DUMP_CHUNK_SIZE ? _dump.pos + DUMP_CHUNK_SIZE : _dump.end;
+
+		if (!write_ring(_dump.fd, _dump.pos, end)) {
+			ret = -EIO;
+		}
+
+		_dump.pos = end;
+	}
+
+	if (ret != 0) {
+		close_dump();
+		return ret;
+	}
+
+	if (_dump.stage == DumpState::Stage::Data && _dump.pos == _dump.end) {
+		close_dump();
+		strncpy(_last_dump_file, _dump.file_name, sizeof(_last_dump_file));
+		++_num_dumps;
+	}
+
+	return 0;
+}
+
+void FlightRecorder::close_dump()
+{
+	::fsync(_dump.fd);
+	::close(_dump.fd);
+	_dump.fd = -1;
+	_dump.stage = DumpState::Stage::Idle;
+}
+
+void FlightRecorder::ack_vehicle_command(orb_advert_t &vehicle_command_ack_pub, uint16_t command, uint32_t result)
+{
+	vehicle_command_ack_s vehicle_command_ack;
+	vehicle_command_ack.timestamp = hrt_absolute_time();
+	vehicle_command_ack.command = command;
+	vehicle_command_ack.result = result;
+
+	if (vehicle_command_ack_pub == nullptr) {
+		vehicle_command_ack_pub = orb_advertise_queue(ORB_ID(vehicle_command_ack), &vehicle_command_ack,
+					  vehicle_command_ack_s::ORB_QUEUE_LENGTH);
+
+	} else {
+		orb_publish(ORB_ID(vehicle_command_ack), vehicle_command_ack_pub, &vehicle_command_ack);
+	}
+}
+
+size_t FlightRecorder::data_rate() const
+{
+	/* recorded rate of the topics, limited by the polling rate */
+	const unsigned max_rate = 1000000 / _interval;
+	size_t bytes_per_second = LOG_MESSAGES_RATE * sizeof(ulog_message_logging_s);
+
+	for (size_t i = 0; i < _num_subscriptions; ++i) {
+		const unsigned rate = _subscriptions[i].rate < max_rate ? _subscriptions[i].rate : max_rate;
+		bytes_per_second += rate * (sizeof(ulog_message_data_header_s) + _subscriptions[i].metadata->o_size_no_padding);
+	}
+
+	return bytes_per_second;
+}
+
+#ifdef __PX4_POSIX
+void FlightRecorder::fault_handler(int signo)
+{
+	/*
+	 * Runs on the alternate signal stack of the faulting task (set up by the POSIX task layer), and
+	 * must only use async-signal-safe calls: the definitions are already in the file, only the ring
+	 * content is appended with write(). The whole ring is written, as the time window cannot be
+	 * applied (hrt_absolute_time() takes a lock).
+	 * The handler is reset to the default action on entry (SA_RESETHAND).
+	 */
+	FlightRecorder *recorder = recorder_ptr;
+
+	if (recorder && recorder->_fault_fd >= 0) {
+		const int fd = recorder->_fault_fd;
+		recorder->_fault_fd = -1;
+		recorder->write_ring(fd, recorder->_ring_read_count, recorder->_ring_write_count);
+		::fsync(fd);
+		::close(fd);
+	}
+
+	raise(signo);
+}
+#endif
+
+void FlightRecorder::install_fault_handler()
+{
+#ifdef __PX4_POSIX
+	/* prepare the dump file now: creating and formatting it is not possible from the fault handler */
+	int fd = open_dump_file(_fault_dump_file, sizeof(_fault_dump_file));
+
+	if (fd < 0) {
+		PX4_WARN("no fault dump file (%i)", fd);
+		return;
+	}
+
+	DumpState state;
+	state.fd = fd;
+	state.reason = "fault";
+	state.stage = DumpState::Stage::Header;
+
+	if (write_definitions(state, SIZE_MAX) != 0) {
+		PX4_WARN("failed to write %s", _fault_dump_file);
+		::close(fd);
+		unlink(_fault_dump_file);
+		return;
+	}
+
+	_fault_fd = fd;
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &FlightRecorder::fault_handler;
+	action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+	sigemptyset(&action.sa_mask);
+
+	for (unsigned i = 0; i < sizeof(fault_signals) / sizeof(fault_signals[0]); ++i) {
+		sigaction(fault_signals[i], &action, nullptr);
+	}
+
+#else
+	/* on NuttX, hardfaults are handled by the board crash dump (see hardfault_log), where
+	 * no file system access is possible. The ring can still be dumped on a failsafe or command. */
+#endif
+}
+
+void FlightRecorder::uninstall_fault_handler()
+{
+#ifdef __PX4_POSIX
+
+	if (_fault_fd < 0) {
+		return;
+	}
+
+	for (unsigned i = 0; i < sizeof(fault_signals) / sizeof(fault_signals[0]); ++i) {
+		signal(fault_signals[i], SIG_DFL);
+	}
+
+	/* no fault: the prepared file only contains the definitions */
+	::close(_fault_fd);
+	_fault_fd = -1;
+	unlink(_fault_dump_file);
+#endif
+}
+
+} // namespace flight_recorder
+} // namespace px4
@@ -0,0 +1,245 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <px4.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/param/param.h>
+
+extern "C" __EXPORT int flight_recorder_main(int argc, char *argv[]);
+
+namespace px4
+{
+namespace flight_recorder
+{
+
+struct RecorderSubscription {
+	const orb_metadata *metadata;
+	unsigned rate; ///< nominal publication rate [Hz], used to size the ring
+	int fd[ORB_MULTI_MAX_INSTANCES];
+	uint16_t msg_ids[ORB_MULTI_MAX_INSTANCES];
+};
+
+/**
+ * Progress of writing a dump file. The file is written in chunks, one per loop iteration of the recorder.
+ */
+struct DumpState {
+	enum class Stage {
+		Idle,
+		Header, ///< ULog header and info messages
+		Formats,
+		Parameters,
+		AddLoggedMsgs,
+		Data, ///< ring content
+	};
+
+	Stage stage = Stage::Idle;
+	int fd = -1;
+	unsigned index = 0; ///< next format, parameter or subscription to write
+	uint64_t pos = 0; ///< next ring position to write. Until it is written, the recorder does not overwrite it.
+	uint64_t end = 0; ///< ring position at which the dump ends
+	const char *reason = nullptr;
+	char file_name[64] = "";
+};
+
+/**
+ * @class FlightRecorder
+ * Black box recorder: keeps the most recent data of a set of topics in a preallocated RAM ring,
+ * encoded as ULog data messages, and writes the ring to a ULog file when triggered.
+ * The ring is sized for FREC_WINDOW + FREC_POST_TRIG seconds at the nominal topic rates.
+ * Triggers:
+ * - by a VEHICLE_CMD_FLIGHT_RECORDER_DUMP vehicle command,
+ * - when the system enters failsafe (vehicle_status.failsafe),
+ * - from a fault handler (POSIX: SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL),
+ * - or from the command line.
+ *
+ * Topics are recorded at full rate, without continuous write load on the SD card.
+ */
+class FlightRecorder
+{
+public:
+	FlightRecorder(size_t max_buffer_size, uint32_t interval);
+
+	~FlightRecorder();
+
+	static int start(char *const *argv);
+
+	static void usage(const char *reason);
+
+	void status();
+
+	/**
+	 * Request a dump of the ring from another task. The file is written by the recorder task.
+	 * @param reason stored in the log file (info message 'flight_recorder_trigger')
+	 * @param delay_us time to continue recording before writing the file
+	 */
+	void trigger(const char *reason, hrt_abstime delay_us);
+
+private:
+	static void run_trampoline(int argc, char *argv[]);
+
+	void run();
+
+	int add_topic(const char *name, unsigned rate);
+
+	/**
+	 * Parse a file containing a list of uORB topics to record (same format as the logger's).
+	 * @return number of topics added
+	 */
+	int add_topics_from_file(const char *fname);
+
+	void add_default_topics();
+
+	/**
+	 * Copy all updated topics into the ring.
+	 */
+	void record_updates(bool try_to_subscribe);
+
+	void record_log_messages(int log_message_sub);
+
+	/**
+	 * Append one ULog message to the ring, dropping the oldest messages if required.
+	 */
+	void ring_write(const uint8_t *data, size_t size);
+
+	void ring_read(uint64_t pos, uint8_t *data, size_t size) const;
+
+	/**
+	 * Find the first message to dump, so that the dump covers the configured time window.
+	 * @return position of the message in the ring
+	 */
+	uint64_t find_window_start(uint64_t read_count, uint64_t write_count) const;
+
+	int open_dump_file(char *file_name, size_t file_name_size);
+
+	/**
+	 * Open a new dump file for the current ring content (within the time window).
+	 * The file is then written by dump_step().
+	 * @return 0 on success, <0 on error
+	 */
+	int start_dump(const char *reason);
+
+	/**
+	 * Write the next chunk of the dump file, and close it when it is complete.
+	 * @return 0 on success, <0 on error (the dump is aborted)
+	 */
+	int dump_step();
+
+	void close_dump();
+
+	/**
+	 * Write the next part of the ULog header, info, formats, parameters and ADD_LOGGED_MSG messages,
+	 * advancing state.stage up to DumpState::Stage::Data.
+	 * @param max_size stop after the message that exceeds this size
+	 * @return 0 on success, <0 on error
+	 */
+	int write_definitions(DumpState &state, size_t max_size);
+
+	/**
+	 * Write the ring content between the positions start and end. Async-signal-safe.
+	 */
+	bool write_ring(int fd, uint64_t start, uint64_t end) const;
+
+	/**
+	 * Recorded data rate of all topics at their nominal rates [bytes/s]
+	 */
+	size_t data_rate() const;
+
+	void ack_vehicle_command(orb_advert_t &vehicle_command_ack_pub, uint16_t command, uint32_t result);
+
+#ifdef __PX4_POSIX
+	static void fault_handler(int signo);
+#endif
+
+	/**
+	 * Prepare the fault dump file and install the signal handlers (POSIX only).
+	 */
+	void install_fault_handler();
+
+	void uninstall_fault_handler();
+
+	static constexpr size_t 	MAX_TOPICS_NUM = 32; /**< Maximum number of recorded topics */
+	static constexpr unsigned	MAX_NO_DUMPFILE = 999; /**< Maximum number of dump files */
+	static constexpr unsigned	DEFAULT_TOPIC_RATE = 10; /**< [Hz] nominal rate of topics from the topics file without rate */
+	static constexpr unsigned	LOG_MESSAGES_RATE = 5; /**< [Hz] log messages reserved in the ring */
+	static constexpr size_t		DUMP_CHUNK_SIZE = 4096; /**< bytes written to the dump file per loop iteration */
+#ifdef __PX4_NUTTX
+	static constexpr size_t		DEFAULT_MAX_RING_SIZE = 64 * 1024;
+#else
+	static constexpr size_t		DEFAULT_MAX_RING_SIZE = 2048 * 1024;
+#endif
+#ifdef __PX4_POSIX_EAGLE
+	static constexpr const char	*DUMP_DIR = PX4_ROOTFSDIR"/log/flight_recorder";
+#else
+	static constexpr const char 	*DUMP_DIR = PX4_ROOTFSDIR"/fs/microsd/log/flight_recorder";
+#endif
+
+	RecorderSubscription		_subscriptions[MAX_TOPICS_NUM];
+	size_t				_num_subscriptions = 0;
+	uint16_t			_next_topic_id = 0;
+
+	uint8_t				*_ring = nullptr;
+	const size_t			_max_ring_size;
+	size_t				_ring_size = 0;
+	float				_ring_seconds = 0.f; ///< time span covered by the ring at the nominal topic rates
+	/* total number of bytes written to/dropped from the ring. Positions in the ring are these modulo _ring_size.
+	 * They are only written by the recorder task, and read by dump() (possibly from a fault handler). */
+	volatile uint64_t		_ring_write_count = 0;
+	volatile uint64_t		_ring_read_count = 0;
+	uint8_t				*_msg_buffer = nullptr;
+	size_t				_msg_buffer_len = 0;
+
+	const uint32_t			_interval;
+	bool				_task_should_exit = true;
+
+	volatile bool			_dump_requested = false;
+	hrt_abstime			_dump_time = 0; ///< when to write the requested dump
+	const char			*_dump_reason = nullptr;
+	DumpState			_dump; ///< dump in progress (only used by the recorder task)
+	uint32_t			_dump_dropped = 0; ///< messages not recorded because the dump had not written their space yet
+
+	// statistics
+	unsigned			_num_dumps = 0;
+	char				_last_dump_file[64] = "";
+
+	int				_fault_fd = -1; ///< prepared dump file for the fault handler
+	char				_fault_dump_file[64] = "";
+
+	param_t				_param_window;
+	param_t				_param_post_trigger;
+	hrt_abstime			_window = 0; ///< [us] time span to dump
+};
+
+} //namespace flight_recorder
+} //namespace px4
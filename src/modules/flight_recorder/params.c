@@ -0,0 +1,63 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * Flight recorder time window
+ *
+ * Time span before the trigger (plus the post-trigger time) that is written
+ * to the dump file. The ring buffer is sized for this time span at the
+ * nominal topic rates, up to the maximum size given on the command line.
+ * Set to 0 to use the maximum size and write the whole ring buffer.
+ * Requires a restart of the flight recorder.
+ *
+ * @unit s
+ * @min 0
+ * @max 600
+ * @decimal 1
+ * @group SD Logging
+ */
+PARAM_DEFINE_FLOAT(FREC_WINDOW, 10.0f);
+
+/**
+ * Flight recorder post-trigger time
+ *
+ * Time to continue recording after a failsafe or a dump command,
+ * before the dump file is written.
+ *
+ * @unit s
+ * @min 0
+ * @max 60
+ * @decimal 1
+ * @group SD Logging
+ */
+PARAM_DEFINE_FLOAT(FREC_POST_TRIG, 2.0f);
@@ -137,6 +137,15 @@ void LogWriter::stop_log_file()
 	}
 }
 
+bool LogWriter::rotate_log_file(const char *filename)
+{
+	if (_log_writer_file) {
+		return _log_writer_file->rotate_log(filename);
+	}
+
+	return false;
+}
+
 void LogWriter::start_log_mavlink()
 {
 	if (_log_writer_mavlink) {
@@ -69,6 +69,19 @@ public:
 
 	void stop_log_file();
 
+	/**
+	 * Continue file logging in a new file (@see LogWriterFile::rotate_log())
+	 * @return false if not possible (yet)
+	 */
+	bool rotate_log_file(const char *filename);
+
+	bool file_rotation_pending() const
+	{
+		if (_log_writer_file) { return _log_writer_file->rotation_pending(); }
+
+		return false;
+	}
+
 	void start_log_mavlink();
 
 	void stop_log_mavlink();
@@ -123,6 +136,42 @@ public:
 		return 0;
 	}
 
+	/**
+	 * Offset in the (uncompressed) log file of the next written message (@see LogWriterFile::get_file_pos())
+	 */
+	uint64_t get_file_pos() const
+	{
+		if (_log_writer_file) { return _log_writer_file->get_file_pos(); }
+
+		return 0;
+	}
+
+	size_t get_total_uncompressed_file() const
+	{
+		if (_log_writer_file) { return _log_writer_file->get_total_uncompressed(); }
+
+		return 0;
+	}
+
+	/**
+	 * Enable or disable compression of the next log file (@see LogWriterFile::set_compression())
+	 * @return false on allocation failure
+	 */
+	bool set_file_compression(bool enable)
+	{
+		if (_log_writer_file) { return _log_writer_file->set_compression(enable); }
+
+		return !enable;
+	}
+
+	/**
+	 * Enable or disable the preallocated I/O mode for the next log file (@see LogWriterFile::set_preallocate())
+	 */
+	void set_file_preallocate(bool enable)
+	{
+		if (_log_writer_file) { _log_writer_file->set_preallocate(enable); }
+	}
+
 	size_t get_buffer_size_file() const
 	{
 		if (_log_writer_file) { return _log_writer_file->get_buffer_size(); }
@@ -33,8 +33,13 @@
 
 #include "log_writer_file.h"
 #include "messages.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef __PX4_LINUX
+#include <sys/uio.h>
+#endif
 
 #include <mathlib/mathlib.h>
 #include <px4_posix.h>
@@ -44,6 +49,7 @@ namespace px4
 namespace logger
 {
 constexpr size_t LogWriterFile::_min_write_chunk;
+constexpr size_t LogWriterFile::PREALLOC_EXTENT;
 
 
 LogWriterFile::LogWriterFile(size_t buffer_size) :
@@ -52,10 +58,11 @@ LogWriterFile::LogWriterFile(size_t buffer_size) :
 	_buffer_size(math::max(buffer_size, _min_write_chunk + 300))
 {
 	pthread_mutex_init(&_mtx, nullptr);
-	pthread_cond_init(&_cv, nullptr);
+	px4_sem_init(&_sem, 0, 0);
 	/* allocate write performance counters */
 	_perf_write = perf_alloc(PC_ELAPSED, "sd write");
 	_perf_fsync = perf_alloc(PC_ELAPSED, "sd fsync");
+	_perf_compress = perf_alloc(PC_ELAPSED, "log compress");
 }
 
 bool LogWriterFile::init()
@@ -72,40 +79,165 @@ bool LogWriterFile::init()
 LogWriterFile::~LogWriterFile()
 {
 	pthread_mutex_destroy(&_mtx);
-	pthread_cond_destroy(&_cv);
+	px4_sem_destroy(&_sem);
 	perf_free(_perf_write);
 	perf_free(_perf_fsync);
+	perf_free(_perf_compress);
 
 	if (_buffer) {
 		delete[] _buffer;
 	}
+
+	delete _compressor;
+	delete[] _compressed_message;
+	free(_next_file_name);
+}
+
+bool LogWriterFile::set_compression(bool enable)
+{
+	_compress = false;
+
+	if (!enable) {
+		return true;
+	}
+
+	if (!_compressor) {
+		_compressor = new ULogCompressor();
+		_compressed_message = new uint8_t[ULogCompressor::MAX_MESSAGE_SIZE];
+
+		if (!_compressor || !_compressed_message || !_compressor->init()) {
+			delete _compressor;
+			delete[] _compressed_message;
+			_compressor = nullptr;
+			_compressed_message = nullptr;
+			return false;
+		}
+	}
+
+	_compress = true;
+	return true;
 }
 
 void LogWriterFile::start_log(const char *filename)
+{
+	if (!open_file(filename)) {
+		_should_run = false;
+		return;
+	}
+
+	_running = true;
+
+	// Clear buffer
+	_head = 0;
+	_tail = 0;
+	_rotate_pending = false;
+	_file_pos = 0;
+
+	/* the writer thread must see the cleared state before it starts */
+	__atomic_store_n(&_should_run, true, __ATOMIC_RELEASE);
+	notify();
+}
+
+bool LogWriterFile::rotate_log(const char *filename)
+{
+	if (!is_started() || rotation_pending()) {
+		return false;
+	}
+
+	free(_next_file_name);
+	_next_file_name = strdup(filename);
+
+	if (!_next_file_name) {
+		return false;
+	}
+
+	/* the data written so far goes into the current file */
+	_rotate_pos = _head;
+	_file_pos = 0;
+	__atomic_store_n(&_rotate_pending, true, __ATOMIC_RELEASE);
+	notify();
+	return true;
+}
+
+bool LogWriterFile::open_file(const char *filename)
 {
 	_fd = ::open(filename, O_CREAT | O_WRONLY, PX4_O_MODE_666);
 
 	if (_fd < 0) {
 		PX4_ERR("Can't open log file %s", filename);
-		_should_run = false;
+		return false;
+	}
+
+	PX4_INFO("Opened log file: %s", filename);
+
+	// Clear counters
+	_total_written = 0;
+	_total_uncompressed = 0;
+
+	_compressing = _compress;
+	_preallocating = _preallocate;
+	_allocated_size = 0;
+
+	if (_compressing) {
+		_compressor->reset();
+		_uncompressed_remaining = sizeof(ulog_file_header_s);
+	}
+
+	return true;
+}
+
+void LogWriterFile::close_file()
+{
+	if (_compressing && _compressor->block_len() > 0 && write_compressed_block() < 0) {
+		PX4_WARN("error writing log file");
+	}
+
+	if (_fd < 0) {
 		return;
+	}
+
+#ifdef __PX4_LINUX
+
+	/* release the preallocated space after the end of the log */
+	if (_allocated_size > _total_written && ::ftruncate(_fd, _total_written) != 0) {
+		PX4_WARN("failed to truncate log file (%i)", errno);
+	}
+
+#endif
+	int res = ::close(_fd);
+	_fd = -1;
+
+	if (res) {
+		PX4_WARN("error closing log file");
+
+	} else if (_compressing) {
+		PX4_INFO("closed logfile, bytes written: %zu (compressed from %zu)", _total_written,
+			 _total_uncompressed);
 
 	} else {
-		PX4_INFO("Opened log file: %s", filename);
-		_should_run = true;
-		_running = true;
+		PX4_INFO("closed logfile, bytes written: %zu", _total_written);
 	}
+}
 
-	// Clear buffer and counters
-	_head = 0;
-	_count = 0;
-	_total_written = 0;
-	notify();
+void LogWriterFile::rotate_file()
+{
+	close_file();
+
+	if (!open_file(_next_file_name)) {
+		/* the remaining data is discarded (_fd < 0) */
+		__atomic_store_n(&_should_run, false, __ATOMIC_RELEASE);
+	}
+
+	free(_next_file_name);
+	_next_file_name = nullptr;
+
+	__atomic_store_n(&_rotate_pending, false, __ATOMIC_RELEASE);
 }
 
 void LogWriterFile::stop_log()
 {
-	_should_run = false;
+	/* everything written to the buffer so far is visible to the writer thread once it sees this */
+	__atomic_store_n(&_should_run, false, __ATOMIC_RELEASE);
 	notify();
 }
 
@@ -131,7 +263,7 @@ void LogWriterFile::thread_stop()
 {
 	// this will terminate the main loop of the writer thread
 	_exit_thread = true;
-	_should_run = false;
+	__atomic_store_n(&_should_run, false, __ATOMIC_RELEASE);
 
 	notify();
 
@@ -158,11 +290,9 @@ void LogWriterFile::run()
 		// Outer endless loop
 		// Wait for _should_run flag
 		while (!_exit_thread) {
-			bool start = false;
-			pthread_mutex_lock(&_mtx);
-			pthread_cond_wait(&_cv, &_mtx);
-			start = _should_run;
-			pthread_mutex_unlock(&_mtx);
+			__atomic_store_n(&_waiting, true, __ATOMIC_SEQ_CST);
+			const bool start = __atomic_load_n(&_should_run, __ATOMIC_ACQUIRE);
+			wait_for_notify(start || _exit_thread);
 
 			if (start) {
 				break;
@@ -174,41 +304,55 @@ void LogWriterFile::run()
 
 		while (true) {
 			size_t available = 0;
+			size_t count = 0;
 			void *read_ptr = nullptr;
 			bool is_part = false;
+			bool should_run;
+			bool rotate;
 
-			/* lock _buffer
-			 * wait for sufficient data, cycle on notify()
-			 */
-			pthread_mutex_lock(&_mtx);
-
+			/* wait for sufficient data, cycle on notify() */
 			while (true) {
-				available = get_read_ptr(&read_ptr, &is_part);
+				__atomic_store_n(&_waiting, true, __ATOMIC_SEQ_CST);
 
-				/* if sufficient data available or partial read or terminating, exit this wait loop */
-				if ((available >= _min_write_chunk) || is_part || !_should_run) {
-					/* GOTO end of block */
-					break;
+				/* read the flag before the buffer state, so that all data is seen when stopping */
+				should_run = __atomic_load_n(&_should_run, __ATOMIC_ACQUIRE);
+				available = get_read_ptr(&read_ptr, &is_part, &count, &rotate);
+
+				if (_preallocating && !_compressing) {
+					/* write both parts of the ring buffer together, in multiples of the chunk size,
+					 * so that all writes are aligned (except for the last one) */
+					available = should_run && !rotate ? count - count % _min_write_chunk : count;
+					is_part = false;
 				}
 
-				/* wait for a call to notify()
-				 * this call unlocks the mutex while waiting, and returns with the mutex locked
-				 */
-				pthread_cond_wait(&_cv, &_mtx);
+				/* if sufficient data available or partial read or terminating or switching the file,
+				 * exit this wait loop */
+				const bool ready = (available >= _min_write_chunk) || is_part || !should_run || rotate;
+				wait_for_notify(ready);
+
+				if (ready) {
+					break;
+				}
 			}
 
-			pthread_mutex_unlock(&_mtx);
 			written = 0;
 
 			if (available > 0) {
-				perf_begin(_perf_write);
-				written = ::write(_fd, read_ptr, available);
-				perf_end(_perf_write);
+				if (_fd < 0) {
+					/* the file could not be opened: discard */
+					written = available;
+
+				} else if (_preallocating && !_compressing) {
+					written = write_ring(read_ptr, available);
+
+				} else {
+					written = write_to_file(read_ptr, available);
+				}
 
 				/* call fsync periodically to minimize potential loss of data */
 				if (++poll_count >= 100) {
 					perf_begin(_perf_fsync);
-					::fsync(_fd);
+					sync_file();
 					perf_end(_perf_fsync);
 					poll_count = 0;
 				}
@@ -220,36 +364,180 @@ void LogWriterFile::run()
 					break;
 				}
 
-				pthread_mutex_lock(&_mtx);
-				/* subtract bytes written from number in _buffer (_count -= written) */
+				/* release the written bytes to the producer */
 				mark_read(written);
-				pthread_mutex_unlock(&_mtx);
+			}
 
-				_total_written += written;
+			if (rotate && written == static_cast<int>(available) && !is_part) {
+				// all data of the current file is written
+				rotate_file();
+				continue;
 			}
 
-			if (!_should_run && written == static_cast<int>(available) && !is_part) {
+			if (!should_run && written == static_cast<int>(available) && !is_part) {
 				// Stop only when all data written
+				close_file();
 				_running = false;
-				_head = 0;
-				_count = 0;
+				break;
+			}
+		}
+	}
+}
 
-				if (_fd >= 0) {
-					int res = ::close(_fd);
-					_fd = -1;
+ssize_t LogWriterFile::write_to_file(const void *ptr, size_t size)
+{
+	if (!_compressing || _uncompressed_remaining > 0) {
+		if (_compressing && size > _uncompressed_remaining) {
+			size = _uncompressed_remaining;
+		}
 
-					if (res) {
-						PX4_WARN("error closing log file");
+		ssize_t written = write_fd(ptr, size);
 
-					} else {
-						PX4_INFO("closed logfile, bytes written: %zu", _total_written);
-					}
-				}
+		if (written > 0) {
+			_total_uncompressed += written;
 
-				break;
+			if (_compressing) {
+				_uncompressed_remaining -= written;
 			}
 		}
+
+		return written;
+	}
+
+	/* Take data from the buffer until a block is full. The data is copied, so that the
+	 * buffer space is freed before the (slow) file write. */
+	size_t taken = _compressor->append(ptr, size);
+	_total_uncompressed += taken;
+
+	if (_compressor->block_full() && write_compressed_block() < 0) {
+		return -1;
+	}
+
+	return taken;
+}
+
+ssize_t LogWriterFile::write_compressed_block()
+{
+	perf_begin(_perf_compress);
+	size_t message_size = _compressor->compress_block(_compressed_message);
+	perf_end(_perf_compress);
+
+	ssize_t written = write_fd(_compressed_message, message_size);
+
+	return written == (ssize_t)message_size ? written : -1;
+}
+
+ssize_t LogWriterFile::write_fd(const void *ptr, size_t size)
+{
+	ssize_t written;
+	perf_begin(_perf_write);
+
+	if (_preallocating) {
+		preallocate(_total_written + size);
+		written = ::pwrite(_fd, ptr, size, _total_written);
+
+	} else {
+		written = ::write(_fd, ptr, size);
+	}
+
+	perf_end(_perf_write);
+
+	if (written > 0) {
+		_total_written += written;
+	}
+
+	return written;
+}
+
+ssize_t LogWriterFile::write_ring(const void *ptr, size_t size)
+{
+	const uint8_t *start = (const uint8_t *)ptr;
+	const size_t first_size = math::min(size, (size_t)(_buffer + _buffer_size - start));
+
+	if (first_size == size) {
+		return write_fd(ptr, size);
+	}
+
+#ifdef __PX4_LINUX
+	struct iovec iov[2];
+	iov[0].iov_base = (void *)start;
+	iov[0].iov_len = first_size;
+	iov[1].iov_base = _buffer;
+	iov[1].iov_len = size - first_size;
+
+	perf_begin(_perf_write);
+	preallocate(_total_written + size);
+	ssize_t written = ::pwritev(_fd, iov, 2, _total_written);
+	perf_end(_perf_write);
+
+	if (written > 0) {
+		_total_written += written;
+	}
+
+	return written;
+#else
+	/* no pwritev: write the two parts separately */
+	ssize_t written = write_fd(start, first_size);
+
+	if (written != (ssize_t)first_size) {
+		return written;
+	}
+
+	ssize_t written_second = write_fd(_buffer, size - first_size);
+	return written_second < 0 ? written_second : written + written_second;
+#endif
+}
+
+void LogWriterFile::preallocate(size_t end)
+{
+	if (end <= _allocated_size) {
+		return;
+	}
+
+	const size_t new_size = (end / PREALLOC_EXTENT + 1) * PREALLOC_EXTENT;
+
+#ifdef __PX4_LINUX
+
+	/* allocate without changing the file size, so that the file stays valid on power loss */
+	if (::fallocate(_fd, FALLOC_FL_KEEP_SIZE, _allocated_size, new_size - _allocated_size) == 0) {
+		_allocated_size = new_size;
+		return;
+	}
+
+	PX4_WARN("log file preallocation failed (%i)", errno);
+#endif
+
+	/* not supported: space is allocated while writing */
+	_allocated_size = SIZE_MAX;
+}
+
+void LogWriterFile::wait_for_notify(bool ready)
+{
+	if (ready) {
+		if (__atomic_exchange_n(&_waiting, false, __ATOMIC_SEQ_CST)) {
+			return;
+		}
+
+		/* notify() already took the flag: consume its post, so that the next wait blocks */
+	}
+
+	while (px4_sem_wait(&_sem) != 0);
+}
+
+void LogWriterFile::sync_file()
+{
+	if (!_preallocating) {
+		::fsync(_fd);
+		return;
 	}
+
+#ifdef __PX4_LINUX
+	/* the file space is already allocated, so only the data and the file size need to be flushed
+	 * (the size grows with each write because of FALLOC_FL_KEEP_SIZE) */
+	::fdatasync(_fd);
+#else
+	::fsync(_fd);
+#endif
 }
 
 int LogWriterFile::write_message(void *ptr, size_t size, uint64_t dropout_start)
@@ -276,8 +564,9 @@ int LogWriterFile::write(void *ptr, size_t size, uint64_t dropout_start)
 		return 0;
 	}
 
-	// Bytes available to write
-	size_t available = _buffer_size - _count;
+	// Bytes available to write (one byte stays unused to tell a full from an empty buffer)
+	size_t head = _head;
+	size_t available = _buffer_size - 1 - fill_count(head, __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
 	size_t dropout_size = 0;
 
 	if (dropout_start) {
@@ -293,23 +582,27 @@ int LogWriterFile::write(void *ptr, size_t size, uint64_t dropout_start)
 		//write dropout msg
 		ulog_message_dropout_s dropout_msg;
 		dropout_msg.duration = (uint16_t)(hrt_elapsed_time(&dropout_start) / 1000);
-		write_no_check(&dropout_msg, sizeof(dropout_msg));
+		head = write_no_check(head, &dropout_msg, sizeof(dropout_msg));
 	}
 
-	write_no_check(ptr, size);
+	head = write_no_check(head, ptr, size);
+	_file_pos += size + dropout_size;
+
+	// commit: publish the message(s) to the writer thread
+	__atomic_store_n(&_head, head, __ATOMIC_RELEASE);
 	return 0;
 }
 
-void LogWriterFile::write_no_check(void *ptr, size_t size)
+size_t LogWriterFile::write_no_check(size_t head, void *ptr, size_t size)
 {
-	size_t n = _buffer_size - _head;	// bytes to end of the buffer
+	size_t n = _buffer_size - head;	// bytes to end of the buffer
 
 	uint8_t *buffer_c = reinterpret_cast<uint8_t *>(ptr);
 
 	if (size > n) {
 		// Message goes over the end of the buffer
-		memcpy(&(_buffer[_head]), buffer_c, n);
-		_head = 0;
+		memcpy(&(_buffer[head]), buffer_c, n);
+		head = 0;
 
 	} else {
 		n = 0;
@@ -317,26 +610,32 @@ void LogWriterFile::write_no_check(void *ptr, size_t size)
 
 	// now: n = bytes already written
 	size_t p = size - n;	// number of bytes to write
-	memcpy(&(_buffer[_head]), &(buffer_c[n]), p);
-	_head = (_head + p) % _buffer_size;
-	_count += size;
+	memcpy(&(_buffer[head]), &(buffer_c[n]), p);
+	return (head + p) % _buffer_size;
 }
 
-size_t LogWriterFile::get_read_ptr(void **ptr, bool *is_part)
+size_t LogWriterFile::get_read_ptr(void **ptr, bool *is_part, size_t *count, bool *rotate)
 {
-	// bytes available to read
-	int read_ptr = _head - _count;
+	// the data between _tail and head is committed and will not be modified by the producer
+	size_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+
+	/* read after _head: if the data after the split position is visible, so is the pending rotation */
+	*rotate = rotation_pending();
+
+	if (*rotate) {
+		head = _rotate_pos;
+	}
+
+	*count = fill_count(head, _tail);
+	*ptr = &_buffer[_tail];
 
-	if (read_ptr < 0) {
-		read_ptr += _buffer_size;
-		*ptr = &_buffer[read_ptr];
+	if (head < _tail) {
 		*is_part = true;
-		return _buffer_size - read_ptr;
+		return _buffer_size - _tail;
 
 	} else {
-		*ptr = &_buffer[read_ptr];
 		*is_part = false;
-		return _count;
+		return *count;
 	}
 }
 
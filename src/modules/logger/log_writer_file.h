@@ -36,9 +36,12 @@
 #include <px4.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <px4_sem.h>
 #include <drivers/drv_hrt.h>
 #include <systemlib/perf_counter.h>
 
+#include "ulog_compression.h"
+
 namespace px4
 {
 namespace logger
@@ -47,6 +50,13 @@ namespace logger
 /**
  * @class LogWriterFile
  * Writes logging data to a file
+ *
+ * The data is passed from the logger thread (the only producer) to the writer thread (the only consumer)
+ * through a lock-free ring buffer: the producer owns _head and the consumer owns _tail, so neither side
+ * ever needs to wait for the other. A message is reserved & copied into the buffer, and then committed
+ * (made visible to the writer thread) at once with the update of _head.
+ * The writer thread sleeps on a semaphore when there is not enough data, and notify() only posts it if
+ * the thread is actually waiting.
  */
 class LogWriterFile
 {
@@ -68,11 +78,25 @@ public:
 
 	void stop_log();
 
+	/**
+	 * Continue logging in a new file: everything written before this call goes into the current file,
+	 * everything after it into the new one. The switch is done by the writer thread once it wrote all
+	 * data of the current file, so the caller does not need to wait. The compression and preallocation
+	 * settings (@see set_compression(), set_preallocate()) are applied to the new file.
+	 * @return false if not logging or the previous rotation is still pending
+	 */
+	bool rotate_log(const char *filename);
+
+	bool rotation_pending() const { return __atomic_load_n(&_rotate_pending, __ATOMIC_ACQUIRE); }
+
 	bool is_started() const { return _should_run; }
 
 	/** @see LogWriter::write_message() */
 	int write_message(void *ptr, size_t size, uint64_t dropout_start = 0);
 
+	/**
+	 * Serializes the producer side (the writer thread does not use the lock, so this never waits for file I/O)
+	 */
 	void lock()
 	{
 		pthread_mutex_lock(&_mtx);
@@ -83,9 +107,14 @@ public:
 		pthread_mutex_unlock(&_mtx);
 	}
 
+	/**
+	 * Wake up the writer thread if it is waiting
+	 */
 	void notify()
 	{
-		pthread_cond_broadcast(&_cv);
+		if (__atomic_exchange_n(&_waiting, false, __ATOMIC_SEQ_CST)) {
+			px4_sem_post(&_sem);
+		}
 	}
 
 	size_t get_total_written() const
@@ -93,6 +122,14 @@ public:
 		return _total_written;
 	}
 
+	/**
+	 * File offset of the next message written to the buffer (producer side, without compression)
+	 */
+	uint64_t get_file_pos() const
+	{
+		return _file_pos;
+	}
+
 	size_t get_buffer_size() const
 	{
 		return _buffer_size;
@@ -100,7 +137,7 @@ public:
 
 	size_t get_buffer_fill_count() const
 	{
-		return _count;
+		return fill_count(__atomic_load_n(&_head, __ATOMIC_ACQUIRE), __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
 	}
 
 	void set_need_reliable_transfer(bool need_reliable)
@@ -113,45 +150,166 @@ public:
 		return _need_reliable_transfer;
 	}
 
+	/**
+	 * Enable or disable compression for the next log file (@see ulog_compression.h).
+	 * Must be called before start_log().
+	 * @return false if the compression buffers could not be allocated (compression is disabled then)
+	 */
+	bool set_compression(bool enable);
+
+	/**
+	 * Enable or disable the preallocated I/O mode for the next log file. Must be called before start_log().
+	 * In this mode the file space is preallocated in extents of PREALLOC_EXTENT (where supported), the
+	 * data is written in multiples of _min_write_chunk at aligned file offsets (both parts of the ring
+	 * buffer in one call), and the periodic sync uses fdatasync() instead of fsync().
+	 */
+	void set_preallocate(bool enable)
+	{
+		_preallocate = enable;
+	}
+
+	/**
+	 * number of message bytes before compression (equal to get_total_written() if compression is disabled)
+	 */
+	size_t get_total_uncompressed() const
+	{
+		return _total_uncompressed;
+	}
+
 private:
 	static void *run_helper(void *);
 
 	void run();
 
-	size_t get_read_ptr(void **ptr, bool *is_part);
+	/** number of bytes in the buffer between tail and head */
+	size_t fill_count(size_t head, size_t tail) const
+	{
+		return head >= tail ? head - tail : _buffer_size - tail + head;
+	}
+
+	/**
+	 * Get the data to write (consumer side)
+	 * @param ptr returns the read pointer
+	 * @param is_part set to true if there is more data at the beginning of the buffer
+	 * @param count returns the total number of bytes in the buffer (for the current file)
+	 * @param rotate set to true if the file needs to be switched after count bytes
+	 * @return number of bytes that can be read from ptr
+	 */
+	size_t get_read_ptr(void **ptr, bool *is_part, size_t *count, bool *rotate);
 
+	/**
+	 * Release n bytes of buffer space (consumer side)
+	 */
 	void mark_read(size_t n)
 	{
-		_count -= n;
+		__atomic_store_n(&_tail, (_tail + n) % _buffer_size, __ATOMIC_RELEASE);
 	}
 
+	/**
+	 * Open a log file and reset the per-file state
+	 * @return true on success
+	 */
+	bool open_file(const char *filename);
+
+	/**
+	 * Flush the remaining (compressed) data and close the log file
+	 */
+	void close_file();
+
+	/**
+	 * Close the current file and continue in _next_file_name (writer thread)
+	 */
+	void rotate_file();
+
+	/**
+	 * Block until notify() is called. Before checking its wakeup condition, the caller must announce the
+	 * wait with _waiting = true, so that a concurrent notification cannot get lost.
+	 * @param ready the wakeup condition is already met: cancel the wait instead
+	 */
+	void wait_for_notify(bool ready);
+
 	/**
 	 * write w/o waiting/blocking
 	 */
 	int write(void *ptr, size_t size, uint64_t dropout_start);
 
 	/**
-	 * Write to the buffer but assuming there is enough space
+	 * Copy to the buffer at position head, assuming there is enough (reserved) space. The data is
+	 * not visible to the writer thread until _head is updated.
+	 * @return the position after the data
+	 */
+	inline size_t write_no_check(size_t head, void *ptr, size_t size);
+
+	/**
+	 * Write buffer data to the file, compressing it if enabled
+	 * @return number of bytes taken from the buffer, <0 on error
 	 */
-	inline void write_no_check(void *ptr, size_t size);
+	ssize_t write_to_file(const void *ptr, size_t size);
+
+	/**
+	 * Compress and write the current (possibly partial) block
+	 * @return <0 on error
+	 */
+	ssize_t write_compressed_block();
+
+	/**
+	 * Write the first size bytes of the ring buffer (starting at ptr) to the file with one call,
+	 * including the part that wraps around (preallocated mode)
+	 * @return number of bytes written, <0 on error
+	 */
+	ssize_t write_ring(const void *ptr, size_t size);
+
+	/**
+	 * Write data at the end of the file
+	 * @return number of bytes written, <0 on error
+	 */
+	ssize_t write_fd(const void *ptr, size_t size);
+
+	/**
+	 * Make sure the file space up to end is allocated (preallocated mode)
+	 */
+	void preallocate(size_t end);
+
+	/**
+	 * Flush the written data to the storage
+	 */
+	void sync_file();
 
 	/* 512 didn't seem to work properly, 4096 should match the FAT cluster size */
 	static constexpr size_t	_min_write_chunk = 4096;
 
+	/* size by which the file is extended in preallocated mode */
+	static constexpr size_t	PREALLOC_EXTENT = 4 * 1024 * 1024;
+
 	int			_fd = -1;
 	uint8_t 	*_buffer = nullptr;
 	const size_t	_buffer_size;
-	size_t			_head = 0; ///< next position to write to
-	size_t			_count = 0; ///< number of bytes in _buffer to be written
+	size_t			_head = 0; ///< next position to write to (only modified by the producer)
+	size_t			_tail = 0; ///< next position to read from (only modified by the consumer)
 	size_t		_total_written = 0;
+	size_t		_total_uncompressed = 0;
+	bool		_compress = false; ///< compress the next log file
+	bool		_compressing = false; ///< compress the current log file
+	size_t		_uncompressed_remaining = 0; ///< bytes at the start of the file that are not compressed (file header)
+	ULogCompressor	*_compressor = nullptr;
+	uint8_t		*_compressed_message = nullptr; ///< output buffer for a COMPRESSED message
+	bool		_preallocate = false; ///< use the preallocated I/O mode for the next log file
+	bool		_preallocating = false; ///< preallocated I/O mode for the current log file
+	size_t		_allocated_size = 0; ///< preallocated file size
 	bool		_should_run = false;
 	bool		_running = false;
 	bool 		_exit_thread = false;
 	bool		_need_reliable_transfer = false;
+	bool		_rotate_pending = false; ///< switch to _next_file_name at buffer position _rotate_pos
+	size_t		_rotate_pos = 0;
+	uint64_t	_file_pos = 0; ///< number of bytes written to the buffer for the current file (producer side)
+	char		*_next_file_name = nullptr;
+	bool		_waiting = false; ///< the writer thread waits (or is about to wait) for notify()
 	pthread_mutex_t		_mtx;
-	pthread_cond_t		_cv;
+	px4_sem_t		_sem; ///< wakes up the writer thread
 	perf_counter_t _perf_write;
 	perf_counter_t _perf_fsync;
+	perf_counter_t _perf_compress;
 	pthread_t _thread = 0;
 };
 
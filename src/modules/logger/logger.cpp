@@ -33,8 +33,11 @@
 
 #include "logger.h"
 #include "messages.h"
+#include "ulog_definitions.h"
+#include "ulog_delta.h"
 
 #include <sys/stat.h>
+#include <dirent.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
@@ -49,6 +52,8 @@
 #include <uORB/topics/vehicle_gps_position.h>
 #include <uORB/topics/vehicle_command.h>
 #include <uORB/topics/vehicle_command_ack.h>
+#include <uORB/topics/ulog_stream_status.h>
+#include <uORB/topics/replay_ack.h>
 
 #include <drivers/drv_hrt.h>
 #include <px4_includes.h>
@@ -186,14 +191,15 @@ void Logger::usage(const char *reason)
 		PX4_WARN("%s\n", reason);
 	}
 
-	PX4_INFO("usage: logger {start|stop|on|off|status} [-r <log rate>] [-b <buffer size>] -e -a -t -x -m <mode> -q <size>\n"
+	PX4_INFO("usage: logger {start|stop|on|off|status} [-r <log rate>] [-b <buffer size>] -e -a -t -x -m <mode> -q <size> -p <topic>\n"
 		 "\t-r\tLog rate in Hz, 0 means unlimited rate\n"
 		 "\t-b\tLog buffer size in KiB, default is 12\n"
 		 "\t-e\tEnable logging right after start until disarm (otherwise only when armed)\n"
 		 "\t-f\tLog until shutdown (implies -e)\n"
 		 "\t-t\tUse date/time for naming log directories and files\n"
 		 "\t-m\tMode: one of 'file', 'mavlink', 'all' (default=all)\n"
-		 "\t-q\tuORB queue size for mavlink mode");
+		 "\t-q\tuORB queue size for mavlink mode\n"
+		 "\t-p\tPoll on a topic instead of running with fixed rate (log rate and topic intervals are ignored)");
 }
 
 int Logger::start(char *const *argv)
@@ -228,6 +234,8 @@ void Logger::status()
 
 	if (_writer.is_started(LogWriter::BackendMavlink)) {
 		PX4_INFO("Mavlink Logging Running");
+		PX4_INFO("Degradation level: %i / %i, samples not streamed: %zu", _mavlink_degrade_level,
+			 MAVLINK_MAX_DEGRADE_LEVEL, _mavlink_skipped);
 	}
 }
 
@@ -244,6 +252,19 @@ void Logger::print_statistics()
 
 	PX4_INFO("Log file: %s/%s", _log_dir, _log_file_name);
 	PX4_INFO("Wrote %4.2f MiB (avg %5.2f KiB/s)", (double)mebibytes, (double)(kibibytes / seconds));
+
+	if (_writer.get_total_written_file() > 0 && _writer.get_total_uncompressed_file() != _writer.get_total_written_file()) {
+		PX4_INFO("Compression ratio: %.2f", (double)_writer.get_total_uncompressed_file() / _writer.get_total_written_file());
+	}
+
+	if (_delta_buffer) {
+		PX4_INFO("Delta encoding saved %4.2f MiB", (double)(_delta_saved_bytes / 1024.0f / 1024.0f));
+	}
+
+	if (_index_enabled) {
+		PX4_INFO("Seek index: %zu entries (interval: %u ms)", _index.num_entries(), (unsigned)_index.interval());
+	}
+
 	PX4_INFO("Since last status: dropouts: %zu (max len: %.3f s), max used buffer: %zu / %zu B",
 		 _write_dropouts, (double)_max_dropout_duration, _high_water, _writer.get_buffer_size_file());
 	_high_water = 0;
@@ -262,12 +283,13 @@ void Logger::run_trampoline(int argc, char *argv[])
 	unsigned int queue_size = 14; //TODO: we might be able to reduce this if mavlink polled on the topic and/or
 	// topic sizes get reduced
 	LogWriter::Backend backend = LogWriter::BackendAll;
+	const orb_metadata *polling_topic_meta = nullptr;
 
 	int myoptind = 1;
 	int ch;
 	const char *myoptarg = NULL;
 
-	while ((ch = px4_getopt(argc, argv, "r:b:etfm:q:", &myoptind, &myoptarg)) != EOF) {
+	while ((ch = px4_getopt(argc, argv, "r:b:etfm:q:p:", &myoptind, &myoptarg)) != EOF) {
 		switch (ch) {
 		case 'r': {
 				unsigned long r = strtoul(myoptarg, NULL, 10);
@@ -330,6 +352,23 @@ void Logger::run_trampoline(int argc, char *argv[])
 
 			break;
 
+		case 'p': {
+				const orb_metadata **topics = orb_get_topics();
+
+				for (size_t i = 0; i < orb_topics_count(); i++) {
+					if (strcmp(myoptarg, topics[i]->o_name) == 0) {
+						polling_topic_meta = topics[i];
+						break;
+					}
+				}
+
+				if (!polling_topic_meta) {
+					PX4_ERR("topic %s not found", myoptarg);
+					error_flag = true;
+				}
+			}
+			break;
+
 		case '?':
 			error_flag = true;
 			break;
@@ -347,7 +386,7 @@ void Logger::run_trampoline(int argc, char *argv[])
 	}
 
 	logger_ptr = new Logger(backend, log_buffer_size, log_interval, log_on_start,
-				log_until_shutdown, log_name_timestamp, queue_size);
+				log_until_shutdown, log_name_timestamp, queue_size, polling_topic_meta);
 
 #if defined(DBGPRINT) && defined(__PX4_NUTTX)
 	struct mallinfo alloc_info = mallinfo();
@@ -374,15 +413,24 @@ void Logger::run_trampoline(int argc, char *argv[])
 
 
 Logger::Logger(LogWriter::Backend backend, size_t buffer_size, uint32_t log_interval, bool log_on_start,
-	       bool log_until_shutdown, bool log_name_timestamp, unsigned int queue_size) :
+	       bool log_until_shutdown, bool log_name_timestamp, unsigned int queue_size,
+	       const orb_metadata *polling_topic_meta) :
 	_arm_override(false),
 	_log_on_start(log_on_start),
 	_log_until_shutdown(log_until_shutdown),
 	_log_name_timestamp(log_name_timestamp),
 	_writer(backend, buffer_size, queue_size),
-	_log_interval(log_interval)
+	_log_interval(log_interval),
+	_polling_topic_meta(polling_topic_meta)
 {
 	_log_utc_offset = param_find("SDLOG_UTC_OFFSET");
+	_log_compress = param_find("SDLOG_COMPRESS");
+	_log_delta = param_find("SDLOG_DELTA");
+	_log_prealloc = param_find("SDLOG_PREALLOC");
+	_log_rotate_size = param_find("SDLOG_ROTATE_MB");
+	_log_rotate_time = param_find("SDLOG_ROTATE_S");
+	_log_quota = param_find("SDLOG_QUOTA_MB");
+	_log_index = param_find("SDLOG_INDEX_MS");
 }
 
 Logger::~Logger()
@@ -407,6 +455,13 @@ Logger::~Logger()
 		} while (logger_task != -1);
 	}
 
+	/* wait for a running quota check */
+	work_cancel(LPWORK, &_quota_work);
+
+	for (unsigned i = 0; _quota_check_running && i < 100; ++i) {
+		usleep(20000);
+	}
+
 	if (_replay_file_name) {
 		free(_replay_file_name);
 	}
@@ -414,6 +469,22 @@ Logger::~Logger()
 	if (_msg_buffer) {
 		delete[](_msg_buffer);
 	}
+
+	if (_delta_buffer) {
+		delete[](_delta_buffer);
+	}
+
+	for (LoggerSubscription &sub : _subscriptions) {
+		if (sub.delta_offsets) {
+			delete[](sub.delta_offsets);
+		}
+
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; ++instance) {
+			if (sub.delta_prev[instance]) {
+				delete[](sub.delta_prev[instance]);
+			}
+		}
+	}
 }
 
 int Logger::add_topic(const orb_metadata *topic)
@@ -439,12 +510,15 @@ int Logger::add_topic(const orb_metadata *topic)
 		PX4_WARN("logger: failed to add topic. Too many subscriptions");
 		orb_unsubscribe(fd);
 		fd = -1;
+
+	} else {
+		set_update_flag(_subscriptions.size() - 1, 0);
 	}
 
 	return fd;
 }
 
-int Logger::add_topic(const char *name, unsigned interval = 0)
+int Logger::add_topic(const char *name, unsigned interval, int mavlink_interval, uint8_t mavlink_priority)
 {
 	const orb_metadata **topics = orb_get_topics();
 	int fd = -1;
@@ -452,15 +526,26 @@ int Logger::add_topic(const char *name, unsigned interval = 0)
 	for (size_t i = 0; i < orb_topics_count(); i++) {
 		if (strcmp(name, topics[i]->o_name) == 0) {
 			fd = add_topic(topics[i]);
-			PX4_DEBUG("logging topic: %s, interval: %i", topics[i]->o_name, interval);
+			PX4_DEBUG("logging topic: %s, interval: %i, mavlink interval: %i", topics[i]->o_name, interval,
+				  mavlink_interval);
 			break;
 		}
 	}
 
-	if (fd >= 0 && interval != 0) {
+	if (fd >= 0 && interval != 0 && !_polling_topic_meta) {
 		orb_set_interval(fd, interval);
 	}
 
+	if (fd >= 0) {
+		LoggerSubscription &sub = _subscriptions[_subscriptions.size() - 1];
+		sub.mavlink_interval = mavlink_interval < 0 ? -1 : (mavlink_interval > INT16_MAX ? INT16_MAX : mavlink_interval);
+		sub.mavlink_priority = mavlink_priority;
+
+		if (sub.mavlink_priority > MAVLINK_PRIORITY_LOW) {
+			sub.mavlink_priority = MAVLINK_PRIORITY_LOW;
+		}
+	}
+
 	return fd;
 }
 
@@ -479,6 +564,7 @@ bool Logger::copy_if_updated_multi(LoggerSubscription &sub, int multi_instance,
 			/* copy first data */
 			if (handle >= 0) {
 				write_add_logged_msg(sub, multi_instance);
+				set_update_flag(&sub - &_subscriptions[0], multi_instance);
 
 				/* set to the same interval as the first instance */
 				unsigned int interval;
@@ -506,6 +592,89 @@ bool Logger::copy_if_updated_multi(LoggerSubscription &sub, int multi_instance,
 	return updated;
 }
 
+void Logger::update_mavlink_degradation(int ulog_stream_status_sub)
+{
+	bool updated = false;
+
+	if (ulog_stream_status_sub < 0 || orb_check(ulog_stream_status_sub, &updated) != 0 || !updated) {
+		return;
+	}
+
+	ulog_stream_status_s status;
+	orb_copy(ORB_ID(ulog_stream_status), ulog_stream_status_sub, &status);
+
+	/* The effect of a step only shows after the queued data is sent, so wait a few reports before
+	 * degrading further. Recovering is done slowly, to avoid oscillating around the link capacity. */
+	if (_mavlink_holdoff > 0) {
+		--_mavlink_holdoff;
+	}
+
+	if (status.lost > 0 || status.retransmitted > 0 || status.backlog) {
+		_mavlink_good_reports = 0;
+
+		if (_mavlink_holdoff == 0 && _mavlink_degrade_level < MAVLINK_MAX_DEGRADE_LEVEL) {
+			++_mavlink_degrade_level;
+			_mavlink_holdoff = MAVLINK_DEGRADE_HOLDOFF;
+			PX4_DEBUG("mavlink link congested (lost=%i), degradation level %i", status.lost, _mavlink_degrade_level);
+		}
+
+	} else if (_mavlink_degrade_level > 0 && ++_mavlink_good_reports >= MAVLINK_RECOVER_COUNT) {
+		_mavlink_good_reports = 0;
+		--_mavlink_degrade_level;
+		PX4_DEBUG("mavlink link recovered, degradation level %i", _mavlink_degrade_level);
+	}
+}
+
+bool Logger::stream_to_mavlink(LoggerSubscription &sub, int instance, uint32_t now_ms)
+{
+	if (sub.mavlink_interval < 0) {
+		return false;
+	}
+
+	uint32_t interval = sub.mavlink_interval;
+
+	/* low priority topics start to degrade at level 1, normal ones at level 2 and high priority ones at
+	 * level 3. Each further level doubles the interval, until the topic is dropped (except high priority). */
+	const int steps = _mavlink_degrade_level - (MAVLINK_PRIORITY_LOW - sub.mavlink_priority);
+
+	if (steps > 0) {
+		if (steps > MAVLINK_MAX_SLOWDOWN && sub.mavlink_priority != MAVLINK_PRIORITY_HIGH) {
+			return false;
+		}
+
+		if (interval < MAVLINK_DEGRADE_BASE_INTERVAL) {
+			interval = MAVLINK_DEGRADE_BASE_INTERVAL;
+		}
+
+		interval <<= steps;
+	}
+
+	if (interval > 0 && now_ms - sub.mavlink_last_ms[instance] < interval) {
+		return false;
+	}
+
+	sub.mavlink_last_ms[instance] = now_ms;
+	return true;
+}
+
+void Logger::set_update_flag(int sub_idx, int instance)
+{
+	const int bit = sub_idx * ORB_MULTI_MAX_INSTANCES + instance;
+
+	if (orb_set_update_flag(_subscriptions[sub_idx].fd[instance], &_updated_flags[bit / 32], 1u << (bit % 32)) != 0) {
+		PX4_ERR("failed to set update flag for %s", _subscriptions[sub_idx].metadata->o_name);
+	}
+
+	/* check it at least once */
+	mark_updated(sub_idx, 1u << instance);
+}
+
+void Logger::mark_updated(int sub_idx, uint32_t instances)
+{
+	const int bit = sub_idx * ORB_MULTI_MAX_INSTANCES;
+	__atomic_fetch_or(&_updated_flags[bit / 32], instances << (bit % 32), __ATOMIC_RELAXED);
+}
+
 void Logger::add_default_topics()
 {
 #ifdef CONFIG_ARCH_BOARD_SITL
@@ -515,23 +684,25 @@ void Logger::add_default_topics()
 #endif
 
 	// Note: try to avoid setting the interval where possible, as it increases RAM usage
+	// The mavlink interval and priority only apply to the mavlink backend, for which the high-rate
+	// topics are slowed down, so that they fit into the bandwidth of a telemetry link.
 
-	add_topic("vehicle_attitude", 10);
-	add_topic("actuator_outputs", 50);
+	add_topic("vehicle_attitude", 10, 50, MAVLINK_PRIORITY_HIGH);
+	add_topic("actuator_outputs", 50, 100);
 	add_topic("telemetry_status");
 	add_topic("vehicle_command");
-	add_topic("vehicle_status");
+	add_topic("vehicle_status", 0, 0, MAVLINK_PRIORITY_HIGH);
 	add_topic("vtol_vehicle_status", 100);
 	add_topic("commander_state", 100);
 	add_topic("satellite_info");
 	add_topic("vehicle_attitude_setpoint", 20);
-	add_topic("vehicle_rates_setpoint", 10);
-	add_topic("actuator_controls", 20);
-	add_topic("actuator_controls_0", 20);
-	add_topic("actuator_controls_1", 20);
-	add_topic("vehicle_local_position", 100);
+	add_topic("vehicle_rates_setpoint", 10, 50, MAVLINK_PRIORITY_LOW);
+	add_topic("actuator_controls", 20, 100, MAVLINK_PRIORITY_LOW);
+	add_topic("actuator_controls_0", 20, 100, MAVLINK_PRIORITY_LOW);
+	add_topic("actuator_controls_1", 20, 100, MAVLINK_PRIORITY_LOW);
+	add_topic("vehicle_local_position", 100, 0, MAVLINK_PRIORITY_HIGH);
 	add_topic("vehicle_local_position_setpoint", 50);
-	add_topic("vehicle_global_position", 100);
+	add_topic("vehicle_global_position", 100, 0, MAVLINK_PRIORITY_HIGH);
 	add_topic("vehicle_global_velocity_setpoint", 100);
 	add_topic("battery_status", 300);
 	add_topic("system_power", 300);
@@ -545,19 +716,19 @@ void Logger::add_default_topics()
 	add_topic("differential_pressure", 50);
 	add_topic("distance_sensor", 20);
 	add_topic("esc_status", 20);
-	add_topic("estimator_status", 50); //this one is large
-	add_topic("ekf2_innovations", 20);
+	add_topic("estimator_status", 50, 200, MAVLINK_PRIORITY_LOW); //this one is large
+	add_topic("ekf2_innovations", 20, 100, MAVLINK_PRIORITY_LOW);
 	add_topic("tecs_status", 20);
 	add_topic("wind_estimate", 100);
 	add_topic("control_state", 20);
 	add_topic("camera_trigger");
 	add_topic("cpuload");
-	add_topic("gps_dump"); //this will only be published if GPS_DUMP_COMM is set
+	add_topic("gps_dump", 0, -1); //this will only be published if GPS_DUMP_COMM is set
 	add_topic("sensor_preflight");
 
 	/* for estimator replay (need to be at full rate) */
-	add_topic("sensor_combined");
-	add_topic("vehicle_gps_position");
+	add_topic("sensor_combined", 0, 50, MAVLINK_PRIORITY_LOW);
+	add_topic("vehicle_gps_position", 0, 0, MAVLINK_PRIORITY_HIGH);
 	add_topic("vehicle_land_detected");
 }
 
@@ -567,6 +738,8 @@ int Logger::add_topics_from_file(const char *fname)
 	char		line[80];
 	char		topic_name[80];
 	unsigned	interval;
+	int		mavlink_interval;
+	unsigned	mavlink_priority;
 	int			ntopics = 0;
 
 	/* open the topic list file */
@@ -577,7 +750,7 @@ int Logger::add_topics_from_file(const char *fname)
 	}
 
 	/* call add_topic for each topic line in the file */
-	// format is TOPIC_NAME, [interval]
+	// format is TOPIC_NAME, [interval], [mavlink interval], [mavlink priority]
 	for (;;) {
 
 		/* get a line, bail on error/EOF */
@@ -592,13 +765,22 @@ int Logger::add_topics_from_file(const char *fname)
 			continue;
 		}
 
+		/* the fields are separated by commas and/or spaces */
+		for (char *c = line; *c; ++c) {
+			if (*c == ',') {
+				*c = ' ';
+			}
+		}
+
 		// default interval to zero
 		interval = 0;
-		int nfields = sscanf(line, "%s, %u", topic_name, &interval);
+		mavlink_interval = 0;
+		mavlink_priority = MAVLINK_PRIORITY_NORMAL;
+		int nfields = sscanf(line, "%79s %u %i %u", topic_name, &interval, &mavlink_interval, &mavlink_priority);
 
 		if (nfields > 0) {
 			/* add topic with specified interval */
-			add_topic(topic_name, interval);
+			add_topic(topic_name, interval, mavlink_interval, mavlink_priority > UINT8_MAX ? UINT8_MAX : mavlink_priority);
 			ntopics++;
 		}
 	}
@@ -662,10 +844,12 @@ void Logger::run()
 	}
 
 	int vehicle_command_sub = -1;
+	int ulog_stream_status_sub = -1;
 	orb_advert_t vehicle_command_ack_pub = nullptr;
 
 	if (_writer.backend() & LogWriter::BackendMavlink) {
 		vehicle_command_sub = orb_subscribe(ORB_ID(vehicle_command));
+		ulog_stream_status_sub = orb_subscribe(ORB_ID(ulog_stream_status));
 	}
 
 	//all topics added. Get required message buffer size
@@ -678,6 +862,10 @@ void Logger::run()
 		}
 	}
 
+	if (_polling_topic_meta && _polling_topic_meta->o_size > max_msg_size) {
+		max_msg_size = _polling_topic_meta->o_size;
+	}
+
 	max_msg_size += sizeof(ulog_message_data_header_s);
 
 	if (sizeof(ulog_message_logging_s) > max_msg_size) {
@@ -698,6 +886,9 @@ void Logger::run()
 		}
 	}
 
+	setup_delta_encoding();
+	setup_index();
+
 
 	if (!_writer.init()) {
 		PX4_ERR("writer init failed");
@@ -717,12 +908,32 @@ void Logger::run()
 		start_log_file();
 	}
 
-	/* init the update timer */
+	/* init the update timer, or the subscription we poll on */
 	struct hrt_call timer_call;
 	memset(&timer_call, 0, sizeof(hrt_call));
 	px4_sem_t timer_semaphore;
 	px4_sem_init(&timer_semaphore, 0, 0);
-	hrt_call_every(&timer_call, _log_interval, _log_interval, timer_callback, &timer_semaphore);
+	int polling_topic_sub = -1;
+	bool polling_topic_updated = false;
+	uint64_t polling_topic_timestamp = 0;
+	orb_advert_t replay_ack_pub = nullptr;
+	replay_ack_s replay_ack = {};
+
+	if (_polling_topic_meta) {
+		polling_topic_sub = orb_subscribe(_polling_topic_meta);
+
+		if (polling_topic_sub < 0) {
+			PX4_ERR("Failed to subscribe (%i)", errno);
+		}
+
+		/* in replay, acknowledge each processed update so that replay can run in lockstep */
+		if (_replay_file_name) {
+			replay_ack_pub = orb_advertise(ORB_ID(replay_ack_logger), &replay_ack);
+		}
+
+	} else {
+		hrt_call_every(&timer_call, _log_interval, _log_interval, timer_callback, &timer_semaphore);
+	}
 
 	// check for new subscription data
 	hrt_abstime next_subscribe_check = 0;
@@ -802,58 +1013,131 @@ void Logger::run()
 				write_changed_parameters();
 			}
 
+			/* only the selected samples are streamed via mavlink (the file backend gets all of them) */
+			const bool mavlink_streaming = _writer.is_started(LogWriter::BackendMavlink);
+			const uint32_t now_ms = (uint32_t)(hrt_absolute_time() / 1000);
+
+			if (mavlink_streaming) {
+				update_mavlink_degradation(ulog_stream_status_sub);
+			}
+
 			/* wait for lock on log buffer */
 			_writer.lock();
 
-			int sub_idx = 0;
+			/* Only check the subscriptions that uORB marked as updated since the last iteration
+			 * (plus the topic for which we try to subscribe to new instances) */
+			uint32_t updated_flags[UPDATED_FLAGS_LEN];
+
+			for (size_t i = 0; i < UPDATED_FLAGS_LEN; ++i) {
+				updated_flags[i] = __atomic_exchange_n(&_updated_flags[i], 0, __ATOMIC_ACQUIRE);
+			}
+
+			if (next_subscribe_topic_index != -1) {
+				const int bit = next_subscribe_topic_index * ORB_MULTI_MAX_INSTANCES;
+				updated_flags[bit / 32] |= ((1u << ORB_MULTI_MAX_INSTANCES) - 1) << (bit % 32);
+			}
+
+			for (size_t i = 0; i < UPDATED_FLAGS_LEN; ++i) {
+				while (updated_flags[i] != 0) {
+					const int sub_idx = (i * 32 + __builtin_ctz(updated_flags[i])) / ORB_MULTI_MAX_INSTANCES;
+					uint32_t instances = updated_instances(updated_flags, sub_idx);
+					updated_flags[i] &= ~(instances << ((sub_idx * ORB_MULTI_MAX_INSTANCES) % 32));
+
+					LoggerSubscription &sub = _subscriptions[sub_idx];
+					/* each message consists of a header followed by an orb data object
+					 */
+					size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+
+					/* if this topic has been updated, copy the new data into the message buffer
+					 * and write a message to the log
+					 */
+					for (uint8_t instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+						if (!(instances & (1u << instance))) {
+							continue;
+						}
+
+						if (copy_if_updated_multi(sub, instance, _msg_buffer + sizeof(ulog_message_data_header_s),
+									  sub_idx == next_subscribe_topic_index)) {
+
+							uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+							//write one byte after another (necessary because of alignment)
+							_msg_buffer[0] = (uint8_t)write_msg_size;
+							_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
+							_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
+							uint16_t write_msg_id = sub.msg_ids[instance];
+							_msg_buffer[3] = (uint8_t)write_msg_id;
+							_msg_buffer[4] = (uint8_t)(write_msg_id >> 8);
+
+							//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
 
-			for (LoggerSubscription &sub : _subscriptions) {
-				/* each message consists of a header followed by an orb data object
-				 */
-				size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+							/* the first sample in each index interval is indexed (and must be a full one) */
+							const uint64_t file_pos = _writer.get_file_pos();
+							const bool indexed = _index_enabled && sub.timestamp_offset >= 0;
+							uint64_t timestamp = 0;
+							bool index_due = false;
 
-				/* if this topic has been updated, copy the new data into the message buffer
-				 * and write a message to the log
-				 */
-				for (uint8_t instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
-					if (copy_if_updated_multi(sub, instance, _msg_buffer + sizeof(ulog_message_data_header_s),
-								  sub_idx == next_subscribe_topic_index)) {
+							if (indexed) {
+								memcpy(&timestamp, _msg_buffer + sizeof(ulog_message_data_header_s) + sub.timestamp_offset,
+								       sizeof(timestamp));
+								index_due = _index.due(write_msg_id, timestamp);
+							}
 
-						uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
-						//write one byte after another (necessary because of alignment)
-						_msg_buffer[0] = (uint8_t)write_msg_size;
-						_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
-						_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
-						uint16_t write_msg_id = sub.msg_ids[instance];
-						_msg_buffer[3] = (uint8_t)write_msg_id;
-						_msg_buffer[4] = (uint8_t)(write_msg_id >> 8);
+							uint8_t *write_buffer = _msg_buffer;
+							size_t write_size = msg_size;
+							size_t delta_size = sub.delta_offsets && !index_due ? encode_delta(sub, instance) : 0;
 
-						//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
+							if (delta_size > 0) {
+								write_buffer = _delta_buffer;
+								write_size = delta_size;
+							}
 
-						if (write_message(_msg_buffer, msg_size)) {
+							const bool stream = mavlink_streaming && stream_to_mavlink(sub, instance, now_ms);
+
+							if (mavlink_streaming && !stream) {
+								_writer.select_write_backend(LogWriter::BackendFile);
+								++_mavlink_skipped;
+							}
+
+							const bool written = write_message(write_buffer, write_size);
+
+							if (mavlink_streaming && !stream) {
+								_writer.unselect_write_backend();
+							}
+
+							if (written) {
 
 #ifdef DBGPRINT
-							total_bytes += msg_size;
+								total_bytes += write_size;
 #endif /* DBGPRINT */
 
-							data_written = true;
+								if (sub.delta_offsets) {
+									set_delta_reference(sub, instance, delta_size == 0);
+									_delta_saved_bytes += msg_size - write_size;
+								}
+
+								if (indexed) {
+									_index.add(write_msg_id, timestamp, file_pos, index_due);
+								}
+
+								data_written = true;
 
-						} else {
-							break;	// Write buffer overflow, skip this record
+							} else {
+								// Write buffer overflow, skip this record and check the remaining instances next time
+								mark_updated(sub_idx, instances & ~((2u << instance) - 1));
+								break;
+							}
 						}
 					}
 				}
-
-				++sub_idx;
 			}
 
 			//check for new logging message(s)
-			bool log_message_updated = false;
-			ret = orb_check(log_message_sub, &log_message_updated);
+			log_message_s log_messages[2]; // queue size of the publisher
+			int num_log_messages = orb_copy_all(ORB_ID(log_message), log_message_sub, log_messages,
+							    sizeof(log_messages) / sizeof(log_messages[0]), nullptr);
 
-			if (ret == 0 && log_message_updated) {
-				log_message_s log_message;
-				orb_copy(ORB_ID(log_message), log_message_sub, &log_message);
+			for (int i = 0; i < num_log_messages; ++i) {
+				const log_message_s &log_message = log_messages[i];
 				const char *message = (const char *)log_message.text;
 				int message_len = strlen(message);
 
@@ -883,6 +1167,13 @@ void Logger::run()
 				_writer.notify();
 			}
 
+			/* continue in a new file if the current one is large or old enough */
+			if (_writer.is_started(LogWriter::BackendFile) &&
+			    ((_rotate_size > 0 && _writer.get_total_written_file() >= _rotate_size) ||
+			     (_rotate_interval > 0 && hrt_elapsed_time(&_start_time_file) >= _rotate_interval))) {
+				rotate_log_file();
+			}
+
 			/* subscription update */
 			if (next_subscribe_topic_index != -1) {
 				if (++next_subscribe_topic_index >= _subscriptions.size()) {
@@ -914,19 +1205,53 @@ void Logger::run()
 
 		}
 
-		/*
-		 * We wait on the semaphore, which periodically gets updated by a high-resolution timer.
-		 * The simpler alternative would be:
-		 *   usleep(max(300, _log_interval - elapsed_time_since_loop_start));
-		 * And on linux this is quite accurate as well, but under NuttX it is not accurate,
-		 * because usleep() has only a granularity of CONFIG_MSEC_PER_TICK (=1ms).
-		 */
-		while (px4_sem_wait(&timer_semaphore) != 0);
+		if (polling_topic_sub >= 0) {
+			if (replay_ack_pub && polling_topic_updated) {
+				replay_ack.timestamp = polling_topic_timestamp;
+				++replay_ack.processed;
+				orb_publish(ORB_ID(replay_ack_logger), replay_ack_pub, &replay_ack);
+			}
+
+			/* wait for the next update of the polled topic (all other updates are logged with it) */
+			px4_pollfd_struct_t fds[1];
+			fds[0].fd = polling_topic_sub;
+			fds[0].events = POLLIN;
+			int pret = px4_poll(fds, 1, 1000);
+			polling_topic_updated = pret > 0 && (fds[0].revents & POLLIN);
+
+			if (pret < 0) {
+				PX4_ERR("poll failed (%i)", pret);
+				usleep(10000);
+
+			} else if (polling_topic_updated) {
+				/* every topic starts with the timestamp */
+				orb_copy(_polling_topic_meta, polling_topic_sub, _msg_buffer);
+				memcpy(&polling_topic_timestamp, _msg_buffer, sizeof(polling_topic_timestamp));
+			}
+
+		} else {
+			/*
+			 * We wait on the semaphore, which periodically gets updated by a high-resolution timer.
+			 * The simpler alternative would be:
+			 *   usleep(max(300, _log_interval - elapsed_time_since_loop_start));
+			 * And on linux this is quite accurate as well, but under NuttX it is not accurate,
+			 * because usleep() has only a granularity of CONFIG_MSEC_PER_TICK (=1ms).
+			 */
+			while (px4_sem_wait(&timer_semaphore) != 0);
+		}
 	}
 
 	hrt_cancel(&timer_call);
 	px4_sem_destroy(&timer_semaphore);
 
+	if (polling_topic_sub >= 0) {
+		orb_unsubscribe(polling_topic_sub);
+	}
+
+	if (replay_ack_pub) {
+		orb_unadvertise(replay_ack_pub);
+	}
+
 	// stop the writer thread
 	_writer.thread_stop();
 
@@ -952,6 +1277,10 @@ void Logger::run()
 	if (vehicle_command_sub != -1) {
 		orb_unsubscribe(vehicle_command_sub);
 	}
+
+	if (ulog_stream_status_sub != -1) {
+		orb_unsubscribe(ulog_stream_status_sub);
+	}
 }
 
 bool Logger::write_message(void *ptr, size_t size)
@@ -1074,6 +1403,12 @@ int Logger::get_log_file_name(char *file_name, size_t file_name_size)
 		snprintf(_log_file_name, sizeof(_log_file_name), "%s%s.ulg", log_file_name_time, replay_suffix);
 		snprintf(file_name, file_name_size, "%s/%s", _log_dir, _log_file_name);
 
+		/* with log rotation, there can be several files in the same second, e.g. 19_37_52_1.ulg */
+		for (unsigned index = 1; file_exist(file_name) && index <= MAX_NO_LOGFILE; ++index) {
+			snprintf(_log_file_name, sizeof(_log_file_name), "%s_%u%s.ulg", log_file_name_time, index, replay_suffix);
+			snprintf(file_name, file_name_size, "%s/%s", _log_dir, _log_file_name);
+		}
+
 	} else {
 		if (create_log_dir(nullptr)) {
 			return -1;
@@ -1174,15 +1509,136 @@ void Logger::start_log_file()
 
 	char file_name[LOG_DIR_LEN] = "";
 
-	if (get_log_file_name(file_name, sizeof(file_name))) {
-		PX4_ERR("logger: failed to get log file name");
+	if (!prepare_log_file(file_name, sizeof(file_name), nullptr)) {
 		return;
 	}
 
+	_writer.start_log_file(file_name);
+	start_file_index();
+	write_file_definitions();
+}
+
+void Logger::rotate_log_file()
+{
+	if (_writer.file_rotation_pending()) {
+		return;
+	}
+
+	/* the current file must not be removed by the quota check */
+	char current_file[LOG_DIR_LEN];
+	snprintf(current_file, sizeof(current_file), "%s/%s", _log_dir, _log_file_name);
+
+	char file_name[LOG_DIR_LEN] = "";
+
+	bool rotated = prepare_log_file(file_name, sizeof(file_name), current_file);
+
+	if (rotated) {
+		/* the index of the current file goes to its end, before the switch */
+		const bool index_enabled = _index_enabled;
+		write_index();
+
+		_writer.lock();
+		rotated = _writer.rotate_log_file(file_name);
+		_writer.unlock();
+
+		if (!rotated) {
+			/* logging continues in the current file: write the index again when it is closed
+			 * (readers use the last INDEX_END message) */
+			_index_enabled = index_enabled;
+		}
+	}
+
+	if (!rotated) {
+		PX4_ERR("log rotation failed, continuing in %s", current_file);
+		_rotate_size = 0;
+		_rotate_interval = 0;
+		return;
+	}
+
+	PX4_INFO("Continue file log in %s", file_name);
+	start_file_index();
+	write_file_definitions();
+}
+
+bool Logger::prepare_log_file(char *file_name, size_t file_name_size, const char *current_file)
+{
+	int32_t rotate_size = 0;
+	int32_t rotate_time = 0;
+
+	if (_log_rotate_size != PARAM_INVALID) {
+		param_get(_log_rotate_size, &rotate_size);
+	}
+
+	if (_log_rotate_time != PARAM_INVALID) {
+		param_get(_log_rotate_time, &rotate_time);
+	}
+
+	_rotate_size = rotate_size > 0 ? (size_t)rotate_size * 1024 * 1024 : 0;
+	_rotate_interval = rotate_time > 0 ? (hrt_abstime)rotate_time * 1000000 : 0;
+
+	if (get_log_file_name(file_name, file_name_size)) {
+		PX4_ERR("logger: failed to get log file name");
+		return false;
+	}
+
+	schedule_remove_old_logs(file_name, current_file);
+
 	/* print logging path, important to find log file later */
 	mavlink_log_info(&_mavlink_log_pub, "[logger] file: %s", file_name);
 
-	_writer.start_log_file(file_name);
+	int32_t compress = 0;
+
+	if (_log_compress != PARAM_INVALID) {
+		param_get(_log_compress, &compress);
+	}
+
+	if (!_writer.set_file_compression(compress != 0)) {
+		PX4_WARN("not enough memory for compression, logging uncompressed");
+	}
+
+	int32_t prealloc = 0;
+
+	if (_log_prealloc != PARAM_INVALID) {
+		param_get(_log_prealloc, &prealloc);
+	}
+
+	_writer.set_file_preallocate(prealloc != 0);
+
+	return true;
+}
+
+void Logger::start_file_index()
+{
+	int32_t index_interval = 0;
+	int32_t compress = 0;
+
+	if (_log_index != PARAM_INVALID) {
+		param_get(_log_index, &index_interval);
+	}
+
+	if (_log_compress != PARAM_INVALID) {
+		param_get(_log_compress, &compress);
+	}
+
+	_index_enabled = false;
+
+	if (index_interval > 0) {
+		if (compress != 0) {
+			// the offsets would refer to the uncompressed stream
+			PX4_WARN("no seek index for compressed logs");
+
+		} else if (!_index.init(LOG_INDEX_MAX_ENTRIES, MAX_TOPICS_NUM * ORB_MULTI_MAX_INSTANCES)) {
+			PX4_ERR("failed to alloc seek index");
+
+		} else {
+			_index.reset(index_interval);
+			_index_enabled = true;
+		}
+	}
+}
+
+void Logger::write_file_definitions()
+{
 	_writer.select_write_backend(LogWriter::BackendFile);
 	_writer.set_need_reliable_transfer(true);
 	write_header();
@@ -1197,11 +1653,186 @@ void Logger::start_log_file()
 	_start_time_file = hrt_absolute_time();
 }
 
+void Logger::schedule_remove_old_logs(const char *new_file, const char *current_file)
+{
+	int32_t quota = 0;
+
+	if (_log_quota != PARAM_INVALID) {
+		param_get(_log_quota, &quota);
+	}
+
+	if (quota <= 0) {
+		return;
+	}
+
+	if (_quota_check_running) {
+		/* the next rotation or log start checks again */
+		return;
+	}
+
+	/* leave space for the next file if rotation is enabled */
+	_quota_max_size = (uint64_t)quota * 1024 * 1024;
+
+	if (_rotate_size > 0 && _rotate_size < _quota_max_size) {
+		_quota_max_size -= _rotate_size;
+	}
+
+	strncpy(_quota_keep_files[0], new_file, sizeof(_quota_keep_files[0]) - 1);
+	strncpy(_quota_keep_files[1], current_file ? current_file : "", sizeof(_quota_keep_files[1]) - 1);
+
+	_quota_check_running = true;
+
+	if (work_queue(LPWORK, &_quota_work, &Logger::remove_old_logs_trampoline, this, 0) != 0) {
+		PX4_ERR("failed to queue the log quota check");
+		_quota_check_running = false;
+	}
+}
+
+void Logger::remove_old_logs_trampoline(void *arg)
+{
+	Logger *logger = reinterpret_cast<Logger *>(arg);
+	logger->remove_old_logs();
+	logger->_quota_check_running = false;
+}
+
+void Logger::remove_old_logs()
+{
+	while (true) {
+		/* The oldest file is the first one in name order, where the session dirs (sess001, used w/o
+		 * a valid time) come before the date dirs (2017-01-19) */
+		char oldest_dir[16] = "";
+		char oldest_file[32] = "";
+		uint64_t total_size = 0;
+		char path[LOG_DIR_LEN];
+		struct stat st;
+
+		DIR *root = opendir(LOG_ROOT);
+
+		if (!root) {
+			return;
+		}
+
+		struct dirent *dir_entry;
+
+		while ((dir_entry = readdir(root)) != nullptr) {
+			if (dir_entry->d_name[0] == '.' || strlen(dir_entry->d_name) >= sizeof(oldest_dir)) {
+				continue;
+			}
+
+			snprintf(path, sizeof(path), "%s/%s", LOG_ROOT, dir_entry->d_name);
+			DIR *dir = opendir(path);
+
+			if (!dir) {
+				continue;
+			}
+
+			const bool is_session_dir = strncmp(dir_entry->d_name, "sess", 4) == 0;
+			struct dirent *file_entry;
+
+			while ((file_entry = readdir(dir)) != nullptr) {
+				const char *extension = strrchr(file_entry->d_name, '.');
+
+				if (!extension || strcmp(extension, ".ulg") != 0 || strlen(file_entry->d_name) >= sizeof(oldest_file)) {
+					continue;
+				}
+
+				snprintf(path, sizeof(path), "%s/%s/%s", LOG_ROOT, dir_entry->d_name, file_entry->d_name);
+
+				if (stat(path, &st) != 0) {
+					continue;
+				}
+
+				total_size += st.st_size;
+
+				if (strcmp(path, _quota_keep_files[0]) == 0 || strcmp(path, _quota_keep_files[1]) == 0) {
+					continue;
+				}
+
+				int order = 1;
+
+				if (oldest_dir[0] != '\0') {
+					const bool oldest_is_session_dir = strncmp(oldest_dir, "sess", 4) == 0;
+
+					if (is_session_dir != oldest_is_session_dir) {
+						order = is_session_dir ? -1 : 1;
+
+					} else {
+						order = strcmp(dir_entry->d_name, oldest_dir);
+
+						if (order == 0) {
+							order = strcmp(file_entry->d_name, oldest_file);
+						}
+					}
+				}
+
+				if (oldest_dir[0] == '\0' || order < 0) {
+					strcpy(oldest_dir, dir_entry->d_name);
+					strcpy(oldest_file, file_entry->d_name);
+				}
+			}
+
+			closedir(dir);
+		}
+
+		closedir(root);
+
+		if (total_size <= _quota_max_size || oldest_dir[0] == '\0') {
+			return;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s/%s", LOG_ROOT, oldest_dir, oldest_file);
+
+		if (unlink(path) != 0) {
+			PX4_ERR("failed to remove %s (%i)", path, errno);
+			return;
+		}
+
+		PX4_INFO("log quota exceeded, removed %s", path);
+
+		/* remove the dir as well if it is empty now (fails otherwise) */
+		snprintf(path, sizeof(path), "%s/%s", LOG_ROOT, oldest_dir);
+		rmdir(path);
+	}
+}
+
 void Logger::stop_log_file()
 {
+	write_index();
 	_writer.stop_log_file();
 }
 
+void Logger::write_index()
+{
+	if (!_index_enabled) {
+		return;
+	}
+
+	_index_enabled = false;
+
+	ulog_message_index_end_s index_end;
+	index_end.interval = _index.interval();
+	memcpy(index_end.magic, ULOG_INDEX_MAGIC, sizeof(index_end.magic));
+
+	_writer.lock();
+	_writer.select_write_backend(LogWriter::BackendFile);
+	_writer.set_need_reliable_transfer(true);
+
+	index_end.index_offset = _writer.get_file_pos();
+	_index.rewind_messages();
+	size_t msg_size;
+
+	while ((msg_size = _index.next_message(_msg_buffer, _msg_buffer_len)) > 0) {
+		write_message(_msg_buffer, msg_size);
+	}
+
+	write_message(&index_end, sizeof(index_end));
+
+	_writer.set_need_reliable_transfer(false);
+	_writer.unselect_write_backend();
+	_writer.unlock();
+	_writer.notify();
+}
+
 void Logger::start_log_mavlink()
 {
 	if (!can_start_mavlink_log()) {
@@ -1210,6 +1841,16 @@ void Logger::start_log_mavlink()
 
 	PX4_INFO("Start mavlink log");
 
+	/* start at full rate, the link feedback degrades it as needed */
+	_mavlink_degrade_level = 0;
+	_mavlink_good_reports = 0;
+	_mavlink_holdoff = 0;
+	_mavlink_skipped = 0;
+
+	for (LoggerSubscription &sub : _subscriptions) {
+		memset(sub.mavlink_last_ms, 0, sizeof(sub.mavlink_last_ms));
+	}
+
 	_writer.start_log_mavlink();
 	_writer.select_write_backend(LogWriter::BackendMavlink);
 	_writer.set_need_reliable_transfer(true);
@@ -1237,11 +1878,7 @@ void Logger::write_formats()
 
 	//write all known formats
 	for (size_t i = 0; i < orb_topics_count(); i++) {
-		int format_len = snprintf(msg.format, sizeof(msg.format), "%s:%s", topics[i]->o_name, topics[i]->o_fields);
-		size_t msg_size = sizeof(msg) - sizeof(msg.format) + format_len;
-		msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
-		write_message(&msg, msg_size);
+		write_message(&msg, ulog_encode_format(msg, topics[i]));
 	}
 
 	_writer.unlock();
@@ -1270,15 +1907,10 @@ void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance
 		subscription.msg_ids[instance] = _next_topic_id++;
 	}
 
-	msg.msg_id = subscription.msg_ids[instance];
-	msg.multi_id = instance;
-
-	int message_name_len = strlen(subscription.metadata->o_name);
-
-	memcpy(msg.message_name, subscription.metadata->o_name, message_name_len);
+	// the first data message after this must be a full one
+	subscription.delta_valid &= ~(1 << instance);
 
-	size_t msg_size = sizeof(msg) - sizeof(msg.message_name) + message_name_len;
-	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	size_t msg_size = ulog_encode_add_logged_msg(msg, subscription.metadata, subscription.msg_ids[instance], instance);
 
 	bool prev_reliable = _writer.need_reliable_transfer();
 	_writer.set_need_reliable_transfer(true);
@@ -1286,67 +1918,133 @@ void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance
 	_writer.set_need_reliable_transfer(prev_reliable);
 }
 
-/* write info message */
-void Logger::write_info(const char *name, const char *value)
+void Logger::setup_delta_encoding()
 {
-	_writer.lock();
-	ulog_message_info_header_s msg;
-	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
-	msg.msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
+	int32_t delta = 0;
 
-	/* construct format key (type and name) */
-	size_t vlen = strlen(value);
-	msg.key_len = snprintf(msg.key, sizeof(msg.key), "char[%zu] %s", vlen, name);
-	size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
+	if (_log_delta != PARAM_INVALID) {
+		param_get(_log_delta, &delta);
+	}
 
-	/* copy string value directly to buffer */
-	if (vlen < (sizeof(msg) - msg_size)) {
-		memcpy(&buffer[msg_size], value, vlen);
-		msg_size += vlen;
+	if (delta == 0) {
+		return;
+	}
+
+	if (_writer.backend() & LogWriter::BackendMavlink) {
+		// the receiver of the mavlink stream would need to understand DATA_DELTA messages
+		PX4_WARN("delta encoding is only supported for the file backend");
+		return;
+	}
 
-		msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	_delta_buffer = new uint8_t[_msg_buffer_len];
 
-		write_message(buffer, msg_size);
+	if (!_delta_buffer) {
+		PX4_ERR("failed to alloc delta buffer");
+		return;
 	}
 
-	_writer.unlock();
+	for (LoggerSubscription &sub : _subscriptions) {
+		const orb_metadata *meta = sub.metadata;
+		const size_t size = meta->o_size_no_padding;
+		int num_fields = ulog_delta_field_offsets(meta->o_fields, size, nullptr, INT16_MAX);
+
+		// the bitmask and the data of all fields must fit into the message buffer
+		if (num_fields <= 0 ||
+		    sizeof(ulog_message_data_delta_header_s) + (num_fields + 7) / 8 + size > (size_t)_msg_buffer_len) {
+			PX4_DEBUG("no delta encoding for %s", meta->o_name);
+			continue;
+		}
+
+		sub.delta_offsets = new uint16_t[num_fields + 1];
+
+		if (!sub.delta_offsets) {
+			PX4_ERR("failed to alloc delta offsets");
+			break;
+		}
+
+		sub.delta_num_fields = ulog_delta_field_offsets(meta->o_fields, size, sub.delta_offsets, num_fields);
+	}
 }
-void Logger::write_info(const char *name, int32_t value)
+
+void Logger::setup_index()
 {
-	_writer.lock();
-	ulog_message_info_header_s msg;
-	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
-	msg.msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
+	for (LoggerSubscription &sub : _subscriptions) {
+		const int offset = ulog_index_timestamp_offset(sub.metadata->o_fields);
+		const bool valid = offset >= 0 && offset + (int)sizeof(uint64_t) <= (int)sub.metadata->o_size_no_padding;
+		sub.timestamp_offset = valid ? offset : -1;
+	}
+}
 
-	/* construct format key (type and name) */
-	msg.key_len = snprintf(msg.key, sizeof(msg.key), "int32_t %s", name);
-	size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
+size_t Logger::encode_delta(LoggerSubscription &sub, int instance)
+{
+	const uint8_t *data = _msg_buffer + sizeof(ulog_message_data_header_s);
 
-	/* copy string value directly to buffer */
-	memcpy(&buffer[msg_size], &value, sizeof(int32_t));
-	msg_size += sizeof(int32_t);
+	if (!(sub.delta_valid & (1 << instance)) || sub.delta_count[instance] >= DELTA_KEYFRAME_INTERVAL) {
+		return 0;
+	}
 
-	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	uint8_t *delta = _delta_buffer + sizeof(ulog_message_data_delta_header_s);
+	const size_t delta_size = ulog_delta_encode(sub.delta_prev[instance], data, sub.delta_offsets,
+				  sub.delta_num_fields, delta);
+	const size_t msg_size = sizeof(ulog_message_data_delta_header_s) + delta_size;
 
-	write_message(buffer, msg_size);
+	if (msg_size >= sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding) {
+		return 0; // most of the fields changed
+	}
+
+	uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+	uint16_t write_msg_id = sub.msg_ids[instance];
+	_delta_buffer[0] = (uint8_t)write_msg_size;
+	_delta_buffer[1] = (uint8_t)(write_msg_size >> 8);
+	_delta_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA_DELTA);
+	_delta_buffer[3] = (uint8_t)write_msg_id;
+	_delta_buffer[4] = (uint8_t)(write_msg_id >> 8);
+	return msg_size;
+}
+
+void Logger::set_delta_reference(LoggerSubscription &sub, int instance, bool full)
+{
+	const uint8_t *data = _msg_buffer + sizeof(ulog_message_data_header_s);
+
+	if (!sub.delta_prev[instance]) {
+		sub.delta_prev[instance] = new uint8_t[sub.metadata->o_size_no_padding];
+
+		if (!sub.delta_prev[instance]) {
+			return;
+		}
+	}
+
+	memcpy(sub.delta_prev[instance], data, sub.metadata->o_size_no_padding);
+	sub.delta_valid |= 1 << instance;
+	sub.delta_count[instance] = full ? 0 : sub.delta_count[instance] + 1;
+}
+
+/* write info message */
+void Logger::write_info(const char *name, const char *value)
+{
+	_writer.lock();
+	ulog_message_info_header_s msg;
+	size_t msg_size = ulog_encode_info(msg, name, value);
+
+	if (msg_size > 0) {
+		write_message(&msg, msg_size);
+	}
 
 	_writer.unlock();
 }
+void Logger::write_info(const char *name, int32_t value)
+{
+	_writer.lock();
+	ulog_message_info_header_s msg;
+	write_message(&msg, ulog_encode_info(msg, name, value));
+	_writer.unlock();
+}
 
 void Logger::write_header()
 {
 	ulog_file_header_s header;
-	header.magic[0] = 'U';
-	header.magic[1] = 'L';
-	header.magic[2] = 'o';
-	header.magic[3] = 'g';
-	header.magic[4] = 0x01;
-	header.magic[5] = 0x12;
-	header.magic[6] = 0x35;
-	header.magic[7] = 0x00; //file version 0
-	header.timestamp = hrt_absolute_time();
 	_writer.lock();
-	write_message(&header, sizeof(header));
+	write_message(&header, ulog_encode_header(header, hrt_absolute_time()));
 	_writer.unlock();
 }
 
@@ -1372,9 +2070,6 @@ void Logger::write_parameters()
 {
 	_writer.lock();
 	ulog_message_parameter_header_s msg;
-	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
-
-	msg.msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
 	int param_idx = 0;
 	param_t param = 0;
 
@@ -1387,37 +2082,11 @@ void Logger::write_parameters()
 
 		// save parameters which are valid AND used
 		if (param != PARAM_INVALID) {
-			/* get parameter type and size */
-			const char *type_str;
-			param_type_t type = param_type(param);
-			size_t value_size = 0;
-
-			switch (type) {
-			case PARAM_TYPE_INT32:
-				type_str = "int32_t";
-				value_size = sizeof(int32_t);
-				break;
-
-			case PARAM_TYPE_FLOAT:
-				type_str = "float";
-				value_size = sizeof(float);
-				break;
+			size_t msg_size = ulog_encode_parameter(msg, param);
 
-			default:
-				continue;
+			if (msg_size > 0) {
+				write_message(&msg, msg_size);
 			}
-
-			/* format parameter key (type and name) */
-			msg.key_len = snprintf(msg.key, sizeof(msg.key), "%s %s", type_str, param_name(param));
-			size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
-
-			/* copy parameter value directly to buffer */
-			param_get(param, &buffer[msg_size]);
-			msg_size += value_size;
-
-			msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
-			write_message(buffer, msg_size);
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
@@ -1429,9 +2098,6 @@ void Logger::write_changed_parameters()
 {
 	_writer.lock();
 	ulog_message_parameter_header_s msg;
-	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
-
-	msg.msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
 	int param_idx = 0;
 	param_t param = 0;
 
@@ -1444,39 +2110,11 @@ void Logger::write_changed_parameters()
 
 		// log parameters which are valid AND used AND unsaved
 		if ((param != PARAM_INVALID) && param_value_unsaved(param)) {
+			size_t msg_size = ulog_encode_parameter(msg, param);
 
-			/* get parameter type and size */
-			const char *type_str;
-			param_type_t type = param_type(param);
-			size_t value_size = 0;
-
-			switch (type) {
-			case PARAM_TYPE_INT32:
-				type_str = "int32_t";
-				value_size = sizeof(int32_t);
-				break;
-
-			case PARAM_TYPE_FLOAT:
-				type_str = "float";
-				value_size = sizeof(float);
-				break;
-
-			default:
-				continue;
+			if (msg_size > 0) {
+				write_message(&msg, msg_size);
 			}
-
-			/* format parameter key (type and name) */
-			msg.key_len = snprintf(msg.key, sizeof(msg.key), "%s %s", type_str, param_name(param));
-			size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
-
-			/* copy parameter value directly to buffer */
-			param_get(param, &buffer[msg_size]);
-			msg_size += value_size;
-
-			/* msg_size is now 1 (msg_type) + 2 (msg_size) + 1 (key_len) + key_len + value_size */
-			msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
-			write_message(buffer, msg_size);
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
@@ -35,7 +35,9 @@
 
 #include "log_writer.h"
 #include "array.h"
+#include "ulog_index.h"
 #include <px4.h>
+#include <px4_workqueue.h>
 #include <drivers/drv_hrt.h>
 #include <uORB/Subscription.hpp>
 #include <version/version.h>
@@ -49,8 +51,10 @@ extern "C" __EXPORT int logger_main(int argc, char *argv[]);
 
 #ifdef __PX4_NUTTX
 #define LOG_DIR_LEN 64
+#define LOG_INDEX_MAX_ENTRIES 512 // maximum number of seek index entries per log file (the interval grows if needed)
 #else
 #define LOG_DIR_LEN 256
+#define LOG_INDEX_MAX_ENTRIES 65536
 #endif
 
 namespace px4
@@ -63,6 +67,20 @@ struct LoggerSubscription {
 	uint16_t msg_ids[ORB_MULTI_MAX_INSTANCES];
 	const orb_metadata *metadata = nullptr;
 
+	/* delta encoding state (@see ulog_delta.h), only used if delta_offsets is set */
+	uint16_t *delta_offsets = nullptr; ///< field layout (delta_num_fields + 1 entries)
+	int delta_num_fields = 0;
+	uint8_t *delta_prev[ORB_MULTI_MAX_INSTANCES] {}; ///< last written sample of each instance
+	uint8_t delta_count[ORB_MULTI_MAX_INSTANCES] {}; ///< number of delta messages since the last full sample
+	uint8_t delta_valid = 0; ///< bitmask of the instances with a valid delta_prev
+
+	/* mavlink streaming (@see Logger::stream_to_mavlink()) */
+	int16_t mavlink_interval = 0; ///< minimum interval [ms] between streamed samples (0 = all, <0 = not streamed)
+	uint8_t mavlink_priority = 1; ///< 0 = high (never dropped), 1 = normal, 2 = low (degraded first)
+	uint32_t mavlink_last_ms[ORB_MULTI_MAX_INSTANCES] {}; ///< time of the last streamed sample of each instance
+
+	int16_t timestamp_offset = -1; ///< offset of the timestamp in the data (for the seek index, -1 if not indexed)
+
 	LoggerSubscription() {}
 
 	LoggerSubscription(int fd_, const orb_metadata *metadata_) :
@@ -84,7 +102,8 @@ class Logger
 {
 public:
 	Logger(LogWriter::Backend backend, size_t buffer_size, uint32_t log_interval, bool log_on_start,
-	       bool log_until_shutdown, bool log_name_timestamp, unsigned int queue_size);
+	       bool log_until_shutdown, bool log_name_timestamp, unsigned int queue_size,
+	       const orb_metadata *polling_topic_meta);
 
 	~Logger();
 
@@ -100,9 +119,12 @@ public:
 	 * (because it does not write an ADD_LOGGED_MSG message).
 	 * @param name topic name
 	 * @param interval limit rate if >0, otherwise log as fast as the topic is updated.
+	 * @param mavlink_interval additional rate limit [ms] for the mavlink backend if >0, <0 to not stream the topic
+	 * @param mavlink_priority order in which topics are degraded on the mavlink backend (MAVLINK_PRIORITY_*)
 	 * @return 0 on success
 	 */
-	int add_topic(const char *name, unsigned interval);
+	int add_topic(const char *name, unsigned interval = 0, int mavlink_interval = 0,
+		      uint8_t mavlink_priority = MAVLINK_PRIORITY_NORMAL);
 
 	/**
 	 * add a logged topic (called by add_topic() above)
@@ -118,6 +140,10 @@ public:
 
 	void set_arm_override(bool override) { _arm_override = override; }
 
+	static constexpr uint8_t	MAVLINK_PRIORITY_HIGH = 0;
+	static constexpr uint8_t	MAVLINK_PRIORITY_NORMAL = 1;
+	static constexpr uint8_t	MAVLINK_PRIORITY_LOW = 2;
+
 private:
 	static void run_trampoline(int argc, char *argv[]);
 
@@ -158,6 +184,50 @@ private:
 
 	void stop_log_file();
 
+	/**
+	 * Continue file logging in a new file (SDLOG_ROTATE_MB / SDLOG_ROTATE_S), which gets its own
+	 * header, definitions and parameters, so that each file can be used independently.
+	 */
+	void rotate_log_file();
+
+	/**
+	 * Get the name of the next log file and read the per-file settings
+	 * @param current_file file that is still being written (nullptr if none)
+	 * @return true on success
+	 */
+	bool prepare_log_file(char *file_name, size_t file_name_size, const char *current_file);
+
+	/**
+	 * Set up the seek index for a new log file (SDLOG_INDEX_MS)
+	 */
+	void start_file_index();
+
+	/**
+	 * Write the header, definitions and parameters at the start of a new log file
+	 */
+	void write_file_definitions();
+
+	/**
+	 * Append the seek index to the current log file (@see ulog_index.h), if enabled
+	 */
+	void write_index();
+
+	/**
+	 * Queue the quota check (remove_old_logs()) on the low-priority work queue, so that the
+	 * directory walk does not block the logger loop. Skipped if the previous check is still running.
+	 * @param new_file file that is about to be written
+	 * @param current_file file that is still being written (nullptr if none)
+	 */
+	void schedule_remove_old_logs(const char *new_file, const char *current_file);
+
+	static void remove_old_logs_trampoline(void *arg);
+
+	/**
+	 * Remove the oldest log files until all log files together use at most _quota_max_size.
+	 * The files in _quota_keep_files are never removed. Runs on the low-priority work queue.
+	 */
+	void remove_old_logs();
+
 	void start_log_mavlink();
 
 	void stop_log_mavlink();
@@ -189,6 +259,63 @@ private:
 
 	bool copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, void *buffer, bool try_to_subscribe);
 
+	/**
+	 * Get the field layouts of the subscribed topics if SDLOG_DELTA is enabled
+	 */
+	void setup_delta_encoding();
+
+	/**
+	 * Encode the data message in _msg_buffer as DATA_DELTA message into _delta_buffer
+	 * @return size of the message, or 0 if the full data message should be written instead
+	 */
+	size_t encode_delta(LoggerSubscription &sub, int instance);
+
+	/**
+	 * Store the sample in _msg_buffer, after it was written to the log, as reference for the next delta message
+	 * @param full true if it was written as a full data message
+	 */
+	void set_delta_reference(LoggerSubscription &sub, int instance, bool full);
+
+	/**
+	 * Get the timestamp offsets of the subscribed topics for the seek index (SDLOG_INDEX_MS)
+	 */
+	void setup_index();
+
+	/**
+	 * Adapt the mavlink degradation level to the link feedback (ulog_stream_status)
+	 */
+	void update_mavlink_degradation(int ulog_stream_status_sub);
+
+	/**
+	 * Check whether a new sample of a subscription should also be streamed via mavlink, taking into account
+	 * the configured interval and the current degradation level.
+	 * @param now_ms current time [ms]
+	 * @return true if the sample is due (and mark it as streamed)
+	 */
+	bool stream_to_mavlink(LoggerSubscription &sub, int instance, uint32_t now_ms);
+
+	/**
+	 * Let uORB mark a subscribed instance as updated in _updated_flags
+	 * @param sub_idx index into _subscriptions
+	 */
+	void set_update_flag(int sub_idx, int instance);
+
+	/**
+	 * Mark instances as updated, so that they are checked in the next iteration
+	 * @param instances bitmask of instances
+	 */
+	void mark_updated(int sub_idx, uint32_t instances);
+
+	/**
+	 * Get the updated instances of a subscription from a snapshot of _updated_flags
+	 * @return bitmask of instances
+	 */
+	static uint32_t updated_instances(const uint32_t *flags, int sub_idx)
+	{
+		const int bit = sub_idx * ORB_MULTI_MAX_INSTANCES;
+		return (flags[bit / 32] >> (bit % 32)) & ((1u << ORB_MULTI_MAX_INSTANCES) - 1);
+	}
+
 	/**
 	 * Write exactly one ulog message to the logger and handle dropouts.
 	 * Must be called with _writer.lock() held.
@@ -216,6 +343,14 @@ private:
 	void ack_vehicle_command(orb_advert_t &vehicle_command_ack_pub, uint16_t command, uint32_t result);
 
 	static constexpr size_t 	MAX_TOPICS_NUM = 64; /**< Maximum number of logged topics */
+	static constexpr size_t		UPDATED_FLAGS_LEN = (MAX_TOPICS_NUM * ORB_MULTI_MAX_INSTANCES + 31) / 32;
+	static_assert(32 % ORB_MULTI_MAX_INSTANCES == 0, "the instances of a subscription must fit into one flag word");
+	static constexpr uint8_t	DELTA_KEYFRAME_INTERVAL = 50; /**< write a full sample after this many delta messages */
+	static constexpr int		MAVLINK_MAX_DEGRADE_LEVEL = 8; /**< maximum mavlink degradation level */
+	static constexpr int		MAVLINK_MAX_SLOWDOWN = 3; /**< normal and low priority topics are dropped after being slowed down 2^this */
+	static constexpr uint32_t	MAVLINK_DEGRADE_BASE_INTERVAL = 20; /**< [ms] slowed down interval of topics without rate limit */
+	static constexpr int		MAVLINK_DEGRADE_HOLDOFF = 3; /**< minimum number of link reports between two degradation steps */
+	static constexpr int		MAVLINK_RECOVER_COUNT = 20; /**< number of good link reports before recovering one level */
 	static constexpr unsigned	MAX_NO_LOGFOLDER = 999;	/**< Maximum number of log dirs */
 	static constexpr unsigned	MAX_NO_LOGFILE = 999;	/**< Maximum number of log files */
 #ifdef __PX4_POSIX_EAGLE
@@ -226,6 +361,7 @@ private:
 
 	uint8_t						*_msg_buffer = nullptr;
 	int						_msg_buffer_len = 0;
+	uint8_t						*_delta_buffer = nullptr; ///< DATA_DELTA message (same size as _msg_buffer)
 	char 						_log_dir[LOG_DIR_LEN];
 	char 						_log_file_name[32];
 	bool						_task_should_exit = true;
@@ -240,14 +376,37 @@ private:
 	float						_max_dropout_duration = 0.f; ///< max duration of dropout [s]
 	size_t						_write_dropouts = 0; ///< failed buffer writes due to buffer overflow
 	size_t						_high_water = 0; ///< maximum used write buffer
+	size_t						_delta_saved_bytes = 0; ///< bytes saved by delta encoding
+	size_t						_mavlink_skipped = 0; ///< samples that were only written to the file backend
 
 	const bool 					_log_on_start;
 	const bool 					_log_until_shutdown;
 	const bool					_log_name_timestamp;
 	Array<LoggerSubscription, MAX_TOPICS_NUM>	_subscriptions;
+	/** one bit per subscription instance, set by uORB on updates (bit = subscription index * ORB_MULTI_MAX_INSTANCES + instance) */
+	volatile uint32_t				_updated_flags[UPDATED_FLAGS_LEN] {};
 	LogWriter					_writer;
 	uint32_t					_log_interval;
+	const orb_metadata				*_polling_topic_meta = nullptr; ///< if non-null, poll on this topic instead of the timer
 	param_t						_log_utc_offset;
+	param_t						_log_compress;
+	param_t						_log_delta;
+	param_t						_log_prealloc;
+	param_t						_log_rotate_size;
+	param_t						_log_rotate_time;
+	param_t						_log_quota;
+	param_t						_log_index;
+	ULogIndex					_index;
+	bool						_index_enabled = false; ///< the current log file gets a seek index
+	size_t						_rotate_size = 0; ///< rotate the log file at this size [bytes] (0 = disabled)
+	hrt_abstime					_rotate_interval = 0; ///< rotate the log file after this time [us] (0 = disabled)
+	struct work_s					_quota_work {};
+	volatile bool					_quota_check_running = false; ///< remove_old_logs() is queued or running
+	uint64_t					_quota_max_size = 0; ///< [bytes] (only accessed by remove_old_logs() while it runs)
+	char						_quota_keep_files[2][LOG_DIR_LEN] {};
+	int						_mavlink_degrade_level = 0; ///< 0 = stream as configured, increased on link congestion
+	int						_mavlink_good_reports = 0; ///< consecutive link reports without congestion
+	int						_mavlink_holdoff = 0; ///< link reports to ignore after a degradation step
 	orb_advert_t					_mavlink_log_pub = nullptr;
 	uint16_t					_next_topic_id = 0; ///< id of next subscribed ulog topic
 	char						*_replay_file_name = nullptr;
@@ -36,6 +36,7 @@
 enum class ULogMessageType : uint8_t {
 	FORMAT = 'F',
 	DATA = 'D',
+	DATA_DELTA = 'E',
 	INFO = 'I',
 	PARAMETER = 'P',
 	ADD_LOGGED_MSG = 'A',
@@ -43,6 +44,9 @@ enum class ULogMessageType : uint8_t {
 	SYNC = 'S',
 	DROPOUT = 'O',
 	LOGGING = 'L',
+	COMPRESSED = 'Z',
+	INDEX = 'X',
+	INDEX_END = 'Y',
 };
 
 
@@ -105,6 +109,19 @@ struct ulog_message_data_header_s {
 	uint16_t msg_id;
 };
 
+/**
+ * Data message with only the fields that changed since the previous data message of the
+ * same msg_id (@see ulog_delta.h).
+ */
+struct ulog_message_data_delta_header_s {
+	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
+	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::DATA_DELTA);
+
+	uint16_t msg_id;
+	//followed by the bitmask of the changed fields ((num_fields + 7) / 8 bytes, LSB first)
+	//and the data of the changed fields
+};
+
 struct ulog_message_info_header_s {
 	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
 	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
@@ -129,4 +146,49 @@ struct ulog_message_parameter_header_s {
 	uint8_t key_len;
 	char key[255];
 };
+
+/**
+ * Compressed block of the message stream (@see ulog_compression.h). If used, all messages
+ * following the file header are compressed.
+ */
+struct ulog_message_compressed_header_s {
+	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
+	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::COMPRESSED);
+
+	uint16_t uncompressed_size; //size of the decompressed data
+	//followed by the compressed data
+};
+
+/**
+ * Seek index of one msg_id (@see ulog_index.h), written at the end of the file. The entries
+ * of a msg_id can be split into several messages.
+ */
+struct ulog_message_index_header_s {
+	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
+	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::INDEX);
+
+	uint16_t msg_id;
+	uint64_t first_timestamp; //timestamp of the first data message of msg_id in the file
+	uint64_t last_timestamp; //timestamp of the last data message of msg_id in the file
+	//followed by the entries (ulog_index_entry_s), in increasing order
+};
+
+struct ulog_index_entry_s {
+	uint64_t timestamp; //timestamp of the data message
+	uint64_t offset; //file offset of the data message (or a dropout message directly before it)
+};
+
+/**
+ * Last message of an indexed file (it has a fixed size, so that it can be read from the end of the file)
+ */
+struct ulog_message_index_end_s {
+	uint16_t msg_size = sizeof(ulog_message_index_end_s) - ULOG_MSG_HEADER_LEN; //size of message - ULOG_MSG_HEADER_LEN
+	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::INDEX_END);
+
+	uint32_t interval; //index interval [ms]: the first data message of each msg_id in each interval is indexed
+	uint64_t index_offset; //file offset of the first INDEX message
+	uint8_t magic[8]; //ULOG_INDEX_MAGIC
+};
+
+#define ULOG_INDEX_MAGIC "ULogIdx"
 #pragma pack(pop)
@@ -67,3 +67,125 @@ PARAM_DEFINE_INT32(SDLOG_UTC_OFFSET, 0);
  * @group SD Logging
  */
 PARAM_DEFINE_INT32(SDLOG_MODE, 0);
+
+/**
+ * Log file compression
+ *
+ * If enabled, the log files are compressed while logging (LZ4 block format),
+ * which reduces the amount of data that is written to the SD card.
+ * Compressed log files need to be decompressed with Tools/ulog_decompress.py
+ * before they can be analyzed. Replay decompresses them automatically.
+ *
+ * This needs about 20 KB of additional RAM.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @boolean
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_COMPRESS, 0);
+
+/**
+ * Delta encoding of logged topics
+ *
+ * If enabled, a data sample that only differs in a few fields from the
+ * previous sample of the same topic instance is logged as a DATA_DELTA
+ * message, which only contains the changed fields. Every 50th sample is
+ * logged in full.
+ *
+ * Log files with delta encoding need to be converted with
+ * Tools/ulog_decompress.py before they can be analyzed. Replay reads them
+ * directly. Only used for file logging (not with the mavlink backend).
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @boolean
+ * @reboot_required true
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_DELTA, 0);
+
+/**
+ * Preallocated log file I/O
+ *
+ * If enabled, the log file is preallocated in large extents, the data is
+ * written in block-aligned chunks at explicit file offsets, and the periodic
+ * sync only flushes the data and the file size instead of a full fsync. This
+ * moves the file system allocation and metadata updates out of the write path.
+ *
+ * Preallocation is only available on Linux; on other
+ * platforms only the aligned writes are used.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @boolean
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_PREALLOC, 0);
+
+/**
+ * Log file rotation size
+ *
+ * If set, logging continues in a new file when the current log file reaches
+ * this size. Each file contains the full definitions and parameters, so it
+ * can be analyzed and replayed on its own.
+ * Set to 0 to disable.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @unit MB
+ * @min 0
+ * @max 4000
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_ROTATE_MB, 0);
+
+/**
+ * Log file rotation time
+ *
+ * If set, logging continues in a new file when the current log file has been
+ * written for this amount of time.
+ * Set to 0 to disable.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @unit s
+ * @min 0
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_ROTATE_S, 0);
+
+/**
+ * Maximum disk space used by log files
+ *
+ * When a new log file is started, the oldest log files are deleted in the
+ * background until all log files together use less than this (including the
+ * size of the next file if SDLOG_ROTATE_MB is set).
+ * Set to 0 to disable.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @unit MB
+ * @min 0
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_QUOTA_MB, 0);
+
+/**
+ * Seek index interval
+ *
+ * If set, a seek index is appended to each log file when it is closed. It
+ * contains the file offset of the first sample of each topic in every
+ * interval, so that tools and replay can directly seek to a time or to the
+ * data of a topic. The interval is increased on long logs to limit the
+ * memory usage. Compressed logs (SDLOG_COMPRESS) are not indexed.
+ * Set to 0 to disable.
+ *
+ * This parameter is only for the new logger (SYS_LOGGER=1).
+ *
+ * @unit ms
+ * @min 0
+ * @max 60000
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_INDEX_MS, 0);
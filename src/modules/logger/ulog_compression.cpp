@@ -0,0 +1,200 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+#include "ulog_compression.h"
+
+#include <string.h>
+
+namespace px4
+{
+namespace logger
+{
+constexpr size_t ULogCompressor::BLOCK_SIZE;
+constexpr size_t ULogCompressor::MAX_MESSAGE_SIZE;
+
+ULogCompressor::~ULogCompressor()
+{
+	delete[] _window;
+	delete[] _table;
+}
+
+bool ULogCompressor::init()
+{
+	if (_window) {
+		return true;
+	}
+
+	_window = new uint8_t[2 * BLOCK_SIZE];
+	_table = new uint16_t[1 << HASH_BITS];
+
+	if (!_window || !_table) {
+		delete[] _window;
+		delete[] _table;
+		_window = nullptr;
+		_table = nullptr;
+		return false;
+	}
+
+	reset();
+	return true;
+}
+
+void ULogCompressor::reset()
+{
+	memset(_table, 0, sizeof(_table[0]) << HASH_BITS);
+	_block_len = 0;
+}
+
+size_t ULogCompressor::append(const void *data, size_t size)
+{
+	size_t n = BLOCK_SIZE - _block_len;
+
+	if (size < n) {
+		n = size;
+	}
+
+	memcpy(_window + BLOCK_SIZE + _block_len, data, n);
+	_block_len += n;
+	return n;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/** write a sequence length extension (the part that does not fit into the token) */
+static inline uint8_t *write_length(uint8_t *op, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		*op++ = 255;
+	}
+
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+size_t ULogCompressor::compress_block(uint8_t *message)
+{
+	uint8_t *const data = message + sizeof(ulog_message_compressed_header_s);
+	uint8_t *op = data;
+	const size_t start = BLOCK_SIZE;
+	const size_t end = BLOCK_SIZE + _block_len;
+	size_t anchor = start;
+	size_t ip = start;
+
+	if (_block_len > MATCH_LIMIT) {
+		const size_t match_limit = end - MATCH_LIMIT;
+
+		while (ip < match_limit) {
+			const uint32_t sequence = read32(_window + ip);
+			const uint32_t h = hash(sequence);
+			const size_t ref = _table[h];
+			_table[h] = ip + 1;
+
+			if (ref == 0 || read32(_window + ref - 1) != sequence) {
+				/* skip faster through incompressible data */
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			const size_t match = ref - 1;
+			size_t match_len = MIN_MATCH;
+
+			while (ip + match_len < end - LAST_LITERALS && _window[match + match_len] == _window[ip + match_len]) {
+				++match_len;
+			}
+
+			/* token, literals, offset, match length */
+			const size_t literals = ip - anchor;
+			const size_t ml = match_len - MIN_MATCH;
+			uint8_t *token = op++;
+			*token = (uint8_t)(((literals < 15 ? literals : 15) << 4) | (ml < 15 ? ml : 15));
+
+			if (literals >= 15) {
+				op = write_length(op, literals - 15);
+			}
+
+			memcpy(op, _window + anchor, literals);
+			op += literals;
+			const size_t offset = ip - match;
+			*op++ = (uint8_t)offset;
+			*op++ = (uint8_t)(offset >> 8);
+
+			if (ml >= 15) {
+				op = write_length(op, ml - 15);
+			}
+
+			ip += match_len;
+			anchor = ip;
+
+			/* also index the end of the match */
+			if (ip - 2 < match_limit) {
+				_table[hash(read32(_window + ip - 2))] = ip - 2 + 1;
+			}
+		}
+	}
+
+	/* last literals */
+	const size_t literals = end - anchor;
+	*op++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+
+	if (literals >= 15) {
+		op = write_length(op, literals - 15);
+	}
+
+	memcpy(op, _window + anchor, literals);
+	op += literals;
+
+	ulog_message_compressed_header_s *header = (ulog_message_compressed_header_s *)message;
+	header->msg_size = (uint16_t)(op - message - ULOG_MSG_HEADER_LEN);
+	header->msg_type = static_cast<uint8_t>(ULogMessageType::COMPRESSED);
+	header->uncompressed_size = (uint16_t)_block_len;
+
+	/* the current block becomes the history: move the window by _block_len */
+	const size_t shift = _block_len;
+	memmove(_window, _window + shift, BLOCK_SIZE);
+
+	for (size_t i = 0; i < (1u << HASH_BITS); ++i) {
+		_table[i] = _table[i] > shift ? _table[i] - shift : 0;
+	}
+
+	_block_len = 0;
+	return op - message;
+}
+
+} //namespace logger
+} //namespace px4
@@ -0,0 +1,210 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ulog_compression.h
+ * Streaming compression of ULog files.
+ *
+ * The message stream after the file header is cut into blocks, and each block is
+ * stored in a COMPRESSED message (@see ulog_message_compressed_header_s). The data
+ * uses the LZ4 block format, where matches can also refer to the data of the
+ * previous block (up to ULogCompressor::BLOCK_SIZE bytes back in the decompressed
+ * stream). So the blocks must be decompressed in order, and the concatenated output
+ * is the uncompressed message stream.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "messages.h"
+
+namespace px4
+{
+namespace logger
+{
+
+/**
+ * @class ULogCompressor
+ * Collects the message stream into blocks and compresses them. Not thread-safe.
+ */
+class ULogCompressor
+{
+public:
+	static constexpr size_t BLOCK_SIZE = 4096; ///< uncompressed size of a (full) block
+	static constexpr size_t MAX_MESSAGE_SIZE = sizeof(ulog_message_compressed_header_s) + BLOCK_SIZE + BLOCK_SIZE / 255 +
+			16; ///< worst case size of a COMPRESSED message
+
+	ULogCompressor() = default;
+	~ULogCompressor();
+
+	/**
+	 * allocate the buffers (16 KB)
+	 * @return true on success
+	 */
+	bool init();
+
+	/**
+	 * Start a new stream (drops the history)
+	 */
+	void reset();
+
+	/**
+	 * Append data to the current block
+	 * @return number of bytes taken, less than size if the block is full
+	 */
+	size_t append(const void *data, size_t size);
+
+	bool block_full() const { return _block_len == BLOCK_SIZE; }
+
+	/** number of bytes in the current block */
+	size_t block_len() const { return _block_len; }
+
+	/**
+	 * Compress the current block into a COMPRESSED message and start the next block.
+	 * @param message buffer of MAX_MESSAGE_SIZE bytes
+	 * @return size of the message
+	 */
+	size_t compress_block(uint8_t *message);
+
+private:
+	static constexpr int HASH_BITS = 12;
+	static constexpr size_t MIN_MATCH = 4;
+	static constexpr size_t LAST_LITERALS = 5; ///< the last bytes of a block are always literals
+	static constexpr size_t MATCH_LIMIT = 12; ///< no match may start in the last bytes of a block
+
+	static uint32_t hash(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HASH_BITS); }
+
+	/**
+	 * history (previous block) in _window[0, BLOCK_SIZE), current block in
+	 * _window[BLOCK_SIZE, BLOCK_SIZE + _block_len)
+	 */
+	uint8_t *_window = nullptr;
+	uint16_t *_table = nullptr; ///< window position + 1 of the last occurrence of a hash, 0 if none
+	size_t _block_len = 0;
+};
+
+/**
+ * Decompress the data of a COMPRESSED message.
+ * @param src compressed data (following ulog_message_compressed_header_s)
+ * @param src_size size of the compressed data
+ * @param dst output buffer. The history_len bytes before dst must contain the previously
+ *            decompressed data (at least ULogCompressor::BLOCK_SIZE bytes, unless the
+ *            stream started less than that before).
+ * @param dst_size size of the output buffer
+ * @param history_len number of valid bytes before dst
+ * @return number of decompressed bytes, -1 on invalid data
+ */
+static inline int ulog_decompress_block(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size,
+					size_t history_len)
+{
+	const uint8_t *ip = src;
+	const uint8_t *const src_end = src + src_size;
+	uint8_t *op = dst;
+	uint8_t *const dst_end = dst + dst_size;
+
+	while (ip < src_end) {
+		const uint8_t token = *ip++;
+		size_t length = token >> 4;
+
+		if (length == 15) {
+			uint8_t b;
+
+			do {
+				if (ip >= src_end) {
+					return -1;
+				}
+
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+
+		if ((size_t)(src_end - ip) < length || (size_t)(dst_end - op) < length) {
+			return -1;
+		}
+
+		for (size_t i = 0; i < length; ++i) {
+			*op++ = *ip++;
+		}
+
+		if (ip == src_end) {
+			break; // the last sequence has no match
+		}
+
+		if (src_end - ip < 2) {
+			return -1;
+		}
+
+		const size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > (size_t)(op - dst) + history_len) {
+			return -1;
+		}
+
+		length = token & 0xf;
+
+		if (length == 15) {
+			uint8_t b;
+
+			do {
+				if (ip >= src_end) {
+					return -1;
+				}
+
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+
+		length += 4;
+
+		if ((size_t)(dst_end - op) < length) {
+			return -1;
+		}
+
+		const uint8_t *match = op - offset;
+
+		for (size_t i = 0; i < length; ++i) { // byte-wise: the match can overlap the output
+			*op++ = *match++;
+		}
+	}
+
+	return op - dst;
+}
+
+} //namespace logger
+} //namespace px4
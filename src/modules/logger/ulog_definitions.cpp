@@ -0,0 +1,158 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "ulog_definitions.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace px4
+{
+namespace logger
+{
+
+size_t ulog_encode_header(ulog_file_header_s &header, uint64_t timestamp)
+{
+	header.magic[0] = 'U';
+	header.magic[1] = 'L';
+	header.magic[2] = 'o';
+	header.magic[3] = 'g';
+	header.magic[4] = 0x01;
+	header.magic[5] = 0x12;
+	header.magic[6] = 0x35;
+	header.magic[7] = 0x00; //file version 0
+	header.timestamp = timestamp;
+	return sizeof(header);
+}
+
+size_t ulog_encode_info(ulog_message_info_header_s &msg, const char *name, const char *value)
+{
+	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
+	msg.msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
+
+	/* construct format key (type and name) */
+	size_t vlen = strlen(value);
+	msg.key_len = snprintf(msg.key, sizeof(msg.key), "char[%zu] %s", vlen, name);
+	size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
+
+	/* copy string value directly to buffer */
+	if (vlen >= (sizeof(msg) - msg_size)) {
+		return 0;
+	}
+
+	memcpy(&buffer[msg_size], value, vlen);
+	msg_size += vlen;
+
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+size_t ulog_encode_info(ulog_message_info_header_s &msg, const char *name, int32_t value)
+{
+	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
+	msg.msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
+
+	/* construct format key (type and name) */
+	msg.key_len = snprintf(msg.key, sizeof(msg.key), "int32_t %s", name);
+	size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
+
+	/* copy value directly to buffer */
+	memcpy(&buffer[msg_size], &value, sizeof(int32_t));
+	msg_size += sizeof(int32_t);
+
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+size_t ulog_encode_format(ulog_message_format_s &msg, const orb_metadata *meta)
+{
+	int format_len = snprintf(msg.format, sizeof(msg.format), "%s:%s", meta->o_name, meta->o_fields);
+	size_t msg_size = sizeof(msg) - sizeof(msg.format) + format_len;
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+size_t ulog_encode_parameter(ulog_message_parameter_header_s &msg, param_t param)
+{
+	uint8_t *buffer = reinterpret_cast<uint8_t *>(&msg);
+	msg.msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
+
+	/* get parameter type and size */
+	const char *type_str;
+	size_t value_size = 0;
+
+	switch (param_type(param)) {
+	case PARAM_TYPE_INT32:
+		type_str = "int32_t";
+		value_size = sizeof(int32_t);
+		break;
+
+	case PARAM_TYPE_FLOAT:
+		type_str = "float";
+		value_size = sizeof(float);
+		break;
+
+	default:
+		return 0;
+	}
+
+	/* format parameter key (type and name) */
+	msg.key_len = snprintf(msg.key, sizeof(msg.key), "%s %s", type_str, param_name(param));
+	size_t msg_size = sizeof(msg) - sizeof(msg.key) + msg.key_len;
+
+	/* copy parameter value directly to buffer */
+	param_get(param, &buffer[msg_size]);
+	msg_size += value_size;
+
+	/* msg_size is now 1 (msg_type) + 2 (msg_size) + 1 (key_len) + key_len + value_size */
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+size_t ulog_encode_add_logged_msg(ulog_message_add_logged_s &msg, const orb_metadata *meta, uint16_t msg_id,
+				  uint8_t multi_id)
+{
+	msg.msg_id = msg_id;
+	msg.multi_id = multi_id;
+
+	int message_name_len = strlen(meta->o_name);
+
+	memcpy(msg.message_name, meta->o_name, message_name_len);
+
+	size_t msg_size = sizeof(msg) - sizeof(msg.message_name) + message_name_len;
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+} //namespace logger
+} //namespace px4
@@ -0,0 +1,79 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ulog_definitions.h
+ * Encoding of the messages of the ULog definitions section: file header, info, format,
+ * parameter and ADD_LOGGED_MSG messages. Shared by the logger and the flight recorder.
+ *
+ * Each function fills in the message and returns the number of bytes to write (including
+ * the message header), or 0 if the message cannot be encoded.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <uORB/uORB.h>
+#include <systemlib/param/param.h>
+
+#include "messages.h"
+
+namespace px4
+{
+namespace logger
+{
+
+size_t ulog_encode_header(ulog_file_header_s &header, uint64_t timestamp);
+
+/**
+ * Info message with a string value. The value must fit into the message buffer.
+ */
+size_t ulog_encode_info(ulog_message_info_header_s &msg, const char *name, const char *value);
+
+size_t ulog_encode_info(ulog_message_info_header_s &msg, const char *name, int32_t value);
+
+size_t ulog_encode_format(ulog_message_format_s &msg, const orb_metadata *meta);
+
+/**
+ * Parameter message with the current value of param. Returns 0 for unsupported types.
+ */
+size_t ulog_encode_parameter(ulog_message_parameter_header_s &msg, param_t param);
+
+size_t ulog_encode_add_logged_msg(ulog_message_add_logged_s &msg, const orb_metadata *meta, uint16_t msg_id,
+				  uint8_t multi_id);
+
+} //namespace logger
+} //namespace px4
@@ -0,0 +1,215 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ulog_delta.h
+ * Field-level delta encoding of logged topics.
+ *
+ * A DATA_DELTA message (@see ulog_message_data_delta_header_s) contains a bitmask of
+ * the fields that changed since the previous data message with the same msg_id,
+ * followed by the data of these fields. The field layout is given by the format of
+ * the topic, where nested types are treated as a single field and the padding at the
+ * end (after o_size_no_padding) is ignored.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uORB/uORBTopics.h>
+
+#include "messages.h"
+
+namespace px4
+{
+namespace logger
+{
+
+/**
+ * Get the size of a (non-array) type used in a topic format.
+ * Nested types are looked up in the uORB topic list.
+ * @return size in bytes, 0 if unknown
+ */
+static inline size_t ulog_delta_type_size(const char *type, size_t type_len)
+{
+	static const struct {
+		const char *name;
+		size_t size;
+	} builtin_types[] = {
+		{"int8_t", 1}, {"uint8_t", 1}, {"char", 1}, {"bool", 1},
+		{"int16_t", 2}, {"uint16_t", 2},
+		{"int32_t", 4}, {"uint32_t", 4}, {"float", 4},
+		{"int64_t", 8}, {"uint64_t", 8}, {"double", 8},
+	};
+
+	for (const auto &builtin_type : builtin_types) {
+		if (strlen(builtin_type.name) == type_len && strncmp(builtin_type.name, type, type_len) == 0) {
+			return builtin_type.size;
+		}
+	}
+
+	const orb_metadata **topics = orb_get_topics();
+
+	for (size_t i = 0; i < orb_topics_count(); i++) {
+		if (strlen(topics[i]->o_name) == type_len && strncmp(topics[i]->o_name, type, type_len) == 0) {
+			return topics[i]->o_size;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Get the field layout of a topic.
+ * @param fields field definitions of the topic, e.g. "uint64_t timestamp;float[3] x;..."
+ * @param size size of the logged data (o_size_no_padding)
+ * @param offsets if not nullptr, set to the offset of each field, followed by the end of the last field
+ * @param max_fields maximum number of fields to return (offsets needs max_fields + 1 entries)
+ * @return number of fields, -1 on error (unknown type, too many fields or size mismatch)
+ */
+static inline int ulog_delta_field_offsets(const char *fields, size_t size, uint16_t *offsets, int max_fields)
+{
+	int num_fields = 0;
+	size_t offset = 0;
+
+	while (*fields && offset < size) {
+		const size_t type_len = strcspn(fields, "[ ;");
+		size_t array_size = 1;
+
+		if (fields[type_len] == '[') {
+			array_size = strtoul(fields + type_len + 1, nullptr, 10);
+		}
+
+		const size_t field_size = ulog_delta_type_size(fields, type_len) * array_size;
+
+		if (field_size == 0 || num_fields >= max_fields) {
+			return -1;
+		}
+
+		if (offsets) {
+			offsets[num_fields] = offset;
+		}
+
+		++num_fields;
+		offset += field_size;
+
+		fields += strcspn(fields, ";");
+
+		if (*fields == ';') {
+			++fields;
+		}
+	}
+
+	// the fields must end exactly at size (only the padding at the end is cut off)
+	if (offset != size) {
+		return -1;
+	}
+
+	if (offsets) {
+		offsets[num_fields] = size;
+	}
+
+	return num_fields;
+}
+
+/**
+ * Encode the changed fields of a sample.
+ * @param prev previously written sample
+ * @param cur current sample
+ * @param offsets field layout (@see ulog_delta_field_offsets())
+ * @param num_fields number of fields
+ * @param out output: bitmask and changed fields. Needs (num_fields + 7) / 8 + offsets[num_fields] bytes.
+ * @return number of bytes written to out
+ */
+static inline size_t ulog_delta_encode(const uint8_t *prev, const uint8_t *cur, const uint16_t *offsets,
+				       int num_fields, uint8_t *out)
+{
+	const int mask_len = (num_fields + 7) / 8;
+	uint8_t *data = out + mask_len;
+	memset(out, 0, mask_len);
+
+	for (int i = 0; i < num_fields; ++i) {
+		const size_t field_size = offsets[i + 1] - offsets[i];
+
+		if (memcmp(prev + offsets[i], cur + offsets[i], field_size) != 0) {
+			out[i / 8] |= 1 << (i % 8);
+			memcpy(data, cur + offsets[i], field_size);
+			data += field_size;
+		}
+	}
+
+	return data - out;
+}
+
+/**
+ * Apply the changed fields of a DATA_DELTA message to the previous sample.
+ * @param delta bitmask and changed fields (following ulog_message_data_delta_header_s)
+ * @param delta_len length of delta
+ * @param offsets field layout (@see ulog_delta_field_offsets())
+ * @param num_fields number of fields
+ * @param data previous sample, updated in place
+ * @return false on invalid data
+ */
+static inline bool ulog_delta_decode(const uint8_t *delta, size_t delta_len, const uint16_t *offsets,
+				     int num_fields, uint8_t *data)
+{
+	const size_t mask_len = (num_fields + 7) / 8;
+
+	if (delta_len < mask_len) {
+		return false;
+	}
+
+	const uint8_t *src = delta + mask_len;
+	const uint8_t *const src_end = delta + delta_len;
+
+	for (int i = 0; i < num_fields; ++i) {
+		if (delta[i / 8] & (1 << (i % 8))) {
+			const size_t field_size = offsets[i + 1] - offsets[i];
+
+			if (src + field_size > src_end) {
+				return false;
+			}
+
+			memcpy(data + offsets[i], src, field_size);
+			src += field_size;
+		}
+	}
+
+	return src == src_end;
+}
+
+} //namespace logger
+} //namespace px4
@@ -0,0 +1,253 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+#include "ulog_index.h"
+#include "ulog_delta.h"
+
+#include <string.h>
+
+namespace px4
+{
+namespace logger
+{
+
+int ulog_index_timestamp_offset(const char *fields)
+{
+	size_t offset = 0;
+
+	while (*fields) {
+		const size_t type_len = strcspn(fields, "[ ;");
+		const size_t field_len = strcspn(fields, ";");
+		size_t array_size = 1;
+
+		if (fields[type_len] == '[') {
+			array_size = strtoul(fields + type_len + 1, nullptr, 10);
+
+		} else if (type_len == 8 && strncmp(fields, "uint64_t", 8) == 0 && field_len == 18 &&
+			   strncmp(fields + 8, " timestamp", 10) == 0) {
+			return offset;
+		}
+
+		const size_t field_size = ulog_delta_type_size(fields, type_len) * array_size;
+
+		if (field_size == 0) {
+			return -1;
+		}
+
+		offset += field_size;
+		fields += field_len;
+
+		if (*fields == ';') {
+			++fields;
+		}
+	}
+
+	return -1;
+}
+
+ULogIndex::~ULogIndex()
+{
+	delete[] _entries;
+	delete[] _next_slot;
+	delete[] _first_timestamp;
+	delete[] _last_timestamp;
+}
+
+bool ULogIndex::init(size_t max_entries, uint16_t max_msg_ids)
+{
+	if (_entries) {
+		return true;
+	}
+
+	_entries = new Entry[max_entries];
+	_next_slot = new uint32_t[max_msg_ids];
+	_first_timestamp = new uint64_t[max_msg_ids];
+	_last_timestamp = new uint64_t[max_msg_ids];
+
+	if (!_entries || !_next_slot || !_first_timestamp || !_last_timestamp) {
+		delete[] _entries;
+		delete[] _next_slot;
+		delete[] _first_timestamp;
+		delete[] _last_timestamp;
+		_entries = nullptr;
+		_next_slot = nullptr;
+		_first_timestamp = nullptr;
+		_last_timestamp = nullptr;
+		return false;
+	}
+
+	_max_entries = max_entries;
+	_max_msg_ids = max_msg_ids;
+	reset(_interval);
+	return true;
+}
+
+void ULogIndex::reset(uint32_t interval)
+{
+	_interval = interval > 0 ? interval : 1;
+	_num_entries = 0;
+
+	for (uint16_t i = 0; i < _max_msg_ids; ++i) {
+		_next_slot[i] = 0;
+		_first_timestamp[i] = UINT64_MAX;
+		_last_timestamp[i] = 0;
+	}
+
+	rewind_messages();
+}
+
+void ULogIndex::add(uint16_t msg_id, uint64_t timestamp, uint64_t offset, bool indexed)
+{
+	if (msg_id >= _max_msg_ids) {
+		return;
+	}
+
+	if (_first_timestamp[msg_id] == UINT64_MAX) {
+		_first_timestamp[msg_id] = timestamp;
+	}
+
+	_last_timestamp[msg_id] = timestamp;
+
+	if (!indexed) {
+		return;
+	}
+
+	if (_num_entries >= _max_entries) {
+		coarsen();
+	}
+
+	const uint32_t slot = timestamp / (_interval * 1000ull);
+
+	if (slot < _next_slot[msg_id]) {
+		return; // not needed anymore with the coarser interval
+	}
+
+	// the slot is marked as done even if the index is still full, so that the message after it is not forced
+	// to be a full one as well
+	_next_slot[msg_id] = slot + 1;
+
+	if (_num_entries < _max_entries) {
+		Entry &entry = _entries[_num_entries++];
+		entry.timestamp = timestamp;
+		entry.offset = offset;
+		entry.msg_id = msg_id;
+	}
+}
+
+void ULogIndex::coarsen()
+{
+	// avoid an overflow (there is only one entry per msg_id left long before that)
+	if (_interval >= UINT32_MAX / 2) {
+		return;
+	}
+
+	_interval *= 2;
+
+	for (uint16_t i = 0; i < _max_msg_ids; ++i) {
+		_next_slot[i] = 0;
+	}
+
+	// the entries are in increasing order per msg_id: keep the first one in each (new) interval
+	size_t num_kept = 0;
+
+	for (size_t i = 0; i < _num_entries; ++i) {
+		const Entry &entry = _entries[i];
+		const uint32_t slot = entry.timestamp / (_interval * 1000ull);
+
+		if (slot >= _next_slot[entry.msg_id]) {
+			_entries[num_kept++] = entry;
+			_next_slot[entry.msg_id] = slot + 1;
+		}
+	}
+
+	_num_entries = num_kept;
+}
+
+size_t ULogIndex::next_message(uint8_t *buffer, size_t buffer_len)
+{
+	ulog_message_index_header_s header;
+	size_t max_count = (buffer_len - sizeof(header)) / sizeof(ulog_index_entry_s);
+	const size_t max_count_msg_size = (UINT16_MAX + ULOG_MSG_HEADER_LEN - sizeof(header)) / sizeof(ulog_index_entry_s);
+
+	if (max_count > max_count_msg_size) {
+		max_count = max_count_msg_size;
+	}
+
+	// skip the msg_ids without data
+	while (_msg_id_pos < _max_msg_ids && _first_timestamp[_msg_id_pos] == UINT64_MAX) {
+		++_msg_id_pos;
+	}
+
+	if (_msg_id_pos >= _max_msg_ids) {
+		return 0;
+	}
+
+	header.msg_id = _msg_id_pos;
+	header.first_timestamp = _first_timestamp[_msg_id_pos];
+	header.last_timestamp = _last_timestamp[_msg_id_pos];
+
+	uint8_t *out = buffer + sizeof(header);
+	size_t count = 0;
+
+	while (_entry_pos < _num_entries && count < max_count) {
+		const Entry &entry = _entries[_entry_pos++];
+
+		if (entry.msg_id == _msg_id_pos) {
+			ulog_index_entry_s index_entry;
+			index_entry.timestamp = entry.timestamp;
+			index_entry.offset = entry.offset;
+			memcpy(out, &index_entry, sizeof(index_entry));
+			out += sizeof(index_entry);
+			++count;
+		}
+	}
+
+	// continue with the next msg_id if this was the last message of this one
+	while (_entry_pos < _num_entries && _entries[_entry_pos].msg_id != _msg_id_pos) {
+		++_entry_pos;
+	}
+
+	if (_entry_pos >= _num_entries) {
+		++_msg_id_pos;
+		_entry_pos = 0;
+	}
+
+	const size_t msg_size = out - buffer;
+	header.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	memcpy(buffer, &header, sizeof(header));
+	return msg_size;
+}
+
+} //namespace logger
+} //namespace px4
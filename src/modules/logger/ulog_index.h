@@ -0,0 +1,150 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ulog_index.h
+ * Seek index of ULog files.
+ *
+ * For each msg_id, the first data message in every index interval is stored with its
+ * timestamp and file offset. When the log file is closed, the index is appended as
+ * INDEX messages (@see ulog_message_index_header_s), followed by an INDEX_END message
+ * with the offset of the first INDEX message. So a reader can find the index by reading
+ * the last sizeof(ulog_message_index_end_s) bytes of the file, and then seek directly to
+ * a time or to the data of a single topic. Indexed data messages are always full DATA
+ * messages (no DATA_DELTA), so that decoding can start there.
+ *
+ * The index has a fixed memory budget: when it is full, the interval is doubled and the
+ * entries that are not needed anymore are dropped.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "messages.h"
+
+namespace px4
+{
+namespace logger
+{
+
+/**
+ * Get the offset of the timestamp field of a topic.
+ * @param fields field definitions of the topic, e.g. "uint64_t timestamp;float[3] x;..."
+ * @return offset, or -1 if the topic has no uint64_t timestamp field
+ */
+int ulog_index_timestamp_offset(const char *fields);
+
+/**
+ * @class ULogIndex
+ * Collects the index entries of a log file. Not thread-safe.
+ */
+class ULogIndex
+{
+public:
+	ULogIndex() = default;
+	~ULogIndex();
+
+	/**
+	 * allocate the buffers
+	 * @param max_entries maximum number of stored entries
+	 * @param max_msg_ids msg_ids must be smaller than this
+	 * @return true on success
+	 */
+	bool init(size_t max_entries, uint16_t max_msg_ids);
+
+	/**
+	 * Start a new file (drops all entries)
+	 * @param interval index interval [ms]
+	 */
+	void reset(uint32_t interval);
+
+	/**
+	 * Check whether a data message needs to be indexed (it must be written as full DATA message then)
+	 */
+	bool due(uint16_t msg_id, uint64_t timestamp) const
+	{
+		return msg_id < _max_msg_ids && timestamp / (_interval * 1000ull) >= _next_slot[msg_id];
+	}
+
+	/**
+	 * Update the index after a data message got written
+	 * @param offset file offset of the message
+	 * @param indexed true if due() was true for this message (add an entry)
+	 */
+	void add(uint16_t msg_id, uint64_t timestamp, uint64_t offset, bool indexed);
+
+	uint32_t interval() const { return _interval; }
+
+	size_t num_entries() const { return _num_entries; }
+
+	/**
+	 * Get the next INDEX message (call this repeatedly, after reset() or the last message).
+	 * @param buffer output buffer
+	 * @param buffer_len size of buffer, must be larger than sizeof(ulog_message_index_header_s)
+	 * @return size of the message written to buffer, 0 if there are no more messages
+	 */
+	size_t next_message(uint8_t *buffer, size_t buffer_len);
+
+	/** restart next_message() at the first message */
+	void rewind_messages() { _msg_id_pos = 0; _entry_pos = 0; }
+
+private:
+	struct Entry {
+		uint64_t timestamp;
+		uint64_t offset;
+		uint16_t msg_id;
+	};
+
+	/** double the interval and drop the entries that are not needed anymore */
+	void coarsen();
+
+	Entry *_entries = nullptr;
+	size_t _max_entries = 0;
+	size_t _num_entries = 0;
+
+	uint16_t _max_msg_ids = 0;
+	uint32_t *_next_slot = nullptr; ///< per msg_id: index of the next interval that needs an entry
+	uint64_t *_first_timestamp = nullptr; ///< per msg_id (0 = no data)
+	uint64_t *_last_timestamp = nullptr;
+
+	uint32_t _interval = 1000; ///< [ms]
+
+	uint16_t _msg_id_pos = 0; ///< next_message() state
+	size_t _entry_pos = 0;
+};
+
+} //namespace logger
+} //namespace px4
@@ -52,7 +52,7 @@
 MavlinkOrbSubscription::MavlinkOrbSubscription(const orb_id_t topic, int instance) :
 	next(nullptr),
 	_topic(topic),
-	_fd(-1),
+	_sub(topic),
 	_instance(instance),
 	_published(false),
 	_subscribe_from_beginning(false),
@@ -62,9 +62,6 @@ MavlinkOrbSubscription::MavlinkOrbSubscription(const orb_id_t topic, int instanc
 
 MavlinkOrbSubscription::~MavlinkOrbSubscription()
 {
-	if (_fd >= 0) {
-		orb_unsubscribe(_fd);
-	}
 }
 
 orb_id_t
@@ -85,14 +82,9 @@ MavlinkOrbSubscription::update(uint64_t *time, void *data)
 
 
 	// TODO this is NOT atomic operation, we can get data newer than time
-	// if topic was published between orb_stat and orb_copy calls.
-
-	uint64_t time_topic;
+	// if topic was published between the last_update() and copy() calls.
 
-	if (orb_stat(_fd, &time_topic)) {
-		/* error getting last topic publication time */
-		time_topic = 0;
-	}
+	uint64_t time_topic = _sub.last_update();
 
 	if (update(data)) {
 		/* data copied successfully */
@@ -116,7 +108,7 @@ MavlinkOrbSubscription::update(void *data)
 		return false;
 	}
 
-	if (orb_copy(_topic, _fd, data)) {
+	if (!_sub.copy(data)) {
 		if (data != nullptr) {
 			/* error copying topic data */
 			memset(data, 0, _topic->o_size);
@@ -137,11 +129,7 @@ MavlinkOrbSubscription::update_if_changed(void *data)
 		return false;
 	}
 
-	bool updated;
-
-	if (orb_check(_fd, &updated)) {
-		return false;
-	}
+	bool updated = _sub.updated();
 
 	// If we didn't update and this topic did not change
 	// its publication status then nothing really changed
@@ -173,9 +161,7 @@ MavlinkOrbSubscription::is_published()
 #if defined(__PX4_QURT) || defined(__PX4_POSIX_EAGLE)
 	// Snapdragon has currently no support for orb_exists, therefore
 	// we're not using it.
-	if (_fd < 0) {
-		_fd = orb_subscribe_multi(_topic, _instance);
-	}
+	_sub.subscribe(_instance);
 #else
 	// We don't want to subscribe to anything that does not exist
 	// in order to save memory and file descriptors.
@@ -185,24 +171,16 @@ MavlinkOrbSubscription::is_published()
 		return false;
 	}
 
-	if (_fd < 0) {
-		_fd = orb_subscribe_multi(_topic, _instance);
-	}
+	_sub.subscribe(_instance);
 #endif
 
-	bool updated;
-	orb_check(_fd, &updated);
-
-	if (updated) {
+	if (_sub.updated()) {
 		_published = true;
 	}
 
 	// topic may have been last published before we subscribed
-	uint64_t time_topic = 0;
-	if (!_published && orb_stat(_fd, &time_topic) == PX4_OK) {
-		if (time_topic != 0) {
-			_published = true;
-		}
+	if (!_published && _sub.last_update() != 0) {
+		_published = true;
 	}
 
 	return _published;
@@ -44,6 +44,7 @@
 #include <systemlib/uthash/utlist.h>
 #include <drivers/drv_hrt.h>
 #include "uORB/uORB.h"	// orb_id_t
+#include <uORB/DirectSubscription.hpp>
 
 class MavlinkOrbSubscription
 {
@@ -95,7 +96,7 @@ public:
 
 private:
 	const orb_id_t _topic;		///< topic metadata
-	int _fd;			///< subscription handle
+	uORB::DirectSubscriptionBase _sub;	///< subscription (accesses the topic directly)
 	const uint8_t _instance;		///< get topic instance
 	bool _published;		///< topic was ever published
 	bool _subscribe_from_beginning; ///< we need to subscribe from the beginning, e.g. for vehicle_command_acks
@@ -71,6 +71,9 @@ MavlinkULog::~MavlinkULog()
 	if (_ulog_stream_ack_pub) {
 		orb_unadvertise(_ulog_stream_ack_pub);
 	}
+	if (_ulog_stream_status_pub) {
+		orb_unadvertise(_ulog_stream_status_pub);
+	}
 	if (_ulog_stream_sub >= 0) {
 		orb_unsubscribe(_ulog_stream_sub);
 	}
@@ -111,6 +114,7 @@ int MavlinkULog::handle_update(mavlink_channel_t channel)
 					return -ETIMEDOUT;
 				} else {
 					PX4_DEBUG("re-sending ulog mavlink message (try=%i)", _sent_tries);
+					++_num_retransmitted;
 					_last_sent_time = hrt_absolute_time();
 					mavlink_logging_data_acked_t msg;
 					msg.sequence = _ulog_data.sequence;
@@ -133,6 +137,15 @@ int MavlinkULog::handle_update(mavlink_channel_t channel)
 	int ret = orb_check(_ulog_stream_sub, &updated);
 	while (updated && !ret && _current_num_msgs < _max_num_messages) {
 		orb_copy(ORB_ID(ulog_stream), _ulog_stream_sub, &_ulog_data);
+
+		// a gap in the sequence means that the queue overflowed (we do not keep up with the logger)
+		uint16_t gap = _ulog_data.sequence - _next_sequence;
+		if (_sequence_valid && gap < 0x8000) {
+			_num_lost += gap;
+		}
+		_next_sequence = _ulog_data.sequence + 1;
+		_sequence_valid = true;
+
 		if (_ulog_data.flags & ulog_stream_s::FLAGS_NEED_ACK) {
 			_sent_tries = 1;
 			_last_sent_time = hrt_absolute_time();
@@ -164,6 +177,10 @@ int MavlinkULog::handle_update(mavlink_channel_t channel)
 		ret = orb_check(_ulog_stream_sub, &updated);
 	}
 
+	if (updated && !ret && _current_num_msgs >= _max_num_messages) {
+		_backlog = true;
+	}
+
 	//need to update the rate?
 	hrt_abstime t = hrt_absolute_time();
 	if (t > _next_rate_check) {
@@ -172,6 +189,7 @@ int MavlinkULog::handle_update(mavlink_channel_t channel)
 		} else {
 			_current_rate_factor = _max_rate_factor;
 		}
+		publish_status();
 		_current_num_msgs = 0;
 		_next_rate_check = t + _rate_calculation_delta_t * 1.e6f;
 		PX4_DEBUG("current rate=%.3f (max=%i msgs in %.3fs)", (double)_current_rate_factor, _max_num_messages,
@@ -244,3 +262,24 @@ void MavlinkULog::publish_ack(uint16_t sequence)
 		orb_publish(ORB_ID(ulog_stream_ack), _ulog_stream_ack_pub, &ack);
 	}
 }
+
+void MavlinkULog::publish_status()
+{
+	ulog_stream_status_s status;
+	status.timestamp = hrt_absolute_time();
+	status.sent = _current_num_msgs;
+	status.lost = _num_lost;
+	status.retransmitted = _num_retransmitted;
+	status.backlog = _backlog;
+
+	if (_ulog_stream_status_pub == nullptr) {
+		_ulog_stream_status_pub = orb_advertise(ORB_ID(ulog_stream_status), &status);
+
+	} else {
+		orb_publish(ORB_ID(ulog_stream_status), _ulog_stream_status_pub, &status);
+	}
+
+	_num_lost = 0;
+	_num_retransmitted = 0;
+	_backlog = false;
+}
@@ -48,6 +48,7 @@
 
 #include <uORB/topics/ulog_stream.h>
 #include <uORB/topics/ulog_stream_ack.h>
+#include <uORB/topics/ulog_stream_status.h>
 
 #include "mavlink_bridge_header.h"
 
@@ -115,6 +116,9 @@ private:
 
 	void publish_ack(uint16_t sequence);
 
+	/** publish the link feedback of the last rate interval (ulog_stream_status) and reset it */
+	void publish_status();
+
 	static px4_sem_t _lock;
 	static bool _init;
 	static MavlinkULog *_instance;
@@ -137,6 +141,14 @@ private:
 	int _current_num_msgs = 0;  ///< number of messages sent within the current time interval
 	hrt_abstime _next_rate_check; ///< next timestamp at which to update the rate
 
+	/* link feedback for the logger, counted within the current time interval */
+	orb_advert_t _ulog_stream_status_pub = nullptr;
+	uint16_t _next_sequence = 0; ///< expected sequence of the next ulog_stream message
+	bool _sequence_valid = false;
+	uint16_t _num_lost = 0; ///< messages dropped from the ulog_stream queue
+	uint16_t _num_retransmitted = 0;
+	bool _backlog = false; ///< the message budget was used up while data was still queued
+
 	/* do not allow copying this class */
 	MavlinkULog(const MavlinkULog &) = delete;
 	MavlinkULog operator=(const MavlinkULog &) = delete;
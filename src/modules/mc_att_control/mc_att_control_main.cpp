@@ -67,6 +67,7 @@
 #include <drivers/drv_hrt.h>
 #include <arch/board/board.h>
 #include <uORB/uORB.h>
+#include <uORB/DirectSubscription.hpp>
 #include <uORB/topics/vehicle_attitude_setpoint.h>
 #include <uORB/topics/manual_control_setpoint.h>
 #include <uORB/topics/actuator_controls.h>
@@ -134,15 +135,15 @@ private:
 	int		_control_task;			/**< task handle */
 
 	int		_ctrl_state_sub;		/**< control state subscription */
-	int		_v_att_sp_sub;			/**< vehicle attitude setpoint subscription */
-	int		_v_rates_sp_sub;		/**< vehicle rates setpoint subscription */
-	int		_v_control_mode_sub;	/**< vehicle control mode subscription */
-	int		_params_sub;			/**< parameter updates subscription */
-	int		_manual_control_sp_sub;	/**< manual control setpoint subscription */
-	int		_armed_sub;				/**< arming status subscription */
-	int		_vehicle_status_sub;	/**< vehicle status subscription */
-	int 	_motor_limits_sub;		/**< motor limits subscription */
-	int 	_battery_status_sub;	/**< battery status subscription */
+	uORB::DirectSubscription<ORB_ID(vehicle_attitude_setpoint)> _v_att_sp_sub;	/**< vehicle attitude setpoint subscription */
+	uORB::DirectSubscription<ORB_ID(vehicle_rates_setpoint)> _v_rates_sp_sub;	/**< vehicle rates setpoint subscription */
+	uORB::DirectSubscription<ORB_ID(vehicle_control_mode)> _v_control_mode_sub;	/**< vehicle control mode subscription */
+	uORB::DirectSubscription<ORB_ID(parameter_update)> _params_sub;	/**< parameter updates subscription */
+	uORB::DirectSubscription<ORB_ID(manual_control_setpoint)> _manual_control_sp_sub;	/**< manual control setpoint subscription */
+	uORB::DirectSubscription<ORB_ID(actuator_armed)> _armed_sub;	/**< arming status subscription */
+	uORB::DirectSubscription<ORB_ID(vehicle_status)> _vehicle_status_sub;	/**< vehicle status subscription */
+	uORB::DirectSubscription<ORB_ID(multirotor_motor_limits)> _motor_limits_sub;	/**< motor limits subscription */
+	uORB::DirectSubscription<ORB_ID(battery_status)> _battery_status_sub;	/**< battery status subscription */
 
 	orb_advert_t	_v_rates_sp_pub;		/**< rate setpoint publication */
 	orb_advert_t	_actuators_0_pub;		/**< attitude actuator controls publication */
@@ -328,12 +329,6 @@ MulticopterAttitudeControl::MulticopterAttitudeControl() :
 
 	/* subscriptions */
 	_ctrl_state_sub(-1),
-	_v_att_sp_sub(-1),
-	_v_control_mode_sub(-1),
-	_params_sub(-1),
-	_manual_control_sp_sub(-1),
-	_armed_sub(-1),
-	_vehicle_status_sub(-1),
 
 	/* publications */
 	_v_rates_sp_pub(nullptr),
@@ -560,14 +555,10 @@ MulticopterAttitudeControl::parameters_update()
 void
 MulticopterAttitudeControl::parameter_update_poll()
 {
-	bool updated;
+	struct parameter_update_s param_update;
 
 	/* Check if parameters have changed */
-	orb_check(_params_sub, &updated);
-
-	if (updated) {
-		struct parameter_update_s param_update;
-		orb_copy(ORB_ID(parameter_update), _params_sub, &param_update);
+	if (_params_sub.update(&param_update)) {
 		parameters_update();
 	}
 }
@@ -575,74 +566,43 @@ MulticopterAttitudeControl::parameter_update_poll()
 void
 MulticopterAttitudeControl::vehicle_control_mode_poll()
 {
-	bool updated;
-
 	/* Check if vehicle control mode has changed */
-	orb_check(_v_control_mode_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(vehicle_control_mode), _v_control_mode_sub, &_v_control_mode);
-	}
+	_v_control_mode_sub.update(&_v_control_mode);
 }
 
 void
 MulticopterAttitudeControl::vehicle_manual_poll()
 {
-	bool updated;
-
 	/* get pilots inputs */
-	orb_check(_manual_control_sp_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(manual_control_setpoint), _manual_control_sp_sub, &_manual_control_sp);
-	}
+	_manual_control_sp_sub.update(&_manual_control_sp);
 }
 
 void
 MulticopterAttitudeControl::vehicle_attitude_setpoint_poll()
 {
 	/* check if there is a new setpoint */
-	bool updated;
-	orb_check(_v_att_sp_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(vehicle_attitude_setpoint), _v_att_sp_sub, &_v_att_sp);
-	}
+	_v_att_sp_sub.update(&_v_att_sp);
 }
 
 void
 MulticopterAttitudeControl::vehicle_rates_setpoint_poll()
 {
 	/* check if there is a new setpoint */
-	bool updated;
-	orb_check(_v_rates_sp_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(vehicle_rates_setpoint), _v_rates_sp_sub, &_v_rates_sp);
-	}
+	_v_rates_sp_sub.update(&_v_rates_sp);
 }
 
 void
 MulticopterAttitudeControl::arming_status_poll()
 {
 	/* check if there is a new setpoint */
-	bool updated;
-	orb_check(_armed_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(actuator_armed), _armed_sub, &_armed);
-	}
+	_armed_sub.update(&_armed);
 }
 
 void
 MulticopterAttitudeControl::vehicle_status_poll()
 {
 	/* check if there is new status information */
-	bool vehicle_status_updated;
-	orb_check(_vehicle_status_sub, &vehicle_status_updated);
-
-	if (vehicle_status_updated) {
-		orb_copy(ORB_ID(vehicle_status), _vehicle_status_sub, &_vehicle_status);
+	if (_vehicle_status_sub.update(&_vehicle_status)) {
 
 		/* set correct uORB ID, depending on if vehicle is VTOL or not */
 		if (!_rates_sp_id) {
@@ -662,24 +622,14 @@ void
 MulticopterAttitudeControl::vehicle_motor_limits_poll()
 {
 	/* check if there is a new message */
-	bool updated;
-	orb_check(_motor_limits_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(multirotor_motor_limits), _motor_limits_sub, &_motor_limits);
-	}
+	_motor_limits_sub.update(&_motor_limits);
 }
 
 void
 MulticopterAttitudeControl::battery_status_poll()
 {
 	/* check if there is a new message */
-	bool updated;
-	orb_check(_battery_status_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(battery_status), _battery_status_sub, &_battery_status);
-	}
+	_battery_status_sub.update(&_battery_status);
 }
 
 /**
@@ -851,30 +801,36 @@ MulticopterAttitudeControl::task_main()
 	/*
 	 * do subscriptions
 	 */
-	_v_att_sp_sub = orb_subscribe(ORB_ID(vehicle_attitude_setpoint));
-	_v_rates_sp_sub = orb_subscribe(ORB_ID(vehicle_rates_setpoint));
+	_v_att_sp_sub.subscribe();
+	_v_rates_sp_sub.subscribe();
 	_ctrl_state_sub = orb_subscribe(ORB_ID(control_state));
-	_v_control_mode_sub = orb_subscribe(ORB_ID(vehicle_control_mode));
-	_params_sub = orb_subscribe(ORB_ID(parameter_update));
-	_manual_control_sp_sub = orb_subscribe(ORB_ID(manual_control_setpoint));
-	_armed_sub = orb_subscribe(ORB_ID(actuator_armed));
-	_vehicle_status_sub = orb_subscribe(ORB_ID(vehicle_status));
-	_motor_limits_sub = orb_subscribe(ORB_ID(multirotor_motor_limits));
-	_battery_status_sub = orb_subscribe(ORB_ID(battery_status));
+	_v_control_mode_sub.subscribe();
+	_params_sub.subscribe();
+	_manual_control_sp_sub.subscribe();
+	_armed_sub.subscribe();
+	_vehicle_status_sub.subscribe();
+	_motor_limits_sub.subscribe();
+	_battery_status_sub.subscribe();
 
 	/* initialize parameters cache */
 	parameters_update();
 
-	/* wakeup source: vehicle attitude */
-	px4_pollfd_struct_t fds[1];
+	/* wakeup source: vehicle attitude, registered once for the lifetime of the task */
+	px4_pollset_t *pollset = px4_pollset_create();
 
-	fds[0].fd = _ctrl_state_sub;
-	fds[0].events = POLLIN;
+	if (pollset == nullptr || px4_pollset_add(pollset, _ctrl_state_sub, POLLIN) != 0) {
+		warn("mc att ctrl: poll set setup failed");
+		px4_pollset_destroy(pollset);
+		_control_task = -1;
+		return;
+	}
+
+	px4_pollfd_struct_t fds[1];
 
 	while (!_task_should_exit) {
 
 		/* wait for up to 100ms for data */
-		int pret = px4_poll(&fds[0], (sizeof(fds) / sizeof(fds[0])), 100);
+		int pret = px4_pollset_wait(pollset, &fds[0], (sizeof(fds) / sizeof(fds[0])), 100);
 
 		/* timed out - periodic check for _task_should_exit */
 		if (pret == 0) {
@@ -1045,6 +1001,8 @@ MulticopterAttitudeControl::task_main()
 		perf_end(_loop_perf);
 	}
 
+	px4_pollset_destroy(pollset);
+
 	_control_task = -1;
 	return;
 }
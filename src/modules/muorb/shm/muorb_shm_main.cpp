@@ -0,0 +1,125 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file muorb_shm_main.cpp
+ * Start/stop the shared memory uORB channel, to exchange topics with other px4 instances
+ * (or other processes) on the same host.
+ */
+
+#include <string.h>
+#include <px4_config.h>
+#include <px4_getopt.h>
+#include <px4_log.h>
+#include "modules/uORB/uORBManager.hpp"
+#include "uORBShmChannel.hpp"
+
+extern "C" { __EXPORT int muorb_shm_main(int argc, char *argv[]); }
+
+static void usage()
+{
+	PX4_INFO("Usage: muorb_shm 'start' [-n <shm name>], 'stop', 'status'");
+	PX4_INFO("  -n <shm name>   name of the shared memory object (default: %s)", UORB_SHM_DEFAULT_NAME);
+}
+
+int
+muorb_shm_main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		usage();
+		return -EINVAL;
+	}
+
+	if (!strcmp(argv[1], "start")) {
+		const char *name = UORB_SHM_DEFAULT_NAME;
+		int myoptind = 1;
+		const char *myoptarg = nullptr;
+		int ch;
+
+		while ((ch = px4_getopt(argc, argv, "n:", &myoptind, &myoptarg)) != EOF) {
+			switch (ch) {
+			case 'n':
+				name = myoptarg;
+				break;
+
+			default:
+				usage();
+				return -EINVAL;
+			}
+		}
+
+		if (uORB::ShmChannel::isInstance() && uORB::ShmChannel::GetInstance()->is_running()) {
+			PX4_WARN("muorb_shm already running");
+			return OK;
+		}
+
+		uORB::ShmChannel *channel = uORB::ShmChannel::GetInstance();
+
+		// register the channel first, so that the receive thread has a handler once it runs
+		uORB::Manager::get_instance()->set_uorb_communicator(channel);
+
+		int ret = channel->Start(name);
+
+		if (ret != 0) {
+			PX4_ERR("failed to start (%i)", ret);
+			return ret;
+		}
+
+		return OK;
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		if (uORB::ShmChannel::isInstance() && uORB::ShmChannel::GetInstance()->is_running()) {
+			uORB::ShmChannel::GetInstance()->Stop();
+
+		} else {
+			PX4_WARN("muorb_shm not running");
+		}
+
+		return OK;
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		if (uORB::ShmChannel::isInstance()) {
+			uORB::ShmChannel::GetInstance()->print_status();
+
+		} else {
+			PX4_INFO("muorb_shm not running");
+		}
+
+		return OK;
+	}
+
+	usage();
+	return -EINVAL;
+}
@@ -0,0 +1,677 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "uORBShmChannel.hpp"
+#include "modules/uORB/uORBManager.hpp"
+#include <px4_log.h>
+#include <px4_posix.h>
+#include <px4_tasks.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+uORB::ShmChannel *uORB::ShmChannel::_InstancePtr = nullptr;
+
+static int futex_wait(uint32_t *addr, uint32_t val, const struct timespec *timeout)
+{
+	return syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, nullptr, 0);
+}
+
+static void futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+static uint64_t monotonic_time_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void wake_process(struct uorb_shm_process_s *process)
+{
+	__atomic_add_fetch(&process->wakeup, 1, __ATOMIC_RELEASE);
+	futex_wake(&process->wakeup);
+}
+
+uORB::ShmChannel::ShmChannel() :
+	_RxHandler(nullptr),
+	_RecvThread(0),
+	_ThreadShouldExit(false),
+	_header(nullptr),
+	_process_index(-1),
+	_last_subscription_changes(0),
+	_num_sent(0),
+	_num_received(0)
+{
+	pthread_mutex_init(&_mutex, nullptr);
+	memset(_remote_subscribers, 0, sizeof(_remote_subscribers));
+}
+
+int uORB::ShmChannel::Start(const char *name)
+{
+	if (_process_index >= 0) {
+		return -EBUSY;
+	}
+
+	if (_header == nullptr) {
+		int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+
+		if (fd < 0) {
+			return -errno;
+		}
+
+		struct stat st;
+
+		if (fstat(fd, &st) != 0 || ((size_t)st.st_size < UORB_SHM_SEGMENT_SIZE && ftruncate(fd, UORB_SHM_SEGMENT_SIZE) != 0)) {
+			int ret = -errno;
+			close(fd);
+			return ret;
+		}
+
+		void *mem = mmap(nullptr, UORB_SHM_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (mem == MAP_FAILED) {
+			return -errno;
+		}
+
+		_header = (struct uorb_shm_header_s *)mem;
+
+		/* the first process initializes the (zero-filled) segment, the others wait for it */
+		uint32_t init_state = 0;
+
+		if (__atomic_compare_exchange_n(&_header->init_state, &init_state, 1, false, __ATOMIC_ACQUIRE,
+						__ATOMIC_ACQUIRE)) {
+			pthread_mutexattr_t attr;
+			pthread_mutexattr_init(&attr);
+			pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+			pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+			pthread_mutex_init(&_header->lock, &attr);
+			pthread_mutexattr_destroy(&attr);
+
+			_header->version = UORB_SHM_VERSION;
+			__atomic_store_n(&_header->magic, UORB_SHM_MAGIC, __ATOMIC_RELEASE);
+			__atomic_store_n(&_header->init_state, 2, __ATOMIC_RELEASE);
+
+		} else if (__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) != UORB_SHM_MAGIC) {
+			/* an older layout has no init_state: it is either being initialized now or is incompatible */
+			for (int i = 0; i < 1000 && __atomic_load_n(&_header->init_state, __ATOMIC_ACQUIRE) != 2; ++i) {
+				usleep(1000);
+			}
+		}
+
+		if (__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) != UORB_SHM_MAGIC
+		    || _header->version != UORB_SHM_VERSION) {
+			PX4_ERR("incompatible shared memory version %u (expected %u)", _header->version, UORB_SHM_VERSION);
+			munmap(_header, UORB_SHM_SEGMENT_SIZE);
+			_header = nullptr;
+			return -EPROTO;
+		}
+	}
+
+	/* register the process, reusing the slots of processes that do not exist anymore */
+	int process_index = -1;
+	header_lock();
+
+	for (int i = 0; i < UORB_SHM_MAX_PROCESSES; ++i) {
+		int32_t pid = _header->processes[i].pid;
+
+		if (pid == 0 || (kill(pid, 0) != 0 && errno == ESRCH)) {
+			process_index = i;
+			_header->processes[i].pid = getpid();
+			break;
+		}
+	}
+
+	if (process_index >= 0) {
+		/* drop the subscriptions of a previous user of the slot */
+		const uint32_t self = 1u << process_index;
+
+		for (uint32_t i = 0; i < _header->num_topics; ++i) {
+			__atomic_and_fetch(&_header->topics[i].subscribers, ~self, __ATOMIC_RELEASE);
+		}
+
+		__atomic_add_fetch(&_header->subscription_changes, 1, __ATOMIC_RELEASE);
+	}
+
+	header_unlock();
+
+	if (process_index < 0) {
+		PX4_ERR("no free process slot (max %i)", UORB_SHM_MAX_PROCESSES);
+		return -ENOSPC;
+	}
+
+	/* make sure the receive thread reports the existing subscriptions of the other processes */
+	memset(_remote_subscribers, 0, sizeof(_remote_subscribers));
+	_last_subscription_changes = __atomic_load_n(&_header->subscription_changes, __ATOMIC_ACQUIRE) - 1;
+	_ThreadShouldExit = false;
+	_process_index = process_index;
+
+	pthread_attr_t recv_thread_attr;
+	pthread_attr_init(&recv_thread_attr);
+
+	struct sched_param param;
+	(void)pthread_attr_getschedparam(&recv_thread_attr, &param);
+	param.sched_priority = SCHED_PRIORITY_MAX - 80;
+	(void)pthread_attr_setschedparam(&recv_thread_attr, &param);
+
+	pthread_attr_setstacksize(&recv_thread_attr, PX4_STACK_ADJUSTED(4096));
+
+	int ret = pthread_create(&_RecvThread, &recv_thread_attr, thread_start, (void *)this);
+	pthread_attr_destroy(&recv_thread_attr);
+
+	if (ret != 0) {
+		PX4_ERR("Error creating the receive thread for muorb_shm");
+		Stop();
+		return -ret;
+	}
+
+	pthread_setname_np(_RecvThread, "muorb_shm_recv");
+
+	/* topics that were subscribed before the channel was started */
+	if (uORB::Manager::get_instance() != nullptr) {
+		uORB::DeviceMaster *device_master = uORB::Manager::get_instance()->get_device_master(uORB::PUBSUB);
+
+		if (device_master != nullptr) {
+			device_master->announceSubscriptions(this);
+		}
+	}
+
+	return 0;
+}
+
+void uORB::ShmChannel::Stop()
+{
+	if (_process_index < 0) {
+		return;
+	}
+
+	struct uorb_shm_process_s *self_process = &_header->processes[_process_index];
+
+	if (_RecvThread != 0) {
+		_ThreadShouldExit = true;
+		wake_process(self_process);
+		pthread_join(_RecvThread, nullptr);
+		_RecvThread = 0;
+	}
+
+	/* unsubscribe and free the slot. The segment stays mapped, as publishers can still call send_message(). */
+	const uint32_t self = 1u << _process_index;
+	header_lock();
+
+	for (uint32_t i = 0; i < _header->num_topics; ++i) {
+		__atomic_and_fetch(&_header->topics[i].subscribers, ~self, __ATOMIC_RELEASE);
+	}
+
+	__atomic_add_fetch(&_header->subscription_changes, 1, __ATOMIC_RELEASE);
+	self_process->pid = 0;
+	header_unlock();
+
+	_process_index = -1;
+
+	for (int i = 0; i < UORB_SHM_MAX_PROCESSES; ++i) {
+		if (_header->processes[i].pid != 0) {
+			wake_process(&_header->processes[i]);
+		}
+	}
+
+	pthread_mutex_lock(&_mutex);
+
+	for (auto &it : _subscriptions) {
+		delete[] it.second.buffer;
+	}
+
+	_subscriptions.clear();
+	pthread_mutex_unlock(&_mutex);
+}
+
+void uORB::ShmChannel::header_lock()
+{
+	/* only held for short, non-blocking sections */
+	int ret = pthread_mutex_lock(&_header->lock);
+
+	if (ret == EOWNERDEAD) {
+		/* the owner died while holding the lock. Every update under the lock is done in an order that
+		 * keeps the header usable (at worst a topic slot or some data space is lost) */
+		PX4_WARN("recovered the shared memory lock from a dead process");
+		pthread_mutex_consistent(&_header->lock);
+
+	} else if (ret != 0) {
+		PX4_ERR("shared memory lock failed (%i)", ret);
+	}
+}
+
+void uORB::ShmChannel::header_unlock()
+{
+	pthread_mutex_unlock(&_header->lock);
+}
+
+int uORB::ShmChannel::find_topic(const char *messageName, bool add)
+{
+	uint32_t num_topics = __atomic_load_n(&_header->num_topics, __ATOMIC_ACQUIRE);
+
+	for (uint32_t i = 0; i < num_topics; ++i) {
+		if (strncmp(_header->topics[i].name, messageName, UORB_SHM_TOPIC_NAME_LEN) == 0) {
+			return i;
+		}
+	}
+
+	if (!add) {
+		return -1;
+	}
+
+	header_lock();
+
+	/* another process might have added it in the meantime */
+	for (uint32_t i = num_topics; i < _header->num_topics; ++i) {
+		if (strncmp(_header->topics[i].name, messageName, UORB_SHM_TOPIC_NAME_LEN) == 0) {
+			header_unlock();
+			return i;
+		}
+	}
+
+	int index = -1;
+
+	if (_header->num_topics < UORB_SHM_MAX_TOPICS) {
+		index = _header->num_topics;
+		strncpy(_header->topics[index].name, messageName, UORB_SHM_TOPIC_NAME_LEN - 1);
+		__atomic_store_n(&_header->num_topics, index + 1, __ATOMIC_RELEASE);
+
+	} else {
+		PX4_ERR("too many topics in shared memory");
+	}
+
+	header_unlock();
+	return index;
+}
+
+int uORB::ShmChannel::lookup_topic(const char *messageName)
+{
+	const uint32_t num_topics = __atomic_load_n(&_header->num_topics, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&_mutex);
+	auto it = _topic_cache.find(messageName);
+	int index;
+
+	/* a missing topic can only appear when topics are added */
+	if (it != _topic_cache.end() && (it->second.index >= 0 || it->second.num_topics == num_topics)) {
+		index = it->second.index;
+
+	} else {
+		index = find_topic(messageName, false);
+		CacheEntry &entry = _topic_cache[messageName];
+		entry.index = index;
+		entry.num_topics = num_topics;
+	}
+
+	pthread_mutex_unlock(&_mutex);
+	return index;
+}
+
+void uORB::ShmChannel::set_subscribed(int topic_index, bool subscribed)
+{
+	const uint32_t self = 1u << _process_index;
+
+	if (subscribed) {
+		__atomic_or_fetch(&_header->topics[topic_index].subscribers, self, __ATOMIC_RELEASE);
+
+	} else {
+		__atomic_and_fetch(&_header->topics[topic_index].subscribers, ~self, __ATOMIC_RELEASE);
+	}
+
+	__atomic_add_fetch(&_header->subscription_changes, 1, __ATOMIC_RELEASE);
+
+	/* let the other processes know, and our own receive thread (for data that is already there) */
+	for (int i = 0; i < UORB_SHM_MAX_PROCESSES; ++i) {
+		if (_header->processes[i].pid != 0) {
+			wake_process(&_header->processes[i]);
+		}
+	}
+}
+
+int16_t uORB::ShmChannel::add_subscription(const char *messageName, int32_t msgRateInHz)
+{
+	if (_process_index < 0) {
+		return -1;
+	}
+
+	int index = find_topic(messageName, true);
+
+	if (index < 0) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&_mutex);
+
+	if (_subscriptions.find(index) == _subscriptions.end()) {
+		LocalSubscription &subscription = _subscriptions[index];
+		subscription.last_seq = 0;
+		subscription.locked_seq = 0;
+		subscription.locked_since = 0;
+		subscription.buffer = nullptr;
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	set_subscribed(index, true);
+	return 0;
+}
+
+int16_t uORB::ShmChannel::remove_subscription(const char *messageName)
+{
+	if (_process_index < 0) {
+		return -1;
+	}
+
+	int index = find_topic(messageName, false);
+
+	if (index < 0) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&_mutex);
+	auto it = _subscriptions.find(index);
+
+	if (it != _subscriptions.end()) {
+		delete[] it->second.buffer;
+		_subscriptions.erase(it);
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	set_subscribed(index, false);
+	return 0;
+}
+
+int16_t uORB::ShmChannel::register_handler(uORBCommunicator::IChannelRxHandler *handler)
+{
+	_RxHandler = handler;
+	return 0;
+}
+
+int16_t uORB::ShmChannel::send_message(const char *messageName, int32_t length, uint8_t *data)
+{
+	if (_process_index < 0) {
+		return 0;
+	}
+
+	int index = lookup_topic(messageName);
+
+	if (index < 0) {
+		return 0; // no process subscribed to the topic yet
+	}
+
+	struct uorb_shm_topic_s *topic = &_header->topics[index];
+	const uint32_t subscribers = __atomic_load_n(&topic->subscribers, __ATOMIC_ACQUIRE) & ~(1u << _process_index);
+
+	if (subscribers == 0) {
+		return 0;
+	}
+
+	if (__atomic_load_n(&topic->size, __ATOMIC_ACQUIRE) == 0) {
+		/* first publication: allocate the data */
+		header_lock();
+
+		if (topic->size == 0) {
+			uint32_t offset = (_header->data_used + 7) & ~7;
+
+			if (offset + length > UORB_SHM_DATA_SIZE) {
+				header_unlock();
+				PX4_ERR("shared memory data area full, cannot add %s", messageName);
+				return -1;
+			}
+
+			topic->data_offset = UORB_SHM_DATA_OFFSET + offset;
+			_header->data_used = offset + length;
+			__atomic_store_n(&topic->size, length, __ATOMIC_RELEASE);
+		}
+
+		header_unlock();
+	}
+
+	if (topic->size != (uint32_t)length) {
+		return -1;
+	}
+
+	/* acquire the sequence lock, there can be publishers in multiple processes */
+	uint32_t seq = __atomic_load_n(&topic->seq, __ATOMIC_RELAXED);
+	uint32_t locked_seq = 0;
+	uint64_t locked_since = 0;
+
+	while ((seq & 1) || !__atomic_compare_exchange_n(&topic->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE,
+			__ATOMIC_RELAXED)) {
+		if (seq & 1) {
+			if (seq != locked_seq) {
+				locked_seq = seq;
+				locked_since = monotonic_time_us();
+			}
+
+			if (!recover_topic_lock(topic, seq, locked_since)) {
+				sched_yield();
+			}
+
+			seq = __atomic_load_n(&topic->seq, __ATOMIC_RELAXED);
+		}
+	}
+
+	__atomic_store_n(&topic->write_pid, (int32_t)getpid(), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(topic_data(topic), data, length);
+	topic->writer = _process_index;
+	__atomic_store_n(&topic->write_pid, 0, __ATOMIC_RELAXED);
+
+	/* this only fails if the lock was taken away from us (after UORB_SHM_SEQ_TIMEOUT_US) */
+	uint32_t locked = seq + 1;
+	__atomic_compare_exchange_n(&topic->seq, &locked, seq + 2, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+	for (int i = 0; i < UORB_SHM_MAX_PROCESSES; ++i) {
+		if (subscribers & (1u << i)) {
+			wake_process(&_header->processes[i]);
+		}
+	}
+
+	++_num_sent;
+	return 0;
+}
+
+void *uORB::ShmChannel::thread_start(void *handler)
+{
+	if (handler != nullptr) {
+		((uORB::ShmChannel *)handler)->recv_thread();
+	}
+
+	return 0;
+}
+
+void uORB::ShmChannel::recv_thread()
+{
+	uint32_t *wakeup = &_header->processes[_process_index].wakeup;
+
+	while (!_ThreadShouldExit) {
+		const uint32_t wakeup_count = __atomic_load_n(wakeup, __ATOMIC_ACQUIRE);
+		const uint32_t subscription_changes = __atomic_load_n(&_header->subscription_changes, __ATOMIC_ACQUIRE);
+
+		if (subscription_changes != _last_subscription_changes) {
+			_last_subscription_changes = subscription_changes;
+			check_remote_subscriptions();
+		}
+
+		const bool retry = receive_updates();
+
+		/* the timeout covers wakeups that get lost if another process dies while writing. Topics
+		 * that were being written are checked again after a short time */
+		struct timespec timeout = {0, (retry ? 1 : 100) * 1000 * 1000};
+		futex_wait(wakeup, wakeup_count, &timeout);
+	}
+}
+
+void uORB::ShmChannel::check_remote_subscriptions()
+{
+	if (_RxHandler == nullptr) {
+		return;
+	}
+
+	const uint32_t self = 1u << _process_index;
+	const uint32_t num_topics = __atomic_load_n(&_header->num_topics, __ATOMIC_ACQUIRE);
+
+	for (uint32_t i = 0; i < num_topics; ++i) {
+		const uint32_t subscribers = __atomic_load_n(&_header->topics[i].subscribers, __ATOMIC_ACQUIRE) & ~self;
+
+		/* this publishes the current data of the topic (if there is any) to the new subscriber */
+		if (subscribers != 0 && _remote_subscribers[i] == 0) {
+			_RxHandler->process_add_subscription(_header->topics[i].name, 1);
+
+		} else if (subscribers == 0 && _remote_subscribers[i] != 0) {
+			_RxHandler->process_remove_subscription(_header->topics[i].name);
+		}
+
+		_remote_subscribers[i] = subscribers;
+	}
+}
+
+bool uORB::ShmChannel::recover_topic_lock(struct uorb_shm_topic_s *topic, uint32_t seq, uint64_t locked_since)
+{
+	const int32_t pid = __atomic_load_n(&topic->write_pid, __ATOMIC_RELAXED);
+	const bool writer_died = pid != 0 && kill(pid, 0) != 0 && errno == ESRCH;
+
+	if (!writer_died && monotonic_time_us() - locked_since < UORB_SHM_SEQ_TIMEOUT_US) {
+		return false;
+	}
+
+	/* the data is torn: make sure it is not received */
+	topic->writer = UORB_SHM_MAX_PROCESSES;
+	topic->write_pid = 0;
+
+	if (__atomic_compare_exchange_n(&topic->seq, &seq, seq + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		PX4_WARN("released the lock of %s (writer %s)", topic->name, writer_died ? "died" : "timed out");
+	}
+
+	return true;
+}
+
+bool uORB::ShmChannel::receive_updates()
+{
+	bool retry = false;
+
+	pthread_mutex_lock(&_mutex);
+
+	for (auto &it : _subscriptions) {
+		struct uorb_shm_topic_s *topic = &_header->topics[it.first];
+		LocalSubscription &subscription = it.second;
+		const uint32_t size = __atomic_load_n(&topic->size, __ATOMIC_ACQUIRE);
+		uint32_t seq = __atomic_load_n(&topic->seq, __ATOMIC_ACQUIRE);
+
+		if (size == 0 || seq == 0 || seq == subscription.last_seq) {
+			continue;
+		}
+
+		if (subscription.buffer == nullptr) {
+			subscription.buffer = new uint8_t[size];
+		}
+
+		/* never wait for a writer here, _mutex blocks the local publishers */
+		uint32_t writer = UORB_SHM_MAX_PROCESSES;
+		bool copied = false;
+
+		for (int attempt = 0; attempt < 3 && !copied; ++attempt) {
+			seq = __atomic_load_n(&topic->seq, __ATOMIC_ACQUIRE);
+
+			if (seq & 1) {
+				if (seq != subscription.locked_seq) {
+					subscription.locked_seq = seq;
+					subscription.locked_since = monotonic_time_us();
+				}
+
+				recover_topic_lock(topic, seq, subscription.locked_since);
+				break;
+			}
+
+			memcpy(subscription.buffer, topic_data(topic), size);
+			writer = topic->writer;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			copied = __atomic_load_n(&topic->seq, __ATOMIC_RELAXED) == seq;
+		}
+
+		if (!copied) {
+			retry = true;
+			continue;
+		}
+
+		subscription.last_seq = seq;
+
+		/* our own publications are already in the local node, and invalid (torn) data is dropped */
+		if (writer != (uint32_t)_process_index && writer < UORB_SHM_MAX_PROCESSES && _RxHandler != nullptr) {
+			_RxHandler->process_received_message(topic->name, size, subscription.buffer);
+			++_num_received;
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	return retry;
+}
+
+void uORB::ShmChannel::print_status()
+{
+	if (_header == nullptr || _process_index < 0) {
+		PX4_INFO("not running");
+		return;
+	}
+
+	PX4_INFO("process slot %i, sent: %u, received: %u, data used: %u/%u bytes", _process_index, _num_sent,
+		 _num_received, _header->data_used, UORB_SHM_DATA_SIZE);
+
+	for (int i = 0; i < UORB_SHM_MAX_PROCESSES; ++i) {
+		if (_header->processes[i].pid != 0) {
+			PX4_INFO("process %i: pid %i%s", i, (int)_header->processes[i].pid, i == _process_index ? " (this)" : "");
+		}
+	}
+
+	const uint32_t num_topics = __atomic_load_n(&_header->num_topics, __ATOMIC_ACQUIRE);
+
+	for (uint32_t i = 0; i < num_topics; ++i) {
+		const struct uorb_shm_topic_s *topic = &_header->topics[i];
+		PX4_INFO("topic %s: size %u, subscribers 0x%02x, updates %u", topic->name, topic->size, topic->subscribers,
+			 topic->seq / 2);
+	}
+}
@@ -0,0 +1,223 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef _uORBShmChannel_hpp_
+#define _uORBShmChannel_hpp_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include "uORB/uORBCommunicator.hpp"
+#include "uORBShmLayout.h"
+
+namespace uORB
+{
+class ShmChannel;
+}
+
+/**
+ * IChannel implementation that exchanges topics with other processes on the same
+ * host through a POSIX shared memory segment (see uORBShmLayout.h).
+ *
+ * Publications are only copied into the segment if another process subscribed to
+ * the topic, and the subscribed processes are woken up through a futex. A receive
+ * thread copies updated topics out of the segment and publishes them locally.
+ */
+class uORB::ShmChannel : public uORBCommunicator::IChannel
+{
+public:
+	/**
+	 * static method to get the IChannel Implementor.
+	 */
+	static uORB::ShmChannel *GetInstance()
+	{
+		if (_InstancePtr == nullptr) {
+			_InstancePtr = new uORB::ShmChannel();
+		}
+
+		return _InstancePtr;
+	}
+
+	/**
+	 * Static method to check if there is an instance.
+	 */
+	static bool isInstance()
+	{
+		return (_InstancePtr != nullptr);
+	}
+
+	/**
+	 * @brief Interface to notify the remote entity of interest of a
+	 * subscription for a message.
+	 *
+	 * @param messageName
+	 * 	This represents the uORB message name; This message name should be
+	 * 	globally unique.
+	 * @param msgRate
+	 * 	The max rate at which the subscriber can accept the messages (ignored).
+	 * @return
+	 * 	0 = success; otherwise = failure.
+	 */
+	virtual int16_t add_subscription(const char *messageName, int32_t msgRateInHz);
+
+	/**
+	 * @brief Interface to notify the remote entity of removal of a subscription
+	 *
+	 * @param messageName
+	 * 	This represents the uORB message name; This message name should be
+	 * 	globally unique.
+	 * @return
+	 * 	0 = success; otherwise = failure.
+	 */
+	virtual int16_t remove_subscription(const char *messageName);
+
+	/**
+	 * Register Message Handler.  This is internal for the IChannel implementer*
+	 */
+	virtual int16_t register_handler(uORBCommunicator::IChannelRxHandler *handler);
+
+	/**
+	 * @brief Sends the data message over the communication link.
+	 * The data is only written to the shared memory if another process subscribed to it.
+	 * @param messageName
+	 * 	This represents the uORB message name; This message name should be
+	 * 	globally unique.
+	 * @param length
+	 * 	The length of the data buffer to be sent.
+	 * @param data
+	 * 	The actual data to be sent.
+	 * @return
+	 *  0 = success; otherwise = failure.
+	 */
+	virtual int16_t send_message(const char *messageName, int32_t length, uint8_t *data);
+
+	/**
+	 * Map the shared memory segment, register this process in it and start the receive thread.
+	 * @param name name of the shared memory object
+	 * @return 0 on success, -errno otherwise
+	 */
+	int Start(const char *name);
+	void Stop();
+
+	bool is_running() const { return _process_index >= 0; }
+
+	/**
+	 * Print the processes and topics in the segment.
+	 */
+	void print_status();
+
+private: // data members
+	static uORB::ShmChannel *_InstancePtr;
+	uORBCommunicator::IChannelRxHandler *_RxHandler;
+	pthread_t _RecvThread;
+	volatile bool _ThreadShouldExit;
+
+	struct uorb_shm_header_s *_header;
+	int _process_index; ///< index of this process in _header->processes
+
+	struct LocalSubscription {
+		uint32_t last_seq; ///< sequence count of the last received data
+		uint32_t locked_seq; ///< odd sequence count last seen (the topic was being written)
+		uint64_t locked_since; ///< when locked_seq was first seen [us]
+		uint8_t *buffer; ///< receive buffer (allocated once the topic size is known)
+	};
+
+	pthread_mutex_t _mutex; ///< protects _subscriptions and _topic_cache
+	std::map<int, LocalSubscription> _subscriptions; ///< topics subscribed by this process, by topic index
+
+	struct CacheEntry {
+		int index; ///< topic index, -1 if the topic does not exist
+		uint32_t num_topics; ///< _header->num_topics when a missing topic was looked up
+	};
+
+	std::map<const char *, CacheEntry> _topic_cache; ///< topics by name pointer (the names are the static orb metadata)
+
+	uint32_t _remote_subscribers[UORB_SHM_MAX_TOPICS]; ///< last seen subscribers of other processes, per topic
+	uint32_t _last_subscription_changes;
+
+	uint32_t _num_sent;
+	uint32_t _num_received;
+
+private://class members.
+	/// constructor.
+	ShmChannel();
+
+	static void *thread_start(void *handler);
+	void recv_thread();
+
+	void header_lock();
+	void header_unlock();
+
+	/**
+	 * Find a topic in the segment.
+	 * @param add add the topic if it does not exist
+	 * @return topic index or -1
+	 */
+	int find_topic(const char *messageName, bool add);
+
+	/**
+	 * Find a topic using the local cache.
+	 * @return topic index or -1
+	 */
+	int lookup_topic(const char *messageName);
+
+	/**
+	 * Set or clear the subscription bit of this process for a topic.
+	 */
+	void set_subscribed(int topic_index, bool subscribed);
+
+	/**
+	 * Notify the local handler about subscription changes of other processes.
+	 */
+	void check_remote_subscriptions();
+
+	/**
+	 * Copy updated topics out of the segment and publish them locally.
+	 * Topics that are being written are skipped.
+	 * @return true if a topic was skipped and should be checked again soon
+	 */
+	bool receive_updates();
+
+	/**
+	 * Release the sequence lock of a topic if its writer died or held it for longer than
+	 * UORB_SHM_SEQ_TIMEOUT_US.
+	 * @param seq the odd sequence count that was seen
+	 * @param locked_since when seq was first seen [us]
+	 * @return true if the lock is not held with seq anymore
+	 */
+	bool recover_topic_lock(struct uorb_shm_topic_s *topic, uint32_t seq, uint64_t locked_since);
+
+	uint8_t *topic_data(const struct uorb_shm_topic_s *topic) { return (uint8_t *)_header + topic->data_offset; }
+};
+
+#endif /* _uORBShmChannel_hpp_ */
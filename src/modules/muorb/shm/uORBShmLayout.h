@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file uORBShmLayout.h
+ * Layout of the POSIX shared memory segment used by uORB::ShmChannel.
+ *
+ * The segment consists of a uorb_shm_header_s followed by the topic data.
+ * Adding processes and topics and allocating data is protected by 'lock', a
+ * robust process-shared mutex, so that a process that dies while holding it
+ * does not block the others (the next owner gets EOWNERDEAD and continues: the
+ * protected updates leave the header consistent at every step).
+ * Processes other than px4 (e.g. an offboard planner or a logging daemon)
+ * can map the segment with shm_open()/mmap() and use this header to read or
+ * write topics directly:
+ * - each topic has one data slot, protected by a sequence lock (seq is odd
+ *   while the data is written; readers retry if seq changed while copying).
+ *   A writer sets 'write_pid' after acquiring the lock and clears it before
+ *   releasing it. If the writer dies (or the lock stays held for
+ *   UORB_SHM_SEQ_TIMEOUT_US), another process releases the lock and sets
+ *   'writer' to UORB_SHM_MAX_PROCESSES, so that the torn data is not received,
+ * - a process subscribes to a topic by setting its bit in 'subscribers' and
+ *   incrementing 'subscription_changes',
+ * - after writing a topic, the writer increments the 'wakeup' futex word of
+ *   every subscribed process and wakes it with FUTEX_WAKE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define UORB_SHM_DEFAULT_NAME		"/px4_uorb"
+#define UORB_SHM_MAGIC			0x4d42524f /* "ORBM" */
+#define UORB_SHM_VERSION		3
+#define UORB_SHM_MAX_PROCESSES		8
+#define UORB_SHM_MAX_TOPICS		256
+#define UORB_SHM_TOPIC_NAME_LEN		64
+#define UORB_SHM_DATA_SIZE		(1024 * 1024)
+#define UORB_SHM_SEQ_TIMEOUT_US		(1000 * 1000)
+
+struct uorb_shm_process_s {
+	int32_t pid;			/**< process using this slot, 0 if the slot is free */
+	uint32_t wakeup;		/**< futex word, incremented whenever a subscribed topic is written */
+};
+
+struct uorb_shm_topic_s {
+	char name[UORB_SHM_TOPIC_NAME_LEN]; /**< 0-terminated topic name (without instance) */
+	uint32_t size;			/**< topic size, 0 until the first publication allocated the data */
+	uint32_t data_offset;		/**< offset of the data from the start of the segment */
+	uint32_t seq;			/**< sequence lock: odd while the data is written, 0 if never written */
+	uint32_t writer;		/**< index of the process that wrote the data last, UORB_SHM_MAX_PROCESSES if invalid */
+	uint32_t subscribers;		/**< bitmask of the processes subscribed to the topic */
+	int32_t write_pid;		/**< process holding the sequence lock, 0 if none (or not known yet) */
+};
+
+struct uorb_shm_header_s {
+	uint32_t magic;			/**< UORB_SHM_MAGIC once the segment is initialized */
+	uint32_t version;		/**< UORB_SHM_VERSION */
+	uint32_t init_state;		/**< 0: zero-filled, 1: being initialized, 2: initialized */
+	pthread_mutex_t lock;		/**< robust, process-shared: for adding processes and topics and for allocating data */
+	uint32_t num_topics;		/**< number of valid entries in topics */
+	uint32_t data_used;		/**< bytes allocated in the data area */
+	uint32_t subscription_changes;	/**< incremented whenever a subscribers mask changes */
+	struct uorb_shm_process_s processes[UORB_SHM_MAX_PROCESSES];
+	struct uorb_shm_topic_s topics[UORB_SHM_MAX_TOPICS];
+};
+
+/** offset of the data area from the start of the segment */
+#define UORB_SHM_DATA_OFFSET		((sizeof(struct uorb_shm_header_s) + 63) & ~63)
+
+/** total size of the segment */
+#define UORB_SHM_SEGMENT_SIZE		(UORB_SHM_DATA_OFFSET + UORB_SHM_DATA_SIZE)
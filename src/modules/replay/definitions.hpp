@@ -39,6 +39,7 @@ namespace replay
 {
 
 static const char *ENV_FILENAME = "replay"; ///< name for getenv()
+static const char *const ENV_MODE = "replay_mode"; ///< name for getenv(), "ekf2" for lockstep replay (@see Replay)
 
 
 } //namespace replay
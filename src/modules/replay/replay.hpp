@@ -33,14 +33,18 @@
 
 #pragma once
 
-#include <fstream>
+#include <deque>
+#include <functional>
 #include <map>
+#include <queue>
 #include <vector>
 #include <set>
 #include <string>
+#include <utility>
 
 #include "definitions.hpp"
 
+#include <logger/messages.h>
 #include <uORB/uORBTopics.h>
 
 namespace px4
@@ -49,9 +53,20 @@ namespace px4
 /**
  * @class Replay
  * Parses an ULog file and replays it in 'real-time'. The timestamp of each replayed message is offset
- * to match the starting time of replay. It keeps a stream for each subscription to find the next message
- * to replay. This is necessary because data messages from different subscriptions don't need to be in
- * monotonic increasing order.
+ * to match the starting time of replay. The file is memory-mapped, and it keeps a file offset for each
+ * subscription to find the next message to replay. This is necessary because data messages from different
+ * subscriptions don't need to be in monotonic increasing order. The subscriptions are ordered by the
+ * timestamp of their next message in a min-heap.
+ *
+ * With the environment variable replay_mode=ekf2, it replays as fast as possible in lockstep with ekf2
+ * instead: the timestamps are not offset, and after each published sensor_combined sample it waits until
+ * ekf2 (started with --replay) and the logger (if started with -p replay_ack_ekf2) acknowledged it via
+ * replay_ack. Like this the estimator output only depends on the log, not on the timing of the replay.
+ * If a module does not acknowledge a sample within ACK_TIMEOUT_MS, the replay is aborted ("Replay aborted").
+ *
+ * The replay can be restricted to a time window and a subset of the topics (@see setFilter). If the file
+ * has a seek index, each subscription directly seeks to the start of the window, otherwise the samples
+ * before are skipped without publishing them. Parameter changes before the window are still applied.
  */
 class Replay
 {
@@ -80,16 +95,51 @@ public:
 	static void setupReplayFile(const char *file_name);
 
 	static bool isSetup() { return _replay_file; }
+
+	/**
+	 * Restrict the replay to a time window and/or a set of topics. Must be called before start().
+	 * @param window_start start of the window [us] (timestamps of the log), 0 to start at the beginning
+	 * @param window_end end of the window [us], UINT64_MAX to replay until the end
+	 * @param topics comma-separated list of topic names to replay, nullptr to replay all topics
+	 */
+	static void setFilter(uint64_t window_start, uint64_t window_end, const char *topics);
 private:
+	/**
+	 * Decompress a log file that was written with SDLOG_COMPRESS enabled.
+	 * @return true if the file was compressed and out_file_name got written
+	 */
+	static bool decompressFile(const char *file_name, const char *out_file_name);
+
+	/**
+	 * Map the replay file into memory (read-only).
+	 * @return true on success
+	 */
+	bool mapFile(const char *file_name);
+	void unmapFile();
+
+	/**
+	 * Get the message at a file offset.
+	 * @return nullptr if there is no complete message at pos (EOF or truncated file)
+	 */
+	const ulog_message_header_s *messageAt(uint64_t pos) const;
+
+	const uint8_t *_file_data = nullptr; ///< mapped replay file
+	uint64_t _file_size = 0;
+
 	bool _task_should_exit = false;
 	std::set<std::string> _overridden_params;
 	std::map<std::string, std::string> _file_formats; ///< all formats we read from the file
 
 	uint64_t _file_start_time;
 	uint64_t _replay_start_time;
-	std::streampos _data_section_start; ///< first ADD_LOGGED_MSG message
+	uint64_t _data_section_start; ///< first ADD_LOGGED_MSG message
 	std::vector<uint8_t> _read_buffer;
 
+	bool _lockstep = false; ///< replay_mode=ekf2
+	int _ack_ekf2_sub = -1;
+	int _ack_logger_sub = -1;
+	static constexpr int ACK_TIMEOUT_MS = 10000;
+
 	struct Subscription {
 
 		const orb_metadata *orb_meta = nullptr; ///< if nullptr, this subscription is invalid
@@ -97,53 +147,84 @@ private:
 		uint8_t multi_id;
 		int timestamp_offset; ///< marks the field of the timestamp
 
-		std::streampos next_read_pos;
+		uint64_t next_read_pos; ///< file offset
 		uint64_t next_timestamp; ///< timestamp of the file
+		std::vector<uint8_t> data; ///< sample at next_read_pos (o_size bytes, empty if invalid)
+		std::vector<uint16_t> delta_offsets; ///< field layout to apply DATA_DELTA messages (empty if unknown)
+	};
+	/** indexed by msg_id. A deque, because references to it must stay valid when new subscriptions are added */
+	std::deque<Subscription> _subscriptions;
+
+	/** timestamp and msg_id of the next message of each valid subscription, the earliest on top */
+	typedef std::pair<uint64_t, int> NextMessage;
+	std::priority_queue<NextMessage, std::vector<NextMessage>, std::greater<NextMessage>> _next_messages;
+
+	/** file positions of the ADD_LOGGED_MSG messages we read, to avoid adding a subscription multiple times. */
+	std::set<uint64_t> _added_subscriptions;
+
+	/** seek index of a msg_id (@see logger/ulog_index.h) */
+	struct Index {
+		uint64_t first_timestamp;
+		uint64_t last_timestamp;
+		std::vector<ulog_index_entry_s> entries;
 	};
-	std::vector<Subscription> _subscriptions;
+	std::map<uint16_t, Index> _index; ///< empty if the file has no index
 
-	/** keep track of file position to avoid adding a subscription multiple times. */
-	std::streampos _subscription_file_pos = 0;
+	/**
+	 * Read the seek index from the end of the file, if there is one.
+	 * @return true if the file has a valid index
+	 */
+	bool readIndex();
 
-	bool readFileHeader(std::ifstream &file);
+	bool readFileHeader();
 
 	/**
 	 * Read definitions section: check formats, apply parameters and store
 	 * the start of the data section.
 	 * @return true on success
 	 */
-	bool readFileDefinitions(std::ifstream &file);
+	bool readFileDefinitions();
 
 	///file parsing methods. They return false, when further parsing should be aborted.
-	bool readFormat(std::ifstream &file, uint16_t msg_size);
-	bool readAndAddSubscription(std::ifstream &file, uint16_t msg_size);
+	bool readFormat(const uint8_t *payload, uint16_t msg_size);
+
+	/**
+	 * Add a subscription for the ADD_LOGGED_MSG message at message_pos, read its first sample
+	 * and insert it into _next_messages.
+	 */
+	bool readAndAddSubscription(uint64_t message_pos);
 
 	/**
 	 * Read the file header and definitions sections. Apply the parameters from this section
 	 * and apply user-defined overridden parameters.
 	 * @return true on success
 	 */
-	bool readDefinitionsAndApplyParams(std::ifstream &file);
+	bool readDefinitionsAndApplyParams();
 
 	/**
-	 * Read and handle additional messages starting at current file position, while position < end_position.
+	 * Read and handle additional messages starting at file position pos, while position < end_position.
 	 * This handles dropout and parameter update messages.
 	 * We need to handle these separately, because they have no timestamp. We look at the file position instead.
-	 * @return false on file error
 	 */
-	bool readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position);
-	bool readDropout(std::ifstream &file, uint16_t msg_size);
-	bool readAndApplyParameter(std::ifstream &file, uint16_t msg_size);
+	void readAndHandleAdditionalMessages(uint64_t pos, uint64_t end_position);
+	void readDropout(const uint8_t *payload, uint16_t msg_size);
+	bool readAndApplyParameter(const uint8_t *message, uint16_t msg_size);
 
 	/**
 	 * Find next data message for this subscription, starting with the stored file offset.
-	 * Skip the first message, and if found, read the timestamp and store the new file offset.
-	 * This also takes care of new subscriptions and parameter updates. When reaching EOF,
-	 * the subscription is set to invalid.
-	 * File seek position is arbitrary after this call.
-	 * @return false on file error
+	 * Skip the first message, and if found, read the data (applying DATA_DELTA messages) and store
+	 * the new file offset.
+	 * This also takes care of new subscriptions. When reaching EOF, the subscription is set to invalid.
+	 * The caller is responsible for inserting the subscription into _next_messages again.
+	 * @param skip_first false if the message at the stored file offset has not been read yet
+	 */
+	void nextDataMessage(Subscription &subscription, int msg_id, bool skip_first = true);
+
+	/**
+	 * Read the payload of a DATA or DATA_DELTA message (after the msg id) into subscription.data.
+	 * @return true if subscription.data contains a valid sample
 	 */
-	bool nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id);
+	bool readData(Subscription &subscription, uint8_t msg_type, const uint8_t *payload, uint16_t data_size);
 
 	static const orb_metadata *findTopic(const std::string &name);
 	/** get the array size from a type. eg. float[3] -> return float */
@@ -155,7 +236,25 @@ private:
 
 	void setUserParams(const char *filename);
 
+	/**
+	 * Lockstep mode: wait until all modules acknowledged the published sensor_combined sample.
+	 * @param timestamp timestamp of the published sample
+	 * @return false if a module did not acknowledge: the output would depend on the timing, so the
+	 *         replay must be aborted
+	 */
+	bool waitForAcks(uint64_t timestamp);
+
+	/**
+	 * Wait for a new acknowledgement of a module for a sample with at least the given timestamp.
+	 * @return false on timeout (ACK_TIMEOUT_MS) or error
+	 */
+	bool waitForAck(const orb_metadata *meta, int sub, const char *module_name, uint64_t timestamp);
+
 	static char *_replay_file;
+
+	static uint64_t _window_start;
+	static uint64_t _window_end;
+	static std::set<std::string> _topic_filter; ///< empty: replay all topics
 };
 
 } //namespace px4
@@ -42,11 +42,15 @@
 
 #include <drivers/drv_hrt.h>
 #include <px4_defines.h>
+#include <px4_getopt.h>
 #include <px4_posix.h>
 #include <px4_tasks.h>
 #include <px4_time.h>
 
+#include <algorithm>
 #include <cstring>
+#include <errno.h>
+#include <fcntl.h>
 #include <float.h>
 #include <fstream>
 #include <iostream>
@@ -56,12 +60,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <logger/messages.h>
+#include <logger/ulog_compression.h>
+#include <logger/ulog_delta.h>
+
+#include <uORB/topics/replay_ack.h>
+#include <uORB/topics/sensor_combined.h>
 
 #include "replay.hpp"
 
 #define PARAMS_OVERRIDE_FILE PX4_ROOTFSDIR "/replay_params.txt"
+#define DECOMPRESSED_FILE PX4_ROOTFSDIR "/replay_decompressed.ulg"
 
 
 extern "C" __EXPORT int replay_main(int argc, char *argv[]);
@@ -81,6 +94,9 @@ static int	control_task = -1;			//task handle for task
 
 
 char *Replay::_replay_file = nullptr;
+uint64_t Replay::_window_start = 0;
+uint64_t Replay::_window_end = UINT64_MAX;
+std::set<std::string> Replay::_topic_filter;
 
 Replay::Replay()
 {
@@ -105,6 +121,8 @@ Replay::~Replay()
 			}
 		} while (replay::control_task != -1);
 	}
+
+	unmapFile();
 }
 
 void Replay::setupReplayFile(const char *file_name)
@@ -116,6 +134,104 @@ void Replay::setupReplayFile(const char *file_name)
 	_replay_file = strdup(file_name);
 }
 
+void Replay::setFilter(uint64_t window_start, uint64_t window_end, const char *topics)
+{
+	_window_start = window_start;
+	_window_end = window_end;
+	_topic_filter.clear();
+
+	if (!topics) {
+		return;
+	}
+
+	string topic_list(topics);
+	size_t start = 0;
+
+	while (start <= topic_list.size()) {
+		size_t end = topic_list.find(',', start);
+
+		if (end == string::npos) {
+			end = topic_list.size();
+		}
+
+		if (end > start) {
+			_topic_filter.insert(topic_list.substr(start, end - start));
+		}
+
+		start = end + 1;
+	}
+}
+
+bool Replay::decompressFile(const char *file_name, const char *out_file_name)
+{
+	ifstream file(file_name, ios::in | ios::binary);
+	ulog_file_header_s file_header;
+	ulog_message_compressed_header_s msg_header;
+
+	file.read((char *)&file_header, sizeof(file_header));
+	file.read((char *)&msg_header, sizeof(msg_header));
+
+	if (!file || msg_header.msg_type != (uint8_t)ULogMessageType::COMPRESSED) {
+		return false; // not compressed (or not a ULog file, which is reported later)
+	}
+
+	PX4_INFO("Decompressing log file to %s...", out_file_name);
+
+	ofstream out_file(out_file_name, ios::out | ios::binary | ios::trunc);
+
+	if (!out_file) {
+		PX4_ERR("Failed to open %s", out_file_name);
+		return false;
+	}
+
+	out_file.write((const char *)&file_header, sizeof(file_header));
+
+	// the previous block (the history for matches) followed by the current one
+	const int history_size = logger::ULogCompressor::BLOCK_SIZE;
+	vector<uint8_t> buffer(history_size + logger::ULogCompressor::BLOCK_SIZE);
+	vector<uint8_t> compressed;
+	int history_len = 0;
+	file.seekg(sizeof(file_header));
+
+	while (file.read((char *)&msg_header, sizeof(msg_header))) {
+		int compressed_size = msg_header.msg_size - (sizeof(msg_header) - ULOG_MSG_HEADER_LEN);
+
+		if (msg_header.msg_type != (uint8_t)ULogMessageType::COMPRESSED || compressed_size < 0) {
+			PX4_WARN("Unexpected message in compressed file. Broken file?");
+			break;
+		}
+
+		compressed.resize(compressed_size);
+		file.read((char *)compressed.data(), compressed_size);
+
+		if (!file) {
+			break; // truncated file, e.g. after a power loss
+		}
+
+		int ret = logger::ulog_decompress_block(compressed.data(), compressed_size, buffer.data() + history_len,
+							logger::ULogCompressor::BLOCK_SIZE, history_len);
+
+		if (ret != msg_header.uncompressed_size) {
+			PX4_WARN("Invalid compressed block. Broken file?");
+			break;
+		}
+
+		out_file.write((const char *)buffer.data() + history_len, ret);
+
+		// keep the last history_size bytes for the next block
+		int total = history_len + ret;
+		history_len = total < history_size ? total : history_size;
+		memmove(buffer.data(), buffer.data() + total - history_len, history_len);
+	}
+
+	if (!out_file) {
+		PX4_ERR("Failed to write %s", out_file_name);
+		return false;
+	}
+
+	return true;
+}
+
 
 
 void Replay::setUserParams(const char *filename)
@@ -159,16 +275,66 @@ void Replay::setUserParams(const char *filename)
 	}
 }
 
-bool Replay::readFileHeader(std::ifstream &file)
+bool Replay::mapFile(const char *file_name)
+{
+	int fd = ::open(file_name, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat file_stat;
+	void *data = MAP_FAILED;
+
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+		data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	::close(fd); //the mapping stays valid
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	_file_data = (const uint8_t *)data;
+	_file_size = file_stat.st_size;
+	return true;
+}
+
+void Replay::unmapFile()
+{
+	if (_file_data) {
+		munmap((void *)_file_data, _file_size);
+		_file_data = nullptr;
+		_file_size = 0;
+	}
+}
+
+const ulog_message_header_s *Replay::messageAt(uint64_t pos) const
+{
+	if (pos + ULOG_MSG_HEADER_LEN > _file_size) {
+		return nullptr;
+	}
+
+	const ulog_message_header_s *header = (const ulog_message_header_s *)(_file_data + pos);
+
+	if (pos + ULOG_MSG_HEADER_LEN + header->msg_size > _file_size) {
+		return nullptr; //truncated, e.g. after a power loss
+	}
+
+	return header;
+}
+
+bool Replay::readFileHeader()
 {
-	file.seekg(0);
 	ulog_file_header_s msg_header;
-	file.read((char *)&msg_header, sizeof(msg_header));
 
-	if (!file) {
+	if (_file_size < sizeof(msg_header)) {
 		return false;
 	}
 
+	memcpy(&msg_header, _file_data, sizeof(msg_header));
+
 	_file_start_time = msg_header.timestamp;
 	//verify it's an ULog file
 	char magic[8];
@@ -182,66 +348,58 @@ bool Replay::readFileHeader(std::ifstream &file)
 	return memcmp(magic, msg_header.magic, 7) == 0;
 }
 
-bool Replay::readFileDefinitions(std::ifstream &file)
+bool Replay::readFileDefinitions()
 {
 	PX4_INFO("Applying params from ULog file...");
 
-	ulog_message_header_s message_header;
-	file.seekg(sizeof(ulog_file_header_s));
+	uint64_t pos = sizeof(ulog_file_header_s);
 
 	while (true) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+		const ulog_message_header_s *message_header = messageAt(pos);
 
-		if (!file) {
+		if (!message_header) {
 			return false;
 		}
 
-		switch (message_header.msg_type) {
+		const uint8_t *payload = _file_data + pos + ULOG_MSG_HEADER_LEN;
+
+		switch (message_header->msg_type) {
 		case (int)ULogMessageType::FORMAT:
-			if (!readFormat(file, message_header.msg_size)) {
+			if (!readFormat(payload, message_header->msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
+			if (!readAndApplyParameter(payload, message_header->msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			_data_section_start = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
+			_data_section_start = pos;
 			return true;
 
 		case (int)ULogMessageType::INFO: //skip
-			file.seekg(message_header.msg_size, ios::cur);
 			break;
 
 		default:
 			PX4_ERR("unknown log definition type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
+				(int)message_header->msg_type, (int)message_header->msg_size, (int)pos);
 			break;
 		}
+
+		pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
 	}
 
 	return true;
 }
 
-bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
+bool Replay::readFormat(const uint8_t *payload, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *format = (char *)_read_buffer.data();
-	file.read(format, msg_size);
-	format[msg_size] = 0;
-
-	if (!file) {
-		return false;
-	}
-
-	string str_format(format);
+	string str_format((const char *)payload, msg_size);
 	size_t pos = str_format.find(':');
 
 	if (pos == string::npos) {
@@ -255,27 +413,27 @@ bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
+bool Replay::readAndAddSubscription(uint64_t message_pos)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *message = (char *)_read_buffer.data();
-	streampos this_message_pos = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
-	file.read(message, msg_size);
-	message[msg_size] = 0;
+	const ulog_message_header_s *message_header = messageAt(message_pos);
 
-	if (!file) {
+	if (!message_header || message_header->msg_size < 3) {
 		return false;
 	}
 
-	if (file.tellg() <= _subscription_file_pos) { //already read this subscription
+	if (!_added_subscriptions.insert(message_pos).second) { //already read this subscription
 		return true;
 	}
 
-	_subscription_file_pos = file.tellg();
-
-	uint8_t multi_id = *(uint8_t *)message;
+	const uint8_t *message = _file_data + message_pos + ULOG_MSG_HEADER_LEN;
+	uint8_t multi_id = message[0];
 	uint16_t msg_id = ((uint16_t) message[1]) | (((uint16_t) message[2]) << 8);
-	string topic_name(message + 3);
+	string topic_name((const char *)message + 3, message_header->msg_size - 3);
+
+	if (!_topic_filter.empty() && _topic_filter.find(topic_name) == _topic_filter.end()) {
+		return true; //not selected for replay
+	}
+
 	const orb_metadata *orb_meta = findTopic(topic_name);
 
 	if (!orb_meta) {
@@ -297,6 +455,16 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 	subscription.orb_meta = orb_meta;
 	subscription.multi_id = multi_id;
 
+	//field layout, in case the file contains DATA_DELTA messages
+	int num_fields = logger::ulog_delta_field_offsets(file_format.c_str(), orb_meta->o_size_no_padding, nullptr,
+			 INT16_MAX);
+
+	if (num_fields > 0) {
+		subscription.delta_offsets.resize(num_fields + 1);
+		logger::ulog_delta_field_offsets(file_format.c_str(), orb_meta->o_size_no_padding,
+						 subscription.delta_offsets.data(), num_fields);
+	}
+
 
 	//find the timestamp offset (not necessarily the first field)
 	string fields = orb_meta->o_fields;
@@ -336,14 +504,34 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 
 
 	//find first data message (and the timestamp)
-	streampos cur_pos = file.tellg();
-	subscription.next_read_pos = this_message_pos; //this will be skipped
-
-	if (!nextDataMessage(file, subscription, msg_id)) {
-		return false;
+	subscription.next_read_pos = message_pos; //this will be skipped
+	bool skip_first = true;
+	auto index = _index.find(msg_id);
+
+	if (index != _index.end() && !index->second.entries.empty()) {
+		const vector<ulog_index_entry_s> &entries = index->second.entries;
+		//last indexed message at or before the start of the replay window
+		auto entry = upper_bound(entries.begin(), entries.end(), _window_start,
+		[](uint64_t timestamp, const ulog_index_entry_s & e) { return timestamp < e.timestamp; });
+
+		if (entry != entries.begin()) {
+			--entry;
+			subscription.next_read_pos = entry->offset;
+			skip_first = false;
+
+		} else if (entries[0].timestamp == index->second.first_timestamp) {
+			//the index points directly to the first data message
+			subscription.next_read_pos = entries[0].offset;
+			skip_first = false;
+		}
 	}
 
-	file.seekg(cur_pos);
+	nextDataMessage(subscription, msg_id, skip_first);
+
+	//skip the samples before the replay window
+	while (subscription.orb_meta && subscription.next_timestamp < _window_start) {
+		nextDataMessage(subscription, msg_id);
+	}
 
 	if (!subscription.orb_meta) {
 		//no message found. This is not a fatal error
@@ -358,54 +546,47 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 	}
 
 	_subscriptions[msg_id] = subscription;
+	_next_messages.push(NextMessage(subscription.next_timestamp, msg_id));
 
 	return true;
 }
 
-bool Replay::readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position)
+void Replay::readAndHandleAdditionalMessages(uint64_t pos, uint64_t end_position)
 {
-	ulog_message_header_s message_header;
+	while (pos < end_position) {
+		const ulog_message_header_s *message_header = messageAt(pos);
 
-	while (file.tellg() < end_position) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
-
-		if (!file) {
-			return false;
+		if (!message_header) {
+			return;
 		}
 
-		switch (message_header.msg_type) {
-		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
-				return false;
-			}
+		const uint8_t *payload = _file_data + pos + ULOG_MSG_HEADER_LEN;
 
+		switch (message_header->msg_type) {
+		case (int)ULogMessageType::PARAMETER:
+			readAndApplyParameter(payload, message_header->msg_size);
 			break;
 
 		case (int)ULogMessageType::DROPOUT:
-			readDropout(file, message_header.msg_size);
+			readDropout(payload, message_header->msg_size);
 			break;
 
 		default: //skip all others
-			file.seekg(message_header.msg_size, ios::cur);
 			break;
 		}
-	}
 
-	return true;
+		pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
+	}
 }
 
-bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
+bool Replay::readAndApplyParameter(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size);
-	uint8_t *message = (uint8_t *)_read_buffer.data();
-	file.read((char *)message, msg_size);
-
-	if (!file) {
+	if (msg_size < 1 || message[0] + 1 > msg_size) {
 		return false;
 	}
 
 	uint8_t key_len = message[0];
-	string key((char *)message + 1, key_len);
+	string key((const char *)message + 1, key_len);
 
 	size_t pos = key.find(' ');
 
@@ -426,74 +607,133 @@ bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
 		return true;
 	}
 
+	if (msg_size < 1 + key_len + 4) {
+		return false;
+	}
+
 	param_t handle = param_find(param_name.c_str());
 
 	if (handle != PARAM_INVALID) {
-		param_set(handle, (const void *)(message + 1 + key_len));
+		//both int32_t and float are 4 bytes: copy the value, it is not necessarily aligned
+		uint32_t value;
+		memcpy(&value, message + 1 + key_len, sizeof(value));
+		param_set(handle, (const void *)&value);
 	}
 
 	return true;
 }
 
-bool Replay::readDropout(std::ifstream &file, uint16_t msg_size)
+bool Replay::readIndex()
 {
-	uint16_t duration;
-	file.read((char *)&duration, sizeof(duration));
+	ulog_message_index_end_s index_end;
 
-	PX4_INFO("Dropout in replayed log, %i ms", (int)duration);
-	return file.good();
+	if (_file_size < sizeof(ulog_file_header_s) + sizeof(index_end)) {
+		return false;
+	}
+
+	const uint64_t index_end_pos = _file_size - sizeof(index_end);
+	memcpy(&index_end, _file_data + index_end_pos, sizeof(index_end));
+
+	if (index_end.msg_type != (uint8_t)ULogMessageType::INDEX_END ||
+	    index_end.msg_size != sizeof(index_end) - ULOG_MSG_HEADER_LEN ||
+	    memcmp(index_end.magic, ULOG_INDEX_MAGIC, sizeof(index_end.magic)) != 0 ||
+	    index_end.index_offset >= index_end_pos) {
+		return false;
+	}
+
+	uint64_t pos = index_end.index_offset;
+
+	while (pos < index_end_pos) {
+		ulog_message_index_header_s header;
+
+		if (pos + sizeof(header) > index_end_pos) {
+			break;
+		}
+
+		memcpy(&header, _file_data + pos, sizeof(header));
+		const int entries_size = (int)header.msg_size - (int)(sizeof(header) - ULOG_MSG_HEADER_LEN);
+
+		if (header.msg_type != (uint8_t)ULogMessageType::INDEX || entries_size < 0 ||
+		    entries_size % sizeof(ulog_index_entry_s) != 0 || pos + sizeof(header) + entries_size > index_end_pos) {
+			break;
+		}
+
+		Index &index = _index[header.msg_id];
+		index.first_timestamp = header.first_timestamp;
+		index.last_timestamp = header.last_timestamp;
+		const size_t num_entries = index.entries.size();
+		index.entries.resize(num_entries + entries_size / sizeof(ulog_index_entry_s));
+		memcpy(index.entries.data() + num_entries, _file_data + pos + sizeof(header), entries_size);
+		pos += sizeof(header) + entries_size;
+	}
+
+	if (pos != index_end_pos) {
+		PX4_WARN("Invalid seek index. Ignoring it");
+		_index.clear();
+		return false;
+	}
+
+	PX4_INFO("Using seek index (%zu topics, interval %u ms)", _index.size(), (unsigned)index_end.interval);
+	return true;
 }
 
-bool Replay::nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id)
+void Replay::readDropout(const uint8_t *payload, uint16_t msg_size)
 {
-	ulog_message_header_s message_header;
-	file.seekg(subscription.next_read_pos);
-	//ignore the first message (it's data we already read)
-	file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	uint16_t duration = 0;
 
-	if (file) {
-		file.seekg(message_header.msg_size, ios::cur);
+	if (msg_size >= sizeof(duration)) {
+		memcpy(&duration, payload, sizeof(duration));
 	}
 
-	uint16_t file_msg_id;
-	bool done = false;
+	PX4_INFO("Dropout in replayed log, %i ms", (int)duration);
+}
+
+void Replay::nextDataMessage(Subscription &subscription, int msg_id, bool skip_first)
+{
+	uint64_t pos = subscription.next_read_pos;
+	const ulog_message_header_s *message_header;
 
-	while (file && !done) {
-		streampos cur_pos = file.tellg();
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	if (skip_first) {
+		//ignore the first message (it's data we already read)
+		message_header = messageAt(pos);
 
-		if (!file) {
-			break;
+		if (message_header) {
+			pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
 		}
+	}
 
-		switch (message_header.msg_type) {
+	while ((message_header = messageAt(pos)) != nullptr) {
+		const uint64_t cur_pos = pos;
+		const uint8_t *payload = _file_data + pos + ULOG_MSG_HEADER_LEN;
+		pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
+
+		switch (message_header->msg_type) {
 		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			readAndAddSubscription(file, message_header.msg_size);
+			readAndAddSubscription(cur_pos);
 			break;
 
 		case (int)ULogMessageType::DATA:
-			file.read((char *)&file_msg_id, sizeof(file_msg_id));
+		case (int)ULogMessageType::DATA_DELTA: {
+				uint16_t file_msg_id;
+
+				if (message_header->msg_size < sizeof(file_msg_id)) {
+					break;
+				}
+
+				memcpy(&file_msg_id, payload, sizeof(file_msg_id));
 
-			if (file) {
 				if (msg_id == file_msg_id) {
-					if (message_header.msg_size == subscription.orb_meta->o_size_no_padding + 2) {
+					const uint16_t data_size = message_header->msg_size - sizeof(file_msg_id);
+
+					if (readData(subscription, message_header->msg_type, payload + sizeof(file_msg_id), data_size)) {
 						subscription.next_read_pos = cur_pos;
-						file.seekg(subscription.timestamp_offset, ios::cur);
-						file.read((char *)&subscription.next_timestamp, sizeof(subscription.next_timestamp));
-						done = true;
-
-					} else { //sanity check failed!
-						PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
-							subscription.orb_meta->o_name, message_header.msg_size,
-							subscription.orb_meta->o_size_no_padding + 2);
-						file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
+						const uint8_t *data = subscription.data.data();
+						memcpy(&subscription.next_timestamp, data + subscription.timestamp_offset,
+						       sizeof(subscription.next_timestamp));
+						return;
 					}
-
-				} else { //not the one we are looking for
-					file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
 				}
 			}
-
 			break;
 
 		case (int)ULogMessageType::REMOVE_LOGGED_MSG: //skip these
@@ -501,24 +741,50 @@ bool Replay::nextDataMessage(std::ifstream &file, Subscription &subscription, in
 		case (int)ULogMessageType::DROPOUT:
 		case (int)ULogMessageType::SYNC:
 		case (int)ULogMessageType::LOGGING:
-			file.seekg(message_header.msg_size, ios::cur);
+		case (int)ULogMessageType::INDEX:
+		case (int)ULogMessageType::INDEX_END:
 			break;
 
 		default:
 			//this really should not happen
 			PX4_ERR("unknown log message type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
+				(int)message_header->msg_type, (int)message_header->msg_size, (int)cur_pos);
 			break;
 		}
 	}
 
-	if (file.eof()) { //no more data messages for this subscription
-		subscription.orb_meta = nullptr;
-		file.clear();
+	//no more data messages for this subscription
+	subscription.orb_meta = nullptr;
+}
+
+bool Replay::readData(Subscription &subscription, uint8_t msg_type, const uint8_t *payload, uint16_t data_size)
+{
+	const size_t size = subscription.orb_meta->o_size_no_padding;
+
+	if (msg_type == (uint8_t)ULogMessageType::DATA) {
+		if (data_size != size) { //sanity check failed!
+			PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
+				subscription.orb_meta->o_name, data_size + 2, (int)size + 2);
+			subscription.data.clear();
+			return false;
+		}
+
+		subscription.data.resize(subscription.orb_meta->o_size);
+		memcpy(subscription.data.data(), payload, size);
+		return true;
+	}
+
+	//DATA_DELTA: apply the changed fields to the previous sample
+	if (subscription.data.empty() || subscription.delta_offsets.empty() ||
+	    !logger::ulog_delta_decode(payload, data_size, subscription.delta_offsets.data(),
+				       subscription.delta_offsets.size() - 1, subscription.data.data())) {
+		//skip everything up to the next full sample
+		PX4_ERR("cannot decode delta message of %s. Skipping", subscription.orb_meta->o_name);
+		subscription.data.clear();
+		return false;
 	}
 
-	return file.good();
+	return true;
 }
 
 const orb_metadata *Replay::findTopic(const std::string &name)
@@ -588,7 +854,59 @@ size_t Replay::sizeOfFullType(const std::string &type_name_full)
 	return sizeOfType(type_name) * array_size;
 }
 
-bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
+bool Replay::waitForAcks(uint64_t timestamp)
+{
+	if (!waitForAck(ORB_ID(replay_ack_ekf2), _ack_ekf2_sub, "ekf2", timestamp)) {
+		return false;
+	}
+
+	//the logger only acknowledges if it runs in poll mode, and it might not be running yet when we start
+	if (_ack_logger_sub < 0 && orb_exists(ORB_ID(replay_ack_logger), 0) == PX4_OK) {
+		_ack_logger_sub = orb_subscribe(ORB_ID(replay_ack_logger));
+		PX4_INFO("Lockstep replay with logger");
+	}
+
+	//the logger polls on the ekf2 ack, so it is always the last one
+	return _ack_logger_sub < 0 || waitForAck(ORB_ID(replay_ack_logger), _ack_logger_sub, "logger", timestamp);
+}
+
+bool Replay::waitForAck(const orb_metadata *meta, int sub, const char *module_name, uint64_t timestamp)
+{
+	replay_ack_s ack;
+	px4_pollfd_struct_t fds[1];
+	fds[0].fd = sub;
+	fds[0].events = POLLIN;
+
+	while (!_task_should_exit) {
+		bool updated = false;
+		orb_check(sub, &updated);
+
+		if (updated) {
+			orb_copy(meta, sub, &ack);
+
+			if (ack.timestamp >= timestamp) {
+				return true;
+			}
+
+		} else {
+			int ret = px4_poll(fds, 1, ACK_TIMEOUT_MS);
+
+			if (ret == 0) {
+				PX4_ERR("%s did not acknowledge the sample at %.3lf s within %i ms", module_name,
+					(double)timestamp / 1.e6, ACK_TIMEOUT_MS);
+				return false;
+
+			} else if (ret < 0 && errno != EINTR) {
+				PX4_ERR("poll failed (%i)", errno);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool Replay::readDefinitionsAndApplyParams()
 {
 	// log reader currently assumes little endian
 	int num = 1;
@@ -598,18 +916,18 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 		return false;
 	}
 
-	if (!file.is_open()) {
+	if (!_file_data && !mapFile(_replay_file)) {
 		PX4_ERR("Failed to open replay file");
 		return false;
 	}
 
-	if (!readFileHeader(file)) {
+	if (!readFileHeader()) {
 		PX4_ERR("Failed to read file header. Not a valid ULog file");
 		return false;
 	}
 
 	//initialize the formats and apply the parameters from the log file
-	if (!readFileDefinitions(file)) {
+	if (!readFileDefinitions()) {
 		PX4_ERR("Failed to read ULog definitions section. Broken file?");
 		return false;
 	}
@@ -620,69 +938,119 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 
 void Replay::task_main()
 {
-	ifstream replay_file(_replay_file, ios::in | ios::binary);
-
-	if (!readDefinitionsAndApplyParams(replay_file)) {
+	if (!readDefinitionsAndApplyParams()) {
 		return;
 	}
 
 	_replay_start_time = hrt_absolute_time();
 
+	const char *replay_mode = getenv(replay::ENV_MODE);
+	_lockstep = replay_mode && strcmp(replay_mode, "ekf2") == 0;
+
+	if (_lockstep) {
+		_ack_ekf2_sub = orb_subscribe(ORB_ID(replay_ack_ekf2));
+		PX4_INFO("Lockstep replay with ekf2");
+	}
+
 	PX4_INFO("Replay in progress...");
 
-	ulog_message_header_s message_header;
-	replay_file.seekg(_data_section_start);
+	readIndex();
 
-	//we know the next message must be an ADD_LOGGED_MSG
-	replay_file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	//we know the next message must be an ADD_LOGGED_MSG. Read all of them up to the first data message:
+	//with the index, a new subscription does not scan the file up to its first data message, which would
+	//find the others.
+	uint64_t pos = _data_section_start;
+	const ulog_message_header_s *message_header;
 
-	if (!readAndAddSubscription(replay_file, message_header.msg_size)) {
-		PX4_ERR("Failed to read subscription");
-		return;
+	while ((message_header = messageAt(pos)) != nullptr) {
+		if (message_header->msg_type == (uint8_t)ULogMessageType::ADD_LOGGED_MSG) {
+			if (!readAndAddSubscription(pos)) {
+				PX4_ERR("Failed to read subscription");
+				return;
+			}
+
+		} else if (message_header->msg_type == (uint8_t)ULogMessageType::DATA ||
+			   message_header->msg_type == (uint8_t)ULogMessageType::DATA_DELTA) {
+			break;
+		}
+
+		pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
+	}
+
+	if (!_index.empty() && _window_start > 0) {
+		//the subscriptions jumped to the replay window, so they did not see the topics that were added
+		//before it. Find them without reading the data.
+		uint64_t window_pos = _file_size;
+
+		for (const auto &subscription : _subscriptions) {
+			if (subscription.orb_meta && subscription.next_read_pos < window_pos) {
+				window_pos = subscription.next_read_pos;
+			}
+		}
+
+		while (pos < window_pos && (message_header = messageAt(pos)) != nullptr) {
+			if (message_header->msg_type == (uint8_t)ULogMessageType::ADD_LOGGED_MSG) {
+				readAndAddSubscription(pos);
+			}
+
+			pos += ULOG_MSG_HEADER_LEN + message_header->msg_size;
+		}
+	}
+
+	if (_window_end != UINT64_MAX) {
+		PX4_INFO("Replaying from %.3lf s to %.3lf s", (double)_window_start / 1.e6, (double)_window_end / 1.e6);
+
+	} else if (_window_start > 0) {
+		PX4_INFO("Replaying from %.3lf s", (double)_window_start / 1.e6);
+	}
+
+	if (!_topic_filter.empty()) {
+		PX4_INFO("Replaying %zu topic instances (%zu topics selected)", _next_messages.size(), _topic_filter.size());
 	}
 
 
 	//we update the timestamps from the file by a constant offset to match
-	//the current replay time
-	const uint64_t timestamp_offset = _replay_start_time - _file_start_time;
+	//the current replay time (in lockstep mode, the file time is used as-is)
+	const uint64_t first_file_time = _window_start > _file_start_time ? _window_start : _file_start_time;
+	const uint64_t timestamp_offset = _lockstep ? 0 : _replay_start_time - first_file_time;
 	uint32_t nr_published_messages = 0;
-	streampos last_additional_message_pos = _data_section_start;
+	bool aborted = false;
+	uint64_t last_additional_message_pos = _data_section_start;
 
-	while (!_task_should_exit && replay_file) {
+	while (!_task_should_exit && !_next_messages.empty()) {
 
 		//Find the next message to publish. Messages from different subscriptions don't need
-		//to be in chronological order, so we need to check all subscriptions
-		uint64_t next_file_time = 0;
-		int next_msg_id = -1;
-
-		for (size_t i = 0; i < _subscriptions.size(); ++i) {
-			const Subscription &subscription = _subscriptions[i];
+		//to be in chronological order, so the subscriptions are ordered by their next timestamp
+		const uint64_t next_file_time = _next_messages.top().first;
+		const int next_msg_id = _next_messages.top().second;
 
-			if (subscription.orb_meta) {
-				if (next_file_time == 0 || subscription.next_timestamp < next_file_time) {
-					next_msg_id = (int)i;
-					next_file_time = subscription.next_timestamp;
-				}
-			}
+		if (next_file_time > _window_end) {
+			break; //all the remaining messages are after the replay window
 		}
 
-		if (next_msg_id == -1) {
-			break; //no active subscription anymore. We're done.
-		}
+		_next_messages.pop();
 
 		Subscription &sub = _subscriptions[next_msg_id];
 
+		if (!sub.orb_meta) {
+			continue;
+		}
+
 		if (next_file_time == 0) {
 			//someone didn't set the timestamp properly. Consider the message invalid
-			nextDataMessage(replay_file, sub, next_msg_id);
+			nextDataMessage(sub, next_msg_id);
+
+			if (sub.orb_meta) {
+				_next_messages.push(NextMessage(sub.next_timestamp, next_msg_id));
+			}
+
 			continue;
 		}
 
 
 		//handle additional messages between last and next published data
-		replay_file.seekg(last_additional_message_pos);
-		streampos next_additional_message_pos = sub.next_read_pos;
-		readAndHandleAdditionalMessages(replay_file, next_additional_message_pos);
+		const uint64_t next_additional_message_pos = sub.next_read_pos;
+		readAndHandleAdditionalMessages(last_additional_message_pos, next_additional_message_pos);
 		last_additional_message_pos = next_additional_message_pos;
 
 
@@ -690,16 +1058,15 @@ void Replay::task_main()
 		const uint64_t publish_timestamp = next_file_time + timestamp_offset;
 		uint64_t cur_time = hrt_absolute_time();
 
-		if (cur_time < publish_timestamp) {
+		if (!_lockstep && cur_time < publish_timestamp) {
 			usleep(publish_timestamp - cur_time);
 		}
 
 		//It's time to publish
-		const size_t msg_read_size = sub.orb_meta->o_size_no_padding;
 		const size_t msg_write_size = sub.orb_meta->o_size;
-		_read_buffer.reserve(msg_write_size);
-		replay_file.seekg(sub.next_read_pos + (streamoff)(ULOG_MSG_HEADER_LEN + 2)); //skip header & msg id
-		replay_file.read((char *)_read_buffer.data(), msg_read_size);
+		//sub.data keeps the logged timestamp: it is the base for the next DATA_DELTA message
+		_read_buffer.resize(msg_write_size);
+		memcpy(_read_buffer.data(), sub.data.data(), msg_write_size);
 		*(uint64_t *)(_read_buffer.data() + sub.timestamp_offset) = publish_timestamp;
 
 		if (sub.orb_advert) {
@@ -734,7 +1101,19 @@ void Replay::task_main()
 		}
 
 
-		nextDataMessage(replay_file, _subscriptions[next_msg_id], next_msg_id);
+		//ekf2 runs on sensor_combined: let it (and the logger) process the sample before publishing the next one
+		if (_lockstep && sub.orb_advert && sub.multi_id == 0 && sub.orb_meta == ORB_ID(sensor_combined)) {
+			if (!waitForAcks(publish_timestamp)) {
+				aborted = true;
+				break;
+			}
+		}
+
+		nextDataMessage(sub, next_msg_id);
+
+		if (sub.orb_meta) {
+			_next_messages.push(NextMessage(sub.next_timestamp, next_msg_id));
+		}
 
 		//TODO: output status (eg. every sec), including total duration...
 	}
@@ -746,7 +1125,21 @@ void Replay::task_main()
 		}
 	}
 
-	if (!_task_should_exit) {
+	if (_ack_ekf2_sub >= 0) {
+		orb_unsubscribe(_ack_ekf2_sub);
+		_ack_ekf2_sub = -1;
+	}
+
+	if (_ack_logger_sub >= 0) {
+		orb_unsubscribe(_ack_logger_sub);
+		_ack_logger_sub = -1;
+	}
+
+	if (aborted) {
+		//without the acknowledgements, the output depends on the timing of the replay and is not reproducible
+		PX4_ERR("Replay aborted (lockstep broken after %u msgs)", nr_published_messages);
+
+	} else if (!_task_should_exit) {
 		PX4_INFO("Replay done (published %u msgs, %.3lf s)", nr_published_messages,
 			 (double)hrt_elapsed_time(&_replay_start_time) / 1.e6);
 
@@ -778,7 +1171,13 @@ int Replay::start(bool quiet, bool apply_params_only)
 	if (logfile) {
 		if (!isSetup()) {
 			PX4_INFO("using replay log file: %s", logfile);
-			setupReplayFile(logfile);
+
+			if (decompressFile(logfile, DECOMPRESSED_FILE)) {
+				setupReplayFile(DECOMPRESSED_FILE);
+
+			} else {
+				setupReplayFile(logfile);
+			}
 		}
 
 	} else {
@@ -799,9 +1198,7 @@ int Replay::start(bool quiet, bool apply_params_only)
 			return -ENOMEM;
 		}
 
-		ifstream replay_file(_replay_file, ios::in | ios::binary);
-
-		if (!r->readDefinitionsAndApplyParams(replay_file)) {
+		if (!r->readDefinitionsAndApplyParams()) {
 			ret = -1;
 		}
 
@@ -831,25 +1228,62 @@ int Replay::start(bool quiet, bool apply_params_only)
 
 using namespace px4;
 
+static void usage()
+{
+	PX4_INFO("usage: replay {tryapplyparams|trystart|start|stop|status} [-s <start>] [-e <end>] [-t <topics>]\n"
+		 "\t-s\tStart of the replay window [s] (timestamps of the log)\n"
+		 "\t-e\tEnd of the replay window [s]\n"
+		 "\t-t\tComma-separated list of topics to replay (default: all)");
+}
+
 int replay_main(int argc, char *argv[])
 {
-	if (argc < 1) {
-		PX4_WARN("usage: replay {tryapplyparams|trystart|start|stop|status}");
+	uint64_t window_start = 0;
+	uint64_t window_end = UINT64_MAX;
+	const char *topics = nullptr;
+
+	int myoptind = 1;
+	int ch;
+	const char *myoptarg = NULL;
+
+	while ((ch = px4_getopt(argc, argv, "s:e:t:", &myoptind, &myoptarg)) != EOF) {
+		switch (ch) {
+		case 's':
+			window_start = (uint64_t)(strtod(myoptarg, NULL) * 1.e6);
+			break;
+
+		case 'e':
+			window_end = (uint64_t)(strtod(myoptarg, NULL) * 1.e6);
+			break;
+
+		case 't':
+			topics = myoptarg;
+			break;
+
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (myoptind >= argc) {
+		usage();
 		return 1;
 	}
 
+	const char *command = argv[myoptind];
 	bool do_start = false;
 	bool quiet = false;
 	bool apply_params_only = false;
 
-	if (!strcmp(argv[1], "start")) {
+	if (!strcmp(command, "start")) {
 		do_start = true;
 
-	} else if (!strcmp(argv[1], "trystart")) {
+	} else if (!strcmp(command, "trystart")) {
 		do_start = true;
 		quiet = true;
 
-	} else if (!strcmp(argv[1], "tryapplyparams")) {
+	} else if (!strcmp(command, "tryapplyparams")) {
 		do_start = true;
 		quiet = true;
 		apply_params_only = true;
@@ -861,6 +1295,13 @@ int replay_main(int argc, char *argv[])
 			return 1;
 		}
 
+		if (window_end < window_start) {
+			PX4_ERR("invalid replay window");
+			return 1;
+		}
+
+		Replay::setFilter(window_start, window_end, topics);
+
 		if (PX4_OK != replay::instance->start(quiet, apply_params_only)) {
 			PX4_ERR("start failed");
 			return 1;
@@ -869,7 +1310,7 @@ int replay_main(int argc, char *argv[])
 		return 0;
 	}
 
-	if (!strcmp(argv[1], "stop")) {
+	if (!strcmp(command, "stop")) {
 		if (replay::instance == nullptr) {
 			PX4_WARN("not running");
 			return 1;
@@ -881,7 +1322,7 @@ int replay_main(int argc, char *argv[])
 		return 0;
 	}
 
-	if (!strcmp(argv[1], "status")) {
+	if (!strcmp(command, "status")) {
 		if (replay::instance) {
 			PX4_WARN("running");
 			return 0;
@@ -893,5 +1334,6 @@ int replay_main(int argc, char *argv[])
 	}
 
 	PX4_ERR("unrecognized command");
+	usage();
 	return 1;
 }
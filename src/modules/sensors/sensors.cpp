@@ -89,6 +89,7 @@
 #include <lib/ecl/validation/data_validator_group.h>
 
 #include <uORB/uORB.h>
+#include <uORB/DirectSubscription.hpp>
 #include <uORB/topics/sensor_combined.h>
 #include <uORB/topics/rc_channels.h>
 #include <uORB/topics/manual_control_setpoint.h>
@@ -235,11 +236,11 @@ private:
 	SensorData _baro;
 
 	int		_actuator_ctrl_0_sub;		/**< attitude controls sub */
-	int 		_rc_sub;			/**< raw rc channels data subscription */
-	int		_diff_pres_sub;			/**< raw differential pressure subscription */
-	int		_vcontrol_mode_sub;		/**< vehicle control mode subscription */
-	int 		_params_sub;			/**< notification of parameter updates */
-	int		_rc_parameter_map_sub;		/**< rc parameter map subscription */
+	uORB::DirectSubscription<ORB_ID(input_rc)> _rc_sub;	/**< raw rc channels data subscription */
+	uORB::DirectSubscription<ORB_ID(differential_pressure)> _diff_pres_sub;	/**< raw differential pressure subscription */
+	uORB::DirectSubscription<ORB_ID(vehicle_control_mode)> _vcontrol_mode_sub;	/**< vehicle control mode subscription */
+	uORB::DirectSubscription<ORB_ID(parameter_update)> _params_sub;	/**< notification of parameter updates */
+	uORB::DirectSubscription<ORB_ID(rc_parameter_map)> _rc_parameter_map_sub;	/**< rc parameter map subscription */
 	int 		_manual_control_sub;		/**< notification of manual control updates */
 
 	orb_advert_t	_sensor_pub;			/**< combined sensor data topic */
@@ -589,10 +590,6 @@ Sensors::Sensors() :
 	_hil_enabled(false),
 	_publishing(true),
 	_armed(false),
-	_rc_sub(-1),
-	_vcontrol_mode_sub(-1),
-	_params_sub(-1),
-	_rc_parameter_map_sub(-1),
 	_manual_control_sub(-1),
 
 	/* publications */
@@ -1378,11 +1375,7 @@ Sensors::baro_poll(struct sensor_combined_s &raw)
 void
 Sensors::diff_pres_poll(struct sensor_combined_s &raw)
 {
-	bool updated;
-	orb_check(_diff_pres_sub, &updated);
-
-	if (updated) {
-		orb_copy(ORB_ID(differential_pressure), _diff_pres_sub, &_diff_pres);
+	if (_diff_pres_sub.update(&_diff_pres)) {
 
 		float air_temperature_celsius = (_diff_pres.temperature > -300.0f) ? _diff_pres.temperature :
 						(raw.baro_temp_celcius - PCB_TEMP_ESTIMATE_DEG);
@@ -1426,14 +1419,10 @@ void
 Sensors::vehicle_control_mode_poll()
 {
 	struct vehicle_control_mode_s vcontrol_mode;
-	bool vcontrol_mode_updated;
 
 	/* Check HIL state if vehicle control mode has changed */
-	orb_check(_vcontrol_mode_sub, &vcontrol_mode_updated);
-
-	if (vcontrol_mode_updated) {
+	if (_vcontrol_mode_sub.update(&vcontrol_mode)) {
 
-		orb_copy(ORB_ID(vehicle_control_mode), _vcontrol_mode_sub, &vcontrol_mode);
 		_armed = vcontrol_mode.flag_armed;
 
 		/* switching from non-HIL to HIL mode */
@@ -1453,15 +1442,11 @@ Sensors::vehicle_control_mode_poll()
 void
 Sensors::parameter_update_poll(bool forced)
 {
-	bool param_updated = false;
-
-	/* Check if any parameter has changed */
-	orb_check(_params_sub, &param_updated);
+	/* Check if any parameter has changed, read from param to clear updated flag */
+	struct parameter_update_s update;
+	bool param_updated = _params_sub.update(&update);
 
 	if (param_updated || forced) {
-		/* read from param to clear updated flag */
-		struct parameter_update_s update;
-		orb_copy(ORB_ID(parameter_update), _params_sub, &update);
 
 		/* update parameters */
 		parameters_update();
@@ -1809,11 +1794,7 @@ Sensors::apply_mag_calibration(DevHandle &h, const struct mag_calibration_s *mca
 void
 Sensors::rc_parameter_map_poll(bool forced)
 {
-	bool map_updated;
-	orb_check(_rc_parameter_map_sub, &map_updated);
-
-	if (map_updated) {
-		orb_copy(ORB_ID(rc_parameter_map), _rc_parameter_map_sub, &_rc_parameter_map);
+	if (_rc_parameter_map_sub.update(&_rc_parameter_map)) {
 
 		/* update parameter handles to which the RC channels are mapped */
 		for (int i = 0; i < rc_parameter_map_s::RC_PARAM_MAP_NCHAN; i++) {
@@ -2032,14 +2013,10 @@ Sensors::set_params_from_rc()
 void
 Sensors::rc_poll()
 {
-	bool rc_updated;
-	orb_check(_rc_sub, &rc_updated);
-
-	if (rc_updated) {
-		/* read low-level values from FMU or IO RC inputs (PPM, Spektrum, S.Bus) */
-		struct rc_input_values rc_input;
+	/* read low-level values from FMU or IO RC inputs (PPM, Spektrum, S.Bus) */
+	struct rc_input_values rc_input;
 
-		orb_copy(ORB_ID(input_rc), _rc_sub, &rc_input);
+	if (_rc_sub.update(&rc_input)) {
 
 		/* detect RC signal loss */
 		bool signal_lost;
@@ -2492,15 +2469,15 @@ Sensors::task_main()
 	/* reload calibration params */
 	parameter_update_poll(true);
 
-	_rc_sub = orb_subscribe(ORB_ID(input_rc));
+	_rc_sub.subscribe();
 
-	_diff_pres_sub = orb_subscribe(ORB_ID(differential_pressure));
+	_diff_pres_sub.subscribe();
 
-	_vcontrol_mode_sub = orb_subscribe(ORB_ID(vehicle_control_mode));
+	_vcontrol_mode_sub.subscribe();
 
-	_params_sub = orb_subscribe(ORB_ID(parameter_update));
+	_params_sub.subscribe();
 
-	_rc_parameter_map_sub = orb_subscribe(ORB_ID(rc_parameter_map));
+	_rc_parameter_map_sub.subscribe();
 
 	_manual_control_sub = orb_subscribe(ORB_ID(manual_control_setpoint));
 
@@ -2662,11 +2639,11 @@ Sensors::task_main()
 		orb_unsubscribe(_baro.subscription[i]);
 	}
 
-	orb_unsubscribe(_rc_sub);
-	orb_unsubscribe(_diff_pres_sub);
-	orb_unsubscribe(_vcontrol_mode_sub);
-	orb_unsubscribe(_params_sub);
-	orb_unsubscribe(_rc_parameter_map_sub);
+	_rc_sub.unsubscribe();
+	_diff_pres_sub.unsubscribe();
+	_vcontrol_mode_sub.unsubscribe();
+	_params_sub.unsubscribe();
+	_rc_parameter_map_sub.unsubscribe();
 	orb_unsubscribe(_manual_control_sub);
 	orb_unsubscribe(_actuator_ctrl_0_sub);
 	orb_unadvertise(_sensor_pub);
@@ -266,16 +266,26 @@ param_notify_changes(bool is_saved)
 param_t
 param_find_internal(const char *name, bool notification)
 {
-	param_t param;
+	param_t front = 0;
+	param_t last = get_param_info_count();
 
-	/* perform a linear search of the known parameters */
-	for (param = 0; handle_in_range(param); param++) {
-		if (!strcmp(param_info_base[param].name, name)) {
+	/* perform a binary search of the known parameters, they are sorted by name (@see px_generate_params.py) */
+	while (front < last) {
+		param_t middle = front + (last - front) / 2;
+		int ret = strcmp(name, param_info_base[middle].name);
+
+		if (ret == 0) {
 			if (notification) {
-				param_set_used_internal(param);
+				param_set_used_internal(middle);
 			}
 
-			return param;
+			return middle;
+
+		} else if (ret < 0) {
+			last = middle;
+
+		} else {
+			front = middle + 1;
 		}
 	}
 
@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file DirectSubscription.cpp
+ *
+ */
+
+#include "DirectSubscription.hpp"
+#include "uORBDevices.hpp"
+#include "uORBManager.hpp"
+#include "uORBUtils.hpp"
+
+namespace uORB
+{
+
+bool DirectSubscriptionBase::subscribe(unsigned instance)
+{
+	if (_node != nullptr) {
+		return true;
+	}
+
+	/* subscribing through a file descriptor creates the node if it does not exist yet */
+	int handle = orb_subscribe_multi(_meta, instance);
+
+	if (handle < 0) {
+		return false;
+	}
+
+	char path[orb_maxpath];
+	int inst = instance;
+	DeviceMaster *master = Manager::get_instance()->get_device_master(PUBSUB);
+	DeviceNode *node = nullptr;
+
+	if (master != nullptr && Utils::node_mkpath(path, PUBSUB, _meta, &inst) == OK) {
+		node = master->getDeviceNode(path);
+	}
+
+	if (node != nullptr) {
+		/* count the subscription before closing the file descriptor, so that remote channels
+		 * do not see the subscriber count drop to 0 in between */
+		node->add_internal_subscriber();
+
+		/* like orb_subscribe(): no pending update */
+		_generation = node->published_message_count();
+		_published_count = node->published_message_counter();
+		_node = node;
+	}
+
+	orb_unsubscribe(handle);
+	return _node != nullptr;
+}
+
+void DirectSubscriptionBase::unsubscribe()
+{
+	if (_node != nullptr) {
+		_node->remove_internal_subscriber();
+		_node = nullptr;
+		_published_count = nullptr;
+	}
+}
+
+bool DirectSubscriptionBase::copy(void *dst)
+{
+	return _node != nullptr && _node->copy(dst, _generation);
+}
+
+hrt_abstime DirectSubscriptionBase::last_update() const
+{
+	return _node != nullptr ? _node->last_update() : 0;
+}
+
+} // namespace uORB
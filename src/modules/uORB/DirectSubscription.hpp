@@ -0,0 +1,168 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file DirectSubscription.hpp
+ *
+ * Subscriptions that access the topic node directly instead of going through
+ * a file descriptor (orb_check()/orb_copy()/orb_stat()), for use in hot loops.
+ * The uORB internals are not exposed to the users of this header.
+ */
+
+#pragma once
+
+#include <drivers/drv_hrt.h>
+#include <uORB/uORB.h>
+
+namespace uORB
+{
+
+class DeviceNode;
+
+/**
+ * Untyped direct subscription. The node is looked up once on subscribe(); checking
+ * for updates is then an inline comparison with the node's generation counter, and
+ * data is only copied (through the node, under its lock) when requested.
+ *
+ * The subscription is counted as a subscriber of the node (without holding a file
+ * descriptor), so that it is visible to publishers and remote channels. It is not
+ * bound to a task: it can be destroyed from any task.
+ *
+ * Intervals (orb_set_interval()) and polling are not supported.
+ */
+class DirectSubscriptionBase
+{
+public:
+	DirectSubscriptionBase(const struct orb_metadata *meta) :
+		_meta(meta)
+	{
+	}
+
+	~DirectSubscriptionBase()
+	{
+		unsubscribe();
+	}
+
+	/**
+	 * Subscribe to a topic instance.
+	 * @return true on success
+	 */
+	bool subscribe(unsigned instance = 0);
+
+	void unsubscribe();
+
+	bool subscribed() const { return _node != nullptr; }
+
+	/**
+	 * Check whether the topic has been published since the last copy (@see orb_check()).
+	 */
+	bool updated() const
+	{
+		return _published_count != nullptr && *_published_count != _generation;
+	}
+
+	/**
+	 * Copy the next element (@see orb_copy()).
+	 * @param dst buffer of o_size bytes
+	 * @return false if not subscribed or nothing was published yet
+	 */
+	bool copy(void *dst);
+
+	/**
+	 * Copy the next element if the topic has been updated.
+	 * @return true if data was copied
+	 */
+	bool update(void *dst)
+	{
+		return updated() && copy(dst);
+	}
+
+	/**
+	 * Check whether the topic has ever been published.
+	 */
+	bool published() const
+	{
+		return _published_count != nullptr && *_published_count > 0;
+	}
+
+	/**
+	 * Time of the last publication, 0 if none (@see orb_stat()).
+	 */
+	hrt_abstime last_update() const;
+
+	const struct orb_metadata *get_meta() const { return _meta; }
+
+protected:
+	const struct orb_metadata *_meta;
+	DeviceNode *_node = nullptr;
+	const volatile unsigned *_published_count = nullptr; /**< generation counter of the node */
+	unsigned _generation = 0; /**< last generation that was copied */
+
+private:
+	DirectSubscriptionBase(const DirectSubscriptionBase &) = delete;
+	DirectSubscriptionBase &operator=(const DirectSubscriptionBase &) = delete;
+};
+
+/**
+ * Typed direct subscription for a topic, e.g.
+ * DirectSubscription<ORB_ID(vehicle_status)>. The message struct is derived from the
+ * topic metadata at compile time, so copies into a struct of a different type do not compile.
+ */
+template<const struct orb_metadata *META>
+class DirectSubscription : public DirectSubscriptionBase
+{
+public:
+	typedef typename TopicStruct<META>::type type;
+
+	DirectSubscription() :
+		DirectSubscriptionBase(META),
+		_data()
+	{
+	}
+
+	bool copy(type *dst) { return DirectSubscriptionBase::copy(dst); }
+	bool update(type *dst) { return DirectSubscriptionBase::update(dst); }
+
+	/**
+	 * Update the embedded struct if the topic has been updated.
+	 * @return true if data was copied
+	 */
+	bool update() { return update(&_data); }
+
+	const type &get() const { return _data; }
+
+private:
+	type _data;
+};
+
+} // namespace uORB
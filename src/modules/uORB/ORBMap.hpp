@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -43,30 +44,31 @@ class DeviceNode;
 class ORBMap;
 }
 
+/**
+ * Map from node path to DeviceNode.
+ *
+ * Implemented as an open-addressing hash table with linear probing, so that
+ * lookups (advertise, subscribe, orb_exists) do not have to compare the path
+ * against every existing node. Elements are never removed, since a DeviceNode
+ * is never deleted either. The table grows by doubling when it gets 3/4 full.
+ */
 class uORB::ORBMap
 {
 public:
 	struct Node {
-		struct Node *next;
-		const char *node_name;
+		uint32_t hash;
+		const char *node_name; ///< nullptr if the slot is empty
 		uORB::DeviceNode *node;
 	};
 
 	ORBMap() :
-		_top(nullptr),
-		_end(nullptr)
+		_nodes(nullptr),
+		_capacity(0),
+		_size(0)
 	{ }
 	~ORBMap()
 	{
-		while (_top != nullptr) {
-			unlinkNext(_top);
-
-			if (_top->next == nullptr) {
-				free(_top);
-				_top = nullptr;
-				_end = nullptr;
-			}
-		}
+		free(_nodes);
 	}
 
 	/**
@@ -74,88 +76,146 @@ public:
 	 * @param node_name name of the node. This will not be copied, so the caller has to ensure
 	 *                  the pointer is valid until the node is removed from ORBMap
 	 * @param node
+	 * @return false if the table could not be grown (out of memory)
 	 */
-	void insert(const char *node_name, uORB::DeviceNode *node)
+	bool insert(const char *node_name, uORB::DeviceNode *node)
 	{
-		Node **p;
+		if ((_size + 1) * 4 > _capacity * 3) {
+			if (!resize(_capacity > 0 ? _capacity * 2 : initial_capacity)) {
+				return false;
+			}
+		}
 
-		if (_top == nullptr) {
-			p = &_top;
+		insert_hashed(hash(node_name), node_name, node);
+		++_size;
+		return true;
+	}
 
-		} else {
-			p = &_end->next;
-		}
+	bool find(const char *node_name) const
+	{
+		return lookup(node_name) != nullptr;
+	}
 
-		*p = (Node *)malloc(sizeof(Node));
+	uORB::DeviceNode *get(const char *node_name) const
+	{
+		const Node *p = lookup(node_name);
+		return p ? p->node : nullptr;
+	}
 
-		if (_end) {
-			_end = _end->next;
+	/**
+	 * Iteration: first element (nullptr if empty)
+	 */
+	Node *top() const
+	{
+		return next_used(0);
+	}
 
-		} else {
-			_end = _top;
-		}
+	/**
+	 * Iteration: element following n (nullptr at the end)
+	 */
+	Node *next(const Node *n) const
+	{
+		return next_used(n - _nodes + 1);
+	}
 
-		_end->next = nullptr;
-		_end->node_name = node_name;
-		_end->node = node;
+	bool empty() const
+	{
+		return _size == 0;
 	}
 
-	bool find(const char *node_name)
+	unsigned size() const
 	{
-		Node *p = _top;
+		return _size;
+	}
 
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return true;
-			}
+private:
+	static const unsigned initial_capacity = 64; ///< must be a power of 2
 
-			p = p->next;
+	/**
+	 * FNV-1a hash of a string
+	 */
+	static uint32_t hash(const char *str)
+	{
+		uint32_t h = 2166136261u;
+
+		while (*str) {
+			h = (h ^ (uint8_t) * str++) * 16777619u;
 		}
 
-		return false;
+		return h;
 	}
 
-	uORB::DeviceNode *get(const char *node_name)
+	const Node *lookup(const char *node_name) const
 	{
-		Node *p = _top;
+		if (_size == 0) {
+			return nullptr;
+		}
 
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return p->node;
+		const uint32_t h = hash(node_name);
+
+		for (unsigned i = h & (_capacity - 1);; i = (i + 1) & (_capacity - 1)) {
+			const Node &n = _nodes[i];
+
+			if (n.node_name == nullptr) {
+				return nullptr;
 			}
 
-			p = p->next;
+			if (n.hash == h && strcmp(n.node_name, node_name) == 0) {
+				return &n;
+			}
 		}
-
-		return nullptr;
 	}
 
-	Node *top() const
+	void insert_hashed(uint32_t h, const char *node_name, uORB::DeviceNode *node)
 	{
-		return _top;
-	}
+		unsigned i = h & (_capacity - 1);
 
-	bool empty() const
-	{
-		return !_top;
+		while (_nodes[i].node_name != nullptr) {
+			i = (i + 1) & (_capacity - 1);
+		}
+
+		_nodes[i].hash = h;
+		_nodes[i].node_name = node_name;
+		_nodes[i].node = node;
 	}
 
-private:
-	void unlinkNext(Node *a)
+	bool resize(unsigned capacity)
 	{
-		Node *b = a->next;
+		Node *old_nodes = _nodes;
+		unsigned old_capacity = _capacity;
 
-		if (b != nullptr) {
-			if (_end == b) {
-				_end = a;
+		_nodes = (Node *)calloc(capacity, sizeof(Node));
+
+		if (_nodes == nullptr) {
+			_nodes = old_nodes;
+			return false;
+		}
+
+		_capacity = capacity;
+
+		for (unsigned i = 0; i < old_capacity; ++i) {
+			if (old_nodes[i].node_name != nullptr) {
+				insert_hashed(old_nodes[i].hash, old_nodes[i].node_name, old_nodes[i].node);
 			}
+		}
 
-			a->next = b->next;
-			free(b);
+		free(old_nodes);
+		return true;
+	}
+
+	Node *next_used(unsigned i) const
+	{
+		for (; i < _capacity; ++i) {
+			if (_nodes[i].node_name != nullptr) {
+				return &_nodes[i];
+			}
 		}
+
+		return nullptr;
 	}
 
-	Node *_top;
-	Node *_end;
+	Node *_nodes;
+	unsigned _capacity;
+	unsigned _size;
 };
 
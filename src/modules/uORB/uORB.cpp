@@ -89,6 +89,21 @@ int  orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const voi
 	return uORB::Manager::get_instance()->orb_publish(meta, handle, data);
 }
 
+void *orb_loan(const struct orb_metadata *meta, orb_advert_t handle)
+{
+	return uORB::Manager::get_instance()->orb_loan(meta, handle);
+}
+
+int  orb_publish_loaned(const struct orb_metadata *meta, orb_advert_t handle)
+{
+	return uORB::Manager::get_instance()->orb_publish_loaned(meta, handle);
+}
+
+int  orb_loan_abort(const struct orb_metadata *meta, orb_advert_t handle)
+{
+	return uORB::Manager::get_instance()->orb_loan_abort(meta, handle);
+}
+
 int  orb_subscribe(const struct orb_metadata *meta)
 {
 	return uORB::Manager::get_instance()->orb_subscribe(meta);
@@ -109,6 +124,21 @@ int  orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
 	return uORB::Manager::get_instance()->orb_copy(meta, handle, buffer);
 }
 
+int  orb_copy_all(const struct orb_metadata *meta, int handle, void *buffer, unsigned max_count, unsigned *dropped)
+{
+	return uORB::Manager::get_instance()->orb_copy_all(meta, handle, buffer, max_count, dropped);
+}
+
+int  orb_borrow(const struct orb_metadata *meta, int handle, const void **buffer)
+{
+	return uORB::Manager::get_instance()->orb_borrow(meta, handle, buffer);
+}
+
+int  orb_return(const struct orb_metadata *meta, int handle)
+{
+	return uORB::Manager::get_instance()->orb_return(meta, handle);
+}
+
 int  orb_check(int handle, bool *updated)
 {
 	return uORB::Manager::get_instance()->orb_check(handle, updated);
@@ -149,3 +179,19 @@ int orb_get_interval(int handle, unsigned *interval)
 {
 	return uORB::Manager::get_instance()->orb_get_interval(handle, interval);
 }
+
+int orb_set_update_flag(int handle, volatile uint32_t *flags, uint32_t mask)
+{
+	return uORB::Manager::get_instance()->orb_set_update_flag(handle, flags, mask);
+}
+
+orb_work_callback_t orb_register_work_callback(const struct orb_metadata *meta, unsigned instance, int qid,
+		void (*worker)(void *arg), void *arg)
+{
+	return uORB::Manager::get_instance()->orb_register_work_callback(meta, instance, qid, worker, arg);
+}
+
+int orb_unregister_work_callback(orb_work_callback_t handle)
+{
+	return uORB::Manager::get_instance()->orb_unregister_work_callback(handle);
+}
@@ -179,6 +179,21 @@ extern int orb_publish_auto(const struct orb_metadata *meta, orb_advert_t *handl
  */
 extern int	orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_loan()
+ */
+extern void	*orb_loan(const struct orb_metadata *meta, orb_advert_t handle) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_publish_loaned()
+ */
+extern int	orb_publish_loaned(const struct orb_metadata *meta, orb_advert_t handle) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_loan_abort()
+ */
+extern int	orb_loan_abort(const struct orb_metadata *meta, orb_advert_t handle) __EXPORT;
+
 /**
  * @see uORB::Manager::orb_subscribe()
  */
@@ -199,6 +214,22 @@ extern int	orb_unsubscribe(int handle) __EXPORT;
  */
 extern int	orb_copy(const struct orb_metadata *meta, int handle, void *buffer) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_copy_all()
+ */
+extern int	orb_copy_all(const struct orb_metadata *meta, int handle, void *buffer, unsigned max_count,
+			     unsigned *dropped) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_borrow()
+ */
+extern int	orb_borrow(const struct orb_metadata *meta, int handle, const void **buffer) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_return()
+ */
+extern int	orb_return(const struct orb_metadata *meta, int handle) __EXPORT;
+
 /**
  * @see uORB::Manager::orb_check()
  */
@@ -237,8 +268,41 @@ extern int	orb_set_interval(int handle, unsigned interval) __EXPORT;
  */
 extern int	orb_get_interval(int handle, unsigned *interval) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_set_update_flag()
+ */
+extern int	orb_set_update_flag(int handle, volatile uint32_t *flags, uint32_t mask) __EXPORT;
+
+/**
+ * ORB work callback handle (@see uORB::Manager::orb_register_work_callback()).
+ */
+typedef void	*orb_work_callback_t;
+
+/**
+ * @see uORB::Manager::orb_register_work_callback()
+ */
+extern orb_work_callback_t orb_register_work_callback(const struct orb_metadata *meta, unsigned instance, int qid,
+		void (*worker)(void *arg), void *arg) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_unregister_work_callback()
+ */
+extern int	orb_unregister_work_callback(orb_work_callback_t handle) __EXPORT;
+
 __END_DECLS
 
+#ifdef __cplusplus
+namespace uORB
+{
+/**
+ * Message struct of a topic (member typedef 'type'). The generated topic headers
+ * specialize this for each topic, so that the struct can be checked at compile time.
+ */
+template<const struct orb_metadata *meta>
+struct TopicStruct;
+}
+#endif
+
 /* Diverse uORB header defines */ //XXX: move to better location
 #define ORB_ID_VEHICLE_ATTITUDE_CONTROLS    ORB_ID(actuator_controls_0)
 typedef uint8_t arming_state_t;
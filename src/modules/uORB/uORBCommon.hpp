@@ -63,5 +63,17 @@ struct orb_advertdata {
 	int *instance;
 	int priority;
 };
+
+struct orb_copy_all_data {
+	void *buffer;		/**< destination for up to max_count elements */
+	unsigned max_count;
+	unsigned count;		/**< returns the number of copied elements */
+	unsigned dropped;	/**< returns the number of elements that were overwritten before they could be copied */
+};
+
+struct orb_update_flag_data {
+	volatile uint32_t *flags;	/**< word in which to set the bits, nullptr to stop */
+	uint32_t mask;		/**< bits to set */
+};
 }
 #endif // _uORBCommon_hpp_
@@ -44,12 +44,6 @@
 #define ATOMIC_LEAVE px4_leave_critical_section(flags)
 #define FILE_FLAGS(filp) filp->f_oflags
 #define FILE_PRIV(filp) filp->f_priv
-#define ITERATE_NODE_MAP() \
-	for (ORBMap::Node *node_iter = _node_map.top(); node_iter; node_iter = node_iter->next)
-#define INIT_NODE_MAP_VARS(node_obj, node_name_str) \
-	DeviceNode *node_obj = node_iter->node; \
-	const char *node_name_str = node_iter->node_name; \
-	UNUSED(node_name_str);
 
 #else
 #include <algorithm>
@@ -57,13 +51,14 @@
 #define FILE_PRIV(filp) filp->priv
 #define ATOMIC_ENTER lock()
 #define ATOMIC_LEAVE unlock()
+#endif
+
 #define ITERATE_NODE_MAP() \
-	for (const auto &node_iter : _node_map)
+	for (ORBMap::Node *node_iter = _node_map.top(); node_iter; node_iter = _node_map.next(node_iter))
 #define INIT_NODE_MAP_VARS(node_obj, node_name_str) \
-	DeviceNode *node_obj = node_iter.second; \
-	const char *node_name_str = node_iter.first.c_str(); \
+	DeviceNode *node_obj = node_iter->node; \
+	const char *node_name_str = node_iter->node_name; \
 	UNUSED(node_name_str);
-#endif
 
 #include "uORBDevices.hpp"
 #include "uORBUtils.hpp"
@@ -74,6 +69,8 @@
 
 using namespace device;
 
+volatile bool uORB::DeviceNode::_latency_statistics_enabled = false;
+
 uORB::DeviceNode::SubscriberData *uORB::DeviceNode::filp_to_sd(device::file_t *filp)
 {
 #ifndef __PX4_NUTTX
@@ -93,6 +90,9 @@ uORB::DeviceNode::DeviceNode(const struct orb_metadata *meta, const char *name,
 	_data(nullptr),
 	_last_update(0),
 	_generation(0),
+#ifndef __PX4_NUTTX
+	_seq(0),
+#endif
 	_priority((uint8_t)priority),
 	_published(false),
 	_queue_size(queue_size),
@@ -109,6 +109,32 @@ uORB::DeviceNode::~DeviceNode()
 		delete[] _data;
 	}
 
+#ifndef __PX4_NUTTX
+
+	if (_loan_elements != nullptr) {
+		delete[] _loan_elements;
+		delete[] _loan_spare;
+	}
+
+#endif
+
+	if (_publish_times != nullptr) {
+		delete[] _publish_times;
+	}
+
+	while (_work_callbacks != nullptr) {
+		WorkCallback *callback = _work_callbacks;
+		_work_callbacks = callback->next;
+		work_cancel(callback->qid, &callback->work);
+		delete callback;
+	}
+
+	while (_interval_groups != nullptr) {
+		IntervalGroup *group = _interval_groups;
+		_interval_groups = group->next;
+		hrt_cancel(&group->update_call);
+		delete group;
+	}
 }
 
 int
@@ -192,11 +218,19 @@ uORB::DeviceNode::close(device::file_t *filp)
 		SubscriberData *sd = filp_to_sd(filp);
 
 		if (sd != nullptr) {
-			if (sd->update_interval) {
-				hrt_cancel(&sd->update_interval->update_call);
+			if (sd->interval_group) {
+				lock();
+				set_interval_group(sd, 0);
+				unlock();
+			}
+
+			if (sd->update_flag) {
+				orb_update_flag_data data = { nullptr, 0 };
+				set_update_flag(sd, &data);
 			}
 
 			remove_internal_subscriber();
+			remove_latency_statistics(sd);
 			delete sd;
 			sd = nullptr;
 		}
@@ -220,31 +254,29 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 		return -EIO;
 	}
 
+	unsigned element;
+	read_next(sd, buffer, element);
+
+	return _meta->o_size;
+}
+
+void
+uORB::DeviceNode::read_next(SubscriberData *sd, char *buffer, unsigned &element)
+{
+#ifdef __PX4_NUTTX
 	/*
 	 * Perform an atomic copy & state update
 	 */
 	ATOMIC_ENTER;
 
-	if (_generation > sd->generation + _queue_size) {
-		/* Reader is too far behind: some messages are lost */
-		_lost_messages += _generation - (sd->generation + _queue_size);
-		sd->generation = _generation - _queue_size;
-	}
-
-	if (_generation == sd->generation && sd->generation > 0) {
-		/* The subscriber already read the latest message, but nothing new was published yet.
-		 * Return the previous message
-		 */
-		--sd->generation;
-	}
+	const unsigned previous_generation = sd->generation;
+	_lost_messages += next_element(sd->generation, element);
+	const unsigned cur_generation = _generation;
+	const hrt_abstime publish_time = _publish_times ? _publish_times[element % _queue_size] : 0;
 
 	/* if the caller doesn't want the data, don't give it to them */
 	if (nullptr != buffer) {
-		memcpy(buffer, _data + (_meta->o_size * (sd->generation % _queue_size)), _meta->o_size);
-	}
-
-	if (sd->generation < _generation) {
-		++sd->generation;
+		memcpy(buffer, element_data(element), _meta->o_size);
 	}
 
 	/* set priority */
@@ -258,21 +290,255 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 
 	ATOMIC_LEAVE;
 
-	return _meta->o_size;
-}
+	if (publish_time != 0 && sd->generation != previous_generation) {
+		record_latency(sd, hrt_absolute_time() - publish_time, cur_generation - element);
+	}
 
-ssize_t
-uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
-{
+#else
 	/*
-	 * Writes are legal from interrupt context as long as the
-	 * object has already been initialised from thread context.
-	 *
-	 * Writes outside interrupt context will allocate the object
-	 * if it has not yet been allocated.
-	 *
-	 * Note that filp will usually be NULL.
+	 * Copy without taking the lock and retry if a publication raced with us.
+	 * The subscriber state is only committed once the copy is consistent.
 	 */
+	unsigned seq;
+	unsigned generation;
+	unsigned lost;
+	unsigned cur_generation;
+	hrt_abstime publish_time;
+
+	do {
+		seq = seq_read_begin();
+		generation = sd->generation;
+		lost = next_element(generation, element);
+		cur_generation = _generation;
+		publish_time = _publish_times ? _publish_times[element % _queue_size] : 0;
+
+		if (nullptr != buffer) {
+			memcpy(buffer, element_data(element), _meta->o_size);
+		}
+	} while (seq_read_retry(seq));
+
+	if (publish_time != 0 && generation != sd->generation) {
+		record_latency(sd, hrt_absolute_time() - publish_time, cur_generation - element);
+	}
+
+	sd->generation = generation;
+
+	if (lost > 0) {
+		__atomic_fetch_add(&_lost_messages, lost, __ATOMIC_RELAXED);
+	}
+
+	if (sd->interval_group) {
+		/* the flags are shared with appears_updated(), which runs under the lock */
+		lock();
+		sd->set_priority(_priority);
+		sd->set_update_reported(false);
+		unlock();
+
+	} else {
+		sd->set_priority(_priority);
+	}
+
+#endif
+}
+
+bool
+uORB::DeviceNode::copy(void *dst, unsigned &generation)
+{
+	if (_data == nullptr) {
+		return false;
+	}
+
+	unsigned element;
+	unsigned lost;
+
+#ifdef __PX4_NUTTX
+	ATOMIC_ENTER;
+
+	lost = next_element(generation, element);
+	memcpy(dst, element_data(element), _meta->o_size);
+	_lost_messages += lost;
+
+	ATOMIC_LEAVE;
+#else
+	unsigned seq;
+	unsigned next_generation;
+
+	do {
+		seq = seq_read_begin();
+		next_generation = generation;
+		lost = next_element(next_generation, element);
+		memcpy(dst, element_data(element), _meta->o_size);
+	} while (seq_read_retry(seq));
+
+	generation = next_generation;
+
+	if (lost > 0) {
+		__atomic_fetch_add(&_lost_messages, lost, __ATOMIC_RELAXED);
+	}
+
+#endif
+
+	return true;
+}
+
+hrt_abstime
+uORB::DeviceNode::last_update()
+{
+	hrt_abstime update_time;
+
+#ifdef __PX4_NUTTX
+	/* a 64 bit read is not atomic, and publications can happen from interrupt context */
+	ATOMIC_ENTER;
+	update_time = _last_update;
+	ATOMIC_LEAVE;
+#else
+	unsigned seq;
+
+	do {
+		seq = seq_read_begin();
+		update_time = _last_update;
+	} while (seq_read_retry(seq));
+
+#endif
+
+	return update_time;
+}
+
+void
+uORB::DeviceNode::read_all(SubscriberData *sd, orb_copy_all_data *data)
+{
+	unsigned count;
+
+#ifdef __PX4_NUTTX
+	ATOMIC_ENTER;
+
+	const unsigned lost = copy_unread(sd->generation, data, count);
+	_lost_messages += lost;
+
+	sd->set_priority(_priority);
+	sd->set_update_reported(false);
+
+	ATOMIC_LEAVE;
+#else
+	unsigned seq;
+	unsigned generation;
+	unsigned lost;
+
+	do {
+		seq = seq_read_begin();
+		generation = sd->generation;
+		lost = copy_unread(generation, data, count);
+	} while (seq_read_retry(seq));
+
+	sd->generation = generation;
+
+	if (lost > 0) {
+		__atomic_fetch_add(&_lost_messages, lost, __ATOMIC_RELAXED);
+	}
+
+	if (sd->interval_group) {
+		/* the flags are shared with appears_updated(), which runs under the lock */
+		lock();
+		sd->set_priority(_priority);
+		sd->set_update_reported(false);
+		unlock();
+
+	} else {
+		sd->set_priority(_priority);
+	}
+
+#endif
+
+	data->count = count;
+	data->dropped = lost;
+}
+
+unsigned
+uORB::DeviceNode::copy_unread(unsigned &generation, orb_copy_all_data *data, unsigned &count)
+{
+	const unsigned cur_generation = _generation;
+	unsigned lost = 0;
+
+	if (cur_generation > generation + _queue_size) {
+		/* Reader is too far behind: some messages are lost */
+		lost = cur_generation - (generation + _queue_size);
+		generation = cur_generation - _queue_size;
+	}
+
+	count = cur_generation - generation;
+
+	if (count > data->max_count) {
+		count = data->max_count;
+	}
+
+	for (unsigned i = 0; i < count; ++i) {
+		memcpy((uint8_t *)data->buffer + i * _meta->o_size, element_data(generation + i), _meta->o_size);
+	}
+
+	generation += count;
+
+	return lost;
+}
+
+unsigned
+uORB::DeviceNode::next_element(unsigned &generation, unsigned &element)
+{
+	const unsigned cur_generation = _generation;
+	unsigned lost = 0;
+
+	if (cur_generation > generation + _queue_size) {
+		/* Reader is too far behind: some messages are lost */
+		lost = cur_generation - (generation + _queue_size);
+		generation = cur_generation - _queue_size;
+	}
+
+	if (cur_generation == generation && generation > 0) {
+		/* The subscriber already read the latest message, but nothing new was published yet.
+		 * Return the previous message
+		 */
+		--generation;
+	}
+
+	element = generation;
+
+	if (generation < cur_generation) {
+		++generation;
+	}
+
+	return lost;
+}
+
+bool
+uORB::DeviceNode::element_valid(unsigned element)
+{
+	/* number of publications that have been started so far */
+	unsigned started;
+
+#ifdef __PX4_NUTTX
+	started = _generation;
+#else
+	/* make sure all the reads of the element's data happened before */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	unsigned seq;
+
+	do {
+		seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE);
+		started = _generation;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq);
+
+	/* count a publication in progress (conservative if it already incremented the generation) */
+	started += seq & 1;
+#endif
+
+	/* the slot gets overwritten by the publication of generation element + _queue_size */
+	return started - element <= _queue_size;
+}
+
+bool
+uORB::DeviceNode::allocate_data()
+{
 	if (nullptr == _data) {
 #ifdef __PX4_NUTTX
 
@@ -298,11 +564,26 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 
 		unlock();
 #endif
+	}
 
+	return _data != nullptr;
+}
+
+ssize_t
+uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
+{
+	/*
+	 * Writes are legal from interrupt context as long as the
+	 * object has already been initialised from thread context.
+	 *
+	 * Writes outside interrupt context will allocate the object
+	 * if it has not yet been allocated.
+	 *
+	 * Note that filp will usually be NULL.
+	 */
+	if (!allocate_data()) {
 		/* failed or could not allocate */
-		if (nullptr == _data) {
-			return -ENOMEM;
-		}
+		return -ENOMEM;
 	}
 
 	/* If write size does not match, that is an error */
@@ -310,15 +591,26 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 		return -EIO;
 	}
 
+	if (_latency_statistics_enabled && _publish_times == nullptr) {
+		allocate_publish_times();
+	}
+
 	/* Perform an atomic copy. */
 	ATOMIC_ENTER;
-	memcpy(_data + (_meta->o_size * (_generation % _queue_size)), buffer, _meta->o_size);
+#ifndef __PX4_NUTTX
+	seq_write_begin();
+#endif
+	memcpy(element_data(_generation), buffer, _meta->o_size);
 
 	/* update the timestamp and generation count */
 	_last_update = hrt_absolute_time();
+	set_publish_time();
 	/* wrap-around happens after ~49 days, assuming a publisher rate of 1 kHz */
 	_generation++;
 
+#ifndef __PX4_NUTTX
+	seq_write_end();
+#endif
 	_published = true;
 
 	ATOMIC_LEAVE;
@@ -326,6 +618,9 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 	/* notify any poll waiters */
 	poll_notify(POLLIN);
 
+	set_update_flags(nullptr);
+	schedule_work_callbacks();
+
 	return _meta->o_size;
 }
 
@@ -336,55 +631,43 @@ uORB::DeviceNode::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 
 	switch (cmd) {
 	case ORBIOCLASTUPDATE: {
+#ifdef __PX4_NUTTX
 			ATOMIC_ENTER;
 			*(hrt_abstime *)arg = _last_update;
 			ATOMIC_LEAVE;
+#else
+			unsigned seq;
+
+			do {
+				seq = seq_read_begin();
+				*(hrt_abstime *)arg = _last_update;
+			} while (seq_read_retry(seq));
+
+#endif
 			return PX4_OK;
 		}
 
 	case ORBIOCUPDATED:
 #ifndef __PX4_NUTTX
-		lock();
-#endif
-		*(bool *)arg = appears_updated(sd);
-#ifndef __PX4_NUTTX
-		unlock();
-#endif
-		return PX4_OK;
 
-	case ORBIOCSETINTERVAL: {
-			int ret = PX4_OK;
+		/* only rate-limited subscribers modify their state in appears_updated() */
+		if (sd->interval_group) {
 			lock();
+			*(bool *)arg = appears_updated(sd);
+			unlock();
 
-			if (arg == 0) {
-				if (sd->update_interval) {
-					delete(sd->update_interval);
-					sd->update_interval = nullptr;
-				}
-
-			} else {
-				if (sd->update_interval) {
-					sd->update_interval->interval = arg;
-#ifndef __PX4_NUTTX
-					sd->update_interval->last_update = hrt_absolute_time();
-#endif
-
-				} else {
-					sd->update_interval = new UpdateIntervalData();
+		} else {
+			*(bool *)arg = appears_updated(sd);
+		}
 
-					if (sd->update_interval) {
-						memset(&sd->update_interval->update_call, 0, sizeof(hrt_call));
-						sd->update_interval->interval = arg;
-#ifndef __PX4_NUTTX
-						sd->update_interval->last_update = hrt_absolute_time();
+#else
+		*(bool *)arg = appears_updated(sd);
 #endif
+		return PX4_OK;
 
-					} else {
-						ret = -ENOMEM;
-					}
-				}
-			}
-
+	case ORBIOCSETINTERVAL: {
+			lock();
+			int ret = set_interval_group(sd, arg);
 			unlock();
 			return ret;
 		}
@@ -403,8 +686,8 @@ uORB::DeviceNode::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 		return update_queue_size(arg);
 
 	case ORBIOCGETINTERVAL:
-		if (sd->update_interval) {
-			*(unsigned *)arg = sd->update_interval->interval;
+		if (sd->interval_group) {
+			*(unsigned *)arg = sd->interval_group->interval;
 
 		} else {
 			*(unsigned *)arg = 0;
@@ -412,6 +695,44 @@ uORB::DeviceNode::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 
 		return OK;
 
+	case ORBIOCBORROW: {
+			if (_data == nullptr) {
+				return -EIO;
+			}
+
+			unsigned element;
+			read_next(sd, nullptr, element);
+			sd->borrowed_element = element;
+			sd->borrowed = true;
+			*(const void **)arg = element_data(element);
+			return PX4_OK;
+		}
+
+	case ORBIOCCOPYALL: {
+			orb_copy_all_data *data = (orb_copy_all_data *)arg;
+
+			if (_data == nullptr) {
+				/* nothing published yet */
+				data->count = 0;
+				data->dropped = 0;
+				return PX4_OK;
+			}
+
+			read_all(sd, data);
+			return PX4_OK;
+		}
+
+	case ORBIOCSETUPDATEFLAG:
+		return set_update_flag(sd, (const orb_update_flag_data *)arg);
+
+	case ORBIOCRETURN:
+		if (!sd->borrowed) {
+			return -EINVAL;
+		}
+
+		sd->borrowed = false;
+		return element_valid(sd->borrowed_element) ? PX4_OK : -EAGAIN;
+
 	default:
 		/* give it to the superclass */
 		return VDev::ioctl(filp, cmd, arg);
@@ -483,6 +804,372 @@ int uORB::DeviceNode::unadvertise(orb_advert_t handle)
 	return PX4_OK;
 }
 
+void *
+uORB::DeviceNode::loan(const orb_metadata *meta, orb_advert_t handle)
+{
+	uORB::DeviceNode *devnode = (uORB::DeviceNode *)handle;
+
+	/* this is a bit risky, since we are trusting the handle in order to deref it */
+	if (devnode == nullptr || devnode->_meta != meta) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+#ifdef __PX4_NUTTX
+	/* subscribers copy in a critical section, so a loan would need a staging buffer and save nothing */
+	errno = ENOTSUP;
+	return nullptr;
+#else
+	return devnode->loan_begin();
+#endif
+}
+
+int
+uORB::DeviceNode::publish_loaned(const orb_metadata *meta, orb_advert_t handle)
+{
+	uORB::DeviceNode *devnode = (uORB::DeviceNode *)handle;
+
+	if (devnode == nullptr || devnode->_meta != meta) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+#ifdef __PX4_NUTTX
+	errno = EINVAL; // there cannot be a loan
+	return ERROR;
+#else
+	return devnode->loan_commit();
+#endif
+}
+
+int
+uORB::DeviceNode::loan_abort(const orb_metadata *meta, orb_advert_t handle)
+{
+	uORB::DeviceNode *devnode = (uORB::DeviceNode *)handle;
+
+	if (devnode == nullptr || devnode->_meta != meta) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+#ifdef __PX4_NUTTX
+	errno = EINVAL; // there cannot be a loan
+	return ERROR;
+#else
+	return devnode->loan_cancel();
+#endif
+}
+
+#ifndef __PX4_NUTTX
+
+void *
+uORB::DeviceNode::loan_begin()
+{
+	if (!allocate_data()) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+
+	if (_latency_statistics_enabled && _publish_times == nullptr) {
+		allocate_publish_times();
+	}
+
+	lock();
+
+	if (_loan_active) {
+		unlock();
+		errno = EBUSY;
+		return nullptr;
+	}
+
+	if (_loan_elements == nullptr) {
+		uint8_t **elements = new uint8_t *[_queue_size];
+		_loan_spare = new uint8_t[_meta->o_size];
+
+		if (elements == nullptr || _loan_spare == nullptr) {
+			delete[] elements;
+			delete[] _loan_spare;
+			_loan_spare = nullptr;
+			unlock();
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		for (unsigned i = 0; i < _queue_size; ++i) {
+			elements[i] = _data + _meta->o_size * i;
+		}
+
+		/* same layout as before, so readers that still use the fixed one are not affected */
+		__atomic_store_n(&_loan_elements, elements, __ATOMIC_RELEASE);
+	}
+
+	/*
+	 * The spare element is not part of the queue, so the publisher fills it in without holding
+	 * any lock: readers and other publishers are not blocked, and the queued data stays intact.
+	 */
+	_loan_active = true;
+	unlock();
+
+	return _loan_spare;
+}
+
+int
+uORB::DeviceNode::loan_commit()
+{
+	lock();
+	const bool active = _loan_active;
+	unlock();
+
+	/* catches a publication without a preceding loan (a loan is only committed by its owner) */
+	if (!active) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	/* send the data over the Multi-ORB link while the loaned element is still private */
+	uORBCommunicator::IChannel *ch = uORB::Manager::get_instance()->get_uorb_communicator();
+	int ret = PX4_OK;
+
+	if (ch != nullptr) {
+		ret = ch->send_message(_meta->o_name, _meta->o_size, _loan_spare);
+	}
+
+	/* swap the loaned element into the queue: the replaced element becomes the next spare */
+	lock();
+	seq_write_begin();
+
+	uint8_t **slot = &_loan_elements[_generation % _queue_size];
+	uint8_t *replaced = *slot;
+	__atomic_store_n(slot, _loan_spare, __ATOMIC_RELAXED);
+	_loan_spare = replaced;
+
+	_last_update = hrt_absolute_time();
+	set_publish_time();
+	_generation++;
+
+	seq_write_end();
+	_published = true;
+	_loan_active = false;
+	unlock();
+
+	/* notify any poll waiters */
+	poll_notify(POLLIN);
+
+	set_update_flags(nullptr);
+	schedule_work_callbacks();
+
+	if (ret != 0) {
+		warnx("[uORB::DeviceNode::loan_commit(%d)]: Error Sending [%s] topic data over comm_channel",
+		      __LINE__, _meta->o_name);
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
+int
+uORB::DeviceNode::loan_cancel()
+{
+	lock();
+
+	if (!_loan_active) {
+		unlock();
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	/* nothing was written to the queue */
+	_loan_active = false;
+	unlock();
+
+	return PX4_OK;
+}
+
+#endif /* __PX4_NUTTX */
+
+void *
+uORB::DeviceNode::register_work_callback(int qid, worker_t worker, void *arg)
+{
+	WorkCallback *callback = new WorkCallback();
+
+	if (callback == nullptr) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+
+	callback->qid = qid;
+	callback->worker = worker;
+	callback->arg = arg;
+	callback->pending = false;
+	callback->running = false;
+	callback->removed = false;
+	callback->free_on_idle = false;
+	callback->node = this;
+
+	ATOMIC_ENTER;
+	callback->next = _work_callbacks;
+	_work_callbacks = callback;
+	ATOMIC_LEAVE;
+
+	return callback;
+}
+
+int
+uORB::DeviceNode::unregister_work_callback(void *handle)
+{
+	WorkCallback *callback = (WorkCallback *)handle;
+
+	if (callback == nullptr) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	return callback->node->remove_work_callback(callback);
+}
+
+int
+uORB::DeviceNode::remove_work_callback(WorkCallback *callback)
+{
+	bool found = false;
+	bool wait = false;
+	bool free_now = false;
+
+	{
+		ATOMIC_ENTER;
+
+		for (WorkCallback **prev = &_work_callbacks; *prev != nullptr; prev = &(*prev)->next) {
+			if (*prev == callback) {
+				*prev = callback->next;
+				found = true;
+				break;
+			}
+		}
+
+		if (found) {
+			/* it is not queued again, and a queued work does not call the worker anymore */
+			callback->removed = true;
+
+			if (!callback->running) {
+				free_now = release_work_callback(callback);
+
+			} else if (pthread_equal(callback->thread, pthread_self())) {
+				/* called from the worker: the trampoline frees it after the worker returned */
+				callback->free_on_idle = true;
+
+			} else {
+				wait = true;
+			}
+		}
+
+		ATOMIC_LEAVE;
+	}
+
+	if (!found) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	/* the worker runs on another thread and may still use the callback (and its arg) */
+	while (wait) {
+		usleep(1000);
+
+		ATOMIC_ENTER;
+
+		if (!callback->running) {
+			free_now = release_work_callback(callback);
+			wait = false;
+		}
+
+		ATOMIC_LEAVE;
+	}
+
+	if (free_now) {
+		delete callback;
+	}
+
+	return PX4_OK;
+}
+
+bool
+uORB::DeviceNode::release_work_callback(WorkCallback *callback)
+{
+	if (callback->pending) {
+		/* the work is queued or about to be executed: the trampoline frees it */
+		callback->free_on_idle = true;
+		return false;
+	}
+
+	return true;
+}
+
+void
+uORB::DeviceNode::schedule_work_callbacks()
+{
+	if (_work_callbacks == nullptr) {
+		return;
+	}
+
+	ATOMIC_ENTER;
+
+	for (WorkCallback *callback = _work_callbacks; callback != nullptr; callback = callback->next) {
+		/* the work may only be queued again once it has been taken off the queue */
+		if (!callback->pending) {
+			callback->pending = true;
+			work_queue(callback->qid, &callback->work, &DeviceNode::work_callback_trampoline, callback, 0);
+		}
+	}
+
+	ATOMIC_LEAVE;
+}
+
+void
+uORB::DeviceNode::work_callback_trampoline(void *arg)
+{
+	WorkCallback *callback = (WorkCallback *)arg;
+	DeviceNode *node = callback->node;
+
+	if (node->work_callback_begin(callback)) {
+		callback->worker(callback->arg);
+	}
+
+	if (node->work_callback_end(callback)) {
+		delete callback;
+	}
+}
+
+bool
+uORB::DeviceNode::work_callback_begin(WorkCallback *callback)
+{
+	ATOMIC_ENTER;
+
+	/* publications from now on queue the work again */
+	callback->pending = false;
+
+	if (!callback->removed) {
+		callback->running = true;
+		callback->thread = pthread_self();
+	}
+
+	const bool run = callback->running;
+
+	ATOMIC_LEAVE;
+
+	return run;
+}
+
+bool
+uORB::DeviceNode::work_callback_end(WorkCallback *callback)
+{
+	ATOMIC_ENTER;
+
+	callback->running = false;
+	const bool free_callback = callback->free_on_idle && !callback->pending;
+
+	ATOMIC_LEAVE;
+
+	return free_callback;
+}
+
 pollevent_t
 uORB::DeviceNode::poll_state(device::file_t *filp)
 {
@@ -537,7 +1224,7 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 		/*
 		 * Handle non-rate-limited subscribers.
 		 */
-		if (sd->update_interval == nullptr) {
+		if (sd->interval_group == nullptr) {
 			ret = true;
 			break;
 		}
@@ -550,37 +1237,11 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 		 * until the topic is read.
 		 */
 		if (sd->update_reported()) {
-			ret = true;
-			break;
-		}
-
-		/*
-		 * If the interval timer is still running, the topic should not
-		 * appear updated, even though at this point we know that it has.
-		 * We have previously been through here, so the subscriber
-		 * must have collected the update we reported, otherwise
-		 * update_reported would still be true.
-		 */
-		if (!hrt_called(&sd->update_interval->update_call)) {
-			break;
-		}
-
-		/*
-		 * Make sure that we don't consider the topic to be updated again
-		 * until the interval has passed once more by restarting the interval
-		 * timer and thereby re-scheduling a poll notification at that time.
-		 */
-		hrt_call_after(&sd->update_interval->update_call,
-			       sd->update_interval->interval,
-			       &uORB::DeviceNode::update_deferred_trampoline,
-			       (void *)this);
-
-		/*
-		 * Remember that we have told the subscriber that there is data.
-		 */
-		sd->set_update_reported(true);
-		ret = true;
+			ret = true;
+			break;
+		}
 
+		ret = interval_update_allowed(sd);
 		break;
 	}
 
@@ -620,7 +1281,7 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 		/*
 		 * Handle non-rate-limited subscribers.
 		 */
-		if (sd->update_interval == nullptr) {
+		if (sd->interval_group == nullptr) {
 			ret = true;
 			break;
 		}
@@ -637,42 +1298,191 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 			break;
 		}
 
-		// If we have not yet reached the deadline, then assume that we can ignore any
-		// newly received data.
-		if (sd->update_interval->last_update + sd->update_interval->interval > hrt_absolute_time()) {
+		ret = interval_update_allowed(sd);
+		break;
+	}
+
+	return ret;
+}
+#endif /* ifdef __PX4_NUTTX */
+
+bool
+uORB::DeviceNode::interval_update_allowed(SubscriberData *sd)
+{
+	IntervalGroup *group = sd->interval_group;
+
+	/*
+	 * Start a new period if the last one expired. All subscribers of the group
+	 * share the period (and the timer), instead of each restarting its own timer.
+	 */
+	if (hrt_called(&group->update_call)) {
+		++group->period;
+		group->generation = _generation;
+		++_interval_callouts;
+
+		hrt_call_after(&group->update_call,
+			       group->interval,
+			       &uORB::DeviceNode::update_deferred_trampoline,
+			       (void *)group);
+	}
+
+	/*
+	 * The topic should not appear updated if the subscriber was already told about
+	 * an update in this period, even though at this point we know that it has.
+	 */
+	if (sd->interval_period == group->period) {
+		return false;
+	}
+
+	/*
+	 * Remember that we have told the subscriber that there is data.
+	 */
+	sd->interval_period = group->period;
+	sd->set_update_reported(true);
+	return true;
+}
+
+int
+uORB::DeviceNode::set_interval_group(SubscriberData *sd, unsigned interval)
+{
+	IntervalGroup *group = sd->interval_group;
+
+	if (group != nullptr) {
+		if (group->interval == interval) {
+			return PX4_OK;
+		}
+
+		--group->subscriber_count;
+		sd->interval_group = nullptr;
+	}
+
+	if (interval == 0) {
+		return PX4_OK;
+	}
+
+	for (group = _interval_groups; group != nullptr; group = group->next) {
+		if (group->interval == interval) {
 			break;
 		}
+	}
 
-		/*
-		 * Remember that we have told the subscriber that there is data.
-		 */
-		sd->set_update_reported(true);
-		sd->update_interval->last_update = hrt_absolute_time();
-		ret = true;
+	if (group == nullptr) {
+		group = new IntervalGroup();
 
-		break;
+		if (group == nullptr) {
+			return -ENOMEM;
+		}
+
+		memset(group, 0, sizeof(*group));
+		group->interval = interval;
+		group->node = this;
+		group->next = _interval_groups;
+		_interval_groups = group;
 	}
 
-	return ret;
+	++group->subscriber_count;
+
+	/* the subscriber can see an update in the current period */
+	sd->interval_period = group->period - 1;
+	sd->interval_group = group;
+	return PX4_OK;
 }
-#endif /* ifdef __PX4_NUTTX */
 
 void
-uORB::DeviceNode::update_deferred()
+uORB::DeviceNode::update_deferred(IntervalGroup *group)
 {
 	/*
-	 * Instigate a poll notification; any subscribers whose intervals have
-	 * expired will be woken.
+	 * Instigate a poll notification if there was a publication during the period;
+	 * the subscribers of the group that were held back will be woken.
 	 */
-	poll_notify(POLLIN);
+	if (group->generation != _generation) {
+		poll_notify(POLLIN);
+		set_update_flags(group);
+	}
+}
+
+int
+uORB::DeviceNode::set_update_flag(SubscriberData *sd, const orb_update_flag_data *data)
+{
+	UpdateFlag *flag = nullptr;
+
+	if (data->flags != nullptr && sd->update_flag == nullptr) {
+		flag = new UpdateFlag();
+
+		if (flag == nullptr) {
+			return -ENOMEM;
+		}
+
+		flag->sd = sd;
+	}
+
+	ATOMIC_ENTER;
+
+	if (data->flags == nullptr) {
+		/* remove */
+		for (UpdateFlag **prev = &_update_flags; *prev != nullptr; prev = &(*prev)->next) {
+			if (*prev == sd->update_flag) {
+				*prev = sd->update_flag->next;
+				flag = sd->update_flag;
+				break;
+			}
+		}
+
+		sd->update_flag = nullptr;
+
+	} else {
+		if (flag != nullptr) {
+			flag->next = _update_flags;
+			_update_flags = flag;
+			sd->update_flag = flag;
+		}
+
+		sd->update_flag->flags = data->flags;
+		sd->update_flag->mask = data->mask;
+		flag = nullptr;
+	}
+
+	ATOMIC_LEAVE;
+
+	delete flag;
+	return PX4_OK;
+}
+
+void
+uORB::DeviceNode::set_update_flags(IntervalGroup *group)
+{
+	if (_update_flags == nullptr) {
+		return;
+	}
+
+	ATOMIC_ENTER;
+
+	for (UpdateFlag *flag = _update_flags; flag != nullptr; flag = flag->next) {
+		IntervalGroup *sd_group = flag->sd->interval_group;
+
+		if (group != nullptr) {
+			if (sd_group != group) {
+				continue;
+			}
+
+		} else if (sd_group != nullptr && !hrt_called(&sd_group->update_call)
+			   && flag->sd->interval_period == sd_group->period) {
+			/* already reported in the current period, update_deferred() flags it */
+			continue;
+		}
+
+		__atomic_fetch_or(flag->flags, flag->mask, __ATOMIC_RELEASE);
+	}
+
+	ATOMIC_LEAVE;
 }
 
 void
 uORB::DeviceNode::update_deferred_trampoline(void *arg)
 {
-	uORB::DeviceNode *node = (uORB::DeviceNode *)arg;
+	IntervalGroup *group = (IntervalGroup *)arg;
 
-	node->update_deferred();
+	group->node->update_deferred(group);
 }
 
 bool
@@ -696,6 +1506,161 @@ uORB::DeviceNode::print_statistics(bool reset)
 	return true;
 }
 
+void
+uORB::DeviceNode::allocate_publish_times()
+{
+#ifdef __PX4_NUTTX
+
+	if (up_interrupt_context()) {
+		return;
+	}
+
+#endif
+
+	lock();
+
+	if (_publish_times == nullptr) {
+		hrt_abstime *publish_times = new hrt_abstime[_queue_size];
+
+		if (publish_times != nullptr) {
+			/* 0 means unknown: elements published before are not recorded */
+			memset(publish_times, 0, sizeof(hrt_abstime) * _queue_size);
+		}
+
+		_publish_times = publish_times;
+	}
+
+	unlock();
+}
+
+void
+uORB::DeviceNode::record_latency(SubscriberData *sd, hrt_abstime latency, unsigned queue_depth)
+{
+	if (!_latency_statistics_enabled) {
+		return;
+	}
+
+	if (sd->latency == nullptr) {
+		/* first copy of this subscriber: the subscriber data is only modified by the subscriber itself */
+		LatencyStatistics *statistics = new LatencyStatistics();
+
+		if (statistics == nullptr) {
+			return;
+		}
+
+		strncpy(statistics->task_name, px4_get_taskname(), sizeof(statistics->task_name) - 1);
+
+		lock();
+		statistics->next = _latency_statistics;
+		_latency_statistics = statistics;
+		sd->latency = statistics;
+		unlock();
+	}
+
+	static const hrt_abstime latency_bounds[latency_buckets - 1] = {100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000};
+	int latency_bucket = 0;
+
+	while (latency_bucket < latency_buckets - 1 && latency >= latency_bounds[latency_bucket]) {
+		++latency_bucket;
+	}
+
+	int queue_depth_bucket = 0;
+
+	while (queue_depth_bucket < queue_depth_buckets - 1 && queue_depth > (1u << queue_depth_bucket)) {
+		++queue_depth_bucket;
+	}
+
+	/* written by the subscriber only, readers of the statistics can tolerate torn updates */
+	LatencyStatistics *statistics = sd->latency;
+	++statistics->latency_histogram[latency_bucket];
+	++statistics->queue_depth_histogram[queue_depth_bucket];
+	++statistics->count;
+	statistics->latency_sum += latency;
+
+	if (latency > statistics->latency_max) {
+		statistics->latency_max = latency;
+	}
+}
+
+void
+uORB::DeviceNode::remove_latency_statistics(SubscriberData *sd)
+{
+	if (sd->latency == nullptr) {
+		return;
+	}
+
+	lock();
+
+	for (LatencyStatistics **prev = &_latency_statistics; *prev != nullptr; prev = &(*prev)->next) {
+		if (*prev == sd->latency) {
+			*prev = sd->latency->next;
+			break;
+		}
+	}
+
+	_closed_latency_sum += sd->latency->latency_sum;
+	_closed_latency_count += sd->latency->count;
+	unlock();
+
+	delete sd->latency;
+	sd->latency = nullptr;
+}
+
+void
+uORB::DeviceNode::get_latency_totals(uint64_t &latency_sum, uint32_t &count)
+{
+	lock();
+	latency_sum = _closed_latency_sum;
+	count = _closed_latency_count;
+
+	for (LatencyStatistics *statistics = _latency_statistics; statistics; statistics = statistics->next) {
+		latency_sum += statistics->latency_sum;
+		count += statistics->count;
+	}
+
+	unlock();
+}
+
+bool
+uORB::DeviceNode::print_latency_statistics(bool reset)
+{
+	bool had_print = false;
+
+	lock();
+
+	for (LatencyStatistics *statistics = _latency_statistics; statistics; statistics = statistics->next) {
+		if (statistics->count == 0) {
+			continue;
+		}
+
+		const uint32_t *l = statistics->latency_histogram;
+		const uint32_t *q = statistics->queue_depth_histogram;
+		PX4_INFO("%s -> %s: %u copies, latency mean %u us, max %u us", _meta->o_name, statistics->task_name,
+			 (unsigned)statistics->count, (unsigned)(statistics->latency_sum / statistics->count),
+			 (unsigned)statistics->latency_max);
+		PX4_INFO("  latency [ms]  <0.1:%u <0.2:%u <0.5:%u <1:%u <2:%u <5:%u <10:%u <20:%u <50:%u >=50:%u",
+			 (unsigned)l[0], (unsigned)l[1], (unsigned)l[2], (unsigned)l[3], (unsigned)l[4],
+			 (unsigned)l[5], (unsigned)l[6], (unsigned)l[7], (unsigned)l[8], (unsigned)l[9]);
+		PX4_INFO("  queue depth   1:%u 2:%u 3-4:%u 5-8:%u >8:%u",
+			 (unsigned)q[0], (unsigned)q[1], (unsigned)q[2], (unsigned)q[3], (unsigned)q[4]);
+		had_print = true;
+
+		if (reset) {
+			_closed_latency_sum += statistics->latency_sum;
+			_closed_latency_count += statistics->count;
+			memset(statistics->latency_histogram, 0, sizeof(statistics->latency_histogram));
+			memset(statistics->queue_depth_histogram, 0, sizeof(statistics->queue_depth_histogram));
+			statistics->count = 0;
+			statistics->latency_sum = 0;
+			statistics->latency_max = 0;
+		}
+	}
+
+	unlock();
+
+	return had_print;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void uORB::DeviceNode::add_internal_subscriber()
@@ -764,8 +1729,8 @@ int16_t uORB::DeviceNode::process_add_subscription(int32_t rateInHz)
 	// send the data to the remote entity.
 	uORBCommunicator::IChannel *ch = uORB::Manager::get_instance()->get_uorb_communicator();
 
-	if (_data != nullptr && ch != nullptr) { // _data will not be null if there is a publisher.
-		ch->send_message(_meta->o_name, _meta->o_size, _data);
+	if (_published && ch != nullptr) {
+		ch->send_message(_meta->o_name, _meta->o_size, element_data(_generation - 1));
 	}
 
 	return PX4_OK;
@@ -911,11 +1876,11 @@ uORB::DeviceMaster::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 
 				} else {
 					// add to the node map;.
-#ifdef __PX4_NUTTX
-					_node_map.insert(devpath, node);
-#else
-					_node_map[std::string(devpath)] = node;
-#endif
+					if (!_node_map.insert(devpath, node)) {
+						delete node;
+						free((void *)devpath);
+						return -ENOMEM;
+					}
 				}
 
 				group_tries++;
@@ -946,21 +1911,89 @@ void uORB::DeviceMaster::printStatistics(bool reset)
 	bool had_print = false;
 
 	lock();
-	ITERATE_NODE_MAP() {
-		INIT_NODE_MAP_VARS(node, node_name)
+	unsigned num_nodes;
+	ORBMap::Node **nodes = sortedNodesLocked(num_nodes);
 
-		if (node->print_statistics(reset)) {
+	for (unsigned i = 0; i < num_nodes; ++i) {
+		if (nodes[i]->node->print_statistics(reset)) {
 			had_print = true;
 		}
 	}
 
 	unlock();
+	delete[] nodes;
 
 	if (!had_print) {
 		PX4_INFO("No lost messages");
 	}
 }
 
+void uORB::DeviceMaster::announceSubscriptions(uORBCommunicator::IChannel *channel)
+{
+	/* collect the names first: the channel must not be called with the lock held, as its receive
+	 * thread can publish (and create nodes) while holding its own locks */
+	lock();
+	int num_nodes = 0;
+
+	ITERATE_NODE_MAP() {
+		++num_nodes;
+	}
+
+	const char **names = new const char *[num_nodes];
+	int num_subscribed = 0;
+
+	if (names != nullptr) {
+		ITERATE_NODE_MAP() {
+			INIT_NODE_MAP_VARS(node, node_name)
+
+			if (node->subscriber_count() > 0) {
+				names[num_subscribed++] = node->get_meta()->o_name;
+			}
+		}
+	}
+
+	unlock();
+
+	if (names == nullptr) {
+		PX4_ERR("failed to announce the subscriptions");
+		return;
+	}
+
+	/* multi-instance topics appear more than once, which is fine for add_subscription() */
+	for (int i = 0; i < num_subscribed; ++i) {
+		channel->add_subscription(names[i], 1);
+	}
+
+	delete[] names;
+}
+
+void uORB::DeviceMaster::printLatencyStatistics(bool reset)
+{
+	if (!DeviceNode::latency_statistics_enabled()) {
+		PX4_INFO("latency statistics are disabled (enable with 'uorb latency on')");
+		return;
+	}
+
+	bool had_print = false;
+
+	lock();
+	unsigned num_nodes;
+	ORBMap::Node **nodes = sortedNodesLocked(num_nodes);
+
+	for (unsigned i = 0; i < num_nodes; ++i) {
+		if (nodes[i]->node->print_latency_statistics(reset)) {
+			had_print = true;
+		}
+	}
+
+	unlock();
+	delete[] nodes;
+
+	if (!had_print) {
+		PX4_INFO("No copies recorded");
+	}
+}
+
 void uORB::DeviceMaster::addNewDeviceNodes(DeviceNodeStatisticsData **first_node, int &num_topics,
 		size_t &max_topic_name_length,
 		char **topic_filter, int num_filters)
@@ -976,8 +2009,13 @@ void uORB::DeviceMaster::addNewDeviceNodes(DeviceNodeStatisticsData **first_node
 	}
 
 
-	ITERATE_NODE_MAP() {
-		INIT_NODE_MAP_VARS(node, node_name)
+	/* new nodes are appended, in the order of their path */
+	unsigned num_nodes;
+	ORBMap::Node **nodes = sortedNodesLocked(num_nodes);
+
+	for (unsigned n = 0; n < num_nodes; ++n) {
+		DeviceNode *node = nodes[n]->node;
+		const char *node_name = nodes[n]->node_name;
 		++num_topics;
 
 		//check if already added
@@ -1029,7 +2067,33 @@ void uORB::DeviceMaster::addNewDeviceNodes(DeviceNodeStatisticsData **first_node
 
 		last_node->last_lost_msg_count = last_node->node->lost_message_count();
 		last_node->last_pub_msg_count = last_node->node->published_message_count();
+		last_node->node->get_latency_totals(last_node->last_latency_sum, last_node->last_latency_count);
+	}
+
+	delete[] nodes;
+}
+
+static int compare_node_names(const void *a, const void *b)
+{
+	return strcmp((*(const uORB::ORBMap::Node * const *)a)->node_name, (*(const uORB::ORBMap::Node * const *)b)->node_name);
+}
+
+uORB::ORBMap::Node **uORB::DeviceMaster::sortedNodesLocked(unsigned &num_nodes)
+{
+	num_nodes = 0;
+	ORBMap::Node **nodes = new ORBMap::Node *[_node_map.size() + 1];
+
+	if (nodes == nullptr) {
+		PX4_ERR("mem alloc failed");
+		return nullptr;
+	}
+
+	ITERATE_NODE_MAP() {
+		nodes[num_nodes++] = node_iter;
 	}
+
+	qsort(nodes, num_nodes, sizeof(nodes[0]), compare_node_names);
+	return nodes;
 }
 
 #define CLEAR_LINE "\033[K"
@@ -1122,6 +2186,14 @@ void uORB::DeviceMaster::showTop(char **topic_filter, int num_filters)
 				cur_node->lost_msg_delta = (num_lost - cur_node->last_lost_msg_count) / dt;
 				cur_node->last_lost_msg_count = num_lost;
 				cur_node->last_pub_msg_count = num_msgs;
+
+				uint64_t latency_sum;
+				uint32_t latency_count;
+				cur_node->node->get_latency_totals(latency_sum, latency_count);
+				cur_node->mean_latency = latency_count > cur_node->last_latency_count ?
+							 (latency_sum - cur_node->last_latency_sum) / (latency_count - cur_node->last_latency_count) : 0;
+				cur_node->last_latency_sum = latency_sum;
+				cur_node->last_latency_count = latency_count;
 				cur_node = cur_node->next;
 			}
 
@@ -1131,9 +2203,9 @@ void uORB::DeviceMaster::showTop(char **topic_filter, int num_filters)
 			printf("\033[H"); // move cursor home and clear screen
 			printf(CLEAR_LINE "update: 1s, num topics: %i\n", num_topics);
 #ifdef __PX4_NUTTX
-			printf(CLEAR_LINE "%*-s INST #SUB #MSG #LOST #QSIZE\n", (int)max_topic_name_length - 2, "TOPIC NAME");
+			printf(CLEAR_LINE "%*-s INST #SUB #MSG #LOST #QSIZE #LAT(us)\n", (int)max_topic_name_length - 2, "TOPIC NAME");
 #else
-			printf(CLEAR_LINE "%*s INST #SUB #MSG #LOST #QSIZE\n", -(int)max_topic_name_length + 2, "TOPIC NAME");
+			printf(CLEAR_LINE "%*s INST #SUB #MSG #LOST #QSIZE #LAT(us)\n", -(int)max_topic_name_length + 2, "TOPIC NAME");
 #endif
 			cur_node = first_node;
 
@@ -1141,13 +2213,14 @@ void uORB::DeviceMaster::showTop(char **topic_filter, int num_filters)
 
 				if (!print_active_only || cur_node->pub_msg_delta > 0) {
 #ifdef __PX4_NUTTX
-					printf(CLEAR_LINE "%*-s %2i %4i %4i %5i %i\n", (int)max_topic_name_length,
+					printf(CLEAR_LINE "%*-s %2i %4i %4i %5i %6i %8i\n", (int)max_topic_name_length,
 #else
-					printf(CLEAR_LINE "%*s %2i %4i %4i %5i %i\n", -(int)max_topic_name_length,
+					printf(CLEAR_LINE "%*s %2i %4i %4i %5i %6i %8i\n", -(int)max_topic_name_length,
 #endif
 					       cur_node->node->get_meta()->o_name, (int)cur_node->instance,
 					       (int)cur_node->node->subscriber_count(), cur_node->pub_msg_delta,
-					       (int)cur_node->lost_msg_delta, cur_node->node->get_queue_size());
+					       (int)cur_node->lost_msg_delta, cur_node->node->get_queue_size(),
+					       (int)cur_node->mean_latency);
 				}
 
 				cur_node = cur_node->next;
@@ -1181,32 +2254,7 @@ uORB::DeviceNode *uORB::DeviceMaster::getDeviceNode(const char *nodepath)
 	return node;
 }
 
-
-#ifdef __PX4_NUTTX
-uORB::DeviceNode *uORB::DeviceMaster::getDeviceNodeLocked(const char *nodepath)
-{
-	uORB::DeviceNode *rc = nullptr;
-
-	if (_node_map.find(nodepath)) {
-		rc = _node_map.get(nodepath);
-	}
-
-	return rc;
-}
-
-#else
-
 uORB::DeviceNode *uORB::DeviceMaster::getDeviceNodeLocked(const char *nodepath)
 {
-	uORB::DeviceNode *rc = nullptr;
-	std::string np(nodepath);
-
-	auto iter = _node_map.find(np);
-
-	if (iter != _node_map.end()) {
-		rc = iter->second;
-	}
-
-	return rc;
+	return _node_map.get(nodepath);
 }
-#endif
@@ -34,13 +34,15 @@
 #pragma once
 
 #include <stdint.h>
+#include <pthread.h>
 #include "uORBCommon.hpp"
+#include "ORBMap.hpp"
+#include <px4_workqueue.h>
 
 
 #ifdef __PX4_NUTTX
 #include <string.h>
 #include <stdlib.h>
-#include "ORBMap.hpp"
 
 namespace device
 {
@@ -49,11 +51,6 @@ typedef ::file file_t;
 typedef CDev VDev;
 }
 
-#else
-
-#include <string>
-#include <map>
-
 #endif /* __PX4_NUTTX */
 
 
@@ -65,6 +62,11 @@ class DeviceMaster;
 class Manager;
 }
 
+namespace uORBCommunicator
+{
+class IChannel;
+}
+
 /**
  * Per-object device instance.
  */
@@ -125,6 +127,32 @@ public:
 
 	static int        unadvertise(orb_advert_t handle);
 
+	/**
+	 * Get a buffer for the next publication to this node (@see orb_loan()).
+	 */
+	static void      *loan(const orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Publish the buffer previously obtained with loan() (@see orb_publish_loaned()).
+	 */
+	static int        publish_loaned(const orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Give back the buffer previously obtained with loan() without publishing it (@see orb_loan_abort()).
+	 */
+	static int        loan_abort(const orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Queue a work item on every publication of this node (@see orb_register_work_callback()).
+	 * @return handle for unregister_work_callback(), nullptr on error
+	 */
+	void             *register_work_callback(int qid, worker_t worker, void *arg);
+
+	/**
+	 * Remove a work item registered with register_work_callback().
+	 */
+	static int        unregister_work_callback(void *handle);
+
 	/**
 	 * processes a request for add subscription from remote
 	 * @param rateInHz
@@ -185,10 +213,53 @@ public:
 	 */
 	bool print_statistics(bool reset);
 
+	/**
+	 * Enable or disable recording of the publication to copy latency and the queue depth
+	 * seen by each subscriber (for all topics). Only copies of new data are recorded.
+	 */
+	static void enable_latency_statistics(bool enable) { _latency_statistics_enabled = enable; }
+	static bool latency_statistics_enabled() { return _latency_statistics_enabled; }
+
+	/**
+	 * Print the latency and queue depth histograms of each subscriber.
+	 * @param reset if true, reset statistics afterwards
+	 * @return true if printed something, false otherwise (if nothing was recorded)
+	 */
+	bool print_latency_statistics(bool reset);
+
+	/**
+	 * Get the sum of all recorded latencies [us] and the number of recorded copies, over all
+	 * subscribers (including the ones that have unsubscribed).
+	 */
+	void get_latency_totals(uint64_t &latency_sum, uint32_t &count);
+
+	/**
+	 * Copy the next element for a subscriber that does not use a file descriptor
+	 * (@see uORB::DirectSubscription). Same semantics as orb_copy(), but intervals
+	 * and latency statistics are not supported.
+	 * @param dst destination buffer of o_size bytes
+	 * @param generation in: last generation seen by the subscriber, out: generation after the copy
+	 * @return false if nothing was published yet
+	 */
+	bool copy(void *dst, unsigned &generation);
+
 	unsigned int get_queue_size() const { return _queue_size; }
 	int16_t subscriber_count() const { return _subscriber_count; }
 	uint32_t lost_message_count() const { return _lost_messages; }
+	uint32_t interval_callout_count() const { return _interval_callouts; }
 	unsigned int published_message_count() const { return _generation; }
+
+	/**
+	 * Counter returned by published_message_count(), for subscribers that check it
+	 * inline (@see uORB::DirectSubscription). Nodes are never deleted.
+	 */
+	const volatile unsigned *published_message_counter() const { return &_generation; }
+
+	/**
+	 * Time of the last publication, 0 if none. Can be called without any lock, the
+	 * value is read consistently with respect to concurrent publications.
+	 */
+	hrt_abstime last_update();
 	const struct orb_metadata *get_meta() const { return _meta; }
 
 protected:
@@ -196,19 +267,56 @@ protected:
 	virtual void poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events);
 
 private:
-	struct UpdateIntervalData {
-		unsigned  interval; /**< if nonzero minimum interval between updates */
-		struct hrt_call update_call;  /**< deferred wakeup call if update_period is nonzero */
-#ifndef __PX4_NUTTX
-		uint64_t last_update; /**< time at which the last update was provided, used when update_interval is nonzero */
-#endif
+	/**
+	 * Rate-limited subscribers with the same interval share a group. Time is divided into periods of
+	 * the interval length, and each subscriber is reported at most one update per period. A period
+	 * starts when a subscriber in the group is reported an update, and it arms the group timer,
+	 * which wakes up the pollers if there was a publication during the period.
+	 * Groups are owned by the node and reused when subscribers set the same interval again.
+	 */
+	struct IntervalGroup {
+		unsigned interval; /**< [us] minimum interval between updates */
+		struct hrt_call update_call; /**< end of the current period */
+		unsigned period; /**< incremented whenever a period starts */
+		unsigned generation; /**< topic generation at the start of the current period */
+		int16_t subscriber_count;
+		DeviceNode *node;
+		IntervalGroup *next;
+	};
+	static const int latency_buckets = 10; /**< latency histogram buckets: < 0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, >= 50 ms */
+	static const int queue_depth_buckets = 5; /**< queue depth histogram buckets: 1, 2, 3-4, 5-8, > 8 */
+
+	struct LatencyStatistics {
+		char task_name[16]; /**< task that subscribed */
+		uint32_t latency_histogram[latency_buckets];
+		uint32_t queue_depth_histogram[queue_depth_buckets]; /**< number of unread messages, including the copied one */
+		uint32_t count; /**< number of recorded copies */
+		uint64_t latency_sum; /**< [us] */
+		uint32_t latency_max; /**< [us] */
+		LatencyStatistics *next;
+	};
+
+	struct SubscriberData;
+
+	/**
+	 * Bits set in a subscriber's bitmap when an update becomes visible to it (@see orb_set_update_flag()).
+	 */
+	struct UpdateFlag {
+		volatile uint32_t *flags;
+		uint32_t mask;
+		SubscriberData *sd;
+		UpdateFlag *next;
 	};
-	struct SubscriberData {
-		~SubscriberData() { if (update_interval) { delete(update_interval); } }
 
+	struct SubscriberData {
 		unsigned  generation; /**< last generation the subscriber has seen */
 		int   flags; /**< lowest 8 bits: priority of publisher, 9. bit: update_reported bit */
-		UpdateIntervalData *update_interval; /**< if null, no update interval */
+		IntervalGroup *interval_group; /**< if null, no update interval */
+		unsigned interval_period; /**< period of interval_group in which the last update was reported */
+		unsigned borrowed_element; /**< generation of the element handed out by ORBIOCBORROW */
+		bool borrowed; /**< true between ORBIOCBORROW and ORBIOCRETURN */
+		LatencyStatistics *latency; /**< allocated on the first copy with latency statistics enabled */
+		UpdateFlag *update_flag; /**< if null, no update flag */
 
 		int priority() const { return flags & 0xff; }
 		void set_priority(uint8_t prio) { flags = (flags & ~0xff) | prio; }
@@ -221,6 +329,9 @@ private:
 	uint8_t     *_data;   /**< allocated object buffer */
 	hrt_abstime   _last_update; /**< time the object was last updated */
 	volatile unsigned   _generation;  /**< object generation count */
+#ifndef __PX4_NUTTX
+	volatile unsigned   _seq;  /**< publication sequence lock: odd while a publication is in progress */
+#endif
 	const uint8_t   _priority;  /**< priority of the topic */
 	bool _published;  /**< has ever data been published */
 	uint8_t _queue_size; /**< maximum number of elements in the queue */
@@ -228,6 +339,45 @@ private:
 
 	inline static SubscriberData    *filp_to_sd(device::file_t *filp);
 
+#ifndef __PX4_NUTTX
+	/*
+	 * Sequence lock helpers. Publishers are serialized by lock() and bracket their update
+	 * with seq_write_begin()/seq_write_end(). Readers do not take the lock: they copy
+	 * optimistically and retry if seq_read_retry() reports a concurrent publication.
+	 */
+	inline void seq_write_begin()
+	{
+		__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	inline void seq_write_end()
+	{
+		__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELEASE);
+	}
+
+	inline unsigned seq_read_begin()
+	{
+		unsigned seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE);
+
+		while (seq & 1) {
+			/* a publication is in progress: block on the publisher's lock instead of spinning,
+			 * so that a preempted lower-priority publisher can finish */
+			lock();
+			unlock();
+			seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE);
+		}
+
+		return seq;
+	}
+
+	inline bool seq_read_retry(unsigned seq) const
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return __atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq;
+	}
+#endif
+
 #ifdef __PX4_NUTTX
 	pid_t     _publisher; /**< if nonzero, current publisher. Only used inside the advertise call.
 					We allow one publisher to have an open file descriptor at the same time. */
@@ -236,22 +386,226 @@ private:
 					We allow one publisher to have an open file descriptor at the same time. */
 #endif
 
+#ifndef __PX4_NUTTX
+	/*
+	 * Loaned publications are written into a spare element, which is swapped with the queue slot
+	 * on publication. The element table replaces the fixed layout of _data after the first loan.
+	 */
+	uint8_t **_loan_elements = nullptr; /**< queue elements by slot, nullptr until the first loan */
+	uint8_t *_loan_spare = nullptr; /**< element that is not in the queue: the buffer of the current loan */
+	bool _loan_active = false; /**< a loaned publication has been started and not yet published or aborted */
+#endif
+
+	struct WorkCallback {
+		struct work_s work; /**< work queue entry, owned by the node */
+		int qid; /**< work queue to run the worker on */
+		worker_t worker;
+		void *arg;
+		bool pending; /**< true while the work is queued (protected by the node lock) */
+		bool running; /**< true while the worker is executed (protected by the node lock) */
+		bool removed; /**< unregistered: the worker is not called anymore (protected by the node lock) */
+		bool free_on_idle; /**< removed, the trampoline frees it once it is neither pending nor running */
+		pthread_t thread; /**< thread executing the worker, valid while running */
+		DeviceNode *node;
+		WorkCallback *next;
+	};
+
+	WorkCallback *_work_callbacks = nullptr; /**< work items queued on publication (protected by the node lock) */
+
+	UpdateFlag *_update_flags = nullptr; /**< flags set on updates (protected by ATOMIC_ENTER) */
+
+	IntervalGroup *_interval_groups = nullptr; /**< (protected by the node lock) */
+	uint32_t _interval_callouts = 0; /**< number of started interval periods (hrt callouts) */
+
+	static volatile bool _latency_statistics_enabled;
+	hrt_abstime *_publish_times = nullptr; /**< publication time of each queue element, allocated with latency statistics */
+	LatencyStatistics *_latency_statistics = nullptr; /**< statistics of all subscribers (protected by the node lock) */
+	uint64_t _closed_latency_sum = 0; /**< totals of the subscribers that have unsubscribed */
+	uint32_t _closed_latency_count = 0;
+
 	//statistics
 	uint32_t _lost_messages = 0; ///< nr of lost messages for all subscribers. If two subscribers lose the same
 	///message, it is counted as two.
 
 	/**
-	 * Perform a deferred update for a rate-limited subscriber.
+	 * Allocate the queue if this has not been done yet.
+	 * @return false if the queue could not be allocated
+	 */
+	bool allocate_data();
+
+	/**
+	 * Get the next element for a subscriber out of the queue and update the subscriber state.
+	 * @param sd the subscriber
+	 * @param buffer destination buffer for a copy of the element, may be nullptr
+	 * @param element returns the generation of the element (@see element_data())
+	 */
+	void read_next(SubscriberData *sd, char *buffer, unsigned &element);
+
+	/**
+	 * Find the next element for a subscriber in the queue.
+	 * On NuttX this must be called inside ATOMIC_ENTER/ATOMIC_LEAVE, on POSIX inside a
+	 * sequence lock read section (it has no side effects on the node, so it can be repeated).
+	 * @param generation in: last generation seen by the subscriber, out: generation after the read
+	 * @param element returns the generation of the element to read
+	 * @return number of messages the subscriber lost
+	 */
+	unsigned next_element(unsigned &generation, unsigned &element);
+
+	/**
+	 * Copy all unread elements (oldest first) for a subscriber and update the subscriber state.
+	 * @param sd the subscriber
+	 * @param data buffer, max_count and the returned count and dropped elements
 	 */
-	void      update_deferred();
+	void read_all(SubscriberData *sd, orb_copy_all_data *data);
+
+	/**
+	 * Copy the unread elements for read_all(). Same locking requirements as next_element().
+	 * @param generation in: last generation seen by the subscriber, out: generation after the copy
+	 * @param count returns the number of copied elements
+	 * @return number of messages the subscriber lost
+	 */
+	unsigned copy_unread(unsigned &generation, orb_copy_all_data *data, unsigned &count);
+
+	/**
+	 * Queue slot in which a given generation is stored.
+	 */
+#ifdef __PX4_NUTTX
+	uint8_t *element_data(unsigned element) { return _data + _meta->o_size * (element % _queue_size); }
+#else
+	uint8_t *element_data(unsigned element)
+	{
+		uint8_t **elements = __atomic_load_n(&_loan_elements, __ATOMIC_ACQUIRE);
+
+		if (elements != nullptr) {
+			return __atomic_load_n(&elements[element % _queue_size], __ATOMIC_RELAXED);
+		}
+
+		return _data + _meta->o_size * (element % _queue_size);
+	}
+#endif
+
+	/**
+	 * Check whether the queue slot of an element has not been (or is not being) overwritten
+	 * by a later publication.
+	 */
+	bool element_valid(unsigned element);
+
+	/**
+	 * Record the latency of a copy for a subscriber.
+	 * @param latency time since the publication of the copied element [us]
+	 * @param queue_depth number of unread elements, including the copied one
+	 */
+	void record_latency(SubscriberData *sd, hrt_abstime latency, unsigned queue_depth);
+
+	/**
+	 * Remove and free the latency statistics of a subscriber.
+	 */
+	void remove_latency_statistics(SubscriberData *sd);
+
+	/**
+	 * Store the publication time of the element that is being published (called with the node locked).
+	 */
+	void set_publish_time()
+	{
+		if (_publish_times != nullptr) {
+			_publish_times[_generation % _queue_size] = _last_update;
+		}
+	}
+
+	/**
+	 * Allocate the publication times if latency statistics are enabled.
+	 */
+	void allocate_publish_times();
+
+#ifndef __PX4_NUTTX
+	/**
+	 * Start/complete/cancel a loaned publication.
+	 */
+	void *loan_begin();
+	int loan_commit();
+	int loan_cancel();
+#endif
+
+	/**
+	 * Queue the work items of all registered callbacks that are not queued yet.
+	 * Called after every publication.
+	 */
+	void schedule_work_callbacks();
+
+	/**
+	 * Work queue entry point of a WorkCallback: clears the pending state and runs the worker,
+	 * unless the callback has been removed. Frees a removed callback if it owns it.
+	 */
+	static void work_callback_trampoline(void *arg);
+
+	/**
+	 * Start executing a callback on the work queue.
+	 * @return true if the worker is to be called, false if the callback has been removed
+	 */
+	bool work_callback_begin(WorkCallback *callback);
+
+	/**
+	 * Finish executing a callback on the work queue.
+	 * @return true if the callback has been removed and is to be freed by the caller
+	 */
+	bool work_callback_end(WorkCallback *callback);
+
+	/**
+	 * Unlink a registered callback and free it once the worker is not executed anymore.
+	 * If the work is still queued, or this is called from the worker itself, the trampoline
+	 * frees it instead. Otherwise this waits for a worker running on another thread.
+	 * @return OK on success, ERROR if it is not registered with this node
+	 */
+	int remove_work_callback(WorkCallback *callback);
+
+	/**
+	 * Hand a removed callback that is not running to the trampoline if its work is still
+	 * queued (must be called with the node lock held).
+	 * @return true if nothing uses the callback anymore and the caller frees it
+	 */
+	bool release_work_callback(WorkCallback *callback);
+
+	/**
+	 * Add, change or remove (data->flags == nullptr) the update flag of a subscriber.
+	 * @return OK on success, -ENOMEM if the flag cannot be allocated
+	 */
+	int set_update_flag(SubscriberData *sd, const orb_update_flag_data *data);
+
+	/**
+	 * Set the update flags after a publication (group == nullptr), or after the end of an
+	 * interval period, in which case only the subscribers of the group are flagged.
+	 * Rate-limited subscribers are not flagged on publication while the update is held back,
+	 * the end of the period flags them instead.
+	 */
+	void set_update_flags(IntervalGroup *group);
+
+	/**
+	 * Perform a deferred update for the rate-limited subscribers of a group,
+	 * if the topic was published during the last period.
+	 */
+	void      update_deferred(IntervalGroup *group);
 
 	/**
 	 * Bridge from hrt_call to update_deferred
 	 *
-	 * void *arg    ORBDevNode pointer for which the deferred update is performed.
+	 * void *arg    IntervalGroup for which the deferred update is performed.
 	 */
 	static void   update_deferred_trampoline(void *arg);
 
+	/**
+	 * Move a subscriber to the group of an interval (or remove it from its group if interval is 0).
+	 * Lock must already be held when calling this.
+	 * @return OK on success, -ENOMEM if a new group cannot be allocated
+	 */
+	int       set_interval_group(SubscriberData *sd, unsigned interval);
+
+	/**
+	 * Check whether a rate-limited subscriber may be reported an update in the current
+	 * period of its group, and start a new period if the last one expired.
+	 * Lock must already be held when calling this.
+	 */
+	bool      interval_update_allowed(SubscriberData *sd);
+
 	/**
 	 * Check whether a topic appears updated to a subscriber.
 	 *
@@ -291,6 +645,12 @@ public:
 	 */
 	void printStatistics(bool reset);
 
+	/**
+	 * Print the latency statistics of each subscriber of each topic.
+	 * @param reset if true, reset statistics afterwards
+	 */
+	void printLatencyStatistics(bool reset);
+
 	/**
 	 * Continuously print statistics, like the unix top command for processes.
 	 * Exited when the user presses the enter key.
@@ -300,6 +660,12 @@ public:
 	 */
 	void showTop(char **topic_filter, int num_filters);
 
+	/**
+	 * Call add_subscription() of a communication channel for every topic with local subscribers.
+	 * This is for channels that are started after topics have been subscribed.
+	 */
+	void announceSubscriptions(uORBCommunicator::IChannel *channel);
+
 private:
 	// Private constructor, uORB::Manager takes care of its creation
 	DeviceMaster(Flavor f);
@@ -312,6 +678,9 @@ private:
 		unsigned int last_pub_msg_count;
 		uint32_t lost_msg_delta;
 		unsigned int pub_msg_delta;
+		uint64_t last_latency_sum;
+		uint32_t last_latency_count;
+		uint32_t mean_latency; ///< [us] over the last update interval (0 if nothing was recorded)
 		DeviceNodeStatisticsData *next = nullptr;
 	};
 	void addNewDeviceNodes(DeviceNodeStatisticsData **first_node, int &num_topics, size_t &max_topic_name_length,
@@ -326,13 +695,17 @@ private:
 	 */
 	uORB::DeviceNode *getDeviceNodeLocked(const char *node_name);
 
+	/**
+	 * Get the nodes sorted by path, for output (the node map iterates in hash order).
+	 * _lock must already be held when calling this.
+	 * @param num_nodes set to the number of returned nodes (0 on allocation failure)
+	 * @return array to be freed with delete[]
+	 */
+	ORBMap::Node **sortedNodesLocked(unsigned &num_nodes);
+
 	const Flavor _flavor;
 
-#ifdef __PX4_NUTTX
 	ORBMap _node_map;
-#else
-	std::map<std::string, uORB::DeviceNode *> _node_map;
-#endif
 	hrt_abstime       _last_statistics_output;
 };
 
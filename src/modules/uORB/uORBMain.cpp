@@ -43,9 +43,10 @@ extern "C" { __EXPORT int uorb_main(int argc, char *argv[]); }
 static uORB::DeviceMaster *g_dev = nullptr;
 static void usage()
 {
-	PX4_INFO("Usage: uorb 'start', 'status', 'top [-a] [<filter1> [<filter2> ...]]'");
+	PX4_INFO("Usage: uorb 'start', 'status', 'top [-a] [<filter1> [<filter2> ...]]', 'latency [on|off|-r]'");
 	PX4_INFO("       -a: print all instead of only currently publishing topics");
 	PX4_INFO("       <filter>: topic(s) to match (implies -a)");
+	PX4_INFO("       latency: enable/disable or print (-r: and reset) publication to copy latencies");
 }
 
 int
@@ -105,6 +106,23 @@ uorb_main(int argc, char *argv[])
 		return OK;
 	}
 
+	if (!strcmp(argv[1], "latency")) {
+		if (g_dev == nullptr) {
+			PX4_INFO("uorb is not running");
+
+		} else if (argc > 2 && !strcmp(argv[2], "on")) {
+			uORB::DeviceNode::enable_latency_statistics(true);
+
+		} else if (argc > 2 && !strcmp(argv[2], "off")) {
+			uORB::DeviceNode::enable_latency_statistics(false);
+
+		} else {
+			g_dev->printLatencyStatistics(argc > 2 && !strcmp(argv[2], "-r"));
+		}
+
+		return OK;
+	}
+
 	if (!strcmp(argv[1], "top")) {
 		if (g_dev != nullptr) {
 			g_dev->showTop(argv + 2, argc - 2);
@@ -120,7 +120,7 @@ uORB::DeviceMaster *uORB::Manager::get_device_master(Flavor flavor)
 int uORB::Manager::orb_exists(const struct orb_metadata *meta, int instance)
 {
 	/*
-	 * Generate the path to the node and try to open it.
+	 * Generate the path to the node and look it up.
 	 */
 	char path[orb_maxpath];
 	int inst = instance;
@@ -131,12 +131,16 @@ int uORB::Manager::orb_exists(const struct orb_metadata *meta, int instance)
 		return ERROR;
 	}
 
-#ifdef __PX4_NUTTX
-	struct stat buffer;
-	return stat(path, &buffer);
-#else
-	return px4_access(path, F_OK);
-#endif
+	/* every node is registered with the DeviceMaster, so a hashed lookup is enough. Do not
+	 * create the DeviceMaster here: without it there are no nodes */
+	DeviceMaster *device_master = _device_masters[PUBSUB];
+
+	if (device_master == nullptr || device_master->getDeviceNode(path) == nullptr) {
+		errno = ENOENT;
+		return ERROR;
+	}
+
+	return PX4_OK;
 }
 
 orb_advert_t uORB::Manager::orb_advertise_multi(const struct orb_metadata *meta, const void *data, int *instance,
@@ -250,6 +254,47 @@ int uORB::Manager::orb_publish(const struct orb_metadata *meta, orb_advert_t han
 	return uORB::DeviceNode::publish(meta, handle, data);
 }
 
+void *uORB::Manager::orb_loan(const struct orb_metadata *meta, orb_advert_t handle)
+{
+#ifdef ORB_USE_PUBLISHER_RULES
+
+	if (handle == _Instance) {
+		/* there is no node to write to, and the data would be dropped anyway */
+		errno = EPERM;
+		return nullptr;
+	}
+
+#endif /* ORB_USE_PUBLISHER_RULES */
+
+	return uORB::DeviceNode::loan(meta, handle);
+}
+
+int uORB::Manager::orb_publish_loaned(const struct orb_metadata *meta, orb_advert_t handle)
+{
+#ifdef ORB_USE_PUBLISHER_RULES
+
+	if (handle == _Instance) {
+		return PX4_OK; //pretend success
+	}
+
+#endif /* ORB_USE_PUBLISHER_RULES */
+
+	return uORB::DeviceNode::publish_loaned(meta, handle);
+}
+
+int uORB::Manager::orb_loan_abort(const struct orb_metadata *meta, orb_advert_t handle)
+{
+#ifdef ORB_USE_PUBLISHER_RULES
+
+	if (handle == _Instance) {
+		return PX4_OK;
+	}
+
+#endif /* ORB_USE_PUBLISHER_RULES */
+
+	return uORB::DeviceNode::loan_abort(meta, handle);
+}
+
 int uORB::Manager::orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
 {
 	int ret;
@@ -268,6 +313,59 @@ int uORB::Manager::orb_copy(const struct orb_metadata *meta, int handle, void *b
 	return PX4_OK;
 }
 
+int uORB::Manager::orb_copy_all(const struct orb_metadata *meta, int handle, void *buffer, unsigned max_count,
+				 unsigned *dropped)
+{
+	orb_copy_all_data data;
+	data.buffer = buffer;
+	data.max_count = max_count;
+	data.count = 0;
+	data.dropped = 0;
+
+	int ret = px4_ioctl(handle, ORBIOCCOPYALL, (unsigned long)(uintptr_t)&data);
+
+	if (ret < 0) {
+#ifndef __PX4_NUTTX
+		errno = -ret;
+#endif
+		return ERROR;
+	}
+
+	if (dropped) {
+		*dropped = data.dropped;
+	}
+
+	return data.count;
+}
+
+int uORB::Manager::orb_borrow(const struct orb_metadata *meta, int handle, const void **buffer)
+{
+	int ret = px4_ioctl(handle, ORBIOCBORROW, (unsigned long)(uintptr_t)buffer);
+
+	if (ret < 0) {
+#ifndef __PX4_NUTTX
+		errno = -ret;
+#endif
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
+int uORB::Manager::orb_return(const struct orb_metadata *meta, int handle)
+{
+	int ret = px4_ioctl(handle, ORBIOCRETURN, 0);
+
+	if (ret < 0) {
+#ifndef __PX4_NUTTX
+		errno = -ret;
+#endif
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
 int uORB::Manager::orb_check(int handle, bool *updated)
 {
 	/* Set to false here so that if `px4_ioctl` fails to false. */
@@ -298,6 +396,63 @@ int uORB::Manager::orb_get_interval(int handle, unsigned *interval)
 	return ret;
 }
 
+int uORB::Manager::orb_set_update_flag(int handle, volatile uint32_t *flags, uint32_t mask)
+{
+	orb_update_flag_data data;
+	data.flags = flags;
+	data.mask = mask;
+
+	int ret = px4_ioctl(handle, ORBIOCSETUPDATEFLAG, (unsigned long)(uintptr_t)&data);
+
+	if (ret < 0) {
+#ifndef __PX4_NUTTX
+		errno = -ret;
+#endif
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
+orb_work_callback_t uORB::Manager::orb_register_work_callback(const struct orb_metadata *meta, unsigned instance,
+		int qid, void (*worker)(void *arg), void *arg)
+{
+	if (worker == nullptr) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	/* subscribing creates the node if it does not exist yet */
+	int fd = orb_subscribe_multi(meta, instance);
+
+	if (fd < 0) {
+		return nullptr;
+	}
+
+	char path[orb_maxpath];
+	int inst = instance;
+	DeviceNode *node = nullptr;
+	DeviceMaster *device_master = get_device_master(PUBSUB);
+
+	if (uORB::Utils::node_mkpath(path, PUBSUB, meta, &inst) == OK && device_master != nullptr) {
+		node = device_master->getDeviceNode(path);
+	}
+
+	orb_unsubscribe(fd);
+
+	if (node == nullptr) {
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	return node->register_work_callback(qid, worker, arg);
+}
+
+int uORB::Manager::orb_unregister_work_callback(orb_work_callback_t handle)
+{
+	return uORB::DeviceNode::unregister_work_callback(handle);
+}
+
 
 int uORB::Manager::node_advertise
 (
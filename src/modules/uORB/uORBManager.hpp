@@ -178,6 +178,53 @@ public:
 	 */
 	int  orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data) ;
 
+	/**
+	 * Get a buffer to fill in the next publication of a topic in place.
+	 *
+	 * This avoids the copy of orb_publish() for large messages: the returned
+	 * buffer is a spare queue element, which becomes part of the queue when it
+	 * is published with orb_publish_loaned() (the element it replaces becomes
+	 * the next spare). The data must be completely written before that, or the
+	 * buffer given back with orb_loan_abort(). No lock is held in between, so
+	 * subscribers and other publishers of the topic are not blocked, and the
+	 * buffer is not visible to subscribers until it is published.
+	 * There is one spare element per topic: orb_loan() fails with EBUSY while
+	 * another loan of the topic is in progress.
+	 * Loans are only supported on POSIX. On NuttX subscribers copy in a critical
+	 * section, so the loaned data would have to be copied anyway: orb_loan()
+	 * fails with ENOTSUP, and the caller falls back to orb_publish().
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  The handle returned from orb_advertise.
+	 * @return    Pointer to a buffer of meta->o_size bytes, nullptr on error
+	 *      with errno set accordingly.
+	 */
+	void *orb_loan(const struct orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Publish the buffer obtained with orb_loan().
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  The handle returned from orb_advertise.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_publish_loaned(const struct orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Give back the buffer obtained with orb_loan() without publishing it.
+	 *
+	 * Subscribers do not see an update, and the queued data is not changed.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  The handle returned from orb_advertise.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly
+	 *      (EINVAL if there is no loan in progress).
+	 */
+	int  orb_loan_abort(const struct orb_metadata *meta, orb_advert_t handle);
+
 	/**
 	 * Subscribe to a topic.
 	 *
@@ -266,6 +313,61 @@ public:
 	 */
 	int  orb_copy(const struct orb_metadata *meta, int handle, void *buffer) ;
 
+	/**
+	 * Borrow data from a topic without copying it.
+	 *
+	 * Like orb_copy(), this fetches the next element for the subscription and
+	 * resets the updated marker, but instead of copying the data it returns a
+	 * pointer into the topic's queue. The data can be overwritten by subsequent
+	 * publications at any time, so after using it the caller must call
+	 * orb_return() and discard any results if that fails. This is intended for
+	 * large topics that are read much more often than they are overwritten (or
+	 * which use a queue).
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  A handle returned from orb_subscribe.
+	 * @param buffer  Returns a pointer to the data.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_borrow(const struct orb_metadata *meta, int handle, const void **buffer);
+
+	/**
+	 * Fetch all unread data of a queued topic.
+	 *
+	 * In one pass this copies every element that was published since the last
+	 * copy for this handle, oldest first, and resets the updated marker. Unlike
+	 * orb_copy() nothing is copied if there is no new data. If more than
+	 * max_count elements are unread, the remaining ones are left for the next
+	 * call. Elements that were overwritten in the queue before they could be
+	 * copied are reported as dropped. Copies are not included in the latency
+	 * statistics.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  A handle returned from orb_subscribe.
+	 * @param buffer  Pointer to a buffer for max_count elements of meta->o_size bytes.
+	 * @param max_count  Maximum number of elements to copy.
+	 * @param dropped  If not null, returns the number of elements that were lost
+	 *      since the last copy.
+	 * @return    The number of copied elements, ERROR otherwise with errno set
+	 *      accordingly.
+	 */
+	int  orb_copy_all(const struct orb_metadata *meta, int handle, void *buffer, unsigned max_count,
+			  unsigned *dropped);
+
+	/**
+	 * Finish using the data returned by orb_borrow().
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  A handle returned from orb_subscribe.
+	 * @return    OK if the borrowed data stayed valid while it was used, ERROR
+	 *      otherwise with errno set to EAGAIN if it was overwritten by a
+	 *      publication (the data read from it must then be discarded).
+	 */
+	int  orb_return(const struct orb_metadata *meta, int handle);
+
 	/**
 	 * Check whether a topic has been published to since the last orb_copy.
 	 *
@@ -351,6 +453,63 @@ public:
 	 */
 	int	orb_get_interval(int handle, unsigned *interval);
 
+	/**
+	 * Mark a subscription as updated in a caller-owned bitmap.
+	 *
+	 * Whenever the topic is published (or, for a rate-limited subscription, an
+	 * update that was held back becomes visible), the bits in mask are atomically
+	 * set in *flags. This lets a subscriber that watches many topics find the
+	 * updated ones without an orb_check() for each: it atomically clears the
+	 * word (e.g. with __atomic_exchange_n()) and checks only the subscriptions
+	 * of the bits that were set. A set bit means that there may be an update,
+	 * orb_check() still decides. Only one word can be set per handle.
+	 *
+	 * The bitmap must remain valid until the flag is removed (flags = nullptr)
+	 * or the handle is closed.
+	 *
+	 * @param handle  A handle returned from orb_subscribe.
+	 * @param flags   Word in which to set the bits, nullptr to remove the flag.
+	 * @param mask    Bits to set.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int	orb_set_update_flag(int handle, volatile uint32_t *flags, uint32_t mask);
+
+	/**
+	 * Run a worker on a work queue whenever a topic is published.
+	 *
+	 * This allows a module to react to a topic without a task of its own that
+	 * waits in poll(): on every publication the work item is queued on the
+	 * given work queue (unless it is still queued from a previous publication,
+	 * in which case publications are coalesced). The worker typically reads the
+	 * topic with orb_copy() using a regular subscription handle.
+	 *
+	 * Like orb_subscribe(), registration succeeds if the topic has not been
+	 * advertised yet.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param instance  The instance of the topic.
+	 * @param qid     The work queue to run the worker on (HPWORK or LPWORK).
+	 * @param worker  The function to call on the work queue.
+	 * @param arg     The argument passed to the worker.
+	 * @return    A handle to unregister the callback, nullptr on error with
+	 *      errno set accordingly.
+	 */
+	orb_work_callback_t orb_register_work_callback(const struct orb_metadata *meta, unsigned instance, int qid,
+			void (*worker)(void *arg), void *arg);
+
+	/**
+	 * Stop running the worker of a callback registered with orb_register_work_callback().
+	 *
+	 * The worker is not called anymore once this returns. If the worker is being executed
+	 * on another thread, this waits for it to return. The worker itself may unregister
+	 * its callback.
+	 *
+	 * @param handle  The handle returned by orb_register_work_callback().
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int	orb_unregister_work_callback(orb_work_callback_t handle);
+
 	/**
 	 * Method to set the uORBCommunicator::IChannel instance.
 	 * @param comm_channel
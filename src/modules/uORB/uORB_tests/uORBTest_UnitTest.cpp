@@ -33,11 +33,16 @@
 
 #include "uORBTest_UnitTest.hpp"
 #include "../uORBCommon.hpp"
+#include "../uORBDevices.hpp"
+#include "../uORBManager.hpp"
+#include "../uORBUtils.hpp"
+#include "../DirectSubscription.hpp"
 #include <px4_config.h>
 #include <px4_time.h>
 #include <stdio.h>
 #include <errno.h>
 #include <poll.h>
+#include <px4_workqueue.h>
 
 ORB_DEFINE(orb_test, struct orb_test, sizeof(orb_test), "ORB_TEST:int val;hrt_abstime time;");
 ORB_DEFINE(orb_multitest, struct orb_test, sizeof(orb_test), "ORB_MULTITEST:int val;hrt_abstime time;");
@@ -51,6 +56,25 @@ ORB_DEFINE(orb_test_medium_queue, struct orb_test_medium, sizeof(orb_test_medium
 ORB_DEFINE(orb_test_medium_queue_poll, struct orb_test_medium, sizeof(orb_test_medium),
 	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
 
+ORB_DEFINE(orb_test_medium_contention, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_CONTENTION:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_loan, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_LOAN:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_callback, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_CALLBACK:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_latency, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_LATENCY:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_drain, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_DRAIN:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_pollset, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_POLLSET:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_direct, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_DIRECT:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_update_flag, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_UPDATE_FLAG:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_interval, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_INTERVAL:int val;hrt_abstime time;char[64] junk;");
+
 ORB_DEFINE(orb_test_large, struct orb_test_large, sizeof(orb_test_large),
 	   "ORB_TEST_LARGE:int val;hrt_abstime time;char[512] junk;");
 
@@ -193,7 +217,61 @@ int uORBTest::UnitTest::test()
 		return ret;
 	}
 
-	return test_queue_poll_notify();
+	ret = test_queue_poll_notify();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_loan();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_work_callback();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_latency_statistics();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_copy_all();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_interval_groups();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_pollset();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_direct_subscription();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_update_flag();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	return contention_test(2, 200, false);
 }
 
 int uORBTest::UnitTest::test_unadvertise()
@@ -592,42 +670,88 @@ int uORBTest::UnitTest::test_multi_reversed()
 	return test_note("PASS multi-topic reversed");
 }
 
-int uORBTest::UnitTest::test_queue()
+int uORBTest::UnitTest::test_loan()
 {
-	test_note("Testing orb queuing");
+	test_note("Testing loaned publications & borrowed copies");
 
-	struct orb_test_medium t, u;
-	int sfd;
-	orb_advert_t ptopic;
+	struct orb_test_medium t;
+	const struct orb_test_medium *b;
+	const unsigned int queue_size = 3;
 	bool updated;
 
-	sfd = orb_subscribe(ORB_ID(orb_test_medium_queue));
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_loan));
 
 	if (sfd < 0) {
 		return test_fail("subscribe failed: %d", errno);
 	}
 
-
-	const unsigned int queue_size = 11;
-	t.val = 0;
-	ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_queue), &t, queue_size);
+	memset(&t, 0, sizeof(t));
+	orb_advert_t ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_loan), &t, queue_size);
 
 	if (ptopic == nullptr) {
 		return test_fail("advertise failed: %d", errno);
 	}
 
-	orb_check(sfd, &updated);
+	if (PX4_OK != orb_borrow(ORB_ID(orb_test_medium_loan), sfd, (const void **)&b) || b->val != 0) {
+		return test_fail("borrow of the advertised data failed");
+	}
 
-	if (!updated) {
-		return test_fail("update flag not set");
+	if (PX4_OK != orb_return(ORB_ID(orb_test_medium_loan), sfd)) {
+		return test_fail("return failed: %d", errno);
 	}
 
-	if (PX4_OK != orb_copy(ORB_ID(orb_test_medium_queue), sfd, &u)) {
-		return test_fail("copy(1) failed: %d", errno);
+#ifdef __PX4_NUTTX
+
+	/* loans are only supported on POSIX */
+	if (orb_loan(ORB_ID(orb_test_medium_loan), ptopic) != nullptr || errno != ENOTSUP) {
+		return test_fail("loan did not fail with ENOTSUP");
 	}
 
-	if (u.val != t.val) {
-		return test_fail("copy(1) mismatch: %d expected %d", u.val, t.val);
+	for (int i = 1; i <= 2; ++i) {
+		t.val = i;
+		memset(t.junk, i, sizeof(t.junk));
+		orb_publish(ORB_ID(orb_test_medium_loan), ptopic, &t);
+	}
+
+#else
+
+	/* publish in place */
+	for (int i = 1; i <= 2; ++i) {
+		struct orb_test_medium *l = (struct orb_test_medium *)orb_loan(ORB_ID(orb_test_medium_loan), ptopic);
+
+		if (l == nullptr) {
+			return test_fail("loan failed: %d", errno);
+		}
+
+		l->val = i;
+		memset(l->junk, i, sizeof(l->junk));
+
+		if (PX4_OK != orb_publish_loaned(ORB_ID(orb_test_medium_loan), ptopic)) {
+			return test_fail("publish_loaned failed: %d", errno);
+		}
+	}
+
+#endif
+
+	/* both loaned publications must be queued and borrowed in order */
+	for (int i = 1; i <= 2; ++i) {
+		orb_check(sfd, &updated);
+
+		if (!updated) {
+			return test_fail("update flag not set, element %i", i);
+		}
+
+		if (PX4_OK != orb_borrow(ORB_ID(orb_test_medium_loan), sfd, (const void **)&b)) {
+			return test_fail("borrow failed: %d", errno);
+		}
+
+		if (b->val != i || b->junk[sizeof(b->junk) - 1] != i) {
+			return test_fail("borrowed wrong element (got %i, should be %i)", b->val, i);
+		}
+
+		if (PX4_OK != orb_return(ORB_ID(orb_test_medium_loan), sfd)) {
+			return test_fail("return failed: %d", errno);
+		}
 	}
 
 	orb_check(sfd, &updated);
@@ -636,203 +760,997 @@ int uORBTest::UnitTest::test_queue()
 		return test_fail("spurious updated flag");
 	}
 
-#define CHECK_UPDATED(element) \
-	orb_check(sfd, &updated); \
-	if (!updated) { \
-		return test_fail("update flag not set, element %i", element); \
-	}
-#define CHECK_NOT_UPDATED(element) \
-	orb_check(sfd, &updated); \
-	if (updated) { \
-		return test_fail("update flag set, element %i", element); \
-	}
-#define CHECK_COPY(i_got, i_correct) \
-	orb_copy(ORB_ID(orb_test_medium_queue), sfd, &u); \
-	if (i_got != i_correct) { \
-		return test_fail("got wrong element from the queue (got %i, should be %i)", i_got, i_correct); \
-	}
+#ifndef __PX4_NUTTX
+	/* an aborted loan must not be published, nor change the queued data */
+	struct orb_test_medium *l = (struct orb_test_medium *)orb_loan(ORB_ID(orb_test_medium_loan), ptopic);
 
-	//no messages in the queue anymore
+	if (l == nullptr) {
+		return test_fail("loan failed: %d", errno);
+	}
 
-	test_note("  Testing to write some elements...");
+	l->val = 99;
+	memset(l->junk, 99, sizeof(l->junk));
 
-	for (unsigned int i = 0; i < queue_size - 2; ++i) {
-		t.val = i;
-		orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
+	if (orb_loan(ORB_ID(orb_test_medium_loan), ptopic) != nullptr || errno != EBUSY) {
+		return test_fail("second loan did not fail with EBUSY");
 	}
 
-	for (unsigned int i = 0; i < queue_size - 2; ++i) {
-		CHECK_UPDATED(i);
-		CHECK_COPY(u.val, i);
+	if (PX4_OK != orb_loan_abort(ORB_ID(orb_test_medium_loan), ptopic)) {
+		return test_fail("loan_abort failed: %d", errno);
 	}
 
-	CHECK_NOT_UPDATED(queue_size);
+	orb_check(sfd, &updated);
 
-	test_note("  Testing overflow...");
-	int overflow_by = 3;
+	if (updated) {
+		return test_fail("aborted loan was published");
+	}
 
-	for (unsigned int i = 0; i < queue_size + overflow_by; ++i) {
-		t.val = i;
-		orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
+#endif
+
+	if (PX4_OK == orb_publish_loaned(ORB_ID(orb_test_medium_loan), ptopic) || errno != EINVAL) {
+		return test_fail("publish_loaned without loan succeeded");
 	}
 
-	for (unsigned int i = 0; i < queue_size; ++i) {
-		CHECK_UPDATED(i);
-		CHECK_COPY(u.val, i + overflow_by);
+	if (PX4_OK == orb_loan_abort(ORB_ID(orb_test_medium_loan), ptopic) || errno != EINVAL) {
+		return test_fail("loan_abort without loan succeeded");
 	}
 
-	CHECK_NOT_UPDATED(queue_size);
+	/* a normal copy must see the same data */
+	if (PX4_OK != orb_copy(ORB_ID(orb_test_medium_loan), sfd, &t) || t.val != 2 || t.junk[sizeof(t.junk) - 1] != 2) {
+		return test_fail("copy after loaned publication failed");
+	}
 
-	test_note("  Testing underflow...");
+	/* a borrowed element must be detected as invalid once its slot gets overwritten */
+	if (PX4_OK != orb_borrow(ORB_ID(orb_test_medium_loan), sfd, (const void **)&b)) {
+		return test_fail("borrow failed: %d", errno);
+	}
 
 	for (unsigned int i = 0; i < queue_size; ++i) {
-		CHECK_NOT_UPDATED(i);
-		CHECK_COPY(u.val, queue_size + overflow_by - 1);
+		t.val = 10 + i;
+		orb_publish(ORB_ID(orb_test_medium_loan), ptopic, &t);
 	}
 
-	t.val = 943;
-	orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
-	CHECK_UPDATED(-1);
-	CHECK_COPY(u.val, t.val);
+	if (PX4_OK == orb_return(ORB_ID(orb_test_medium_loan), sfd) || errno != EAGAIN) {
+		return test_fail("overwritten borrow not detected");
+	}
 
-#undef CHECK_COPY
-#undef CHECK_UPDATED
-#undef CHECK_NOT_UPDATED
+	if (PX4_OK == orb_return(ORB_ID(orb_test_medium_loan), sfd)) {
+		return test_fail("return without borrow succeeded");
+	}
 
+	orb_unsubscribe(sfd);
 	orb_unadvertise(ptopic);
 
-	return test_note("PASS orb queuing");
+	return test_note("PASS loan & borrow");
 }
 
+void uORBTest::UnitTest::work_callback_worker(void *arg)
+{
+	UnitTest *t = (UnitTest *)arg;
+	struct orb_test_medium u;
+
+	if (orb_copy(ORB_ID(orb_test_medium_callback), t->_callback_sub, &u) == PX4_OK) {
+		t->_callback_last_val = u.val;
+	}
+
+	++t->_num_callbacks;
 
-int uORBTest::UnitTest::pub_test_queue_entry(char *const argv[])
+	/* the worker may unregister its own callback, the callback is freed after it returned */
+	if (t->_callback_last_val == t->_callback_stop_val && t->_callback_unregistered == 0) {
+		t->_callback_unregistered = orb_unregister_work_callback(t->_callback_handle) == PX4_OK ? 1 : -1;
+	}
+}
+
+void uORBTest::UnitTest::work_callback_slow_worker(void *arg)
 {
-	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
-	return t.pub_test_queue_main();
+	UnitTest *t = (UnitTest *)arg;
+
+	t->_callback_in_worker = 1;
+	usleep(20000);
+	t->_callback_in_worker = 2;
 }
 
-int uORBTest::UnitTest::pub_test_queue_main()
+int uORBTest::UnitTest::test_work_callback()
 {
+	test_note("Testing work queue callbacks");
+
+	const int num_publications = 20;
 	struct orb_test_medium t;
-	orb_advert_t ptopic;
-	const unsigned int queue_size = 50;
-	t.val = 0;
+	memset(&t, 0, sizeof(t));
 
-	if ((ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_queue_poll), &t, queue_size)) == nullptr) {
-		_thread_should_exit = true;
-		return test_fail("advertise failed: %d", errno);
+	_callback_sub = orb_subscribe(ORB_ID(orb_test_medium_callback));
+
+	if (_callback_sub < 0) {
+		return test_fail("subscribe failed: %d", errno);
 	}
 
-	int message_counter = 0, num_messages = 20 * queue_size;
-	++t.val;
+	_callback_stop_val = num_publications;
+	_callback_unregistered = 0;
 
-	while (message_counter < num_messages) {
+	/* register before the topic is advertised. The handle is set before any publication can run the worker */
+	_callback_handle = orb_register_work_callback(ORB_ID(orb_test_medium_callback), 0, HPWORK,
+			   &UnitTest::work_callback_worker, this);
 
-		//simulate burst
-		int burst_counter = 0;
+	if (_callback_handle == nullptr) {
+		return test_fail("register failed: %d", errno);
+	}
 
-		while (burst_counter++ < queue_size / 2 + 7) { //make interval non-boundary aligned
-			orb_publish(ORB_ID(orb_test_medium_queue_poll), ptopic, &t);
-			++t.val;
-		}
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_callback), &t);
 
-		message_counter += burst_counter;
-		usleep(20 * 1000); //give subscriber a chance to catch up
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
 	}
 
-	_num_messages_sent = t.val;
-	usleep(100 * 1000);
-	_thread_should_exit = true;
-	orb_unadvertise(ptopic);
+	for (int i = 1; i <= num_publications; ++i) {
+		usleep(2000);
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_medium_callback), ptopic, &t);
+	}
 
-	return 0;
-}
+	/* give the work queue time to run the last publication (and unregister) */
+	for (int i = 0; i < 100 && _callback_unregistered == 0; ++i) {
+		usleep(1000);
+	}
 
-int uORBTest::UnitTest::test_queue_poll_notify()
-{
-	test_note("Testing orb queuing (poll & notify)");
+	int num_callbacks = _num_callbacks;
 
-	struct orb_test_medium t;
-	int sfd;
+	if (_callback_last_val != num_publications) {
+		return test_fail("worker did not see the last publication (got %i)", _callback_last_val);
+	}
 
-	if ((sfd = orb_subscribe(ORB_ID(orb_test_medium_queue_poll))) < 0) {
-		return test_fail("subscribe failed: %d", errno);
+	if (num_callbacks < 1 || num_callbacks > num_publications + 1) {
+		return test_fail("wrong number of callbacks: %i", num_callbacks);
 	}
 
-	_thread_should_exit = false;
+	if (_callback_unregistered != 1) {
+		return test_fail("unregister from the worker failed");
+	}
 
-	char *const args[1] = { NULL };
-	int pubsub_task = px4_task_spawn_cmd("uorb_test_queue",
-					     SCHED_DEFAULT,
-					     SCHED_PRIORITY_MIN + 5,
-					     1500,
-					     (px4_main_t)&uORBTest::UnitTest::pub_test_queue_entry,
-					     args);
+	orb_publish(ORB_ID(orb_test_medium_callback), ptopic, &t);
+	usleep(10000);
 
-	if (pubsub_task < 0) {
-		return test_fail("failed launching task");
+	if (_num_callbacks != num_callbacks) {
+		return test_fail("worker called after unregistering");
 	}
 
-	int next_expected_val = 0;
-	px4_pollfd_struct_t fds[1];
-	fds[0].fd = sfd;
-	fds[0].events = POLLIN;
+	/* unregister from another thread while the worker runs: this must wait for the worker to return */
+	_callback_in_worker = 0;
+	_callback_handle = orb_register_work_callback(ORB_ID(orb_test_medium_callback), 0, HPWORK,
+			   &UnitTest::work_callback_slow_worker, this);
 
-	while (!_thread_should_exit) {
+	if (_callback_handle == nullptr) {
+		return test_fail("register failed: %d", errno);
+	}
 
-		int poll_ret = px4_poll(fds, 1, 500);
+	orb_publish(ORB_ID(orb_test_medium_callback), ptopic, &t);
 
-		if (poll_ret == 0) {
-			if (_thread_should_exit) {
-				break;
-			}
+	for (int i = 0; i < 100 && _callback_in_worker == 0; ++i) {
+		usleep(1000);
+	}
 
-			return test_fail("poll timeout");
+	if (_callback_in_worker != 1) {
+		return test_fail("slow worker not called");
+	}
 
-		} else if (poll_ret < 0) {
-			return test_fail("poll error (%d, %d)", poll_ret, errno);
-		}
+	if (orb_unregister_work_callback(_callback_handle) != PX4_OK) {
+		return test_fail("unregister from another thread failed: %d", errno);
+	}
 
-		if (fds[0].revents & POLLIN) {
-			orb_copy(ORB_ID(orb_test_medium_queue_poll), sfd, &t);
+	if (_callback_in_worker != 2) {
+		return test_fail("unregister returned while the worker was running");
+	}
 
-			if (next_expected_val != t.val) {
-				return test_fail("copy mismatch: %d expected %d", t.val, next_expected_val);
-			}
+	orb_publish(ORB_ID(orb_test_medium_callback), ptopic, &t);
+	usleep(10000);
 
-			++next_expected_val;
-		}
+	if (_callback_in_worker != 2) {
+		return test_fail("slow worker called after unregistering");
 	}
 
-	if (_num_messages_sent != next_expected_val) {
-		return test_fail("number of sent and received messages mismatch (sent: %i, received: %i)",
-				 _num_messages_sent, next_expected_val);
-	}
+	orb_unsubscribe(_callback_sub);
+	orb_unadvertise(ptopic);
 
-	return test_note("PASS orb queuing (poll & notify), got %i messages", next_expected_val);
+	return test_note("PASS work queue callbacks (%i callbacks for %i publications)", num_callbacks,
+			 num_publications + 1);
 }
 
-
-int uORBTest::UnitTest::test_fail(const char *fmt, ...)
+int uORBTest::UnitTest::test_latency_statistics()
 {
-	va_list ap;
+	test_note("Testing latency statistics");
 
-	fprintf(stderr, "uORB FAIL: ");
-	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
-	va_end(ap);
-	fprintf(stderr, "\n");
-	fflush(stderr);
-	return uORB::ERROR;
-}
+	const int num_publications = 10;
+	struct orb_test_medium t, u;
+	memset(&t, 0, sizeof(t));
+	bool was_enabled = uORB::DeviceNode::latency_statistics_enabled();
+	uORB::DeviceNode::enable_latency_statistics(true);
 
-int uORBTest::UnitTest::test_note(const char *fmt, ...)
-{
-	va_list ap;
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_latency));
+	orb_advert_t ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_latency), &t, 4);
 
-	fprintf(stderr, "uORB note: ");
-	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	if (sfd < 0 || ptopic == nullptr) {
+		return test_fail("subscribe/advertise failed: %d", errno);
+	}
+
+	orb_copy(ORB_ID(orb_test_medium_latency), sfd, &u);
+
+	for (int i = 1; i < num_publications; ++i) {
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_medium_latency), ptopic, &t);
+		orb_copy(ORB_ID(orb_test_medium_latency), sfd, &u);
+	}
+
+	/* copying again without a new publication is not recorded */
+	orb_copy(ORB_ID(orb_test_medium_latency), sfd, &u);
+
+	char path[uORB::orb_maxpath];
+	int instance = 0;
+	uORB::Utils::node_mkpath(path, uORB::PUBSUB, ORB_ID(orb_test_medium_latency), &instance);
+	uORB::DeviceNode *node = uORB::Manager::get_instance()->get_device_master(uORB::PUBSUB)->getDeviceNode(path);
+
+	if (node == nullptr) {
+		return test_fail("node not found");
+	}
+
+	uint64_t latency_sum;
+	uint32_t count;
+	node->get_latency_totals(latency_sum, count);
+
+	if (count != num_publications) {
+		return test_fail("wrong number of recorded copies: %u, expected %i", (unsigned)count, num_publications);
+	}
+
+	node->print_latency_statistics(false);
+
+	orb_unsubscribe(sfd);
+
+	/* the totals must survive unsubscribing */
+	node->get_latency_totals(latency_sum, count);
+
+	if (count != num_publications) {
+		return test_fail("recorded copies lost after unsubscribing");
+	}
+
+	orb_unadvertise(ptopic);
+	uORB::DeviceNode::enable_latency_statistics(was_enabled);
+
+	return test_note("PASS latency statistics (mean %u us)", (unsigned)(latency_sum / count));
+}
+
+int uORBTest::UnitTest::test_copy_all()
+{
+	test_note("Testing orb_copy_all");
+
+	const unsigned int queue_size = 4;
+	struct orb_test_medium t, u[queue_size];
+	unsigned dropped;
+	bool updated;
+	memset(&t, 0, sizeof(t));
+
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_drain));
+
+	if (sfd < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	if (orb_copy_all(ORB_ID(orb_test_medium_drain), sfd, u, queue_size, &dropped) != 0) {
+		return test_fail("copied data before the topic was advertised");
+	}
+
+	orb_advert_t ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_drain), &t, queue_size);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	for (int i = 1; i < 3; ++i) {
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_medium_drain), ptopic, &t);
+	}
+
+	int n = orb_copy_all(ORB_ID(orb_test_medium_drain), sfd, u, queue_size, &dropped);
+
+	if (n != 3 || dropped != 0) {
+		return test_fail("copy_all(1): got %i elements, %u dropped", n, dropped);
+	}
+
+	for (int i = 0; i < n; ++i) {
+		if (u[i].val != i) {
+			return test_fail("copy_all(1): wrong element %i: %i", i, u[i].val);
+		}
+	}
+
+	orb_check(sfd, &updated);
+
+	if (updated) {
+		return test_fail("update flag set after copy_all");
+	}
+
+	if (orb_copy_all(ORB_ID(orb_test_medium_drain), sfd, u, queue_size, &dropped) != 0) {
+		return test_fail("copy_all returned old data");
+	}
+
+	/* overflow the queue by 2 */
+	for (unsigned int i = 0; i < queue_size + 2; ++i) {
+		t.val = 10 + i;
+		orb_publish(ORB_ID(orb_test_medium_drain), ptopic, &t);
+	}
+
+	/* copy in two parts */
+	n = orb_copy_all(ORB_ID(orb_test_medium_drain), sfd, u, 3, &dropped);
+
+	if (n != 3 || dropped != 2 || u[0].val != 12 || u[2].val != 14) {
+		return test_fail("copy_all(2): got %i elements, %u dropped, first %i", n, dropped, u[0].val);
+	}
+
+	orb_check(sfd, &updated);
+
+	if (!updated) {
+		return test_fail("update flag not set with elements left");
+	}
+
+	n = orb_copy_all(ORB_ID(orb_test_medium_drain), sfd, u, queue_size, &dropped);
+
+	if (n != 1 || dropped != 0 || u[0].val != 15) {
+		return test_fail("copy_all(3): got %i elements, %u dropped, first %i", n, dropped, u[0].val);
+	}
+
+	orb_unsubscribe(sfd);
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS orb_copy_all");
+}
+
+int uORBTest::UnitTest::test_interval_groups()
+{
+	test_note("Testing shared interval timers");
+
+	const int num_subscribers = 8;
+	const unsigned interval = 20; // [ms]
+	const unsigned fast_interval = 5;
+	const int duration_ms = 400;
+	struct orb_test_medium t, u;
+	int sfd[num_subscribers];
+	int updates[num_subscribers];
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_interval), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	/* all subscribers but the last one share an interval */
+	for (int i = 0; i < num_subscribers; ++i) {
+		sfd[i] = orb_subscribe(ORB_ID(orb_test_medium_interval));
+
+		if (sfd[i] < 0) {
+			return test_fail("subscribe failed: %d", errno);
+		}
+
+		orb_set_interval(sfd[i], i == num_subscribers - 1 ? fast_interval : interval);
+		orb_copy(ORB_ID(orb_test_medium_interval), sfd[i], &u);
+		updates[i] = 0;
+	}
+
+	unsigned interval_read;
+
+	if (orb_get_interval(sfd[0], &interval_read) != PX4_OK || interval_read != interval) {
+		return test_fail("orb_get_interval returned %u", interval_read);
+	}
+
+	char path[uORB::orb_maxpath];
+	int instance = 0;
+	uORB::Utils::node_mkpath(path, uORB::PUBSUB, ORB_ID(orb_test_medium_interval), &instance);
+	uORB::DeviceNode *node = uORB::Manager::get_instance()->get_device_master(uORB::PUBSUB)->getDeviceNode(path);
+
+	if (node == nullptr) {
+		return test_fail("node not found");
+	}
+
+	const uint32_t callouts_start = node->interval_callout_count();
+	const hrt_abstime start = hrt_absolute_time();
+
+	/* publish at ~1kHz, every subscriber checks after each publication */
+	while (hrt_elapsed_time(&start) < duration_ms * 1000) {
+		++t.val;
+		orb_publish(ORB_ID(orb_test_medium_interval), ptopic, &t);
+
+		for (int i = 0; i < num_subscribers; ++i) {
+			bool updated;
+			orb_check(sfd[i], &updated);
+
+			if (updated) {
+				orb_copy(ORB_ID(orb_test_medium_interval), sfd[i], &u);
+				++updates[i];
+			}
+		}
+
+		usleep(1000);
+	}
+
+	const float elapsed_ms = hrt_elapsed_time(&start) / 1e3f;
+	const uint32_t callouts = node->interval_callout_count() - callouts_start;
+	const int max_updates = elapsed_ms / interval + 2;
+	const int max_fast_updates = elapsed_ms / fast_interval + 2;
+	int total_updates = 0;
+
+	for (int i = 0; i < num_subscribers; ++i) {
+		const int max = i == num_subscribers - 1 ? max_fast_updates : max_updates;
+
+		if (updates[i] > max || updates[i] < max / 2) {
+			return test_fail("subscriber %i: %i updates (max %i)", i, updates[i], max);
+		}
+
+		total_updates += updates[i];
+		orb_unsubscribe(sfd[i]);
+	}
+
+	/* the subscribers of one interval share one timer: one callout per period and interval */
+	if (callouts > (unsigned)(max_updates + max_fast_updates)) {
+		return test_fail("too many callouts: %u", callouts);
+	}
+
+	orb_unadvertise(ptopic);
+
+	/* with one timer per subscriber, every reported update would restart a timer */
+	return test_note("PASS shared interval timers: %i subscribers, %i updates, %u callouts (%i with per-subscriber timers)",
+			 num_subscribers, total_updates, callouts, total_updates);
+}
+
+int uORBTest::UnitTest::test_pollset()
+{
+	test_note("Testing persistent poll sets");
+
+	const int num_subscribers = 4;
+	const int iterations = 2000;
+	struct orb_test_medium t, u;
+	int sfd[num_subscribers];
+	px4_pollfd_struct_t fds[num_subscribers];
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_pollset), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	px4_pollset_t *set = px4_pollset_create();
+
+	if (set == nullptr) {
+		return test_fail("px4_pollset_create failed");
+	}
+
+	for (int i = 0; i < num_subscribers; ++i) {
+		sfd[i] = orb_subscribe(ORB_ID(orb_test_medium_pollset));
+
+		if (sfd[i] < 0) {
+			return test_fail("subscribe failed: %d", errno);
+		}
+
+		orb_copy(ORB_ID(orb_test_medium_pollset), sfd[i], &u);
+
+		if (px4_pollset_add(set, sfd[i], POLLIN) != 0) {
+			return test_fail("px4_pollset_add failed: %d", errno);
+		}
+	}
+
+	if (px4_pollset_add(set, sfd[0], POLLIN) == 0) {
+		return test_fail("fd added twice");
+	}
+
+	int ret = px4_pollset_wait(set, fds, num_subscribers, 0);
+
+	if (ret != 0) {
+		return test_fail("nothing published, but %i fds ready", ret);
+	}
+
+	orb_publish(ORB_ID(orb_test_medium_pollset), ptopic, &t);
+	ret = px4_pollset_wait(set, fds, num_subscribers, 100);
+
+	if (ret != num_subscribers) {
+		return test_fail("expected %i ready fds, got %i", num_subscribers, ret);
+	}
+
+	/* the fds stay ready until the data is copied */
+	orb_copy(ORB_ID(orb_test_medium_pollset), sfd[0], &u);
+	orb_copy(ORB_ID(orb_test_medium_pollset), sfd[1], &u);
+	ret = px4_pollset_wait(set, fds, num_subscribers, 100);
+
+	if (ret != num_subscribers - 2 || fds[0].fd == sfd[0] || fds[0].fd == sfd[1] || !(fds[0].revents & POLLIN)) {
+		return test_fail("wrong ready fds after copy (%i)", ret);
+	}
+
+	/* ready fds that do not fit are reported on the next call */
+	ret = px4_pollset_wait(set, fds, 1, 100);
+
+	if (ret != 1) {
+		return test_fail("max_ready not respected (%i)", ret);
+	}
+
+	orb_copy(ORB_ID(orb_test_medium_pollset), sfd[2], &u);
+	orb_copy(ORB_ID(orb_test_medium_pollset), sfd[3], &u);
+
+	hrt_abstime start = hrt_absolute_time();
+	ret = px4_pollset_wait(set, fds, num_subscribers, 20);
+
+	if (ret != 0 || hrt_elapsed_time(&start) < 15000) {
+		return test_fail("timeout not respected (%i, %i us)", ret, (int)hrt_elapsed_time(&start));
+	}
+
+	if (px4_pollset_remove(set, sfd[num_subscribers - 1]) != 0) {
+		return test_fail("px4_pollset_remove failed: %d", errno);
+	}
+
+	orb_publish(ORB_ID(orb_test_medium_pollset), ptopic, &t);
+	ret = px4_pollset_wait(set, fds, num_subscribers, 100);
+
+	if (ret != num_subscribers - 1) {
+		return test_fail("expected %i ready fds after remove, got %i", num_subscribers - 1, ret);
+	}
+
+	px4_pollset_add(set, sfd[num_subscribers - 1], POLLIN);
+
+	/* benchmark: one publication per iteration, all subscribers copy it */
+	for (int i = 0; i < num_subscribers; ++i) {
+		fds[i].fd = sfd[i];
+		fds[i].events = POLLIN;
+	}
+
+	hrt_abstime poll_time = 0;
+	hrt_abstime pollset_time = 0;
+
+	for (int k = 0; k < 2 * iterations; ++k) {
+		const bool use_pollset = k >= iterations;
+		orb_publish(ORB_ID(orb_test_medium_pollset), ptopic, &t);
+
+		start = hrt_absolute_time();
+
+		if (use_pollset) {
+			ret = px4_pollset_wait(set, fds, num_subscribers, 100);
+			pollset_time += hrt_elapsed_time(&start);
+
+		} else {
+			ret = px4_poll(fds, num_subscribers, 100);
+			poll_time += hrt_elapsed_time(&start);
+		}
+
+		if (ret != num_subscribers) {
+			return test_fail("benchmark: expected %i ready fds, got %i", num_subscribers, ret);
+		}
+
+		for (int i = 0; i < num_subscribers; ++i) {
+			orb_copy(ORB_ID(orb_test_medium_pollset), sfd[i], &u);
+		}
+	}
+
+	px4_pollset_destroy(set);
+
+	for (int i = 0; i < num_subscribers; ++i) {
+		orb_unsubscribe(sfd[i]);
+	}
+
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS persistent poll sets: %i fds, px4_poll %.2f us, px4_pollset_wait %.2f us per call",
+			 num_subscribers, (double)poll_time / iterations, (double)pollset_time / iterations);
+}
+
+int uORBTest::UnitTest::test_direct_subscription()
+{
+	test_note("Testing direct subscriptions");
+
+	const int iterations = 10000;
+	struct orb_test_medium t, u;
+	memset(&t, 0, sizeof(t));
+
+	uORB::DirectSubscription<ORB_ID(orb_test_medium_direct)> sub;
+
+	if (sub.updated() || sub.copy(&u)) {
+		return test_fail("not subscribed, but updated");
+	}
+
+	/* subscribe before the topic is advertised */
+	if (!sub.subscribe()) {
+		return test_fail("subscribe failed");
+	}
+
+	if (sub.updated() || sub.published() || sub.copy(&u)) {
+		return test_fail("nothing published yet");
+	}
+
+	t.val = 1;
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_direct), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	if (!sub.updated() || !sub.published() || sub.last_update() == 0) {
+		return test_fail("advertise not seen");
+	}
+
+	if (!sub.update() || sub.get().val != 1 || sub.updated()) {
+		return test_fail("update failed (val %i)", sub.get().val);
+	}
+
+	if (sub.update(&u)) {
+		return test_fail("update without publication");
+	}
+
+	/* copy() always returns the latest data, like orb_copy() */
+	if (!sub.copy(&u) || u.val != 1) {
+		return test_fail("copy failed");
+	}
+
+	t.val = 2;
+	orb_publish(ORB_ID(orb_test_medium_direct), ptopic, &t);
+
+	if (!sub.update(&u) || u.val != 2) {
+		return test_fail("update after publish failed");
+	}
+
+	/* benchmark: check and copy through a file descriptor vs. directly */
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_direct));
+	hrt_abstime fd_time = 0;
+	hrt_abstime direct_time = 0;
+	int fd_updates = 0;
+	int direct_updates = 0;
+
+	for (int i = 0; i < iterations; ++i) {
+		if (i % 2 == 0) {
+			++t.val;
+			orb_publish(ORB_ID(orb_test_medium_direct), ptopic, &t);
+		}
+
+		hrt_abstime start = hrt_absolute_time();
+		bool updated;
+		orb_check(sfd, &updated);
+
+		if (updated) {
+			orb_copy(ORB_ID(orb_test_medium_direct), sfd, &u);
+			++fd_updates;
+		}
+
+		fd_time += hrt_elapsed_time(&start);
+
+		start = hrt_absolute_time();
+
+		if (sub.update(&u)) {
+			++direct_updates;
+		}
+
+		direct_time += hrt_elapsed_time(&start);
+	}
+
+	if (fd_updates != iterations / 2 || direct_updates != iterations / 2 || u.val != t.val) {
+		return test_fail("wrong number of updates (%i, %i)", fd_updates, direct_updates);
+	}
+
+	orb_unsubscribe(sfd);
+	sub.unsubscribe();
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS direct subscriptions: orb_check/orb_copy %.3f us, DirectSubscription %.3f us per iteration",
+			 (double)fd_time / iterations, (double)direct_time / iterations);
+}
+
+int uORBTest::UnitTest::test_update_flag()
+{
+	test_note("Testing update flags");
+
+	struct orb_test_medium t, u;
+	memset(&t, 0, sizeof(t));
+	volatile uint32_t flags = 0;
+
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_update_flag));
+	int sfd_interval = orb_subscribe(ORB_ID(orb_test_medium_update_flag));
+
+	if (sfd < 0 || sfd_interval < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	orb_set_interval(sfd_interval, 50);
+
+	if (orb_set_update_flag(sfd, &flags, 1 << 0) != PX4_OK || orb_set_update_flag(sfd_interval, &flags, 1 << 1) != PX4_OK) {
+		return test_fail("orb_set_update_flag failed: %d", errno);
+	}
+
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_update_flag), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	uint32_t updated_flags = __atomic_exchange_n(&flags, 0, __ATOMIC_ACQUIRE);
+
+	if (updated_flags != 3) {
+		return test_fail("advertise: wrong flags 0x%x", updated_flags);
+	}
+
+	bool updated = false;
+	orb_check(sfd_interval, &updated);
+
+	if (!updated) {
+		return test_fail("advertise not seen");
+	}
+
+	orb_copy(ORB_ID(orb_test_medium_update_flag), sfd, &u);
+	orb_copy(ORB_ID(orb_test_medium_update_flag), sfd_interval, &u);
+
+	/* the rate-limited subscription must not be flagged before its interval has passed... */
+	t.val = 1;
+	orb_publish(ORB_ID(orb_test_medium_update_flag), ptopic, &t);
+	updated_flags = __atomic_exchange_n(&flags, 0, __ATOMIC_ACQUIRE);
+
+	if (updated_flags != 1) {
+		return test_fail("publish: wrong flags 0x%x", updated_flags);
+	}
+
+	/* ...but at the end of it */
+	usleep(100 * 1000);
+	updated_flags = __atomic_exchange_n(&flags, 0, __ATOMIC_ACQUIRE);
+	orb_check(sfd_interval, &updated);
+
+	if (updated_flags != 2 || !updated) {
+		return test_fail("interval: wrong flags 0x%x (updated %i)", updated_flags, (int)updated);
+	}
+
+	/* removed and closed subscriptions are not flagged anymore */
+	orb_set_update_flag(sfd, nullptr, 0);
+	orb_unsubscribe(sfd_interval);
+	orb_publish(ORB_ID(orb_test_medium_update_flag), ptopic, &t);
+
+	if (flags != 0) {
+		return test_fail("flags set after removal 0x%x", flags);
+	}
+
+	orb_unsubscribe(sfd);
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS update flags");
+}
+
+int uORBTest::UnitTest::test_queue()
+{
+	test_note("Testing orb queuing");
+
+	struct orb_test_medium t, u;
+	int sfd;
+	orb_advert_t ptopic;
+	bool updated;
+
+	sfd = orb_subscribe(ORB_ID(orb_test_medium_queue));
+
+	if (sfd < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+
+	const unsigned int queue_size = 11;
+	t.val = 0;
+	ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_queue), &t, queue_size);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	orb_check(sfd, &updated);
+
+	if (!updated) {
+		return test_fail("update flag not set");
+	}
+
+	if (PX4_OK != orb_copy(ORB_ID(orb_test_medium_queue), sfd, &u)) {
+		return test_fail("copy(1) failed: %d", errno);
+	}
+
+	if (u.val != t.val) {
+		return test_fail("copy(1) mismatch: %d expected %d", u.val, t.val);
+	}
+
+	orb_check(sfd, &updated);
+
+	if (updated) {
+		return test_fail("spurious updated flag");
+	}
+
+#define CHECK_UPDATED(element) \
+	orb_check(sfd, &updated); \
+	if (!updated) { \
+		return test_fail("update flag not set, element %i", element); \
+	}
+#define CHECK_NOT_UPDATED(element) \
+	orb_check(sfd, &updated); \
+	if (updated) { \
+		return test_fail("update flag set, element %i", element); \
+	}
+#define CHECK_COPY(i_got, i_correct) \
+	orb_copy(ORB_ID(orb_test_medium_queue), sfd, &u); \
+	if (i_got != i_correct) { \
+		return test_fail("got wrong element from the queue (got %i, should be %i)", i_got, i_correct); \
+	}
+
+	//no messages in the queue anymore
+
+	test_note("  Testing to write some elements...");
+
+	for (unsigned int i = 0; i < queue_size - 2; ++i) {
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
+	}
+
+	for (unsigned int i = 0; i < queue_size - 2; ++i) {
+		CHECK_UPDATED(i);
+		CHECK_COPY(u.val, i);
+	}
+
+	CHECK_NOT_UPDATED(queue_size);
+
+	test_note("  Testing overflow...");
+	int overflow_by = 3;
+
+	for (unsigned int i = 0; i < queue_size + overflow_by; ++i) {
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
+	}
+
+	for (unsigned int i = 0; i < queue_size; ++i) {
+		CHECK_UPDATED(i);
+		CHECK_COPY(u.val, i + overflow_by);
+	}
+
+	CHECK_NOT_UPDATED(queue_size);
+
+	test_note("  Testing underflow...");
+
+	for (unsigned int i = 0; i < queue_size; ++i) {
+		CHECK_NOT_UPDATED(i);
+		CHECK_COPY(u.val, queue_size + overflow_by - 1);
+	}
+
+	t.val = 943;
+	orb_publish(ORB_ID(orb_test_medium_queue), ptopic, &t);
+	CHECK_UPDATED(-1);
+	CHECK_COPY(u.val, t.val);
+
+#undef CHECK_COPY
+#undef CHECK_UPDATED
+#undef CHECK_NOT_UPDATED
+
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS orb queuing");
+}
+
+
+int uORBTest::UnitTest::pub_test_queue_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.pub_test_queue_main();
+}
+
+int uORBTest::UnitTest::pub_test_queue_main()
+{
+	struct orb_test_medium t;
+	orb_advert_t ptopic;
+	const unsigned int queue_size = 50;
+	t.val = 0;
+
+	if ((ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_queue_poll), &t, queue_size)) == nullptr) {
+		_thread_should_exit = true;
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	int message_counter = 0, num_messages = 20 * queue_size;
+	++t.val;
+
+	while (message_counter < num_messages) {
+
+		//simulate burst
+		int burst_counter = 0;
+
+		while (burst_counter++ < queue_size / 2 + 7) { //make interval non-boundary aligned
+			orb_publish(ORB_ID(orb_test_medium_queue_poll), ptopic, &t);
+			++t.val;
+		}
+
+		message_counter += burst_counter;
+		usleep(20 * 1000); //give subscriber a chance to catch up
+	}
+
+	_num_messages_sent = t.val;
+	usleep(100 * 1000);
+	_thread_should_exit = true;
+	orb_unadvertise(ptopic);
+
+	return 0;
+}
+
+int uORBTest::UnitTest::test_queue_poll_notify()
+{
+	test_note("Testing orb queuing (poll & notify)");
+
+	struct orb_test_medium t;
+	int sfd;
+
+	if ((sfd = orb_subscribe(ORB_ID(orb_test_medium_queue_poll))) < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	_thread_should_exit = false;
+
+	char *const args[1] = { NULL };
+	int pubsub_task = px4_task_spawn_cmd("uorb_test_queue",
+					     SCHED_DEFAULT,
+					     SCHED_PRIORITY_MIN + 5,
+					     1500,
+					     (px4_main_t)&uORBTest::UnitTest::pub_test_queue_entry,
+					     args);
+
+	if (pubsub_task < 0) {
+		return test_fail("failed launching task");
+	}
+
+	int next_expected_val = 0;
+	px4_pollfd_struct_t fds[1];
+	fds[0].fd = sfd;
+	fds[0].events = POLLIN;
+
+	while (!_thread_should_exit) {
+
+		int poll_ret = px4_poll(fds, 1, 500);
+
+		if (poll_ret == 0) {
+			if (_thread_should_exit) {
+				break;
+			}
+
+			return test_fail("poll timeout");
+
+		} else if (poll_ret < 0) {
+			return test_fail("poll error (%d, %d)", poll_ret, errno);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			orb_copy(ORB_ID(orb_test_medium_queue_poll), sfd, &t);
+
+			if (next_expected_val != t.val) {
+				return test_fail("copy mismatch: %d expected %d", t.val, next_expected_val);
+			}
+
+			++next_expected_val;
+		}
+	}
+
+	if (_num_messages_sent != next_expected_val) {
+		return test_fail("number of sent and received messages mismatch (sent: %i, received: %i)",
+				 _num_messages_sent, next_expected_val);
+	}
+
+	return test_note("PASS orb queuing (poll & notify), got %i messages", next_expected_val);
+}
+
+
+int uORBTest::UnitTest::test_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "uORB FAIL: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	fflush(stderr);
+	return uORB::ERROR;
+}
+
+int uORBTest::UnitTest::test_note(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "uORB note: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
 	va_end(ap);
 	fprintf(stderr, "\n");
 	fflush(stderr);
@@ -844,3 +1762,196 @@ int uORBTest::UnitTest::pubsubtest_threadEntry(char *const argv[])
 	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
 	return t.pubsublatency_main();
 }
+
+int uORBTest::UnitTest::contention_reader_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.contention_reader_main();
+}
+
+int uORBTest::UnitTest::contention_reader_main()
+{
+	struct orb_test_medium t;
+	unsigned num_copies = 0;
+	unsigned num_torn_reads = 0;
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_contention));
+
+	if (sfd < 0) {
+		__atomic_fetch_sub(&_num_readers_running, 1, __ATOMIC_SEQ_CST);
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	while (!_thread_should_exit) {
+		orb_copy(ORB_ID(orb_test_medium_contention), sfd, &t);
+		++num_copies;
+
+		/* the publisher fills the whole message with the same pattern */
+		for (unsigned i = 0; i < sizeof(t.junk); ++i) {
+			if (t.junk[i] != (char)t.val) {
+				++num_torn_reads;
+				break;
+			}
+		}
+	}
+
+	orb_unsubscribe(sfd);
+
+	__atomic_fetch_add(&_num_copies, num_copies, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&_num_torn_reads, num_torn_reads, __ATOMIC_SEQ_CST);
+	__atomic_fetch_sub(&_num_readers_running, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int uORBTest::UnitTest::contention_test(int num_readers, unsigned duration_ms, bool print)
+{
+	test_note("Testing publish/copy contention (%i readers)", num_readers);
+
+	struct orb_test_medium t;
+	memset(&t, 0, sizeof(t));
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_contention), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	_thread_should_exit = false;
+	_num_copies = 0;
+	_num_torn_reads = 0;
+	_num_readers_running = num_readers;
+
+	char *const args[1] = { NULL };
+
+	for (int i = 0; i < num_readers; ++i) {
+		int reader_task = px4_task_spawn_cmd("uorb_contention",
+						     SCHED_DEFAULT,
+						     SCHED_PRIORITY_MAX - 5,
+						     1500,
+						     (px4_main_t)&uORBTest::UnitTest::contention_reader_entry,
+						     args);
+
+		if (reader_task < 0) {
+			_thread_should_exit = true;
+			__atomic_fetch_sub(&_num_readers_running, num_readers - i, __ATOMIC_SEQ_CST);
+			return test_fail("failed launching task");
+		}
+	}
+
+	unsigned num_published = 0;
+	hrt_abstime start_time = hrt_absolute_time();
+	hrt_abstime elapsed;
+
+	while ((elapsed = hrt_elapsed_time(&start_time)) < duration_ms * 1000) {
+		t.val = num_published;
+		memset(t.junk, (char)t.val, sizeof(t.junk));
+		t.time = hrt_absolute_time();
+		orb_publish(ORB_ID(orb_test_medium_contention), ptopic, &t);
+		++num_published;
+
+		/* let the readers run on single-core targets */
+		if ((num_published % 64) == 0) {
+			usleep(1);
+		}
+	}
+
+	_thread_should_exit = true;
+
+	while (_num_readers_running > 0) {
+		usleep(1000);
+	}
+
+	orb_unadvertise(ptopic);
+
+	if (print) {
+		float dt = elapsed / 1e6f;
+		PX4_INFO("readers: %i, publications: %.0f/s, copies: %.0f/s (%.0f/s per reader)", num_readers,
+			 (double)(num_published / dt), (double)(_num_copies / dt),
+			 (double)(_num_copies / dt / num_readers));
+	}
+
+	if (_num_torn_reads > 0) {
+		return test_fail("%u torn reads out of %u copies", _num_torn_reads, _num_copies);
+	}
+
+	return test_note("PASS publish/copy contention");
+}
+
+int uORBTest::UnitTest::registry_test(unsigned num_topics, bool print)
+{
+	test_note("Testing topic registry (%u topics)", num_topics);
+
+	const unsigned name_len = 24;
+	const struct orb_metadata **metas = new const struct orb_metadata *[num_topics];
+
+	if (metas == nullptr) {
+		return test_fail("alloc failed");
+	}
+
+	for (unsigned i = 0; i < num_topics; ++i) {
+		char *name = new char[name_len];
+
+		if (name == nullptr) {
+			delete[] metas;
+			return test_fail("alloc failed");
+		}
+
+		snprintf(name, name_len, "orb_registry_%u", i);
+		metas[i] = new orb_metadata{name, sizeof(orb_test), sizeof(orb_test), "int val;hrt_abstime time;"};
+
+		if (metas[i] == nullptr) {
+			delete[] metas;
+			return test_fail("alloc failed");
+		}
+	}
+
+	/* subscribing creates the topic nodes */
+	int *sfd = new int[num_topics];
+	hrt_abstime start_time = hrt_absolute_time();
+
+	for (unsigned i = 0; i < num_topics; ++i) {
+		sfd[i] = orb_subscribe(metas[i]);
+	}
+
+	hrt_abstime create_time = hrt_elapsed_time(&start_time);
+
+	/* instance 0 exists now, all the other instances do not */
+	int ret = PX4_OK;
+	start_time = hrt_absolute_time();
+
+	for (unsigned i = 0; i < num_topics && ret == PX4_OK; ++i) {
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; ++instance) {
+			bool exists = orb_exists(metas[i], instance) == PX4_OK;
+
+			if (exists != (instance == 0)) {
+				ret = test_fail("orb_exists(%s, %i) returned %i", metas[i]->o_name, instance, (int)exists);
+				break;
+			}
+		}
+	}
+
+	hrt_abstime lookup_time = hrt_elapsed_time(&start_time);
+
+	for (unsigned i = 0; i < num_topics; ++i) {
+		if (sfd[i] < 0) {
+			ret = test_fail("subscribe %u failed: %d", i, errno);
+
+		} else {
+			orb_unsubscribe(sfd[i]);
+		}
+	}
+
+	delete[] sfd;
+
+	/* the metadata stays in use by the nodes */
+	delete[] metas;
+
+	if (ret != PX4_OK) {
+		return ret;
+	}
+
+	if (print) {
+		PX4_INFO("create + subscribe: %.2f us per topic, orb_exists: %.2f us per lookup",
+			 (double)create_time / num_topics, (double)lookup_time / (num_topics * ORB_MULTI_MAX_INSTANCES));
+	}
+
+	return test_note("PASS topic registry");
+}
@@ -54,6 +54,20 @@ ORB_DECLARE(orb_test_medium);
 ORB_DECLARE(orb_test_medium_multi);
 ORB_DECLARE(orb_test_medium_queue);
 ORB_DECLARE(orb_test_medium_queue_poll);
+ORB_DECLARE(orb_test_medium_contention);
+ORB_DECLARE(orb_test_medium_loan);
+ORB_DECLARE(orb_test_medium_callback);
+ORB_DECLARE(orb_test_medium_latency);
+ORB_DECLARE(orb_test_medium_drain);
+ORB_DECLARE(orb_test_medium_interval);
+ORB_DECLARE(orb_test_medium_pollset);
+ORB_DECLARE(orb_test_medium_direct);
+ORB_DECLARE(orb_test_medium_update_flag);
+
+namespace uORB
+{
+template<> struct TopicStruct<&__orb_orb_test_medium_direct> { typedef orb_test_medium type; };
+}
 
 struct orb_test_large {
 	int val;
@@ -77,6 +91,24 @@ public:
 	~UnitTest() {}
 	int test();
 	template<typename S> int latency_test(orb_id_t T, bool print);
+
+	/**
+	 * Publish at full rate while several reader tasks copy the same topic in a tight loop.
+	 * Fails if a reader ever sees a torn (partially updated) message.
+	 * @param num_readers number of concurrent reader tasks
+	 * @param duration_ms run time of the test
+	 * @param print print the publication and copy rates
+	 */
+	int contention_test(int num_readers, unsigned duration_ms, bool print);
+
+	/**
+	 * Create a number of synthetic topics and measure the time it takes to create
+	 * the topic nodes and to look them up with orb_exists().
+	 * Note that the created topics are never freed (DeviceNodes are never deleted).
+	 * @param num_topics number of synthetic topics
+	 * @param print print the timing results
+	 */
+	int registry_test(unsigned num_topics, bool print);
 	int info();
 
 private:
@@ -114,6 +146,46 @@ private:
 	int test_queue_poll_notify();
 	volatile int _num_messages_sent = 0;
 
+	/* loaned publication & borrowed copy test */
+	int test_loan();
+
+	/* work queue callback test */
+	int test_work_callback();
+	static void work_callback_worker(void *arg);
+	static void work_callback_slow_worker(void *arg);
+	int _callback_sub = -1;
+	volatile int _num_callbacks = 0;
+	volatile int _callback_last_val = -1;
+	int _callback_stop_val = 0; /**< the worker unregisters itself after seeing this value */
+	orb_work_callback_t _callback_handle = nullptr;
+	volatile int _callback_unregistered = 0; /**< 1: unregistered by the worker, -1: unregistering failed */
+	volatile int _callback_in_worker = 0; /**< 1: the slow worker is running, 2: it has returned */
+
+	/* latency statistics test */
+	int test_latency_statistics();
+
+	/* copy all queued elements test */
+	int test_copy_all();
+
+	/* shared interval timers test & benchmark */
+	int test_interval_groups();
+
+	/* persistent poll set test & benchmark */
+	int test_pollset();
+
+	/* direct subscription test & benchmark */
+	int test_direct_subscription();
+
+	/* update flags test */
+	int test_update_flag();
+
+	/* contention test */
+	static int contention_reader_entry(char *const argv[]);
+	int contention_reader_main();
+	volatile int _num_readers_running = 0;
+	volatile unsigned _num_copies = 0;
+	volatile unsigned _num_torn_reads = 0;
+
 	int test_fail(const char *fmt, ...);
 	int test_note(const char *fmt, ...);
 };
@@ -32,6 +32,7 @@
  ****************************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
 #include "../uORBDevices.hpp"
 #include "../uORB.h"
 #include "../uORBCommon.hpp"
@@ -44,7 +45,7 @@ extern "C" { __EXPORT int uorb_tests_main(int argc, char *argv[]); }
 
 static void usage()
 {
-	PX4_INFO("Usage: uorb_tests [latency_test]");
+	PX4_INFO("Usage: uorb_tests [latency_test] [contention [<num_readers>] [<duration_ms>]] [registry [<num_topics>]]");
 }
 
 int
@@ -90,6 +91,39 @@ uorb_tests_main(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * Publish/copy contention benchmark.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "contention")) {
+
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		int num_readers = (argc > 2) ? atoi(argv[2]) : 4;
+		unsigned duration_ms = (argc > 3) ? atoi(argv[3]) : 2000;
+
+		if (num_readers <= 0) {
+			usage();
+			return -EINVAL;
+		}
+
+		return t.contention_test(num_readers, duration_ms, true);
+	}
+
+	/*
+	 * Topic registry benchmark.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "registry")) {
+
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		int num_topics = (argc > 2) ? atoi(argv[2]) : 100;
+
+		if (num_topics <= 0) {
+			usage();
+			return -EINVAL;
+		}
+
+		return t.registry_test(num_topics, true);
+	}
+
 #endif
 
 	usage();
@@ -0,0 +1,147 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file px4_nuttx_pollset.c
+ * Poll set API for NuttX. NuttX poll() is cheap already, so this just keeps
+ * the descriptors in an array and forwards to poll().
+ */
+
+#include <px4_config.h>
+#include <px4_posix.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct px4_pollset {
+	struct pollfd *fds;
+	unsigned count;
+	unsigned capacity;
+};
+
+px4_pollset_t *px4_pollset_create(void)
+{
+	px4_pollset_t *set = (px4_pollset_t *)calloc(1, sizeof(px4_pollset_t));
+
+	if (!set) {
+		errno = ENOMEM;
+	}
+
+	return set;
+}
+
+void px4_pollset_destroy(px4_pollset_t *set)
+{
+	if (set) {
+		free(set->fds);
+		free(set);
+	}
+}
+
+int px4_pollset_add(px4_pollset_t *set, int fd, pollevent_t events)
+{
+	if (!set || fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (unsigned i = 0; i < set->count; ++i) {
+		if (set->fds[i].fd == fd) {
+			errno = EEXIST;
+			return -1;
+		}
+	}
+
+	if (set->count == set->capacity) {
+		const unsigned new_capacity = set->capacity > 0 ? set->capacity * 2 : 4;
+		struct pollfd *new_fds = (struct pollfd *)realloc(set->fds, new_capacity * sizeof(struct pollfd));
+
+		if (!new_fds) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		set->fds = new_fds;
+		set->capacity = new_capacity;
+	}
+
+	memset(&set->fds[set->count], 0, sizeof(struct pollfd));
+	set->fds[set->count].fd = fd;
+	set->fds[set->count].events = events;
+	++set->count;
+	return 0;
+}
+
+int px4_pollset_remove(px4_pollset_t *set, int fd)
+{
+	if (!set) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (unsigned i = 0; i < set->count; ++i) {
+		if (set->fds[i].fd == fd) {
+			set->fds[i] = set->fds[--set->count];
+			return 0;
+		}
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+int px4_pollset_wait(px4_pollset_t *set, px4_pollfd_struct_t *ready, unsigned max_ready, int timeout)
+{
+	if (!set || !ready || max_ready == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	int ret = poll(set->fds, set->count, timeout);
+
+	if (ret <= 0) {
+		return ret;
+	}
+
+	unsigned count = 0;
+
+	for (unsigned i = 0; i < set->count && count < max_ready; ++i) {
+		if (set->fds[i].revents != 0) {
+			ready[count++] = set->fds[i];
+		}
+	}
+
+	return count;
+}
@@ -102,8 +102,26 @@ static void *entry_adapter(void *ptr)
 		PX4_ERR("px4_task_spawn_cmd: failed to set name of thread %d %d\n", rv, errno);
 	}
 
+	// alternate stack for signal handlers, so that a fault handler (e.g. the flight recorder's)
+	// still runs after a stack overflow of the task
+	stack_t signal_stack = {};
+	signal_stack.ss_size = SIGSTKSZ;
+	signal_stack.ss_sp = malloc(signal_stack.ss_size);
+
+	if (signal_stack.ss_sp != nullptr && sigaltstack(&signal_stack, nullptr) != 0) {
+		free(signal_stack.ss_sp);
+		signal_stack.ss_sp = nullptr;
+	}
+
 	data->entry(data->argc, data->argv);
 	free(ptr);
+
+	if (signal_stack.ss_sp != nullptr) {
+		stack_t disable = {};
+		disable.ss_flags = SS_DISABLE;
+		sigaltstack(&disable, nullptr);
+		free(signal_stack.ss_sp);
+	}
 	PX4_DEBUG("Before px4_task_exit");
 	px4_task_exit(0);
 	PX4_DEBUG("After px4_task_exit");
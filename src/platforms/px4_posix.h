@@ -128,6 +128,56 @@ __END_DECLS
 // Most full-scale OS use 1-4K of memory from the stack themselves
 #define PX4_STACK_ADJUSTED(_s) (_s * (__SIZEOF_POINTER__ >> 2) + PX4_STACK_OVERHEAD)
 
+/**
+ * Persistent poll set, an alternative to px4_poll() for loops that wait on the same
+ * descriptors over and over (similar to epoll). Interest is registered once with
+ * px4_pollset_add(); px4_pollset_wait() then reuses the registration and wait object
+ * instead of setting up and tearing down every descriptor on each call.
+ *
+ * A set must only be waited on by one thread at a time, and descriptors must be removed
+ * from the set (or the set destroyed) before they are closed.
+ */
+typedef struct px4_pollset px4_pollset_t;
+
+__BEGIN_DECLS
+
+/**
+ * Create an empty poll set.
+ * @return the set, or NULL if out of memory
+ */
+__EXPORT px4_pollset_t	*px4_pollset_create(void);
+
+/**
+ * Remove all descriptors from a set and free it.
+ */
+__EXPORT void		px4_pollset_destroy(px4_pollset_t *set);
+
+/**
+ * Add a descriptor to a set.
+ * @param events	the events to wait for (e.g. POLLIN)
+ * @return 0 on success, -1 otherwise (errno is set)
+ */
+__EXPORT int		px4_pollset_add(px4_pollset_t *set, int fd, pollevent_t events);
+
+/**
+ * Remove a descriptor from a set.
+ * @return 0 on success, -1 if the descriptor is not in the set (errno is set)
+ */
+__EXPORT int		px4_pollset_remove(px4_pollset_t *set, int fd);
+
+/**
+ * Wait until at least one descriptor of the set is ready.
+ * @param ready		array that is filled with fd, events and revents of the ready descriptors.
+ *			Descriptors that do not fit are reported again on the next call.
+ * @param max_ready	size of ready
+ * @param timeout	timeout in ms, 0 to return immediately, -1 to wait forever
+ * @return the number of ready descriptors, 0 on timeout, -1 on error (errno is set)
+ */
+__EXPORT int		px4_pollset_wait(px4_pollset_t *set, px4_pollfd_struct_t *ready, unsigned max_ready,
+					 int timeout);
+
+__END_DECLS
+
 __BEGIN_DECLS
 extern int px4_errno;
 
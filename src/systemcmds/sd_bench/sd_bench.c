@@ -37,8 +37,13 @@
  * SD Card benchmarking
  */
 
+#ifdef __PX4_LINUX
+#define _GNU_SOURCE // fallocate()
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -49,17 +54,47 @@
 
 #include <drivers/drv_hrt.h>
 
+/** log2-scaled histogram of write latencies: 4 bins per power of 2 */
+#define LATENCY_BINS 128
+
+struct latency_histogram {
+	uint32_t bins[LATENCY_BINS];
+	uint32_t count;
+	uint32_t max_us;
+};
+
+/** size by which the file is extended in preallocated mode (same as the logger) */
+#define PREALLOC_EXTENT (4 * 1024 * 1024)
+
 static void	usage(void);
 
-/** sequential write speed test */
-static void	write_test(int fd, uint8_t *block, int block_size);
+/**
+ * sequential write speed test
+ * @param preallocated use the preallocated mode: preallocate the file, write with pwrite()
+ *                     at explicit offsets and sync with fdatasync()
+ * @param hist accumulated write latencies of all runs
+ * @return 0 on success
+ */
+static int	write_test(int fd, uint8_t *block, int block_size, bool preallocated, struct latency_histogram *hist);
 
 /**
- * Measure the time for fsync.
+ * Measure the time for fsync (or fdatasync in preallocated mode).
  * @param fd
  * @return time in ms
  */
-static inline unsigned int time_fsync(int fd);
+static inline unsigned int time_fsync(int fd, bool preallocated);
+
+/**
+ * Make sure the file space up to end is allocated (preallocated mode, only supported on Linux)
+ */
+static void	preallocate(int fd, off_t end, off_t *allocated);
+
+static void	latency_add(struct latency_histogram *hist, uint32_t us);
+
+/** @return upper bound of the latency [us] below which the given fraction of the writes completed */
+static uint32_t	latency_percentile(const struct latency_histogram *hist, float fraction);
+
+static void	print_latencies(const char *name, const struct latency_histogram *hist);
 
 __EXPORT int	sd_bench_main(int argc, char *argv[]);
 
@@ -74,12 +109,14 @@ usage()
 {
 	PX4_WARN(
 		"Test the speed of an SD Card. Usage:\n"
-		"sd_bench [-b <block_size>] [-r <runs>] [-d <duration>] [-s]\n"
+		"sd_bench [-b <block_size>] [-r <runs>] [-d <duration>] [-s] [-p|-c]\n"
 		"\n"
 		"\t-b <block_size>\t\tBlock size for each read/write (default=4096)\n"
 		"\t-r <runs>\t\tNumber of runs (default=5)\n"
 		"\t-d <duration>\t\tDuration of a run in ms (default=2000)\n"
 		"\t-s \t\t\tCall fsync after each block (default=at end of each run)\n"
+		"\t-p \t\t\tPreallocated mode (like the logger with SDLOG_PREALLOC)\n"
+		"\t-c \t\t\tCompare the write latencies of the normal and the preallocated mode\n"
 	);
 
 }
@@ -91,11 +128,13 @@ sd_bench_main(int argc, char *argv[])
 	int myoptind = 1;
 	int ch;
 	const char *myoptarg = NULL;
+	bool preallocated = false;
+	bool compare = false;
 	synchronized = false;
 	num_runs = 5;
 	run_duration = 2000;
 
-	while ((ch = px4_getopt(argc, argv, "b:r:d:s", &myoptind, &myoptarg)) != EOF) {
+	while ((ch = px4_getopt(argc, argv, "b:r:d:spc", &myoptind, &myoptarg)) != EOF) {
 		switch (ch) {
 		case 'b':
 			block_size = strtol(myoptarg, NULL, 0);
@@ -113,6 +152,14 @@ sd_bench_main(int argc, char *argv[])
 			synchronized = true;
 			break;
 
+		case 'p':
+			preallocated = true;
+			break;
+
+		case 'c':
+			compare = true;
+			break;
+
 		default:
 			usage();
 			return -1;
@@ -120,13 +167,6 @@ sd_bench_main(int argc, char *argv[])
 		}
 	}
 
-	int bench_fd = open(BENCHMARK_FILE, O_CREAT | O_WRONLY | O_TRUNC, PX4_O_MODE_666);
-
-	if (bench_fd < 0) {
-		PX4_ERR("Can't open benchmark file %s", BENCHMARK_FILE);
-		return -1;
-	}
-
 	if (block_size <= 0 || num_runs <= 0) {
 		PX4_ERR("invalid argument");
 		return -1;
@@ -144,29 +184,141 @@ sd_bench_main(int argc, char *argv[])
 		block[i] = (uint8_t)i;
 	}
 
-	PX4_INFO("Using block size = %i bytes, sync=%i", block_size, (int)synchronized);
-	write_test(bench_fd, block, block_size);
+	const int num_modes = compare ? 2 : 1;
+	struct latency_histogram hist[2];
+	memset(hist, 0, sizeof(hist));
+	int ret = 0;
+
+	for (int mode = 0; mode < num_modes && ret == 0; ++mode) {
+		bool mode_preallocated = compare ? mode == 1 : preallocated;
+
+		int bench_fd = open(BENCHMARK_FILE, O_CREAT | O_WRONLY | O_TRUNC, PX4_O_MODE_666);
+
+		if (bench_fd < 0) {
+			PX4_ERR("Can't open benchmark file %s", BENCHMARK_FILE);
+			ret = -1;
+			break;
+		}
+
+		PX4_INFO("Using block size = %i bytes, sync=%i, preallocated=%i", block_size, (int)synchronized,
+			 (int)mode_preallocated);
+		ret = write_test(bench_fd, block, block_size, mode_preallocated, &hist[mode]);
+
+		close(bench_fd);
+		unlink(BENCHMARK_FILE);
+	}
+
+	if (ret == 0) {
+		PX4_INFO("");
+		PX4_INFO("Write latency [us]:        p50      p90      p99    p99.9      max");
+
+		if (compare) {
+			print_latencies("normal", &hist[0]);
+			print_latencies("preallocated", &hist[1]);
+
+		} else {
+			print_latencies(preallocated ? "preallocated" : "normal", &hist[0]);
+		}
+	}
 
 	free(block);
-	close(bench_fd);
-	unlink(BENCHMARK_FILE);
 
-	return 0;
+	return ret;
 }
 
-unsigned int time_fsync(int fd)
+unsigned int time_fsync(int fd, bool preallocated)
 {
 	hrt_abstime fsync_start = hrt_absolute_time();
+
+#ifdef __PX4_LINUX
+
+	if (preallocated) {
+		//the file size still changes with each write (FALLOC_FL_KEEP_SIZE), fdatasync() includes it
+		fdatasync(fd);
+
+	} else {
+		fsync(fd);
+	}
+
+#else
 	fsync(fd);
+#endif
+
 	return hrt_elapsed_time(&fsync_start) / 1000;
 }
 
-void write_test(int fd, uint8_t *block, int block_size)
+void preallocate(int fd, off_t end, off_t *allocated)
+{
+#ifdef __PX4_LINUX
+
+	while (end > *allocated) {
+		if (fallocate(fd, FALLOC_FL_KEEP_SIZE, *allocated, PREALLOC_EXTENT) != 0) {
+			PX4_WARN("preallocation not supported");
+			*allocated = INT32_MAX;
+			return;
+		}
+
+		*allocated += PREALLOC_EXTENT;
+	}
+
+#endif
+}
+
+void latency_add(struct latency_histogram *hist, uint32_t us)
+{
+	int bin = us;
+
+	if (us >= 4) {
+		int msb = 31 - __builtin_clz(us);
+		bin = (msb - 1) * 4 + ((us >> (msb - 2)) & 3);
+	}
+
+	++hist->bins[bin];
+	++hist->count;
+
+	if (us > hist->max_us) {
+		hist->max_us = us;
+	}
+}
+
+uint32_t latency_percentile(const struct latency_histogram *hist, float fraction)
+{
+	uint32_t threshold = (uint32_t)(fraction * hist->count + 0.5f);
+	uint32_t sum = 0;
+
+	for (int bin = 0; bin < LATENCY_BINS; ++bin) {
+		sum += hist->bins[bin];
+
+		if (sum >= threshold && sum > 0) {
+			uint32_t upper = bin;
+
+			if (bin >= 4) {
+				int shift = bin / 4 - 1;
+				upper = ((uint32_t)(4 + bin % 4 + 1) << shift) - 1;
+			}
+
+			return upper < hist->max_us ? upper : hist->max_us;
+		}
+	}
+
+	return hist->max_us;
+}
+
+void print_latencies(const char *name, const struct latency_histogram *hist)
+{
+	PX4_INFO("  %-19s %8u %8u %8u %8u %8u", name,
+		 latency_percentile(hist, 0.5f), latency_percentile(hist, 0.9f), latency_percentile(hist, 0.99f),
+		 latency_percentile(hist, 0.999f), hist->max_us);
+}
+
+int write_test(int fd, uint8_t *block, int block_size, bool preallocated, struct latency_histogram *hist)
 {
 	PX4_INFO("");
 	PX4_INFO("Testing Sequential Write Speed...");
 	double total_elapsed = 0.;
 	unsigned int total_blocks = 0;
+	off_t offset = 0;
+	off_t allocated = 0;
 
 	for (int run = 0; run < num_runs; ++run) {
 		hrt_abstime start = hrt_absolute_time();
@@ -177,8 +329,19 @@ void write_test(int fd, uint8_t *block, int block_size)
 		while (hrt_elapsed_time(&start) < run_duration * 1000) {
 
 			hrt_abstime write_start = hrt_absolute_time();
-			size_t written = write(fd, block, block_size);
-			unsigned int write_time = hrt_elapsed_time(&write_start) / 1000;
+			ssize_t written;
+
+			if (preallocated) {
+				preallocate(fd, offset + block_size, &allocated);
+				written = pwrite(fd, block, block_size, offset);
+
+			} else {
+				written = write(fd, block, block_size);
+			}
+
+			uint32_t write_time_us = hrt_elapsed_time(&write_start);
+			unsigned int write_time = write_time_us / 1000;
+			latency_add(hist, write_time_us);
 
 			if (write_time > max_write_time) {
 				max_write_time = write_time;
@@ -186,20 +349,21 @@ void write_test(int fd, uint8_t *block, int block_size)
 
 			if ((int)written != block_size) {
 				PX4_ERR("Write error");
-				return;
+				return -1;
 			}
 
 			if (synchronized) {
-				fsync_time += time_fsync(fd);
+				fsync_time += time_fsync(fd, preallocated);
 			}
 
+			offset += block_size;
 			++num_blocks;
 		}
 
 		//Note: if testing a slow device (SD Card) and the OS buffers a lot (eg. Linux),
 		//fsync can take really long, and it looks like the process hangs. But it does
 		//not and the reported result will still be correct.
-		fsync_time += time_fsync(fd);
+		fsync_time += time_fsync(fd, preallocated);
 
 		//report
 		double elapsed = hrt_elapsed_time(&start) / 1.e6;
@@ -212,4 +376,5 @@ void write_test(int fd, uint8_t *block, int block_size)
 	}
 
 	PX4_INFO("  Avg   : %8.2lf KB/s", (double)block_size * total_blocks / total_elapsed / 1024.);
+	return 0;
 }
@@ -0,0 +1,981 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file uorb_bench.cpp
+ *
+ * uORB throughput and latency benchmarks, with CSV or JSON output so that
+ * results of different builds can be compared.
+ */
+
+#include <px4_config.h>
+#include <px4_defines.h>
+#include <px4_getopt.h>
+#include <px4_log.h>
+#include <px4_posix.h>
+#include <px4_tasks.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <drivers/drv_hrt.h>
+#include <systemlib/git_version.h>
+#include <uORB/uORB.h>
+
+extern "C" __EXPORT int uorb_bench_main(int argc, char *argv[]);
+
+namespace uorb_bench
+{
+
+/** header of every benchmark message, the rest of the message is payload */
+struct bench_msg {
+	uint64_t timestamp; /**< publication time */
+	uint32_t seq;
+	uint32_t publisher;
+};
+
+static const unsigned max_msg_size = 4096;
+static const unsigned max_threads = 16;
+
+/** the benchmark threads only publish and copy topics of this size, so that their buffers fit on the stack */
+static const unsigned thread_msg_size = 64;
+static const unsigned thread_stack_size = 2000;
+
+/**
+ * Collects the results and prints them as CSV or JSON.
+ */
+class Report
+{
+public:
+	enum class Format {
+		CSV,
+		JSON
+	};
+
+	Report() = default;
+	~Report() { delete[] _rows; }
+
+	bool init(unsigned max_rows)
+	{
+		_rows = new Row[max_rows];
+		_max_rows = max_rows;
+		return _rows != nullptr;
+	}
+
+	void add(const char *benchmark, const char *config, const char *metric, double value, const char *unit)
+	{
+		if (_num_rows >= _max_rows) {
+			PX4_WARN("too many results, dropping %s %s", benchmark, metric);
+			return;
+		}
+
+		Row &row = _rows[_num_rows++];
+		row.benchmark = benchmark;
+		strncpy(row.config, config, sizeof(row.config) - 1);
+		row.config[sizeof(row.config) - 1] = '\0';
+		row.metric = metric;
+		row.value = value;
+		row.unit = unit;
+	}
+
+	void print(FILE *out, Format format, unsigned duration_ms, unsigned iterations) const
+	{
+		if (format == Format::CSV) {
+			fprintf(out, "benchmark,config,metric,value,unit\n");
+
+			for (unsigned i = 0; i < _num_rows; ++i) {
+				const Row &row = _rows[i];
+				fprintf(out, "%s,%s,%s,%.3f,%s\n", row.benchmark, row.config, row.metric, row.value, row.unit);
+			}
+
+			return;
+		}
+
+		fprintf(out, "{\n  \"version\": \"%s\",\n  \"duration_ms\": %u,\n  \"iterations\": %u,\n  \"results\": [\n",
+			px4_git_version, duration_ms, iterations);
+
+		for (unsigned i = 0; i < _num_rows; ++i) {
+			const Row &row = _rows[i];
+			fprintf(out, "    {\"benchmark\": \"%s\", \"config\": \"%s\", \"metric\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}%s\n",
+				row.benchmark, row.config, row.metric, row.value, row.unit, i + 1 < _num_rows ? "," : "");
+		}
+
+		fprintf(out, "  ]\n}\n");
+	}
+
+private:
+	struct Row {
+		const char *benchmark;
+		char config[48];
+		const char *metric;
+		double value;
+		const char *unit;
+	};
+
+	Row *_rows{nullptr};
+	unsigned _max_rows{0};
+	unsigned _num_rows{0};
+};
+
+/**
+ * The benchmarks. Each one runs a fixed set of configurations in a fixed order;
+ * the timed ones run for a fixed duration with publishers at fixed rates.
+ */
+class Bench
+{
+public:
+	Bench(Report &report, unsigned duration_ms, unsigned iterations) :
+		_report(report), _duration_ms(duration_ms), _iterations(iterations) {}
+
+	/** single publisher and subscriber in one thread: publish and copy time vs. message size */
+	int throughput();
+
+	/** publishers and subscribers in separate threads: delivery ratio and latency */
+	int fanout();
+
+	/** bursts into queued topics: delivered messages and copy time */
+	int queue();
+
+	/** rate-limited subscribers (orb_set_interval()): update rate and spacing */
+	int interval();
+
+	/** latency from publication to the return of px4_poll()/px4_pollset_wait() */
+	int wakeup();
+
+private:
+	/**
+	 * Get (or create) the metadata of a benchmark topic. Topic nodes are never deleted,
+	 * so the metadata is kept for further runs.
+	 */
+	static const struct orb_metadata *topic(const char *name, unsigned size);
+
+	/** start threads running entry, which get their index with thread_index() */
+	bool start_threads(const char *name, int priority, unsigned count, px4_main_t entry);
+	void stop_threads();
+	unsigned thread_index() { return __atomic_fetch_add(&_next_thread_index, 1, __ATOMIC_SEQ_CST); }
+
+	/** publish at a fixed rate until the benchmark duration has passed (meta->o_size <= thread_msg_size) */
+	unsigned publish_at_rate(const struct orb_metadata *meta, orb_advert_t handle, uint32_t publisher, unsigned rate_hz);
+
+	static int fanout_publisher_entry(int argc, char *argv[]);
+	static int fanout_subscriber_entry(int argc, char *argv[]);
+	static int interval_subscriber_entry(int argc, char *argv[]);
+	static int wakeup_subscriber_entry(int argc, char *argv[]);
+
+	Report &_report;
+	const unsigned _duration_ms;
+	const unsigned _iterations;
+
+	/* state shared with the benchmark threads */
+	const struct orb_metadata *_meta{nullptr};
+	unsigned _num_publishers{0};
+	unsigned _interval_ms{0};
+	bool _use_pollset{false};
+	volatile bool _should_exit{false};
+	volatile unsigned _threads_running{0};
+	unsigned _next_thread_index{0};
+	uint64_t _received[max_threads];
+	uint64_t _latency_sum[max_threads]; /**< [us] */
+	uint32_t _latency_max[max_threads]; /**< [us] */
+	uint32_t _interval_max[max_threads]; /**< [us] largest spacing between two updates */
+	uint32_t *_samples{nullptr}; /**< [us] wakeup latencies */
+	unsigned _max_samples{0};
+	volatile unsigned _num_samples{0};
+	volatile bool _subscriber_ready{false};
+};
+
+static Bench *_bench = nullptr;
+
+const struct orb_metadata *Bench::topic(const char *name, unsigned size)
+{
+	struct Topic {
+		const struct orb_metadata *meta;
+		Topic *next;
+	};
+	static Topic *topics = nullptr;
+
+	for (Topic *t = topics; t != nullptr; t = t->next) {
+		if (strcmp(t->meta->o_name, name) == 0) {
+			return t->meta;
+		}
+	}
+
+	char *topic_name = strdup(name);
+	Topic *t = new Topic;
+
+	if (topic_name == nullptr || t == nullptr) {
+		free(topic_name);
+		delete t;
+		return nullptr;
+	}
+
+	t->meta = new orb_metadata{topic_name, size, size, "uint64_t timestamp;uint32_t seq;uint32_t publisher;"};
+
+	if (t->meta == nullptr) {
+		free(topic_name);
+		delete t;
+		return nullptr;
+	}
+
+	t->next = topics;
+	topics = t;
+	return t->meta;
+}
+
+bool Bench::start_threads(const char *name, int priority, unsigned count, px4_main_t entry)
+{
+	char *const args[1] = { nullptr };
+
+	for (unsigned i = 0; i < count; ++i) {
+		__atomic_fetch_add(&_threads_running, 1, __ATOMIC_SEQ_CST);
+
+		if (px4_task_spawn_cmd(name, SCHED_DEFAULT, priority, thread_stack_size, entry, args) < 0) {
+			__atomic_fetch_sub(&_threads_running, 1, __ATOMIC_SEQ_CST);
+			PX4_ERR("failed to start %s", name);
+			stop_threads();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Bench::stop_threads()
+{
+	_should_exit = true;
+
+	while (_threads_running > 0) {
+		usleep(1000);
+	}
+}
+
+unsigned Bench::publish_at_rate(const struct orb_metadata *meta, orb_advert_t handle, uint32_t publisher,
+				unsigned rate_hz)
+{
+	uint8_t buffer[thread_msg_size] = {};
+	bench_msg *msg = (bench_msg *)buffer;
+	msg->publisher = publisher;
+
+	const hrt_abstime period = 1000000 / rate_hz;
+	const hrt_abstime start = hrt_absolute_time();
+	const hrt_abstime end = start + _duration_ms * 1000;
+	hrt_abstime next = start;
+	unsigned published = 0;
+
+	for (hrt_abstime now = start; now < end; now = hrt_absolute_time()) {
+		if (now < next) {
+			usleep(next - now);
+			continue;
+		}
+
+		msg->timestamp = hrt_absolute_time();
+		orb_publish(meta, handle, buffer);
+		msg->seq = ++published;
+		next += period;
+	}
+
+	return published;
+}
+
+int Bench::throughput()
+{
+	static const unsigned sizes[] = { 16, 64, 256, 1024, 4096 };
+	/* not on the stack: it is as large as the stack of the command */
+	static uint8_t buffer[max_msg_size];
+	memset(buffer, 0, sizeof(buffer));
+	char name[32];
+	char config[48];
+
+	for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		const unsigned size = sizes[s];
+		snprintf(name, sizeof(name), "uorb_bench_size%u", size);
+		const struct orb_metadata *meta = topic(name, size);
+
+		if (meta == nullptr) {
+			return -ENOMEM;
+		}
+
+		orb_advert_t handle = orb_advertise(meta, buffer);
+		int sub = orb_subscribe(meta);
+
+		if (handle == nullptr || sub < 0) {
+			PX4_ERR("advertise/subscribe failed");
+			return -1;
+		}
+
+		hrt_abstime start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < _iterations; ++i) {
+			((bench_msg *)buffer)->seq = i;
+			orb_publish(meta, handle, buffer);
+		}
+
+		const hrt_abstime publish_time = hrt_elapsed_time(&start);
+
+		start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < _iterations; ++i) {
+			bool updated;
+			orb_check(sub, &updated);
+			orb_copy(meta, sub, buffer);
+		}
+
+		const hrt_abstime copy_time = hrt_elapsed_time(&start);
+
+		orb_unsubscribe(sub);
+		orb_unadvertise(handle);
+
+		snprintf(config, sizeof(config), "size=%u", size);
+		_report.add("throughput", config, "publish", publish_time * 1e3 / _iterations, "ns");
+		_report.add("throughput", config, "check_copy", copy_time * 1e3 / _iterations, "ns");
+		_report.add("throughput", config, "publish_bandwidth", (double)size * _iterations / publish_time, "MB/s");
+	}
+
+	return 0;
+}
+
+int Bench::fanout_publisher_entry(int argc, char *argv[])
+{
+	Bench *b = _bench;
+	const unsigned index = b->thread_index();
+	uint8_t buffer[thread_msg_size] = {};
+	int instance;
+	orb_advert_t handle = orb_advertise_multi(b->_meta, buffer, &instance, ORB_PRIO_DEFAULT);
+
+	if (handle != nullptr) {
+		b->_received[index] = b->publish_at_rate(b->_meta, handle, instance, 1000);
+		orb_unadvertise(handle);
+	}
+
+	__atomic_fetch_sub(&b->_threads_running, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int Bench::fanout_subscriber_entry(int argc, char *argv[])
+{
+	Bench *b = _bench;
+	const unsigned index = b->thread_index();
+	uint8_t buffer[thread_msg_size];
+	px4_pollfd_struct_t fds[ORB_MULTI_MAX_INSTANCES];
+
+	for (unsigned i = 0; i < b->_num_publishers; ++i) {
+		fds[i].fd = orb_subscribe_multi(b->_meta, i);
+		fds[i].events = POLLIN;
+	}
+
+	while (!b->_should_exit) {
+		if (px4_poll(fds, b->_num_publishers, 50) <= 0) {
+			continue;
+		}
+
+		for (unsigned i = 0; i < b->_num_publishers; ++i) {
+			if (fds[i].revents & POLLIN) {
+				orb_copy(b->_meta, fds[i].fd, buffer);
+
+				/* skip the initial data of the advertisement */
+				if (((bench_msg *)buffer)->timestamp == 0) {
+					continue;
+				}
+
+				const uint32_t latency = hrt_absolute_time() - ((bench_msg *)buffer)->timestamp;
+				++b->_received[index];
+				b->_latency_sum[index] += latency;
+
+				if (latency > b->_latency_max[index]) {
+					b->_latency_max[index] = latency;
+				}
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < b->_num_publishers; ++i) {
+		orb_unsubscribe(fds[i].fd);
+	}
+
+	__atomic_fetch_sub(&b->_threads_running, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int Bench::fanout()
+{
+	static const unsigned configs[][2] = { {1, 1}, {1, 4}, {1, 8}, {2, 4}, {4, 4}, {4, 8} };
+	char name[32];
+	char config[48];
+
+	for (unsigned c = 0; c < sizeof(configs) / sizeof(configs[0]); ++c) {
+		const unsigned num_publishers = configs[c][0];
+		const unsigned num_subscribers = configs[c][1];
+		snprintf(name, sizeof(name), "uorb_bench_fanout%u", c);
+		_meta = topic(name, thread_msg_size);
+
+		if (_meta == nullptr) {
+			return -ENOMEM;
+		}
+
+		/* thread indexes: subscribers first, then publishers */
+		memset(_received, 0, sizeof(_received));
+		memset(_latency_sum, 0, sizeof(_latency_sum));
+		memset(_latency_max, 0, sizeof(_latency_max));
+		_num_publishers = num_publishers;
+		_next_thread_index = 0;
+		_should_exit = false;
+
+		/* create the instances, so that the subscribers can subscribe to all of them */
+		uint8_t buffer[thread_msg_size] = {};
+		orb_advert_t handles[ORB_MULTI_MAX_INSTANCES];
+
+		for (unsigned i = 0; i < num_publishers; ++i) {
+			int instance;
+			handles[i] = orb_advertise_multi(_meta, buffer, &instance, ORB_PRIO_DEFAULT);
+		}
+
+		for (unsigned i = 0; i < num_publishers; ++i) {
+			orb_unadvertise(handles[i]);
+		}
+
+		if (!start_threads("uorb_bench_sub", SCHED_PRIORITY_MAX - 10, num_subscribers, fanout_subscriber_entry)) {
+			return -1;
+		}
+
+		while (_next_thread_index < num_subscribers) {
+			usleep(1000);
+		}
+
+		/* let the subscribers set up the polling */
+		usleep(10000);
+
+		if (!start_threads("uorb_bench_pub", SCHED_PRIORITY_MAX - 20, num_publishers, fanout_publisher_entry)) {
+			return -1;
+		}
+
+		/* wait for the publishers, then give the subscribers time to get the last messages */
+		while (_threads_running > num_subscribers) {
+			usleep(1000);
+		}
+
+		usleep(20000);
+		stop_threads();
+
+		uint64_t published = 0;
+		uint64_t received = 0;
+		uint64_t latency_sum = 0;
+		uint32_t latency_max = 0;
+
+		for (unsigned i = 0; i < num_subscribers; ++i) {
+			received += _received[i];
+			latency_sum += _latency_sum[i];
+
+			if (_latency_max[i] > latency_max) {
+				latency_max = _latency_max[i];
+			}
+		}
+
+		for (unsigned i = num_subscribers; i < num_subscribers + num_publishers; ++i) {
+			published += _received[i];
+		}
+
+		snprintf(config, sizeof(config), "pubs=%u subs=%u", num_publishers, num_subscribers);
+		_report.add("fanout", config, "published", published * 1000.0 / _duration_ms, "msg/s");
+		_report.add("fanout", config, "delivered", received * 1000.0 / _duration_ms, "msg/s");
+		_report.add("fanout", config, "delivery_ratio",
+			    published > 0 ? (double)received / (published * num_subscribers) : 0.0, "");
+		_report.add("fanout", config, "latency_mean", received > 0 ? (double)latency_sum / received : 0.0, "us");
+		_report.add("fanout", config, "latency_max", latency_max, "us");
+	}
+
+	return 0;
+}
+
+int Bench::queue()
+{
+	static const unsigned queue_sizes[] = { 1, 4, 16 };
+	static const unsigned bursts[] = { 1, 4, 16 };
+	static const unsigned msg_size = 64;
+	uint8_t buffer[msg_size * 16] = {};
+	char name[32];
+	char config[48];
+
+	for (unsigned q = 0; q < sizeof(queue_sizes) / sizeof(queue_sizes[0]); ++q) {
+		/* the queue size is fixed when the topic is created, so use one topic per size */
+		const unsigned queue_size = queue_sizes[q];
+		snprintf(name, sizeof(name), "uorb_bench_queue%u", queue_size);
+		const struct orb_metadata *meta = topic(name, msg_size);
+
+		if (meta == nullptr) {
+			return -ENOMEM;
+		}
+
+		orb_advert_t handle = orb_advertise_queue(meta, buffer, queue_size);
+
+		if (handle == nullptr) {
+			PX4_ERR("advertise failed");
+			return -1;
+		}
+
+		for (unsigned b = 0; b < sizeof(bursts) / sizeof(bursts[0]); ++b) {
+			const unsigned burst = bursts[b];
+			const unsigned rounds = _iterations / burst > 0 ? _iterations / burst : 1;
+
+			/* drain with orb_check() + orb_copy() and with orb_copy_all() */
+			for (int copy_all = 0; copy_all < 2; ++copy_all) {
+				int sub = orb_subscribe(meta);
+
+				if (sub < 0) {
+					PX4_ERR("subscribe failed");
+					orb_unadvertise(handle);
+					return -1;
+				}
+
+				uint64_t received = 0;
+				hrt_abstime copy_time = 0;
+
+				for (unsigned r = 0; r < rounds; ++r) {
+					for (unsigned i = 0; i < burst; ++i) {
+						orb_publish(meta, handle, buffer);
+					}
+
+					const hrt_abstime start = hrt_absolute_time();
+
+					if (copy_all) {
+						int ret = orb_copy_all(meta, sub, buffer, 16, nullptr);
+
+						if (ret > 0) {
+							received += ret;
+						}
+
+					} else {
+						bool updated = true;
+
+						while (orb_check(sub, &updated) == PX4_OK && updated) {
+							orb_copy(meta, sub, buffer);
+							++received;
+						}
+					}
+
+					copy_time += hrt_elapsed_time(&start);
+				}
+
+				orb_unsubscribe(sub);
+
+				snprintf(config, sizeof(config), "queue=%u burst=%u drain=%s", queue_size, burst,
+					 copy_all ? "copy_all" : "copy");
+				_report.add("queue", config, "received_ratio", (double)received / ((uint64_t)rounds * burst), "");
+				_report.add("queue", config, "copy_per_msg", received > 0 ? copy_time * 1e3 / received : 0.0, "ns");
+			}
+		}
+
+		orb_unadvertise(handle);
+	}
+
+	return 0;
+}
+
+int Bench::interval_subscriber_entry(int argc, char *argv[])
+{
+	Bench *b = _bench;
+	const unsigned index = b->thread_index();
+	uint8_t buffer[thread_msg_size];
+	px4_pollfd_struct_t fds[1];
+	fds[0].fd = orb_subscribe(b->_meta);
+	fds[0].events = POLLIN;
+	orb_set_interval(fds[0].fd, (index + 1) * b->_interval_ms);
+	hrt_abstime last_update = 0;
+
+	while (!b->_should_exit) {
+		if (px4_poll(fds, 1, 50) <= 0) {
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			orb_copy(b->_meta, fds[0].fd, buffer);
+			const hrt_abstime now = hrt_absolute_time();
+
+			if (last_update != 0) {
+				const uint32_t spacing = now - last_update;
+				b->_latency_sum[index] += spacing;
+
+				if (spacing > b->_interval_max[index]) {
+					b->_interval_max[index] = spacing;
+				}
+
+				++b->_received[index];
+			}
+
+			last_update = now;
+		}
+	}
+
+	orb_unsubscribe(fds[0].fd);
+	__atomic_fetch_sub(&b->_threads_running, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int Bench::interval()
+{
+	/* subscriber i uses an interval of (i + 1) * _interval_ms */
+	static const unsigned num_subscribers = 4;
+	static const unsigned publish_rate = 1000;
+	uint8_t buffer[thread_msg_size] = {};
+	char config[48];
+
+	_meta = topic("uorb_bench_interval", sizeof(buffer));
+
+	if (_meta == nullptr) {
+		return -ENOMEM;
+	}
+
+	orb_advert_t handle = orb_advertise(_meta, buffer);
+
+	if (handle == nullptr) {
+		PX4_ERR("advertise failed");
+		return -1;
+	}
+
+	memset(_received, 0, sizeof(_received));
+	memset(_latency_sum, 0, sizeof(_latency_sum));
+	memset(_interval_max, 0, sizeof(_interval_max));
+	_interval_ms = 5;
+	_next_thread_index = 0;
+	_should_exit = false;
+
+	if (!start_threads("uorb_bench_int", SCHED_PRIORITY_MAX - 10, num_subscribers, interval_subscriber_entry)) {
+		orb_unadvertise(handle);
+		return -1;
+	}
+
+	while (_next_thread_index < num_subscribers) {
+		usleep(1000);
+	}
+
+	publish_at_rate(_meta, handle, 0, publish_rate);
+	stop_threads();
+	orb_unadvertise(handle);
+
+	for (unsigned i = 0; i < num_subscribers; ++i) {
+		const unsigned interval_ms = (i + 1) * _interval_ms;
+		snprintf(config, sizeof(config), "pub_hz=%u interval_ms=%u", publish_rate, interval_ms);
+		_report.add("interval", config, "expected_rate", 1000.0 / interval_ms, "Hz");
+		_report.add("interval", config, "rate", _received[i] * 1000.0 / _duration_ms, "Hz");
+		_report.add("interval", config, "spacing_mean", _received[i] > 0 ? (double)_latency_sum[i] / _received[i] : 0.0, "us");
+		_report.add("interval", config, "spacing_max", _interval_max[i], "us");
+	}
+
+	return 0;
+}
+
+int Bench::wakeup_subscriber_entry(int argc, char *argv[])
+{
+	Bench *b = _bench;
+	uint8_t buffer[thread_msg_size];
+	px4_pollfd_struct_t fds[1];
+	fds[0].fd = orb_subscribe(b->_meta);
+	fds[0].events = POLLIN;
+	px4_pollset_t *pollset = nullptr;
+
+	if (b->_use_pollset) {
+		pollset = px4_pollset_create();
+
+		if (pollset == nullptr || px4_pollset_add(pollset, fds[0].fd, POLLIN) != 0) {
+			PX4_ERR("pollset setup failed");
+			b->_should_exit = true;
+		}
+	}
+
+	b->_subscriber_ready = true;
+
+	while (!b->_should_exit) {
+		int ret;
+
+		if (pollset) {
+			ret = px4_pollset_wait(pollset, fds, 1, 50);
+
+		} else {
+			ret = px4_poll(fds, 1, 50);
+		}
+
+		const hrt_abstime now = hrt_absolute_time();
+
+		if (ret <= 0 || !(fds[0].revents & POLLIN)) {
+			continue;
+		}
+
+		orb_copy(b->_meta, fds[0].fd, buffer);
+
+		if (b->_num_samples < b->_max_samples) {
+			b->_samples[b->_num_samples] = now - ((bench_msg *)buffer)->timestamp;
+			++b->_num_samples;
+		}
+	}
+
+	if (pollset) {
+		px4_pollset_destroy(pollset);
+	}
+
+	orb_unsubscribe(fds[0].fd);
+	__atomic_fetch_sub(&b->_threads_running, 1, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+	const uint32_t sa = *(const uint32_t *)a;
+	const uint32_t sb = *(const uint32_t *)b;
+	return sa < sb ? -1 : (sa > sb ? 1 : 0);
+}
+
+int Bench::wakeup()
+{
+	static const unsigned publish_rate = 500;
+	uint8_t buffer[thread_msg_size] = {};
+	char config[48];
+
+	_meta = topic("uorb_bench_wakeup", sizeof(buffer));
+
+	if (_meta == nullptr) {
+		return -ENOMEM;
+	}
+
+	_max_samples = publish_rate * _duration_ms / 1000 + 1;
+	_samples = new uint32_t[_max_samples];
+
+	if (_samples == nullptr) {
+		return -ENOMEM;
+	}
+
+	orb_advert_t handle = orb_advertise(_meta, buffer);
+
+	if (handle == nullptr) {
+		PX4_ERR("advertise failed");
+		delete[] _samples;
+		_samples = nullptr;
+		return -1;
+	}
+
+	for (int use_pollset = 0; use_pollset < 2; ++use_pollset) {
+		_use_pollset = use_pollset;
+		_num_samples = 0;
+		_subscriber_ready = false;
+		_should_exit = false;
+
+		if (!start_threads("uorb_bench_wake", SCHED_PRIORITY_MAX - 5, 1, wakeup_subscriber_entry)) {
+			break;
+		}
+
+		while (!_subscriber_ready) {
+			usleep(1000);
+		}
+
+		publish_at_rate(_meta, handle, 0, publish_rate);
+		usleep(10000);
+		stop_threads();
+
+		const unsigned n = _num_samples;
+		qsort(_samples, n, sizeof(_samples[0]), compare_samples);
+
+		snprintf(config, sizeof(config), "wait=%s", use_pollset ? "pollset" : "poll");
+		_report.add("wakeup", config, "samples", n, "");
+
+		if (n > 0) {
+			_report.add("wakeup", config, "p50", _samples[n * 50 / 100], "us");
+			_report.add("wakeup", config, "p90", _samples[n * 90 / 100], "us");
+			_report.add("wakeup", config, "p99", _samples[n * 99 / 100], "us");
+			_report.add("wakeup", config, "max", _samples[n - 1], "us");
+		}
+	}
+
+	orb_unadvertise(handle);
+	delete[] _samples;
+	_samples = nullptr;
+	return 0;
+}
+
+} // namespace uorb_bench
+
+static void
+usage()
+{
+	PX4_WARN(
+		"uORB throughput and latency benchmarks. Usage:\n"
+		"uorb_bench [-f csv|json] [-o <file>] [-d <duration>] [-n <iterations>] [<benchmark> ...]\n"
+		"\n"
+		"\t-f csv|json\t\tOutput format (default=csv)\n"
+		"\t-o <file>\t\tWrite the results to a file instead of stdout\n"
+		"\t-d <duration>\t\tDuration of the timed runs in ms (default=1000)\n"
+		"\t-n <iterations>\t\tIterations of the single-thread runs (default=20000)\n"
+		"\t<benchmark>\t\tthroughput, fanout, queue, interval or wakeup (default=all)\n"
+	);
+}
+
+int
+uorb_bench_main(int argc, char *argv[])
+{
+	using namespace uorb_bench;
+
+	Report::Format format = Report::Format::CSV;
+	const char *output_file = nullptr;
+	int duration = 1000;
+	int iterations = 20000;
+	int myoptind = 1;
+	int ch;
+	const char *myoptarg = nullptr;
+
+	while ((ch = px4_getopt(argc, argv, "f:o:d:n:", &myoptind, &myoptarg)) != EOF) {
+		switch (ch) {
+		case 'f':
+			if (strcmp(myoptarg, "csv") == 0) {
+				format = Report::Format::CSV;
+
+			} else if (strcmp(myoptarg, "json") == 0) {
+				format = Report::Format::JSON;
+
+			} else {
+				usage();
+				return -1;
+			}
+
+			break;
+
+		case 'o':
+			output_file = myoptarg;
+			break;
+
+		case 'd':
+			duration = strtol(myoptarg, nullptr, 0);
+			break;
+
+		case 'n':
+			iterations = strtol(myoptarg, nullptr, 0);
+			break;
+
+		default:
+			usage();
+			return -1;
+		}
+	}
+
+	if (duration <= 0 || iterations <= 0) {
+		PX4_ERR("invalid argument");
+		return -1;
+	}
+
+	if (_bench != nullptr) {
+		PX4_ERR("already running");
+		return -1;
+	}
+
+	static const struct {
+		const char *name;
+		int (Bench::*run)();
+	} benchmarks[] = {
+		{ "throughput", &Bench::throughput },
+		{ "fanout", &Bench::fanout },
+		{ "queue", &Bench::queue },
+		{ "interval", &Bench::interval },
+		{ "wakeup", &Bench::wakeup },
+	};
+	static const unsigned num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	bool selected[num_benchmarks] = {};
+	bool any_selected = false;
+
+	for (int i = myoptind; i < argc; ++i) {
+		bool found = false;
+
+		for (unsigned b = 0; b < num_benchmarks; ++b) {
+			if (strcmp(argv[i], benchmarks[b].name) == 0) {
+				selected[b] = true;
+				found = true;
+			}
+		}
+
+		if (!found) {
+			PX4_ERR("unknown benchmark %s", argv[i]);
+			usage();
+			return -1;
+		}
+
+		any_selected = true;
+	}
+
+	Report report;
+
+	if (!report.init(200)) {
+		PX4_ERR("alloc failed");
+		return -1;
+	}
+
+	_bench = new Bench(report, duration, iterations);
+
+	if (_bench == nullptr) {
+		PX4_ERR("alloc failed");
+		return -1;
+	}
+
+	int ret = 0;
+
+	for (unsigned b = 0; b < num_benchmarks && ret == 0; ++b) {
+		if (any_selected && !selected[b]) {
+			continue;
+		}
+
+		PX4_INFO("running %s", benchmarks[b].name);
+		ret = (_bench->*benchmarks[b].run)();
+
+		if (ret != 0) {
+			PX4_ERR("%s failed (%i)", benchmarks[b].name, ret);
+		}
+	}
+
+	delete _bench;
+	_bench = nullptr;
+
+	FILE *out = stdout;
+
+	if (output_file) {
+		out = fopen(output_file, "w");
+
+		if (out == nullptr) {
+			PX4_ERR("Can't open %s", output_file);
+			return -1;
+		}
+	}
+
+	report.print(out, format, duration, iterations);
+
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	return ret;
+}
@@ -0,0 +1,288 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "modules/uORB/uORBManager.hpp"
+#include "modules/muorb/shm/uORBShmChannel.hpp"
+
+#include "gtest/gtest.h"
+
+/*
+ * The channel talks to the local uORB through the IChannelRxHandler and looks up the
+ * DeviceMaster on start. Stub the Manager, there is none in these tests.
+ */
+uORB::Manager *uORB::Manager::_Instance = nullptr;
+
+uORB::DeviceMaster *uORB::Manager::get_device_master(Flavor flavor)
+{
+	return nullptr;
+}
+
+void uORB::DeviceMaster::announceSubscriptions(uORBCommunicator::IChannel *channel)
+{
+}
+
+/*
+ * Every process using the segment is a child of the test, as ShmChannel is a
+ * per-process singleton that can only be started once.
+ */
+class TestRxHandler : public uORBCommunicator::IChannelRxHandler
+{
+public:
+	int16_t process_add_subscription(const char *messageName, int32_t msgRateInHz) { return 0; }
+	int16_t process_remove_subscription(const char *messageName) { return 0; }
+
+	int16_t process_received_message(const char *messageName, int32_t length, uint8_t *data);
+
+	uint64_t received = 0;
+	bool updated = false; ///< test_value was received
+	bool torn = false; ///< torn_value was received
+};
+
+static const uint64_t test_value = 0x0123456789abcdefULL;
+static const uint64_t torn_value = 0xffffffffffffffffULL;
+
+int16_t TestRxHandler::process_received_message(const char *messageName, int32_t length, uint8_t *data)
+{
+	if (strcmp(messageName, "test_topic") == 0 && length == sizeof(received)) {
+		memcpy(&received, data, sizeof(received));
+
+		if (received == torn_value) {
+			torn = true;
+		}
+
+		if (received == test_value) {
+			__atomic_store_n(&updated, true, __ATOMIC_RELEASE);
+		}
+	}
+
+	return 0;
+}
+
+class MuorbShmTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		snprintf(_shm_name, sizeof(_shm_name), "/px4_uorb_test_%i", (int)getpid());
+		shm_unlink(_shm_name);
+	}
+
+	virtual void TearDown()
+	{
+		shm_unlink(_shm_name);
+	}
+
+	/** run func in a child process and return its exit status, or -1 if it did not exit normally */
+	int run_child(int (*func)(const char *shm_name, int fd), int fd)
+	{
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			/* a deadlock ends the child with SIGALRM */
+			alarm(5);
+			_exit(func(_shm_name, fd));
+		}
+
+		int status = 0;
+
+		if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+			return -1;
+		}
+
+		return WEXITSTATUS(status);
+	}
+
+	char _shm_name[32];
+};
+
+static int subscriber(const char *shm_name, int ready_fd)
+{
+	TestRxHandler handler;
+	uORB::ShmChannel *channel = uORB::ShmChannel::GetInstance();
+	channel->register_handler(&handler);
+
+	if (channel->Start(shm_name) != 0 || channel->add_subscription("test_topic", 1) != 0) {
+		return 1;
+	}
+
+	/* let the publisher start */
+	char c = 0;
+
+	if (write(ready_fd, &c, 1) != 1) {
+		return 2;
+	}
+
+	for (int i = 0; i < 200 && !__atomic_load_n(&handler.updated, __ATOMIC_ACQUIRE); ++i) {
+		usleep(10000);
+	}
+
+	channel->Stop();
+
+	if (!handler.updated) {
+		return 3;
+	}
+
+	return handler.torn ? 4 : 0;
+}
+
+static int publisher(const char *shm_name, int fd)
+{
+	uORB::ShmChannel *channel = uORB::ShmChannel::GetInstance();
+
+	if (channel->Start(shm_name) != 0) {
+		return 1;
+	}
+
+	uint64_t value = test_value;
+	int ret = channel->send_message("test_topic", sizeof(value), (uint8_t *)&value);
+	channel->Stop();
+	return ret == 0 ? 0 : 2;
+}
+
+static int lock_and_die(const char *shm_name, int fd)
+{
+	if (uORB::ShmChannel::GetInstance()->Start(shm_name) != 0) {
+		return 1;
+	}
+
+	int shm_fd = shm_open(shm_name, O_RDWR, 0666);
+
+	if (shm_fd < 0) {
+		return 2;
+	}
+
+	void *mem = mmap(nullptr, UORB_SHM_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+
+	if (mem == MAP_FAILED) {
+		return 3;
+	}
+
+	/* exit while holding the lock */
+	struct uorb_shm_header_s *header = (struct uorb_shm_header_s *)mem;
+	return pthread_mutex_lock(&header->lock) == 0 ? 0 : 4;
+}
+
+static int die_while_writing(const char *shm_name, int fd)
+{
+	uORB::ShmChannel *channel = uORB::ShmChannel::GetInstance();
+
+	/* a complete publication first, so that the topic data is allocated */
+	uint64_t value = 1;
+
+	if (channel->Start(shm_name) != 0 || channel->send_message("test_topic", sizeof(value), (uint8_t *)&value) != 0) {
+		return 1;
+	}
+
+	int shm_fd = shm_open(shm_name, O_RDWR, 0666);
+
+	if (shm_fd < 0) {
+		return 2;
+	}
+
+	void *mem = mmap(nullptr, UORB_SHM_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+
+	if (mem == MAP_FAILED) {
+		return 3;
+	}
+
+	/* exit in the middle of the next write, like send_message() would */
+	struct uorb_shm_header_s *header = (struct uorb_shm_header_s *)mem;
+
+	for (uint32_t i = 0; i < header->num_topics; ++i) {
+		struct uorb_shm_topic_s *topic = &header->topics[i];
+
+		if (strcmp(topic->name, "test_topic") == 0) {
+			__atomic_add_fetch(&topic->seq, 1, __ATOMIC_ACQUIRE);
+			topic->write_pid = getpid();
+			memset((uint8_t *)mem + topic->data_offset, 0xff, topic->size);
+			return (topic->seq & 1) ? 0 : 4;
+		}
+	}
+
+	return 5;
+}
+
+static int start_and_subscribe(const char *shm_name, int fd)
+{
+	uORB::ShmChannel *channel = uORB::ShmChannel::GetInstance();
+
+	/* both need the header lock */
+	if (channel->Start(shm_name) != 0 || channel->add_subscription("other_topic", 1) != 0) {
+		return 1;
+	}
+
+	channel->Stop();
+	return 0;
+}
+
+TEST_F(MuorbShmTest, PublishToOtherProcess)
+{
+	int ready[2];
+	ASSERT_EQ(0, pipe(ready));
+
+	pid_t subscriber_pid = fork();
+	ASSERT_LE(0, subscriber_pid);
+
+	if (subscriber_pid == 0) {
+		close(ready[0]);
+		alarm(5);
+		_exit(subscriber(_shm_name, ready[1]));
+	}
+
+	close(ready[1]);
+
+	char c;
+	ASSERT_EQ(1, read(ready[0], &c, 1)) << "subscriber failed to start";
+	close(ready[0]);
+
+	EXPECT_EQ(0, run_child(publisher, -1));
+
+	int status = 0;
+	ASSERT_EQ(subscriber_pid, waitpid(subscriber_pid, &status, 0));
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST_F(MuorbShmTest, WriterDied)
+{
+	int ready[2];
+	ASSERT_EQ(0, pipe(ready));
+
+	pid_t subscriber_pid = fork();
+	ASSERT_LE(0, subscriber_pid);
+
+	if (subscriber_pid == 0) {
+		close(ready[0]);
+		alarm(5);
+		_exit(subscriber(_shm_name, ready[1]));
+	}
+
+	close(ready[1]);
+
+	char c;
+	ASSERT_EQ(1, read(ready[0], &c, 1)) << "subscriber failed to start";
+	close(ready[0]);
+
+	// the next writer must recover the topic, and the subscriber must not receive the torn data
+	EXPECT_EQ(0, run_child(die_while_writing, -1));
+	EXPECT_EQ(0, run_child(publisher, -1));
+
+	int status = 0;
+	ASSERT_EQ(subscriber_pid, waitpid(subscriber_pid, &status, 0));
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST_F(MuorbShmTest, LockOwnerDied)
+{
+	ASSERT_EQ(0, run_child(lock_and_die, -1));
+	EXPECT_EQ(0, run_child(start_and_subscribe, -1));
+}
@@ -39,10 +39,11 @@ void _add_parameters()
 	};
 	rc2_x.val.i = 16;
 
-	param_array[0] = test_1;
-	param_array[1] = test_2;
-	param_array[2] = rc_x;
-	param_array[3] = rc2_x;
+	// sorted by name, like the generated parameters (param_find() uses a binary search)
+	param_array[0] = rc2_x;
+	param_array[1] = rc_x;
+	param_array[2] = test_1;
+	param_array[3] = test_2;
 	param_info_base = (struct param_info_s *) &param_array[0];
 	// needs to point at the end of the data,
 	//  therefore number of params + 1
@@ -91,10 +92,10 @@ TEST(ParamTest, ResetAll)
 
 	param_reset_all();
 
-	_assert_parameter_int_value((param_t)0, 2);
-	_assert_parameter_int_value((param_t)1, 4);
-	_assert_parameter_int_value((param_t)2, 8);
-	_assert_parameter_int_value((param_t)3, 16);
+	_assert_parameter_int_value((param_t)0, 16);
+	_assert_parameter_int_value((param_t)1, 8);
+	_assert_parameter_int_value((param_t)2, 2);
+	_assert_parameter_int_value((param_t)3, 4);
 }
 
 TEST(ParamTest, ResetAllExcludesOne)
@@ -105,10 +106,10 @@ TEST(ParamTest, ResetAllExcludesOne)
 	const char *excludes[] = {"RC_X"};
 	param_reset_excludes(excludes, 1);
 
-	_assert_parameter_int_value((param_t)0, 2);
-	_assert_parameter_int_value((param_t)1, 4);
-	_assert_parameter_int_value((param_t)2, 50);
-	_assert_parameter_int_value((param_t)3, 16);
+	_assert_parameter_int_value((param_t)0, 16);
+	_assert_parameter_int_value((param_t)1, 50);
+	_assert_parameter_int_value((param_t)2, 2);
+	_assert_parameter_int_value((param_t)3, 4);
 }
 
 TEST(ParamTest, ResetAllExcludesTwo)
@@ -119,10 +120,10 @@ TEST(ParamTest, ResetAllExcludesTwo)
 	const char *excludes[] = {"RC_X", "TEST_1"};
 	param_reset_excludes(excludes, 2);
 
-	_assert_parameter_int_value((param_t)0, 50);
-	_assert_parameter_int_value((param_t)1, 4);
+	_assert_parameter_int_value((param_t)0, 16);
+	_assert_parameter_int_value((param_t)1, 50);
 	_assert_parameter_int_value((param_t)2, 50);
-	_assert_parameter_int_value((param_t)3, 16);
+	_assert_parameter_int_value((param_t)3, 4);
 }
 
 TEST(ParamTest, ResetAllExcludesBoundaryCheck)
@@ -133,10 +134,10 @@ TEST(ParamTest, ResetAllExcludesBoundaryCheck)
 	const char *excludes[] = {"RC_X", "TEST_1"};
 	param_reset_excludes(excludes, 1);
 
-	_assert_parameter_int_value((param_t)0, 2);
-	_assert_parameter_int_value((param_t)1, 4);
-	_assert_parameter_int_value((param_t)2, 50);
-	_assert_parameter_int_value((param_t)3, 16);
+	_assert_parameter_int_value((param_t)0, 16);
+	_assert_parameter_int_value((param_t)1, 50);
+	_assert_parameter_int_value((param_t)2, 2);
+	_assert_parameter_int_value((param_t)3, 4);
 }
 
 TEST(ParamTest, ResetAllExcludesWildcard)
@@ -147,8 +148,20 @@ TEST(ParamTest, ResetAllExcludesWildcard)
 	const char *excludes[] = {"RC*"};
 	param_reset_excludes(excludes, 1);
 
-	_assert_parameter_int_value((param_t)0, 2);
-	_assert_parameter_int_value((param_t)1, 4);
-	_assert_parameter_int_value((param_t)2, 50);
-	_assert_parameter_int_value((param_t)3, 50);
+	_assert_parameter_int_value((param_t)0, 50);
+	_assert_parameter_int_value((param_t)1, 50);
+	_assert_parameter_int_value((param_t)2, 2);
+	_assert_parameter_int_value((param_t)3, 4);
+}
+
+TEST(ParamTest, FindAll)
+{
+	_add_parameters();
+
+	ASSERT_EQ((param_t)0, param_find("RC2_X"));
+	ASSERT_EQ((param_t)1, param_find("RC_X"));
+	ASSERT_EQ((param_t)2, param_find("TEST_1"));
+	ASSERT_EQ((param_t)3, param_find("TEST_2"));
+	ASSERT_EQ(PARAM_INVALID, param_find("TEST_3"));
+	ASSERT_EQ(PARAM_INVALID, param_find("A"));
 }